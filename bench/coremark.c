@@ -0,0 +1,164 @@
+// Copyright 2026 Ken Pettit <pettitkd@gmail.com>
+// Released under the MIT license.
+//
+// CoreMark style kernel, scaled for an 8-bit core:  a linked list walk
+// and sort, a small matrix multiply, and a state machine scan, with a
+// CRC over the results of each.
+//
+// Expect: 179
+
+struct node {
+    struct node *next;
+    unsigned char   data;
+    unsigned char   idx;
+};
+
+struct node nodes[8];
+unsigned int  mat_a[16];
+unsigned int  mat_b[16];
+unsigned int  mat_c[16];
+char input[16] = "12,-5.3e7,x9,+42";
+
+unsigned int crcu8(unsigned char data, unsigned int crc) {
+    unsigned char i;
+    for (i = 0; i < 8; i++) {
+        if ((data ^ crc) & 1)
+            crc = (crc >> 1) ^ 0xA001;
+        else
+            crc = crc >> 1;
+        data = data >> 1;
+    }
+    return crc;
+}
+
+struct node *list_init(void) {
+    struct node *n = nodes;
+    unsigned char i;
+    for (i = 0; i < 8; i++) {
+        n->data = (i * 37 + 11) & 0x7F;
+        n->idx = i;
+        if (i < 7)
+            n->next = n + 1;
+        else
+            n->next = 0;
+        n++;
+    }
+    return nodes;
+}
+
+// Insertion sort of the list by data
+struct node *list_sort(struct node *head) {
+    struct node *sorted = 0;
+    struct node *n, *p, *next;
+    while (head) {
+        next = head->next;
+        if (sorted == 0 || head->data < sorted->data) {
+            head->next = sorted;
+            sorted = head;
+        } else {
+            p = sorted;
+            while (1) {
+                n = p->next;
+                if (n == 0 || n->data > head->data)
+                    break;
+                p = n;
+            }
+            head->next = n;
+            p->next = head;
+        }
+        head = next;
+    }
+    return sorted;
+}
+
+unsigned int list_bench(void) {
+    struct node *n;
+    unsigned int crc = 0;
+    n = list_sort(list_init());
+    while (n) {
+        crc = crcu8(n->data, crc);
+        crc = crcu8(n->idx, crc);
+        n = n->next;
+    }
+    return crc;
+}
+
+// The indexes are kept in chars, since the compiler does char math in a
+// char, and the elements in ints so their products are not
+unsigned int matrix_bench(void) {
+    unsigned char i, j, k, a, b;
+    unsigned int sum, crc = 0;
+    for (i = 0; i < 16; i++) {
+        a = i + 1;
+        b = 16 - i;
+        mat_a[i] = a;
+        mat_b[i] = b;
+    }
+    for (i = 0; i < 4; i++) {
+        for (j = 0; j < 4; j++) {
+            sum = 0;
+            for (k = 0; k < 4; k++) {
+                a = i * 4 + k;
+                b = k * 4 + j;
+                sum = sum + mat_a[a] * mat_b[b];
+            }
+            a = i * 4 + j;
+            mat_c[a] = sum;
+            crc = crcu8(sum, crc);
+        }
+    }
+    return crc;
+}
+
+// Classify the comma separated fields of input as int, float or invalid
+unsigned int state_bench(void) {
+    unsigned char i, state = 0;
+    unsigned int r;
+    unsigned char counts[4];
+    char c;
+    counts[0] = counts[1] = counts[2] = counts[3] = 0;
+    for (i = 0; i < 16; i++) {
+        c = input[i];
+        if (c == ',') {
+            counts[state]++;
+            state = 0;
+            continue;
+        }
+        switch (state) {
+        case 0:
+            if (c == '+' || c == '-' || (c >= '0' && c <= '9'))
+                state = 1;
+            else
+                state = 3;
+            break;
+        case 1:
+            if (c == '.' || c == 'e')
+                state = 2;
+            else if (c < '0' || c > '9')
+                state = 3;
+            break;
+        case 2:
+            if ((c < '0' || c > '9') && c != 'e')
+                state = 3;
+            break;
+        default:
+            break;
+        }
+    }
+    counts[state]++;
+
+    // Built in an int, since a char shifted by the compiler stays a char
+    r = counts[3];
+    r = (r << 4) | counts[2];
+    return (r << 4) | counts[1];
+}
+
+char main(void) {
+    unsigned int crc;
+    crc = crcu8(list_bench(), 0);
+    crc = crcu8(matrix_bench(), crc);
+    crc = crcu8(state_bench(), crc);
+    return crc ^ (crc >> 8);
+}
+
+void porta_isr(void) { }
@@ -0,0 +1,54 @@
+// Copyright 2026 Ken Pettit <pettitkd@gmail.com>
+// Released under the MIT license.
+//
+// CRC benchmark:  bitwise CRC-8 and CRC-16/CCITT over a message buffer.
+//
+// Expect: 17
+
+unsigned char msg[32] = {
+    0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37, 0x38,
+    0x39, 0x4C, 0x49, 0x53, 0x41, 0x20, 0x63, 0x6F,
+    0x72, 0x65, 0x20, 0x62, 0x65, 0x6E, 0x63, 0x68,
+    0x6D, 0x61, 0x72, 0x6B, 0x21, 0x0D, 0x0A, 0x00
+};
+
+unsigned char crc8(unsigned char *d, unsigned char n) {
+    unsigned char c = 0;
+    unsigned char i, j;
+    for (i = 0; i < n; i++) {
+        c = c ^ d[i];
+        for (j = 0; j < 8; j++) {
+            if (c & 0x80)
+                c = (c << 1) ^ 0x07;
+            else
+                c = c << 1;
+        }
+    }
+    return c;
+}
+
+unsigned int crc16(unsigned char *d, unsigned char n) {
+    unsigned int c = 0xFFFF;
+    unsigned char i, j;
+    for (i = 0; i < n; i++) {
+        c = c ^ (d[i] << 8);
+        for (j = 0; j < 8; j++) {
+            if (c & 0x8000)
+                c = (c << 1) ^ 0x1021;
+            else
+                c = c << 1;
+        }
+    }
+    return c;
+}
+
+char main(void) {
+    unsigned int c16;
+    unsigned char c8, r;
+    c8 = crc8(msg, 32);
+    c16 = crc16(msg, 32);
+    r = c8 ^ c16 ^ (c16 >> 8);
+    return r;
+}
+
+void porta_isr(void) { }
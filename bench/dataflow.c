@@ -0,0 +1,57 @@
+// Copyright 2026 Ken Pettit <pettitkd@gmail.com>
+// Released under the MIT license.
+//
+// Acc dataflow benchmark:  a command interpreter whose switch compare trees
+// reload the same byte, and whose chained stores and loads of globals leave
+// the acc or ix holding the value the next instruction loads again.
+//
+// Expect: 90
+
+unsigned char script[20] = {
+    1, 4, 2, 7, 0, 3, 1, 9, 2, 2, 3, 5, 1, 1, 0, 8, 2, 6, 3, 0
+};
+
+unsigned char mode;
+unsigned char acc;
+unsigned char hi, lo, last;
+
+void op(unsigned char cmd, unsigned char arg) {
+    switch (cmd) {
+    case 0:
+        acc = arg;
+        break;
+    case 1:
+        acc = acc + arg;
+        break;
+    case 2:
+        acc = acc - arg;
+        break;
+    default:
+        acc = acc ^ arg;
+        break;
+    }
+    hi = lo = last = acc;
+}
+
+void step(void) {
+    switch (mode) {
+    case 0: mode = 2; break;
+    case 1: mode = 0; break;
+    case 2: mode = 3; break;
+    case 3: mode = 1; break;
+    case 4: mode = 0; break;
+    }
+}
+
+char main(void) {
+    unsigned char i, r;
+    r = 0;
+    for (i = 0; i < 20; i = i + 2) {
+        op(script[i], script[i + 1]);
+        step();
+        r = r + mode + last;
+    }
+    return r + hi + lo;
+}
+
+void porta_isr(void) { }
@@ -0,0 +1,67 @@
+// Copyright 2026 Ken Pettit <pettitkd@gmail.com>
+// Released under the MIT license.
+//
+// Static frame benchmark:  built with -fstatic-frames, so the char locals
+// of each function live in its overlaid static frame.  Functions whose
+// locals all moved have no stack frame of their own, yet still spill and
+// push through the stack around their calls, and others keep int locals
+// on the stack beside their static ones.
+//
+// Flags: -fstatic-frames
+// Expect: 104
+
+unsigned char k = 3;
+int bias = 1000;
+
+char two(void) {
+    return 2;
+}
+
+int twice(int x) {
+    return x + x;
+}
+
+char mix(char a, int b, char c) {
+    return a + c + b;
+}
+
+// Char locals only, calling with int and char arguments
+char calls(char n) {
+    char i, t = 0;
+    for (i = 0; i < n; i++)
+        t = t + twice(i);
+    i = n + 1;
+    return t + mix(i, 300, n);
+}
+
+// Char locals only, compared, subtracted and multiplied with each other
+char arith(char n) {
+    unsigned char a, b, r;
+    a = two();
+    b = n;
+    r = 0;
+    if (a < b)
+        r = b - a;
+    if (b > a)
+        r = r * k;
+    return r - a;
+}
+
+// An int local on the stack beside char locals in the static frame
+int both(char n) {
+    char i;
+    int sum = 0;
+    for (i = 0; i < n; i++)
+        sum = sum + twice(i) - bias;
+    return sum + bias * n;
+}
+
+char main(void) {
+    char r, s;
+    r = calls(4);
+    s = arith(9);
+    r = r + s;
+    return r + both(5);
+}
+
+void porta_isr(void) { }
@@ -0,0 +1,88 @@
+// Copyright 2026 Ken Pettit <pettitkd@gmail.com>
+// Released under the MIT license.
+//
+// State machine benchmark:  a byte protocol parser driven by a switch, and
+// a table driven debouncer, fed from a canned input stream.
+//
+// Expect: 35
+
+#define ST_IDLE     0
+#define ST_SYNC     1
+#define ST_LEN      2
+#define ST_DATA     3
+#define ST_CHECK    4
+
+unsigned char stream[24] = {
+    0x00, 0xAA, 0x55, 3, 10, 20, 30, 60,
+    0xAA, 0x55, 2, 7, 9, 17, 0x12, 0xAA,
+    0x55, 1, 200, 201, 0xAA, 0x00, 0x55, 0x01
+};
+
+unsigned char state;
+unsigned char length;
+unsigned char count;
+unsigned char sum;
+unsigned char good;
+unsigned char bad;
+
+void parse(unsigned char c) {
+    switch (state) {
+    case ST_IDLE:
+        if (c == 0xAA)
+            state = ST_SYNC;
+        break;
+    case ST_SYNC:
+        state = c == 0x55 ? ST_LEN : ST_IDLE;
+        break;
+    case ST_LEN:
+        length = c;
+        count = 0;
+        sum = c;
+        state = c ? ST_DATA : ST_CHECK;
+        break;
+    case ST_DATA:
+        sum = sum + c;
+        count++;
+        if (count == length)
+            state = ST_CHECK;
+        break;
+    case ST_CHECK:
+        if (sum == c)
+            good = good + 1;
+        else
+            bad = bad + 1;
+        state = ST_IDLE;
+        break;
+    default:
+        state = ST_IDLE;
+        break;
+    }
+}
+
+// Next debounce state for each state and input level
+unsigned char next_state[8] = { 0, 1, 0, 2, 1, 3, 2, 3 };
+
+unsigned char debounce(unsigned char input) {
+    unsigned char s = 0;
+    unsigned char edges = 0;
+    unsigned char i, n;
+    for (i = 0; i < 8; i++) {
+        n = next_state[(s << 1) | (input & 1)];
+        input = input >> 1;
+        if (n == 3 && s != 3)
+            edges = edges + 1;
+        s = n;
+    }
+    return edges;
+}
+
+char main(void) {
+    unsigned char i, r;
+    for (i = 0; i < 24; i++)
+        parse(stream[i]);
+    r = good + (bad << 4);
+    r = r + debounce(0x3C) + debounce(0xF3);
+    return r;
+}
+
+void porta_isr(void) { }
@@ -0,0 +1,71 @@
+// Copyright 2026 Ken Pettit <pettitkd@gmail.com>
+// Released under the MIT license.
+//
+// Integer math benchmark:  16-bit multiply, divide and remainder through
+// the runtime library, plus the char arithmetic the core does natively.
+//
+// Expect: 4
+
+int table[8] = { 3, -7, 120, 255, -300, 1000, 17, -1 };
+
+int gcd(int a, int b) {
+    int t;
+    while (b != 0) {
+        t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+unsigned char isqrt(unsigned char n) {
+    unsigned char r = 0;
+    unsigned char bit = 0x40;
+    unsigned char t;
+    while (bit > n)
+        bit = bit >> 2;
+    while (bit != 0) {
+        t = r + bit;
+        if (n >= t) {
+            n = n - t;
+            r = (r >> 1) + bit;
+        } else
+            r = r >> 1;
+        bit = bit >> 2;
+    }
+    return r;
+}
+
+int dot(int *a, int *b, char n) {
+    int sum = 0;
+    char i;
+    for (i = 0; i < n; i++)
+        sum = sum + a[i] * b[i];
+    return sum;
+}
+
+unsigned char fib8(unsigned char n) {
+    unsigned char a = 0, b = 1, t;
+    while (n > 0) {
+        t = a + b;
+        a = b;
+        b = t;
+        n--;
+    }
+    return a;
+}
+
+char main(void) {
+    int r;
+    r = gcd(1071, 462);
+    r = r + isqrt(200);
+    r = r + dot(table, table, 8);
+    r = r + table[5] / 7 + table[4] % 11;
+    r = r + fib8(13);
+    return r;
+}
+
+void porta_isr(void) { }
+
+// Called by the runtime library on a divide by zero
+void _div0_vec(void) { }
@@ -0,0 +1,189 @@
+#!/bin/bash
+#
+# Module:  Benchmark suite and regression harness for lisa-tools
+#
+# Copyright 2026 by Ken Pettit <pettitkd@gmail.com>
+#
+# Builds each benchmark in this directory at -O0, -O1, -O2 and -Os through
+# lisa_cc, lisa_ld and the runtime library, runs it on lisa_sim, and prints
+# the code words, data bytes and cycles of each build.  The numbers are
+# compared with baseline.txt:  a build fails when any of them grows by more
+# than the threshold.  A build also fails, even with -u, when it does not
+# compile, link and return its expected value within the cycle limit.
+#
+# Each benchmark returns a checksum from main.  The value it must return is
+# given by an "Expect:" comment in the source, and any lisa_cc options it
+# must be built with by a "Flags:" comment.
+#
+# With -p each build is profile guided:  the benchmark is first built with
+# lisa_cc -fprofile-generate and run to write a branch profile, which the
+# measured build is then compiled with through -fprofile-use.
+#
+# usage:  run_bench.sh [-u] [-p] [-t percent] [-n cycles] [benchmark...]
+#
+#    -u              Write the results to baseline.txt instead of comparing
+#    -p              Build with a branch profile of a first instrumented run
+#    -t percent      Regression threshold (default 2)
+#    -n cycles       Cycle limit of each run (default 2000000)
+#
+# ------------------------------------------------------------------------------
+
+BENCHDIR=$(cd "$(dirname "$0")" && pwd)
+TOP=$(dirname "$BENCHDIR")
+CC=$TOP/lisa_cc/lisa_cc
+LD=$TOP/lisa_ld/lisa_ld
+SIM=$TOP/lisa_sim/lisa_sim
+LIBDIR=$TOP/lisa_as/lib/out
+SCRIPT=$TOP/lisa_ld/lisa.ld
+OUT=$BENCHDIR/out
+BASELINE=$BENCHDIR/baseline.txt
+LEVELS="0 1 2 s"
+
+update=0
+pgo=0
+threshold=2
+maxcycles=2000000
+
+while getopts "upt:n:h" opt; do
+    case $opt in
+        u) update=1 ;;
+        p) pgo=1 ;;
+        t) threshold=$OPTARG ;;
+        n) maxcycles=$OPTARG ;;
+        *) sed -n '/^# usage/,/^# ---/p' "$0" | sed 's/^# \{0,1\}//;$d'; exit 1 ;;
+    esac
+done
+shift $((OPTIND - 1))
+
+if [ $# -gt 0 ]; then
+    benches="$*"
+else
+    benches=$(cd "$BENCHDIR" && ls *.c | sed 's/\.c$//')
+fi
+
+for tool in "$CC" "$LD" "$SIM" "$LIBDIR/crt0.rel" "$LIBDIR/liblisa.lar"; do
+    if [ ! -f "$tool" ]; then
+        echo "Missing $tool, run make first"
+        exit 1
+    fi
+done
+mkdir -p "$OUT"
+
+# Value of a symbol in the map file of a build
+symbol() {
+    echo $(( $(awk -v name="$2" '$2 == name { print $1; exit }' "$1") ))
+}
+
+# Field of the baseline entry of a build
+baseline() {
+    [ -f "$BASELINE" ] && awk -v b="$1" -v o="$2" -v f="$3" \
+        '$1 == b && $2 == o { print $f; exit }' "$BASELINE"
+}
+
+# Percent change from $1 to $2, and whether it is over the threshold
+delta() {
+    awk -v old="$1" -v new="$2" -v t="$threshold" 'BEGIN {
+        if (old == "" || old == 0) { printf "      -"; exit 0 }
+        d = 100.0 * (new - old) / old
+        printf "%+6.1f%%", d
+        exit d > t
+    }'
+}
+
+results=$(mktemp)
+failed=0
+
+printf "%-10s %-4s %6s %7s %6s %7s %9s %7s  %s\n" "Benchmark" "Opt" "Code" "" \
+    "Data" "" "Cycles" "" "Result"
+printf "%s\n" "------------------------------------------------------------------------"
+
+for b in $benches; do
+    src=$BENCHDIR/$b.c
+    expect=$(sed -n 's/.*Expect: *\([0-9-]*\).*/\1/p' "$src" | head -1)
+    srcflags=$(sed -n 's/^\/\/ *Flags: *//p' "$src" | head -1)
+
+    for o in $LEVELS; do
+        base=$OUT/$b.O$o
+        code=0; data=0; cycles=0
+        flags="$srcflags"
+
+        # Collect the branch profile of an instrumented build
+        if [ $pgo -eq 1 ]; then
+            rm -f "$base.prof"
+            "$CC" -w -O$o $srcflags -fprofile-generate -c -o "$base.gen.rel" "$src" > "$base.cclog" 2>&1 &&
+            "$LD" -T "$SCRIPT" -M -o "$base.gen.lst" "$LIBDIR/crt0.rel" "$base.gen.rel" \
+                "$LIBDIR/liblisa.lar" > "$base.ldlog" 2>&1 &&
+            "$SIM" -w 16 -n "$maxcycles" -m "$base.gen.map" -g "$base.prof" "$base.gen.lst" \
+                > "$base.simlog" 2>&1
+            [ -f "$base.prof" ] && flags="$flags -fprofile-use=$base.prof"
+        fi
+
+        # lisa_cc reports some errors only in its output
+        if ! "$CC" -w -O$o $flags -c -o "$base.rel" "$src" > "$base.cclog" 2>&1 ||
+                grep -q "ERROR!" "$base.cclog"; then
+            result="build"
+        elif ! "$LD" -T "$SCRIPT" -M -o "$base.lst" "$LIBDIR/crt0.rel" "$base.rel" \
+                "$LIBDIR/liblisa.lar" > "$base.ldlog" 2>&1; then
+            result="link"
+        else
+            code=$(symbol "$base.map" _etext)
+            data=$(( $(symbol "$base.map" _edata) - $(symbol "$base.map" _sdata) +
+                     $(symbol "$base.map" _bss_end) - $(symbol "$base.map" _bss_start) ))
+
+            "$SIM" -w 16 -n "$maxcycles" "$base.lst" > "$base.simlog" 2>&1
+            cycles=$(awk '/^Cycles:/ { print $2 }' "$base.simlog")
+            stopped=$(sed -n 's/^Stopped: *//p' "$base.simlog")
+            case "$stopped" in
+                "main returned, A = "*)
+                    a=$(( $(echo "$stopped" | sed 's/.*A = \(0x[0-9A-F]*\).*/\1/') ))
+                    if [ -z "$expect" ] || [ $a -eq $(( expect & 0xFF )) ]; then
+                        result="ok"
+                    else
+                        result="wrong"
+                    fi
+                    ;;
+                "cycle limit"*)   result="limit" ;;
+                "invalid"*)       result="invalid" ;;
+                *)                result="stopped" ;;
+            esac
+        fi
+        echo "$b O$o $code $data $cycles $result" >> "$results"
+
+        # Compare with the baseline
+        status=0
+        dcode=$(delta "$(baseline $b O$o 3)" $code) || status=1
+        ddata=$(delta "$(baseline $b O$o 4)" $data) || status=1
+        dcycles=$(delta "$(baseline $b O$o 5)" $cycles) || status=1
+        note=""
+        if [ $update -eq 0 ] && [ $status -ne 0 ]; then
+            failed=1
+            note="  REGRESSION"
+        fi
+        if [ "$result" != "ok" ]; then
+            failed=1
+            note="$note  FAILED"
+        fi
+
+        printf "%-10s -O%-2s %6d %7s %6d %7s %9d %7s  %s%s\n" $b $o $code "$dcode" \
+            $data "$ddata" $cycles "$dcycles" $result "$note"
+    done
+done
+
+if [ $update -eq 1 ] && [ $failed -ne 0 ]; then
+    echo
+    echo "FAILED:  baseline not written, as not every build returned its expected value"
+elif [ $update -eq 1 ]; then
+    {
+        echo "# lisa-tools benchmark baseline, written by run_bench.sh -u"
+        echo "# benchmark  opt  code_words  data_bytes  cycles  result"
+        cat "$results"
+    } > "$BASELINE"
+    echo
+    echo "Baseline written to $BASELINE"
+elif [ $failed -ne 0 ]; then
+    echo
+    echo "FAILED:  failed builds or regressions over ${threshold}% against $BASELINE"
+fi
+rm -f "$results"
+
+exit $failed
@@ -0,0 +1,86 @@
+// Copyright 2026 Ken Pettit <pettitkd@gmail.com>
+// Released under the MIT license.
+//
+// String benchmark:  the length, copy, compare, search and reverse loops
+// of a small string library, all through char pointers.
+//
+// Expect: 29
+
+char src[24] = "The quick brown fox";
+char dst[24];
+char key[8] = "brown";
+
+unsigned char str_len(char *s) {
+    unsigned char n = 0;
+    while (*s++)
+        n++;
+    return n;
+}
+
+void str_cpy(char *d, char *s) {
+    while ((*d++ = *s++) != 0)
+        ;
+}
+
+char str_cmp(char *a, char *b) {
+    while (*a && *a == *b) {
+        a++;
+        b++;
+    }
+    if (*a == *b)
+        return 0;
+    return *a < *b ? -1 : 1;
+}
+
+char *str_chr(char *s, char c) {
+    while (*s) {
+        if (*s == c)
+            return s;
+        s++;
+    }
+    return 0;
+}
+
+char str_find(char *s, char *k) {
+    char i, j;
+    for (i = 0; s[i]; i++) {
+        for (j = 0; k[j] && s[i + j] == k[j]; j++)
+            ;
+        if (k[j] == 0)
+            return i;
+    }
+    return -1;
+}
+
+void str_rev(char *s, unsigned char n) {
+    unsigned char i = 0, j = n;
+    j--;
+    char t;
+    while (i < j) {
+        t = s[i];
+        s[i] = s[j];
+        s[j] = t;
+        i++;
+        j--;
+    }
+}
+
+void str_upper(char *s) {
+    for (; *s; s++)
+        if (*s >= 'a' && *s <= 'z')
+            *s = *s & 0xDF;
+}
+
+char main(void) {
+    char r;
+    str_cpy(dst, src);
+    str_upper(dst);
+    str_rev(dst, str_len(dst));
+    r = str_cmp(src, dst);
+    r = r + str_find(src, key);
+    if (str_chr(src, 'x') != 0)
+        r++;
+    return r + str_len(dst);
+}
+
+void porta_isr(void) { }
@@ -0,0 +1,78 @@
+// Copyright 2026 Ken Pettit <pettitkd@gmail.com>
+// Released under the MIT license.
+//
+// Struct benchmark:  arrays of records updated through pointers, member
+// access at small and large offsets, and struct copies.
+//
+// Expect: 68
+
+struct point {
+    char    x;
+    char    y;
+};
+
+struct body {
+    char    x;
+    char    y;
+    char    vx;
+    char    vy;
+    int     mass;
+    char    alive;
+};
+
+struct body bodies[6];
+struct point origin;
+
+void init(struct body *b, char n) {
+    char i;
+    for (i = 0; i < n; i++) {
+        b->x = i;
+        b->y = i * 2;
+        b->vx = 1;
+        b->vy = -1;
+        b->mass = 100 + i;
+        b->alive = 1;
+        b++;
+    }
+}
+
+void step(struct body *b, char n) {
+    char i;
+    for (i = 0; i < n; i++) {
+        if (b->alive) {
+            b->x = b->x + b->vx;
+            b->y = b->y + b->vy;
+            if (b->y < 0) {
+                b->vy = 1;
+                b->mass = b->mass + -10;
+            }
+            if (b->mass < 50)
+                b->alive = 0;
+        }
+        b++;
+    }
+}
+
+int total_mass(struct body *b, char n) {
+    int m = 0;
+    char i;
+    for (i = 0; i < n; i++) {
+        if (b[i].alive)
+            m = m + b[i].mass;
+    }
+    return m;
+}
+
+char main(void) {
+    char i;
+    struct point p;
+    init(bodies, 6);
+    for (i = 0; i < 10; i++)
+        step(bodies, 6);
+    p.x = bodies[3].x;
+    p.y = bodies[3].y;
+    origin = p;
+    return total_mass(bodies, 6) + origin.x + origin.y;
+}
+
+void porta_isr(void) { }
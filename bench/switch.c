@@ -0,0 +1,49 @@
+// Copyright 2026 Ken Pettit <pettitkd@gmail.com>
+// Released under the MIT license.
+//
+// Switch benchmark:  int switches dispatched through a jump table and
+// through a binary tree of compares, over values in and out of range of
+// their cases.  Both need the int relational compares of liblisa.
+//
+// Expect: 6
+
+int dense(int x) {
+    switch (x) {
+    case 0: return 3;
+    case 1: return 5;
+    case 2: return 7;
+    case 3: return 11;
+    case 4: return 13;
+    case 5: return 17;
+    case 6: return 19;
+    }
+    return 1;
+}
+
+int sparse(int x) {
+    switch (x) {
+    case -300: return 2;
+    case 1:    return 3;
+    case 100:  return 5;
+    case 200:  return 7;
+    case 300:  return 11;
+    case 400:  return 13;
+    case 500:  return 17;
+    case 600:  return 19;
+    }
+    return 1;
+}
+
+int vals[12] = { -300, -1, 0, 3, 6, 7, 1, 99, 100, 250, 600, 601 };
+
+char main(void) {
+    unsigned char i;
+    unsigned int r = 0;
+    for (i = 0; i < 12; i++) {
+        r = r + dense(vals[i]);
+        r = (r << 1) ^ sparse(vals[i]);
+    }
+    return r ^ (r >> 8);
+}
+
+void porta_isr(void) { }
@@ -0,0 +1,566 @@
+// ------------------------------------------------------------------------------
+// (c) Copyright, Ken Pettit, BSD License
+//         All Rights Reserved
+// ------------------------------------------------------------------------------
+//
+//  File        : relbin.cpp
+//  Revision    : 1.0
+//  Author      : Ken Pettit
+//  Created     : 10/16/2026
+//
+// Description:
+//    Reading, writing and validation of the text and binary relocatable
+//    object formats.  This file is built into both lisa_as and lisa_ld and
+//    uses the including tool's errors.h.
+//
+// Modifications:
+//
+//    Author            Date        Ver  Description
+//    ================  ==========  ===  =======================================
+//    Ken Pettit        10/16/2026  1.0  Initial version
+//
+// ------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+
+#include "relbin.h"
+#include "errors.h"
+
+/*
+=============================================================================
+Destructor
+=============================================================================
+*/
+CRelObject::~CRelObject()
+{
+    std::vector<CRelSection *>::iterator it;
+
+    for (it = m_Sections.begin(); it != m_Sections.end(); ++it)
+        delete *it;
+}
+
+/*
+=============================================================================
+Tests if the file starts with the binary object magic
+=============================================================================
+*/
+bool CRelObject::IsBinary(const char *pFilename)
+{
+    FILE*   fd;
+    char    magic[4];
+    bool    isBinary = false;
+
+    if ((fd = fopen(pFilename, "rb")) != NULL)
+    {
+        isBinary = fread(magic, 1, sizeof(magic), fd) == sizeof(magic) &&
+                   memcmp(magic, RELBIN_MAGIC, sizeof(magic)) == 0;
+        fclose(fd);
+    }
+
+    return isBinary;
+}
+
+/*
+=============================================================================
+Reads text records from an open file.  Records are interpreted the same
+way lisa_ld's CFile does.
+=============================================================================
+*/
+int CRelObject::ReadText(FILE* fd, const char *pFilename)
+{
+    char            sLine[512];
+    char*           pComment;
+    char*           sNextToken;
+    char*           pArgs[4];
+    int             argc, line = 0;
+    int             minArgs, word;
+    CRelSection*    pSection = NULL;
+    RelSymbol_t     sym;
+    RelReloc_t      rel;
+    RelBinFill_t    fill;
+
+    while (fgets(sLine, sizeof sLine, fd) != NULL)
+    {
+        line++;
+
+        // Remove any comment and split the record into arguments
+        if ((pComment = strchr(sLine, '#')) != NULL)
+            *pComment = '\0';
+        argc = 0;
+        pArgs[0] = strtok_r(sLine, " \t\r\n", &sNextToken);
+        while (pArgs[argc] != NULL && ++argc < 4)
+            pArgs[argc] = strtok_r(NULL, " \t\r\n", &sNextToken);
+
+        // Skip empty lines
+        if (argc == 0)
+            continue;
+
+        // Validate the record type and its argument count
+        minArgs = strchr("saiu", pArgs[0][0]) != NULL ? 2 : 3;
+        if (pArgs[0][1] != '\0' || strchr("splaieRru", pArgs[0][0]) == NULL ||
+            argc < minArgs)
+        {
+            fprintf(m_pLog, "%s: Line %d: Invalid relocation record\n", pFilename, line);
+            return ERROR_INVALID_SYNTAX;
+        }
+
+        // Start a new section
+        if (pArgs[0][0] == 's')
+        {
+            pSection = new CRelSection;
+            pSection->m_Name = pArgs[1];
+            m_Sections.push_back(pSection);
+            continue;
+        }
+
+        if (pSection == NULL)
+        {
+            fprintf(m_pLog, "%s: Line %d: Records must be in a section\n", pFilename, line);
+            return ERROR_INVALID_SYNTAX;
+        }
+
+        switch (pArgs[0][0])
+        {
+            case 'p':
+            case 'l':
+                sym.name = pArgs[1];
+                sym.type = pArgs[0][0] == 'p' ? RELBIN_SYM_PUBLIC : RELBIN_SYM_LOCAL;
+                sym.value = strtol(pArgs[2], NULL, 0);
+                pSection->m_Symbols.push_back(sym);
+                continue;
+
+            case 'a':
+                pSection->m_Address = strtol(pArgs[1], NULL, 0);
+                if (pSection->m_Address < 0 || pSection->m_Address >= RELBIN_MAX_WORDS)
+                {
+                    fprintf(m_pLog, "%s: Line %d: Address outside the section\n",
+                        pFilename, line);
+                    return ERROR_INVALID_SYNTAX;
+                }
+                continue;
+        }
+
+        // Every word placed must lie inside the section
+        if (pSection->m_Address >= RELBIN_MAX_WORDS)
+        {
+            fprintf(m_pLog, "%s: Line %d: Code past the end of the section\n",
+                pFilename, line);
+            return ERROR_INVALID_SYNTAX;
+        }
+
+        // Remaining records place words at the current address
+        if (pSection->m_Address < pSection->m_FirstCode)
+            pSection->m_FirstCode = pSection->m_Address;
+
+        switch (pArgs[0][0])
+        {
+            case 'u':
+                fill.offset = pSection->m_Address;
+                fill.count = strtol(pArgs[1], NULL, 0);
+                if (fill.count < 0 || fill.count > RELBIN_MAX_WORDS - fill.offset)
+                {
+                    fprintf(m_pLog, "%s: Line %d: Fill outside the section\n",
+                        pFilename, line);
+                    return ERROR_INVALID_SYNTAX;
+                }
+                pSection->m_Fills.push_back(fill);
+                pSection->m_Address += fill.count;
+                break;
+
+            case 'i':
+            case 'e':
+            case 'r':
+            case 'R':
+                word = strtol(pArgs[1], NULL, 0);
+                if (pArgs[0][0] != 'i')
+                {
+                    rel.type = pArgs[0][0] == 'e' ? RELBIN_REL_EXTERN :
+                               pArgs[0][0] == 'R' ? RELBIN_REL_SYMBOL : RELBIN_REL_FUNCTION;
+                    rel.offset = pSection->m_Address;
+                    rel.opcode = word;
+                    rel.name = pArgs[2];
+                    pSection->m_Relocs.push_back(rel);
+                }
+                if ((int) pSection->m_Code.size() <= pSection->m_Address)
+                    pSection->m_Code.resize(pSection->m_Address + 1, 0);
+                pSection->m_Code[pSection->m_Address++] = word;
+                break;
+        }
+
+        if (pSection->m_Address > pSection->m_LastCode)
+            pSection->m_LastCode = pSection->m_Address;
+    }
+
+    // Every section holds its words from offset 0 through m_LastCode
+    for (std::vector<CRelSection *>::iterator it = m_Sections.begin();
+         it != m_Sections.end(); ++it)
+    {
+        (*it)->m_Code.resize((*it)->m_LastCode, 0);
+    }
+
+    return ERROR_NONE;
+}
+
+/*
+=============================================================================
+Writes the object as text records
+=============================================================================
+*/
+int CRelObject::WriteText(FILE* fd)
+{
+    std::vector<CRelSection *>::iterator        it;
+    std::vector<RelSymbol_t>::iterator          sit;
+    std::map<int, RelReloc_t *>                 relocs;
+    std::map<int, RelReloc_t *>::iterator       rit;
+    std::map<int, int>                          fills;
+    std::map<int, int>::iterator                fit;
+    CRelSection*    pSection;
+    int             x;
+
+    for (it = m_Sections.begin(); it != m_Sections.end(); ++it)
+    {
+        pSection = *it;
+        fprintf(fd, "s %s\n", pSection->m_Name.c_str());
+
+        for (sit = pSection->m_Symbols.begin(); sit != pSection->m_Symbols.end(); ++sit)
+            fprintf(fd, "%c %s 0x%04X\n", sit->type == RELBIN_SYM_PUBLIC ? 'p' : 'l',
+                    sit->name.c_str(), sit->value);
+
+        if (pSection->m_FirstCode == RELBIN_NO_CODE)
+            continue;
+
+        // Index the relocations and fills by offset
+        relocs.clear();
+        fills.clear();
+        for (x = 0; x < (int) pSection->m_Relocs.size(); x++)
+            relocs[pSection->m_Relocs[x].offset] = &pSection->m_Relocs[x];
+        for (x = 0; x < (int) pSection->m_Fills.size(); x++)
+            fills[pSection->m_Fills[x].offset] = pSection->m_Fills[x].count;
+
+        fprintf(fd, "a 0x%04X\n", pSection->m_FirstCode);
+        for (x = pSection->m_FirstCode; x < pSection->m_LastCode; )
+        {
+            if ((fit = fills.find(x)) != fills.end() && fit->second > 0)
+            {
+                fprintf(fd, "u %d\n", fit->second);
+                x += fit->second;
+                continue;
+            }
+
+            if ((rit = relocs.find(x)) == relocs.end())
+                fprintf(fd, "i 0x%04X\n", pSection->m_Code[x]);
+            else
+                fprintf(fd, "%c 0x%04X %s\n", rit->second->type == RELBIN_REL_EXTERN ? 'e' :
+                        rit->second->type == RELBIN_REL_SYMBOL ? 'R' : 'r',
+                        rit->second->opcode, rit->second->name.c_str());
+            x++;
+        }
+
+        // Restore the final section address if it is not the end of code
+        if (pSection->m_Address != pSection->m_LastCode)
+            fprintf(fd, "a 0x%04X\n", pSection->m_Address);
+    }
+
+    return ERROR_NONE;
+}
+
+/*
+=============================================================================
+Adds a string to the string table being built, returning its offset
+=============================================================================
+*/
+static uint32_t AddString(std::string& strings, std::map<std::string, uint32_t>& index,
+        const std::string& str)
+{
+    std::map<std::string, uint32_t>::iterator   it;
+    uint32_t    offset;
+
+    if ((it = index.find(str)) != index.end())
+        return it->second;
+
+    offset = strings.size();
+    strings.append(str.c_str(), str.size() + 1);
+    index.insert(std::pair<std::string, uint32_t>(str, offset));
+    return offset;
+}
+
+/*
+=============================================================================
+Writes the object in binary format
+=============================================================================
+*/
+int CRelObject::WriteBin(const char *pFilename)
+{
+    RelBinHeader_t                      hdr;
+    std::vector<RelBinSection_t>        sections;
+    std::vector<RelBinSymbol_t>         symbols;
+    std::vector<RelBinReloc_t>          relocs;
+    std::vector<RelBinFill_t>           fills;
+    std::vector<uint16_t>               code;
+    std::string                         strings(1, '\0');
+    std::map<std::string, uint32_t>     index;
+    std::vector<CRelSection *>::iterator it;
+    RelBinSection_t     sec;
+    RelBinSymbol_t      sym;
+    RelBinReloc_t       rel;
+    CRelSection*        pSection;
+    FILE*               fd;
+    size_t              x;
+    bool                ok;
+
+    // Build the tables
+    for (it = m_Sections.begin(); it != m_Sections.end(); ++it)
+    {
+        pSection = *it;
+        sec.name = AddString(strings, index, pSection->m_Name);
+        sec.address = pSection->m_Address;
+        sec.firstCode = pSection->m_FirstCode;
+        sec.lastCode = pSection->m_LastCode;
+        sec.code = code.size();
+        sec.firstSymbol = symbols.size();
+        sec.symbolCount = pSection->m_Symbols.size();
+        sec.firstReloc = relocs.size();
+        sec.relocCount = pSection->m_Relocs.size();
+        sec.firstFill = fills.size();
+        sec.fillCount = pSection->m_Fills.size();
+        sections.push_back(sec);
+
+        code.insert(code.end(), pSection->m_Code.begin(), pSection->m_Code.end());
+        fills.insert(fills.end(), pSection->m_Fills.begin(), pSection->m_Fills.end());
+
+        for (x = 0; x < pSection->m_Symbols.size(); x++)
+        {
+            sym.name = AddString(strings, index, pSection->m_Symbols[x].name);
+            sym.type = pSection->m_Symbols[x].type;
+            sym.value = pSection->m_Symbols[x].value;
+            symbols.push_back(sym);
+        }
+
+        for (x = 0; x < pSection->m_Relocs.size(); x++)
+        {
+            rel.type = pSection->m_Relocs[x].type;
+            rel.offset = pSection->m_Relocs[x].offset;
+            rel.opcode = pSection->m_Relocs[x].opcode;
+            rel.name = AddString(strings, index, pSection->m_Relocs[x].name);
+            relocs.push_back(rel);
+        }
+    }
+
+    // Fill in the header.  Every table is a multiple of 4 bytes except the
+    // code and strings, so the code words are always aligned.
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, RELBIN_MAGIC, sizeof(hdr.magic));
+    hdr.version = RELBIN_VERSION;
+    hdr.headerSize = sizeof(hdr);
+    hdr.sectionCount = sections.size();
+    hdr.sectionOffset = sizeof(hdr);
+    hdr.symbolCount = symbols.size();
+    hdr.symbolOffset = hdr.sectionOffset + sections.size() * sizeof(RelBinSection_t);
+    hdr.relocCount = relocs.size();
+    hdr.relocOffset = hdr.symbolOffset + symbols.size() * sizeof(RelBinSymbol_t);
+    hdr.fillCount = fills.size();
+    hdr.fillOffset = hdr.relocOffset + relocs.size() * sizeof(RelBinReloc_t);
+    hdr.codeWords = code.size();
+    hdr.codeOffset = hdr.fillOffset + fills.size() * sizeof(RelBinFill_t);
+    hdr.stringSize = strings.size();
+    hdr.stringOffset = hdr.codeOffset + code.size() * sizeof(uint16_t);
+
+    if ((fd = fopen(pFilename, "wb")) == NULL)
+    {
+        fprintf(m_pLog, "%s: Unable to open file for writing\n", pFilename);
+        return ERROR_CANT_OPEN_FILE;
+    }
+
+    ok = fwrite(&hdr, sizeof(hdr), 1, fd) == 1;
+    ok = ok && fwrite(sections.data(), sizeof(RelBinSection_t), sections.size(), fd) == sections.size();
+    ok = ok && fwrite(symbols.data(), sizeof(RelBinSymbol_t), symbols.size(), fd) == symbols.size();
+    ok = ok && fwrite(relocs.data(), sizeof(RelBinReloc_t), relocs.size(), fd) == relocs.size();
+    ok = ok && fwrite(fills.data(), sizeof(RelBinFill_t), fills.size(), fd) == fills.size();
+    ok = ok && fwrite(code.data(), sizeof(uint16_t), code.size(), fd) == code.size();
+    ok = ok && fwrite(strings.data(), 1, strings.size(), fd) == strings.size();
+    ok = fclose(fd) == 0 && ok;
+
+    if (!ok)
+    {
+        fprintf(m_pLog, "%s: Error writing file\n", pFilename);
+        return ERROR_CANT_OPEN_FILE;
+    }
+
+    return ERROR_NONE;
+}
+
+/*
+=============================================================================
+Validates the header and tables of a binary object image so that readers
+may index them without further bounds checks.
+=============================================================================
+*/
+int CRelObject::Validate(const uint8_t *pImage, size_t size, const char *pFilename,
+                         FILE *pLog)
+{
+    const RelBinHeader_t*   pHdr = (const RelBinHeader_t *) pImage;
+    const RelBinSection_t*  pSec;
+    const RelBinSymbol_t*   pSym;
+    const RelBinReloc_t*    pRel;
+    uint32_t                x, y;
+
+    if (size < sizeof(RelBinHeader_t) || memcmp(pHdr->magic, RELBIN_MAGIC, 4) != 0)
+    {
+        fprintf(pLog, "%s: Not a binary relocatable object\n", pFilename);
+        return ERROR_INVALID_FILE_FORMAT;
+    }
+
+    // The tables are used in place, so they must be in the host byte order
+    if (pHdr->version == (uint16_t) (RELBIN_VERSION << 8) &&
+        pHdr->headerSize == (uint16_t) ((sizeof(RelBinHeader_t) << 8) |
+                                        (sizeof(RelBinHeader_t) >> 8)))
+    {
+        fprintf(pLog, "%s: Binary object was written on a host of the other byte order\n",
+            pFilename);
+        return ERROR_INVALID_FILE_FORMAT;
+    }
+
+    if (pHdr->version != RELBIN_VERSION || pHdr->headerSize != sizeof(RelBinHeader_t))
+    {
+        fprintf(pLog, "%s: Unsupported binary object version %d\n", pFilename, pHdr->version);
+        return ERROR_INVALID_FILE_FORMAT;
+    }
+
+    // Each table must lie within the file
+    #define TABLE_OK(off, count, type) \
+        ((off) <= size && (uint64_t) (count) * sizeof(type) <= size - (off) && \
+         (off) % sizeof(uint16_t) == 0)
+
+    if (!TABLE_OK(pHdr->sectionOffset, pHdr->sectionCount, RelBinSection_t) ||
+        !TABLE_OK(pHdr->symbolOffset, pHdr->symbolCount, RelBinSymbol_t) ||
+        !TABLE_OK(pHdr->relocOffset, pHdr->relocCount, RelBinReloc_t) ||
+        !TABLE_OK(pHdr->fillOffset, pHdr->fillCount, RelBinFill_t) ||
+        !TABLE_OK(pHdr->codeOffset, pHdr->codeWords, uint16_t) ||
+        !TABLE_OK(pHdr->stringOffset, pHdr->stringSize, char) ||
+        pHdr->stringSize == 0 || pImage[pHdr->stringOffset + pHdr->stringSize - 1] != '\0')
+    {
+        fprintf(pLog, "%s: Corrupt binary object tables\n", pFilename);
+        return ERROR_INVALID_FILE_FORMAT;
+    }
+    #undef TABLE_OK
+
+    // Validate each section's references into the other tables
+    pSec = (const RelBinSection_t *) (pImage + pHdr->sectionOffset);
+    pSym = (const RelBinSymbol_t *) (pImage + pHdr->symbolOffset);
+    pRel = (const RelBinReloc_t *) (pImage + pHdr->relocOffset);
+    for (x = 0; x < pHdr->sectionCount; x++, pSec++)
+    {
+        if (pSec->name >= pHdr->stringSize || pSec->lastCode < 0 ||
+            (uint64_t) pSec->code + pSec->lastCode > pHdr->codeWords ||
+            (uint64_t) pSec->firstSymbol + pSec->symbolCount > pHdr->symbolCount ||
+            (uint64_t) pSec->firstReloc + pSec->relocCount > pHdr->relocCount ||
+            (uint64_t) pSec->firstFill + pSec->fillCount > pHdr->fillCount)
+        {
+            fprintf(pLog, "%s: Corrupt binary object section %d\n", pFilename, x);
+            return ERROR_INVALID_FILE_FORMAT;
+        }
+
+        for (y = pSec->firstSymbol; y < pSec->firstSymbol + pSec->symbolCount; y++)
+            if (pSym[y].name >= pHdr->stringSize)
+            {
+                fprintf(pLog, "%s: Corrupt binary object symbol %d\n", pFilename, y);
+                return ERROR_INVALID_FILE_FORMAT;
+            }
+
+        // Relocations patch code words in place so must be inside the section
+        for (y = pSec->firstReloc; y < pSec->firstReloc + pSec->relocCount; y++)
+            if (pRel[y].name >= pHdr->stringSize || pRel[y].offset < 0 ||
+                pRel[y].offset >= pSec->lastCode)
+            {
+                fprintf(pLog, "%s: Corrupt binary object relocation %d\n", pFilename, y);
+                return ERROR_INVALID_FILE_FORMAT;
+            }
+    }
+
+    return ERROR_NONE;
+}
+
+/*
+=============================================================================
+Reads a binary object
+=============================================================================
+*/
+int CRelObject::ReadBin(const char *pFilename)
+{
+    std::vector<uint8_t>    image;
+    const RelBinHeader_t*   pHdr;
+    const RelBinSection_t*  pSec;
+    const RelBinSymbol_t*   pSym;
+    const RelBinReloc_t*    pRel;
+    const RelBinFill_t*     pFill;
+    const uint16_t*         pCode;
+    const char*             pStrings;
+    CRelSection*            pSection;
+    RelSymbol_t             sym;
+    RelReloc_t              rel;
+    FILE*                   fd;
+    long                    size;
+    uint32_t                x, y;
+    int                     err;
+
+    if ((fd = fopen(pFilename, "rb")) == NULL)
+    {
+        fprintf(m_pLog, "Error opening file %s\n", pFilename);
+        return ERROR_CANT_OPEN_FILE;
+    }
+    fseek(fd, 0, SEEK_END);
+    size = ftell(fd);
+    fseek(fd, 0, SEEK_SET);
+    image.resize(size > 0 ? size : 0);
+    if (size <= 0 || fread(image.data(), 1, size, fd) != (size_t) size)
+        image.clear();
+    fclose(fd);
+
+    if ((err = Validate(image.data(), image.size(), pFilename, m_pLog)) != ERROR_NONE)
+        return err;
+
+    pHdr = (const RelBinHeader_t *) image.data();
+    pSec = (const RelBinSection_t *) (image.data() + pHdr->sectionOffset);
+    pSym = (const RelBinSymbol_t *) (image.data() + pHdr->symbolOffset);
+    pRel = (const RelBinReloc_t *) (image.data() + pHdr->relocOffset);
+    pFill = (const RelBinFill_t *) (image.data() + pHdr->fillOffset);
+    pCode = (const uint16_t *) (image.data() + pHdr->codeOffset);
+    pStrings = (const char *) image.data() + pHdr->stringOffset;
+
+    for (x = 0; x < pHdr->sectionCount; x++, pSec++)
+    {
+        pSection = new CRelSection;
+        pSection->m_Name = pStrings + pSec->name;
+        pSection->m_Address = pSec->address;
+        pSection->m_FirstCode = pSec->firstCode;
+        pSection->m_LastCode = pSec->lastCode;
+        pSection->m_Code.assign(pCode + pSec->code, pCode + pSec->code + pSec->lastCode);
+        pSection->m_Fills.assign(pFill + pSec->firstFill, pFill + pSec->firstFill + pSec->fillCount);
+
+        for (y = pSec->firstSymbol; y < pSec->firstSymbol + pSec->symbolCount; y++)
+        {
+            sym.name = pStrings + pSym[y].name;
+            sym.type = pSym[y].type;
+            sym.value = pSym[y].value;
+            pSection->m_Symbols.push_back(sym);
+        }
+
+        for (y = pSec->firstReloc; y < pSec->firstReloc + pSec->relocCount; y++)
+        {
+            rel.type = pRel[y].type;
+            rel.offset = pRel[y].offset;
+            rel.opcode = pRel[y].opcode;
+            rel.name = pStrings + pRel[y].name;
+            pSection->m_Relocs.push_back(rel);
+        }
+
+        m_Sections.push_back(pSection);
+    }
+
+    return ERROR_NONE;
+}
+
+// vim: sw=4 ts=4
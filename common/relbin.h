@@ -0,0 +1,194 @@
+// ------------------------------------------------------------------------------
+// (c) Copyright, Ken Pettit, BSD License
+//         All Rights Reserved
+// ------------------------------------------------------------------------------
+//
+//  File        : relbin.h
+//  Revision    : 1.0
+//  Author      : Ken Pettit
+//  Created     : 10/16/2026
+//
+// Description:
+//    Relocatable object (.rel) formats shared by lisa_as and lisa_ld.
+//
+//    The text format is one record per line:
+//
+//        s name              Start section 'name'
+//        p name addr         Public label
+//        l name addr         Local label
+//        a addr              Set the section address
+//        i word              Instruction / data word
+//        e word label        Word referencing extern 'label'
+//        r word section      Word with a section relative jump address
+//        R word section      Word holding a section relative address
+//        u count             Reserve 'count' uninitialized words
+//        # ...               Comment
+//
+//    The binary format holds the same information as fixed size tables so
+//    the linker can memory map it and use the code words in place.  All
+//    fields are in the byte order of the host that wrote the object, which
+//    must match the host that reads it;  an object of the other byte order
+//    is rejected by its byte swapped version and header size.  Layout:
+//
+//        RelBinHeader_t
+//        RelBinSection_t[sectionCount]
+//        RelBinSymbol_t[symbolCount]
+//        RelBinReloc_t[relocCount]
+//        RelBinFill_t[fillCount]
+//        uint16_t code[codeWords]    Each section's words from offset 0
+//        char strings[stringSize]    NUL terminated, offset 0 is ""
+//
+// Modifications:
+//
+//    Author            Date        Ver  Description
+//    ================  ==========  ===  =======================================
+//    Ken Pettit        10/16/2026  1.0  Initial version
+//
+// ------------------------------------------------------------------------------
+
+#ifndef RELBIN_H
+#define RELBIN_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#define RELBIN_MAGIC        "LREL"
+#define RELBIN_VERSION      1
+
+/// Value of firstCode for a section with no code
+#define RELBIN_NO_CODE      0xFFFFFF
+
+/// Words a section may hold, one per 16 bit address
+#define RELBIN_MAX_WORDS    65536
+
+/// Symbol types
+#define RELBIN_SYM_PUBLIC   1
+#define RELBIN_SYM_LOCAL    2
+
+/// Relocation types (same values as lisa_ld's REL_TYPE_*)
+#define RELBIN_REL_EXTERN   1       // 'e' record
+#define RELBIN_REL_FUNCTION 2       // 'r' record
+#define RELBIN_REL_SYMBOL   3       // 'R' record
+
+typedef struct RelBinHeader_s
+{
+    char            magic[4];       // RELBIN_MAGIC
+    uint16_t        version;        // RELBIN_VERSION
+    uint16_t        headerSize;     // sizeof(RelBinHeader_t)
+    uint32_t        sectionCount;
+    uint32_t        sectionOffset;
+    uint32_t        symbolCount;
+    uint32_t        symbolOffset;
+    uint32_t        relocCount;
+    uint32_t        relocOffset;
+    uint32_t        fillCount;
+    uint32_t        fillOffset;
+    uint32_t        codeWords;
+    uint32_t        codeOffset;
+    uint32_t        stringSize;
+    uint32_t        stringOffset;
+} RelBinHeader_t;
+
+typedef struct RelBinSection_s
+{
+    uint32_t        name;           // String table offset
+    int32_t         address;        // Section address after the last record
+    int32_t         firstCode;      // First code offset or RELBIN_NO_CODE
+    int32_t         lastCode;       // One past the last code offset
+    uint32_t        code;           // Index of the section's word 0 in code[]
+    uint32_t        firstSymbol;
+    uint32_t        symbolCount;
+    uint32_t        firstReloc;
+    uint32_t        relocCount;
+    uint32_t        firstFill;
+    uint32_t        fillCount;
+} RelBinSection_t;
+
+typedef struct RelBinSymbol_s
+{
+    uint32_t        name;           // String table offset
+    uint32_t        type;           // RELBIN_SYM_*
+    int32_t         value;          // Section offset of the label
+} RelBinSymbol_t;
+
+typedef struct RelBinReloc_s
+{
+    uint32_t        type;           // RELBIN_REL_*
+    int32_t         offset;         // Section offset of the word
+    uint32_t        opcode;         // Unrelocated word
+    uint32_t        name;           // Extern label or target section
+} RelBinReloc_t;
+
+/// An uninitialized ('u') region, kept so text output can be regenerated
+typedef struct RelBinFill_s
+{
+    int32_t         offset;
+    int32_t         count;
+} RelBinFill_t;
+
+typedef struct RelSymbol_s
+{
+    std::string     name;
+    int             type;
+    int             value;
+} RelSymbol_t;
+
+typedef struct RelReloc_s
+{
+    int             type;
+    int             offset;
+    int             opcode;
+    std::string     name;
+} RelReloc_t;
+
+/// One section of a relocatable object held in memory
+class CRelSection
+{
+    public:
+        CRelSection() { m_Address = 0; m_FirstCode = RELBIN_NO_CODE; m_LastCode = 0; }
+
+        std::string                 m_Name;
+        int                         m_Address;
+        int                         m_FirstCode;
+        int                         m_LastCode;
+        std::vector<uint16_t>       m_Code;
+        std::vector<RelSymbol_t>    m_Symbols;
+        std::vector<RelReloc_t>     m_Relocs;
+        std::vector<RelBinFill_t>   m_Fills;
+};
+
+/// A relocatable object in either format, used for conversion
+class CRelObject
+{
+    public:
+        CRelObject() { m_pLog = stdout; }
+        ~CRelObject();
+
+        /// Reads text records from an open file
+        int                 ReadText(FILE* fd, const char *pFilename);
+
+        /// Reads a binary object
+        int                 ReadBin(const char *pFilename);
+
+        /// Writes text records to an open file
+        int                 WriteText(FILE* fd);
+
+        /// Writes a binary object
+        int                 WriteBin(const char *pFilename);
+
+        /// Tests if the file starts with the binary magic
+        static bool         IsBinary(const char *pFilename);
+
+        /// Validates the tables of a binary object image in memory
+        static int          Validate(const uint8_t *pImage, size_t size,
+                                const char *pFilename, FILE *pLog = stdout);
+
+        std::vector<CRelSection *> m_Sections;
+        FILE*               m_pLog;         // Diagnostics output
+};
+
+#endif  // RELBIN_H
+
+// vim: sw=4 ts=4
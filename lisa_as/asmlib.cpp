@@ -0,0 +1,148 @@
+// ------------------------------------------------------------------------------
+// (c) Copyright, Ken Pettit, BSD License
+//         All Rights Reserved
+// ------------------------------------------------------------------------------
+//
+//  File        : asmlib.cpp
+//  Revision    : 1.0
+//  Author      : Ken Pettit
+//  Created     : 10/16/2026
+//
+// Description:
+//    C interface to the assembler engine.  See asmlib.h.
+//
+// Modifications:
+//
+//    Author            Date        Ver  Description
+//    ================  ==========  ===  =======================================
+//    Ken Pettit        10/16/2026  1.0  Initial version
+//
+// ------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "asmlib.h"
+#include "parser.h"
+#include "assembler.h"
+#include "errors.h"
+
+struct LisaAsm_s
+{
+    LisaAsm_s() : m_Parser(&m_Spec), m_RecordErr(ERROR_NONE) {}
+
+    CParseCtx       m_Spec;
+    CParser         m_Parser;
+    CAssembler      m_Assembler;
+
+    /// Slots of the names given to lisa_asm_symbol, by symbol id
+    std::vector<CSymbolSlot *>  m_Symbols;
+
+    /// Set if lisa_asm_op was given an invalid record
+    int32_t         m_RecordErr;
+};
+
+/*
+================================================================================
+Create the parse context for a new in-memory module
+================================================================================
+*/
+LisaAsm_t* lisa_asm_open(const char *pSourceName, int width, FILE *pLog)
+{
+    LisaAsm_t*      pAsm = new LisaAsm_t;
+
+    pAsm->m_Parser.m_pLog = pLog;
+    pAsm->m_Parser.m_Width = width;
+    pAsm->m_Parser.m_DebugLevel = 0;
+    pAsm->m_Assembler.m_pLog = pLog;
+    pAsm->m_Assembler.m_Width = width;
+    pAsm->m_Assembler.m_DebugLevel = 0;
+    pAsm->m_Parser.BeginSource(pSourceName, &pAsm->m_Spec);
+
+    return pAsm;
+}
+
+/*
+================================================================================
+Parse the next line of the module
+================================================================================
+*/
+int lisa_asm_line(LisaAsm_t *pAsm, const char *pLine)
+{
+    return pAsm->m_Parser.ParseSource(pLine);
+}
+
+/*
+================================================================================
+Find the opcode id (its index in gOpcodes[]) of a mnemonic
+================================================================================
+*/
+int lisa_asm_opcode(const char *pMnemonic)
+{
+    const Opcode_t*     pOpcode = FindOpcode(pMnemonic);
+
+    return pOpcode ? pOpcode - gOpcodes : -1;
+}
+
+/*
+================================================================================
+Give a name used as an operand an id for lisa_asm_op
+================================================================================
+*/
+int lisa_asm_symbol(LisaAsm_t *pAsm, const char *pName)
+{
+    pAsm->m_Symbols.push_back(CExpression::InternSymbol(pName, false,
+            pAsm->m_Spec.m_Symbols));
+    return pAsm->m_Symbols.size() - 1;
+}
+
+/*
+================================================================================
+Add the next line of the module as an opcode record
+================================================================================
+*/
+int lisa_asm_op(LisaAsm_t *pAsm, int opcode, int argKind, int symbol, int value)
+{
+    CSymbolSlot*    pSymbol = NULL;
+
+    if (opcode < 0 || opcode >= gOpcodeCount || argKind < LISA_ASM_ARG_NONE ||
+        argKind > LISA_ASM_ARG_SYMBOL || (argKind == LISA_ASM_ARG_SYMBOL &&
+        (symbol < 0 || symbol >= (int) pAsm->m_Symbols.size())))
+    {
+        fprintf(pAsm->m_Parser.m_pLog, "Invalid opcode record (%d, %d, %d)\n",
+                opcode, argKind, symbol);
+        return pAsm->m_RecordErr = ERROR_INVALID_OPCODE_SYNTAX;
+    }
+    if (argKind == LISA_ASM_ARG_SYMBOL)
+        pSymbol = pAsm->m_Symbols[symbol];
+
+    // The LISA_ASM_ARG_* kinds are the parser's OPARG_* kinds
+    return pAsm->m_Parser.ParseOpcode(&gOpcodes[opcode], argKind, value, pSymbol);
+}
+
+/*
+================================================================================
+Assemble the module and write the .rel.  Like lisa_as, nothing is written
+if any line failed to parse.
+================================================================================
+*/
+int lisa_asm_finish(LisaAsm_t *pAsm, const char *pOutFile, int binaryRel)
+{
+    std::string     sOut = pOutFile;
+    int32_t         err;
+
+    if ((err = pAsm->m_Parser.EndSource()) == ERROR_NONE &&
+        (err = pAsm->m_RecordErr) == ERROR_NONE)
+    {
+        pAsm->m_Assembler.m_BinaryRel = binaryRel != 0;
+        err = pAsm->m_Assembler.Assemble((char *) sOut.c_str(), &pAsm->m_Spec);
+        if (err != ERROR_NONE)
+            fprintf(pAsm->m_Assembler.m_pLog, "Asm error = %d\n", err);
+    }
+
+    delete pAsm;
+    return err;
+}
+
+// vim: sw=4 ts=4
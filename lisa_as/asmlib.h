@@ -0,0 +1,83 @@
+// ------------------------------------------------------------------------------
+// (c) Copyright, Ken Pettit, BSD License
+//         All Rights Reserved
+// ------------------------------------------------------------------------------
+//
+//  File        : asmlib.h
+//  Revision    : 1.0
+//  Author      : Ken Pettit
+//  Created     : 10/16/2026
+//
+// Description:
+//    C interface to the assembler engine in liblisa_as.a, used by lisa_cc to
+//    assemble its generated code in-process.  Source lines are handed over
+//    from memory as they are produced and the .rel is written directly, so
+//    no temporary .s file or separate lisa_as process is needed.
+//
+//        LisaAsm_t *pAsm = lisa_asm_open("file.s", 16, stderr);
+//        lisa_asm_line(pAsm, "    .section .text");
+//        lisa_asm_op(pAsm, lisa_asm_opcode("ldi"), LISA_ASM_ARG_CONST, 0, 0);
+//        ...
+//        err = lisa_asm_finish(pAsm, "file.rel", 0);
+//
+//    Opcodes can be handed over as typed records with lisa_asm_op, which
+//    skips tokenizing and compiling their operand.  Labels, directives and
+//    anything else are given as text.
+//
+// Modifications:
+//
+//    Author            Date        Ver  Description
+//    ================  ==========  ===  =======================================
+//    Ken Pettit        10/16/2026  1.0  Initial version
+//
+// ------------------------------------------------------------------------------
+
+#ifndef ASMLIB_H
+#define ASMLIB_H
+
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct LisaAsm_s LisaAsm_t;
+
+/// Operand kinds of lisa_asm_op
+#define LISA_ASM_ARG_NONE       0
+#define LISA_ASM_ARG_CONST      1       // value
+#define LISA_ASM_ARG_STACK      2       // value(sp)
+#define LISA_ASM_ARG_SYMBOL     3       // Label or other name, by symbol id
+
+/// Starts a new module.  pSourceName is used in diagnostics, which are
+/// written to pLog.  width is the instruction width (lisa_as -w).
+LisaAsm_t*  lisa_asm_open(const char *pSourceName, int width, FILE *pLog);
+
+/// Parses one source line (without its newline).  Returns an ERROR_* code.
+int         lisa_asm_line(LisaAsm_t *pAsm, const char *pLine);
+
+/// Returns the opcode id of a mnemonic, or -1 if there is no such opcode.
+/// Ids are the same for every module.
+int         lisa_asm_opcode(const char *pMnemonic);
+
+/// Returns the symbol id of a label, condition code or other name used as
+/// an operand in the module
+int         lisa_asm_symbol(LisaAsm_t *pAsm, const char *pName);
+
+/// Adds an opcode line with an operand of the given LISA_ASM_ARG_* kind.
+/// symbol is the operand of LISA_ASM_ARG_SYMBOL and value that of the
+/// others.  This assembles the same as the line's text would.  Returns an
+/// ERROR_* code.
+int         lisa_asm_op(LisaAsm_t *pAsm, int opcode, int argKind, int symbol, int value);
+
+/// Assembles the module, writes it to pOutFile as a text or binary .rel
+/// and frees pAsm.  Returns ERROR_NONE (0) or the first error.
+int         lisa_asm_finish(LisaAsm_t *pAsm, const char *pOutFile, int binaryRel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // ASMLIB_H
+
+// vim: sw=4 ts=4
@@ -34,6 +34,7 @@
 #include "elfload.h"
 #include "elf.h"
 #include "intelhex.h"
+#include "relbin.h"
 
 using namespace std;
 
@@ -48,6 +49,7 @@ CAssembler::CAssembler()
     m_pData = NULL;
     m_pTempData = NULL;
     m_Mixed = false;
+    m_BinaryRel = false;
 }
 
 // =============================================================================
@@ -69,7 +71,10 @@ int32_t CAssembler::PerformCodeAssembly(ResourceSection_t* pSection, CResource*
     Instruction_t*          pInst = pRes->m_pInst;
     int32_t                 ret = ERROR_NONE;
     StrList_t::iterator     it;
+    std::vector<CExpression *>::iterator eit;
     StrLabelMap_t::iterator labelIt;
+    CLabel*                 pLabel = NULL;
+    CLabel*                 pArgLabel;
     std::string             sarg[8];
     std::string             externLabel;
     int                     isExtern;
@@ -103,7 +108,7 @@ int32_t CAssembler::PerformCodeAssembly(ResourceSection_t* pSection, CResource*
             labelIt = m_pSpec->m_LabelMap.find(pInst->args.front());
             if (labelIt == m_pSpec->m_LabelMap.end())
             {
-                printf("%s: Line %d: PUBLIC Label %s not defined\n", 
+                fprintf(m_pLog, "%s: Line %d: PUBLIC Label %s not defined\n", 
                     pInst->filename.c_str(), pInst->line, pInst->args.front().c_str());
                 return ERROR_LABEL_NOT_DEFINED;
             }
@@ -111,7 +116,7 @@ int32_t CAssembler::PerformCodeAssembly(ResourceSection_t* pSection, CResource*
             // Test if the label was defined
             if (labelIt->second->m_Defined == 0)
             {
-                printf("%s: Line %d: PUBLIC Label %s not defined\n", 
+                fprintf(m_pLog, "%s: Line %d: PUBLIC Label %s not defined\n", 
                     pInst->filename.c_str(), pInst->line, pInst->args.front().c_str());
                 return ERROR_LABEL_NOT_DEFINED;
             }
@@ -125,7 +130,7 @@ int32_t CAssembler::PerformCodeAssembly(ResourceSection_t* pSection, CResource*
             labelIt = m_pSpec->m_LabelMap.find(pInst->args.front());
             if (labelIt == m_pSpec->m_LabelMap.end())
             {
-                printf("%s: Line %d: LOCAL Label %s not defined\n", 
+                fprintf(m_pLog, "%s: Line %d: LOCAL Label %s not defined\n", 
                     pInst->filename.c_str(), pInst->line, pInst->args.front().c_str());
                 return ERROR_LABEL_NOT_DEFINED;
             }
@@ -133,7 +138,7 @@ int32_t CAssembler::PerformCodeAssembly(ResourceSection_t* pSection, CResource*
             // Test if the label was defined
             if (labelIt->second->m_Defined == 0)
             {
-                printf("%s: Line %d: LOCAL Label %s not defined\n", 
+                fprintf(m_pLog, "%s: Line %d: LOCAL Label %s not defined\n", 
                     pInst->filename.c_str(), pInst->line, pInst->args.front().c_str());
                 return ERROR_LABEL_NOT_DEFINED;
             }
@@ -156,6 +161,7 @@ int32_t CAssembler::PerformCodeAssembly(ResourceSection_t* pSection, CResource*
 
             // Resolve arguments
             it = pInst->args.begin();
+            eit = pInst->exprs.begin();
             argc = 0;
             while (it != pInst->args.end())
             {
@@ -171,23 +177,21 @@ int32_t CAssembler::PerformCodeAssembly(ResourceSection_t* pSection, CResource*
                 }
                 else
                 {
-                    bool isStxx = pInst->value == OPCODE_STXX || pInst->value == OPCODE_LDXX ||
-                                  pInst->value == OPCODE16_STXX || pInst->value == OPCODE16_LDXX;
-                    commaValue = -1;
-                    if ((ret = EvaluateExpression(*it, arg[argc], pInst->filename,
-                        pInst->line, commaValue, isStxx)) != ERROR_NONE)
+                    commaValue = (*eit)->m_CommaValue;
+                    if ((ret = EvaluateExpression(*eit, arg[argc], pInst->filename,
+                        pInst->line)) != ERROR_NONE)
                     {
-                        printf("%s: Line %d: Argument %s has no value\n", pInst->filename.c_str(),
+                        fprintf(m_pLog, "%s: Line %d: Argument %s has no value\n", pInst->filename.c_str(),
                                 pInst->line, (*it).c_str());
                         ret = ERROR_VARIABLE_NOT_FOUND;
                     }
 
                     // Test if argument is an extern label
-                    labelIt = m_pSpec->m_LabelMap.find(*it);
-                    if (labelIt != m_pSpec->m_LabelMap.end())
+                    if ((pArgLabel = FindArgLabel(*eit)) != NULL)
                     {
+                        pLabel = pArgLabel;
                         isLabel = 1;
-                        if (labelIt->second->m_Type & SIZE_EXTERN)
+                        if (pLabel->m_Type & SIZE_EXTERN)
                         {
                             isExtern = 1;
                             externLabel = *it;
@@ -196,6 +200,7 @@ int32_t CAssembler::PerformCodeAssembly(ResourceSection_t* pSection, CResource*
                 }
 
                 it++;
+                eit++;
                 argc++;
             }
             if (ret != ERROR_NONE)
@@ -216,7 +221,7 @@ int32_t CAssembler::PerformCodeAssembly(ResourceSection_t* pSection, CResource*
                     // Validate the jump distance
                     if (diff > 255 || diff < -256)
                     {
-                        printf("%s: Line %d: Branch distance (%d) too big\n",
+                        fprintf(m_pLog, "%s: Line %d: Branch distance (%d) too big\n",
                                 pInst->filename.c_str(),
                                 pInst->line, diff);
                         ret = ERROR_BRANCH_DISTANCE_TOO_BIG;
@@ -237,7 +242,7 @@ int32_t CAssembler::PerformCodeAssembly(ResourceSection_t* pSection, CResource*
                     // Validate the jump distance
                     if (diff > 1023 || diff < -1204)
                     {
-                        printf("%s: Line %d: Branch distance (%d) too big\n",
+                        fprintf(m_pLog, "%s: Line %d: Branch distance (%d) too big\n",
                                 pInst->filename.c_str(),
                                 pInst->line, diff);
                         ret = ERROR_BRANCH_DISTANCE_TOO_BIG;
@@ -264,7 +269,7 @@ int32_t CAssembler::PerformCodeAssembly(ResourceSection_t* pSection, CResource*
                         if (isLabel)
                             fprintf(m_pOutFile, "r 0x%04X %s%s # %-8s%s\n", op1,
                               m_pSpec->m_ModuleName.c_str(),
-                              labelIt->second->m_Segment.c_str(),
+                              pLabel->m_Segment.c_str(),
                               pInst->name.c_str(), sarg[0].c_str());
                         else
                             fprintf(m_pOutFile, "r 0x%04X  # %-8s%s\n", op1, pInst->name.c_str(),
@@ -280,7 +285,7 @@ int32_t CAssembler::PerformCodeAssembly(ResourceSection_t* pSection, CResource*
                     else if (isLabel)
                         fprintf(m_pOutFile, "R 0x%04X %s%s\n", arg[0],
                               m_pSpec->m_ModuleName.c_str(),
-                              labelIt->second->m_Segment.c_str());
+                              pLabel->m_Segment.c_str());
                     else
                         fprintf(m_pOutFile, "i 0x%04X\n", arg[0]);
                     break;
@@ -326,6 +331,23 @@ int32_t CAssembler::PerformCodeAssembly(ResourceSection_t* pSection, CResource*
                         op1 |= arg[0] & 0x3FF;
                     else
                         op1 |= arg[0] & 0xFF;
+
+                    // The direct address of a label is relative to its section
+                    if (isLabel && (pInst->value == OPCODE16_LDA || pInst->value == OPCODE16_STA ||
+                        pInst->value == OPCODE_LDA || pInst->value == OPCODE_STA))
+                    {
+                        if (isExtern)
+                            fprintf(m_pOutFile, "e 0x%04X %s  # %s   %-8s\n", pInst->value,
+                              externLabel.c_str(), pInst->name.c_str(),
+                              externLabel.c_str());
+                        else
+                            fprintf(m_pOutFile, "R 0x%04X %s%s  # %-8s%s\n", op1,
+                              m_pSpec->m_ModuleName.c_str(),
+                              pLabel->m_Segment.c_str(),
+                              pInst->name.c_str(), sarg[0].c_str());
+                        break;
+                    }
+
                     if (pInst->argc == 1)
                       fprintf(m_pOutFile, "i 0x%04X  # %-8s%s\n", op1, pInst->name.c_str(),
                           sarg[0].c_str());
@@ -359,10 +381,10 @@ int32_t CAssembler::PerformCodeAssembly(ResourceSection_t* pSection, CResource*
             it = pInst->args.begin();
 
             // Evaluate the 1st argument
-            if ((ret = EvaluateExpression(*it, arg[0], pInst->filename, commaValue,
+            if ((ret = EvaluateExpression(pInst->exprs.front(), arg[0], pInst->filename,
                 pInst->line)) != ERROR_NONE)
             {
-                printf("%s: Line %d: Argument %s has no value\n", pInst->filename.c_str(),
+                fprintf(m_pLog, "%s: Line %d: Argument %s has no value\n", pInst->filename.c_str(),
                         pInst->line, (*it).c_str());
                 ret = ERROR_VARIABLE_NOT_FOUND;
                 break;
@@ -378,10 +400,10 @@ int32_t CAssembler::PerformCodeAssembly(ResourceSection_t* pSection, CResource*
             it = pInst->args.begin();
 
             // Evaluate the 1st argument
-            if ((ret = EvaluateExpression(*it, arg[0], pInst->filename, commaValue,
+            if ((ret = EvaluateExpression(pInst->exprs.front(), arg[0], pInst->filename,
                 pInst->line)) != ERROR_NONE)
             {
-                printf("%s: Line %d: Argument %s has no value\n", pInst->filename.c_str(),
+                fprintf(m_pLog, "%s: Line %d: Argument %s has no value\n", pInst->filename.c_str(),
                         pInst->line, (*it).c_str());
                 ret = ERROR_VARIABLE_NOT_FOUND;
                 break;
@@ -395,6 +417,7 @@ int32_t CAssembler::PerformCodeAssembly(ResourceSection_t* pSection, CResource*
         case TYPE_DB:
             // Evaluate the DS
             it = pInst->args.begin();
+            eit = pInst->exprs.begin();
 
             // Evaluate all arguments
             while (it != pInst->args.end())
@@ -426,10 +449,10 @@ int32_t CAssembler::PerformCodeAssembly(ResourceSection_t* pSection, CResource*
                 else
                 {
                     // Evaluate the argument
-                    if ((ret = EvaluateExpression(*it, arg[0], pInst->filename, commaValue,
+                    if ((ret = EvaluateExpression(*eit, arg[0], pInst->filename,
                         pInst->line)) != ERROR_NONE)
                     {
-                        printf("%s: Line %d: Argument %s has no value\n", pInst->filename.c_str(),
+                        fprintf(m_pLog, "%s: Line %d: Argument %s has no value\n", pInst->filename.c_str(),
                                 pInst->line, (*it).c_str());
                         ret = ERROR_VARIABLE_NOT_FOUND;
                         break;
@@ -441,21 +464,23 @@ int32_t CAssembler::PerformCodeAssembly(ResourceSection_t* pSection, CResource*
                 }
 
                 it++;
+                eit++;
             }
             break;
             
         case TYPE_DW:
             // Evaluate the DS
             it = pInst->args.begin();
+            eit = pInst->exprs.begin();
 
             // Evaluate all arguments
             while (it != pInst->args.end())
             {
                 // Evaluate the argument
-                if ((ret = EvaluateExpression(*it, arg[0], pInst->filename, commaValue,
+                if ((ret = EvaluateExpression(*eit, arg[0], pInst->filename,
                     pInst->line)) != ERROR_NONE)
                 {
-                    printf("%s: Line %d: Argument %s has no value\n", pInst->filename.c_str(),
+                    fprintf(m_pLog, "%s: Line %d: Argument %s has no value\n", pInst->filename.c_str(),
                             pInst->line, (*it).c_str());
                     ret = ERROR_VARIABLE_NOT_FOUND;
                     break;
@@ -469,6 +494,7 @@ int32_t CAssembler::PerformCodeAssembly(ResourceSection_t* pSection, CResource*
                 pSection->address += 2;
 
                 it++;
+                eit++;
             }
             break;
             
@@ -569,389 +595,131 @@ int32_t CAssembler::PopulateAllDataBlocks(void)
 
 // =============================================================================
 
-int32_t CAssembler::EvaluateExpression(std::string& sExpr, uint32_t& value,
-        std::string& sFilename, uint32_t lineNo, int& commaValue, bool isStxx)
+int32_t CAssembler::EvaluateExpression(CExpression* pExpr, uint32_t& value,
+        std::string& sFilename, uint32_t lineNo)
 {
-    int32_t                 err = ERROR_NONE;
-    uint32_t                tempVal;
-    std::string             sSubst;
-    std::string             varValue;
-    char                    opStack[20];
-    int                     opStackIdx = 0;
-    int32_t                 valStack[20];
-    int                     valStackIdx = 0;
-    int                     len, x, parenLevel;
-    int                     neg;
-
-    // Perform variable substitution
-    if ((err = SubstituteVariables(sExpr, sSubst, sFilename, lineNo,
-                                   commaValue, isStxx)) != ERROR_NONE)
-        return err;
-
-    // Setup our evaluation stacks
-    opStack[0] = '=';
-    opStackIdx = 1;
-    valStackIdx = 0;
-    neg = 1;
-
-    // Parse the equation
-    len = strlen(sSubst.c_str());
-    for (x = 0; x <= len && err == ERROR_NONE; )
-    {
-        switch (sSubst[x])
-        {
-            case '\0':
-            case ' ':
-                // Test if we have something to evaluate
-                if (strlen(varValue.c_str()) > 0)
-                {
-                    // Evaluate the token
-                    err = EvaluateToken(varValue, tempVal, sFilename, lineNo);
-                    if (err == ERROR_NONE && opStackIdx > 0)
-                    {
-                        // Test for = operation
-                        if (opStack[opStackIdx-1] == '=')
-                        {
-                            valStack[valStackIdx++] = tempVal;
-                            opStackIdx--;
-                        }
-
-                        // Test for & operation ... higher precedence
-                        else if (opStack[opStackIdx-1] == '&')
-                        {
-                            valStack[valStackIdx-1] &= tempVal;
-                            opStackIdx--;
-                        }
-
-                        // Must be | operation ... push value to stack
-                        // to test for higher precidence & operation following
-                        else
-                        {
-                            valStack[valStackIdx++] = tempVal;
-                        }
-                    }
-                }
-
-                varValue = "";
-
-                // Advance to next character
-                 x++;
-
-                break;
-           
-            case '-':
-                neg = -1;
-                x++;
-                break;
-
-            case '|':
-                opStack[opStackIdx++] = '|';
-                x++;
-                break;
-
-            case '&':
-                opStack[opStackIdx++] = '&';
-                x++;
-                break;
-
-            case '(':
-                parenLevel = 1;
-                x++;
-                while (x <= len && parenLevel > 0)
-                {
-                   if (sSubst[x] == '(')
-                   {
-                      parenLevel++;
-                      varValue += '(';
-                   }
-                   else if (sSubst[x] == ')')
-                   {
-                      parenLevel--;
-                      if (parenLevel > 0)
-                         varValue += ')';
-                   }
-                   else
-                   {
-                     varValue += sSubst[x];
-                   }
-                   x++;
-                }
-
-                // Test for balanced parenthesis
-                if (parenLevel > 0)
-                {
-                    printf("%s: Line %d: Unbalanced parenthesis\n", sFilename.c_str(), lineNo);
-                    err = ERROR_SEGMENT_NOT_LOCATED;
-                }
-                
-                err = EvaluateExpression(varValue, tempVal, sFilename, lineNo, commaValue);
-                varValue = "";
-                if (err == ERROR_NONE)
-                {
-                    // Test for = operation
-                    if (opStack[opStackIdx-1] == '=')
-                    {
-                        valStack[valStackIdx++] = tempVal;
-                        opStackIdx--;
-                    }
-                    // Test for & operation ... higher precedence
-                    else if (opStack[opStackIdx-1] == '&')
-                    {
-                        valStack[valStackIdx-1] &= tempVal;
-                        opStackIdx--;
-                    }
-
-                    // Must be | operation ... push value to stack
-                    // to test for higher precidence & operation following
-                    else
-                    {
-                        valStack[valStackIdx++] = tempVal;
-                    }
-                }
-                break;
-
-            default:
-                varValue += sSubst[x];
-                x++;
-                break;
-        }
-    }
-
-    // Unwind anything on the operation stack
-    while (opStackIdx)
+    // Arguments that are not expressions (quoted strings) have no value
+    if (pExpr == NULL)
     {
-       switch (opStack[--opStackIdx])
-       {
-            // Test for = operation
-            case '=':
-                valStack[valStackIdx++] = tempVal;
-                break;
-
-            case '&':
-                valStack[valStackIdx-1] &= tempVal;
-                break;
-
-            case '|':
-                tempVal = valStack[--valStackIdx];
-                valStack[valStackIdx-1] |= tempVal;
-                break;
-       }
+        fprintf(m_pLog, "%s: Line %d: Invalid equation\n", sFilename.c_str(), lineNo);
+        return ERROR_INVALID_SYNTAX;
     }
 
-    // Test for invalid equation
-    if (valStackIdx != 1)
-    {
-        printf("%s: Line %d: Invalid equation\n", sFilename.c_str(), lineNo);
-        err = ERROR_SEGMENT_NOT_LOCATED;
-    }
-    else
-        value = valStack[0] * neg;
-
-    return err;
+    return pExpr->Evaluate(this, value, sFilename, lineNo);
 }
 
 // =============================================================================
 
-int32_t CAssembler::EvaluateToken(std::string& sExpr, uint32_t& value,
-        std::string& sFilename, uint32_t lineNo)
+int32_t CAssembler::ResolveSymbol(CSymbolSlot* pSlot, uint32_t& value,
+        const std::string& sFilename, uint32_t lineNo)
 {
-    int32_t                 err = ERROR_NONE;
+    int32_t                 err;
     StrStrMap_t::iterator   varIter;
     ResourceMap_t::iterator labelIter;
     StrLabelMap_t::iterator labelMapIter;
-    std::string             varValue;
-    CResource              *pRes;
-    int                     commaValue;
-
+    std::string             sError;
+    char*                   pEnvVar;
+    const char*             pValue = NULL;
 
-    // Do a lookup in case it is a define
-    varValue = sExpr;
-    if ((varIter = m_pSpec->m_Variables.find(sExpr)) != m_pSpec->m_Variables.end())
+    // Bind the slot to its definition on first use.  Lookups that fail
+    // are not cached since variables may be added later in the assembly.
+    if (pSlot->m_Kind == SYM_UNBOUND)
     {
-        // Variable found.  Evaluate it as an expression
-        varValue = varIter->second;
-        err = EvaluateExpression(varValue, value, sFilename, lineNo, commaValue);
-        return err;
-    }
+        // Do a lookup in case it is a define
+        if ((varIter = m_pSpec->m_Variables.find(pSlot->m_Name)) != m_pSpec->m_Variables.end())
+            pValue = varIter->second.c_str();
 
-    // Look in the labels for the token
-    if ((labelIter = m_pSpec->m_Labels.find(sExpr)) != m_pSpec->m_Labels.end())
-    {
-        // Label found.  Use the label address as the value
-        pRes = labelIter->second;
-        value = pRes->m_pInst->address; 
-        return err;
-    }
+        // $(NAME) references may also come from the environment
+        else if (pSlot->m_Subst)
+        {
+            if ((pEnvVar = getenv(pSlot->m_Name.c_str())) != NULL)
+                pValue = pEnvVar;
+        }
 
-    // Look in LabelMap in case it is an extern
-    if ((labelMapIter = m_pSpec->m_LabelMap.find(sExpr)) != m_pSpec->m_LabelMap.end())
-    {
-        // Label found.  Test if it is extern
-        if (labelMapIter->second->m_Type & SIZE_EXTERN)
+        // Look in the labels for the token
+        else if ((labelIter = m_pSpec->m_Labels.find(pSlot->m_Name)) != m_pSpec->m_Labels.end())
         {
-          value = 0;
-          return err;
+            pSlot->m_pRes = labelIter->second;
+            pSlot->m_Kind = SYM_LABEL;
         }
-    }
-   
-    // Evaluate.  
-    if (strncmp(varValue.c_str(), "0x", 2) == 0)
-       sscanf(varValue.c_str() + 2, "%x", &value);
-    else if (strncmp(varValue.c_str(), "b'", 2) == 0 ||
-             strncmp(varValue.c_str(), "B'", 2) == 0)
-    {
-        // Convert binary value
-        const char *ptr = varValue.c_str()+2;
-        value = 0;
-        while (*ptr != '\'' && *ptr != '\0')
+
+        // Look in LabelMap in case it is an extern
+        else if ((labelMapIter = m_pSpec->m_LabelMap.find(pSlot->m_Name)) != m_pSpec->m_LabelMap.end() &&
+                 (labelMapIter->second->m_Type & SIZE_EXTERN))
         {
-           if (*ptr == '_')
-              ptr++;
-           else if (*ptr == '0')
-           {
-              value = value << 1;
-              ptr++;
-           }
-           else if (*ptr == '1')
-           {
-              value = (value << 1) | 1;
-              ptr++;
-           }
-           else
-              break;
+            pSlot->m_Kind = SYM_EXTERN;
         }
-    }
-    else if (strncmp(varValue.c_str(), "h'", 2) == 0 || 
-             strncmp(varValue.c_str(), "H'", 2) == 0)
-    {
-        sscanf(&varValue.c_str()[2], "%i", &value);
-    }
-    else
-    {
-        // Validate only numeric values present
-        int  x, len;
-        len = strlen(varValue.c_str());
-        for (x = 0; x < len; x++)
+
+        // Compile a variable's value once
+        if (pValue != NULL)
         {
-            char ch = varValue.c_str()[x];
-            if (ch < '0' || ch > '9')
+            pSlot->m_pValue = CExpression::Compile(pValue, m_Width, false,
+                                    m_pSpec->m_Symbols, sError);
+            if (pSlot->m_pValue == NULL)
             {
-                printf("%s: Line %d: Variable %s not defined2\n", 
-                        sFilename.c_str(), lineNo, varValue.c_str());
-                return ERROR_VARIABLE_NOT_FOUND;
+                fprintf(m_pLog, "%s: Line %d: Variable %s: %s in '%s'\n", sFilename.c_str(),
+                        lineNo, pSlot->m_Name.c_str(), sError.c_str(), pValue);
+                return ERROR_INVALID_SYNTAX;
             }
+            pSlot->m_Kind = SYM_VARIABLE;
         }
-        sscanf(varValue.c_str(), "%i", &value);
-    }
-
-    return err;
-}
-
-// =============================================================================
-
-int32_t CAssembler::SubstituteVariables(std::string& sExpr, std::string& sSubst,
-        std::string& sFilename, uint32_t lineNo, int& commaValue,  bool isStxx)
-{
-    int32_t                 err = ERROR_NONE;
-    size_t                  found;
-    const char*             pStr;
-    uint32_t                varEnd, c;
-    StrStrMap_t::iterator   varIter;
 
-    // First copy expression to subst
-    sSubst = sExpr;
-  
-    // Search for comma
-    found = sSubst.find("@");
-    if (found != std::string::npos)
-    {
-        // We have an @ argument
-        commaValue = atoi(&sSubst.c_str()[found+1]);
-        sSubst.replace(found, std::string::npos, "");
+        if (pSlot->m_Kind == SYM_UNBOUND)
+        {
+            fprintf(m_pLog, "%s: Line %d: Variable %s not defined\n", sFilename.c_str(),
+                    lineNo, pSlot->m_Name.c_str());
+            return ERROR_VARIABLE_NOT_FOUND;
+        }
     }
-     
-    // Search for (ix) in the expression
-    found = sSubst.find("(ix)");
-    if (found != std::string::npos)
+
+    switch (pSlot->m_Kind)
     {
-        sSubst.replace(found, 4, "");
+        case SYM_LABEL:
+            // Use the label's current address as the value
+            value = pSlot->m_pRes->m_pInst->address;
+            return ERROR_NONE;
+
+        case SYM_EXTERN:
+            // Externs are resolved by the linker
+            value = 0;
+            return ERROR_NONE;
     }
 
-    // Search for (sp) in the expression
-    found = sSubst.find("(sp)");
-    if (found != std::string::npos)
+    // Evaluate the variable's expression, guarding against self reference
+    if (pSlot->m_Busy)
     {
-        if (isStxx)
-            sSubst.replace(found, 4, "");
-        else
-        {
-            if (m_Width == 16)
-                sSubst.replace(found, 4, " | 512");
-            else
-                sSubst.replace(found, 4, " | 128");
-        }
+        fprintf(m_pLog, "%s: Line %d: Variable %s is defined recursively\n", sFilename.c_str(),
+                lineNo, pSlot->m_Name.c_str());
+        return ERROR_VARIABLE_NOT_FOUND;
     }
+    pSlot->m_Busy = true;
+    err = pSlot->m_pValue->Evaluate(this, value, sFilename, lineNo);
+    pSlot->m_Busy = false;
 
-    // Search for '$(' in the expression
-    while ((found = sSubst.find("$(")) != std::string::npos)
-    {
-        // Find end of variable to perform lookup
-        pStr = sSubst.c_str();
-        for (c = found + 2; pStr[c] != '\0' && pStr[c] != ')'; c++)
-            ;
+    return err;
+}
 
-        // Test if end of variable found
-        if (pStr[c] == ')')
-        {
-            // Get variable name
-            std::string varName = sSubst.substr(found+2, c-found-2);
-            std::string varValue;
-            bool varFound = false;
-            char*   pEnvVar;
-
-            // Lookup variable in CParseCtx's variable map
-            if ((varIter = m_pSpec->m_Variables.find(varName)) == m_pSpec->m_Variables.end())
-            {
-                // Variable not found, search environemnt
-                if ((pEnvVar = getenv(varName.c_str())) != NULL)
-                {
-                    varFound = true;
-                    varValue = pEnvVar;
-                }
-                else
-                {
-                    printf("%s: Line %d: Variable %s not defined3\n", sFilename.c_str(), lineNo, varName.c_str());
-                    err = ERROR_VARIABLE_NOT_FOUND;
-                    break;
-                }
-            }
-            else
-            {
-                // Variable found
-                varFound = true;
-                varValue = varIter->second;
-            }
+// =============================================================================
 
-            // Test if varibable found local or envrironment space
-            if (varFound)
-            {
-                // Perform the substitution
-                sSubst.replace(found, c-found+1, varValue);
+CLabel* CAssembler::FindArgLabel(CExpression* pExpr)
+{
+    CSymbolSlot*            pSlot;
+    StrLabelMap_t::iterator labelIt;
 
-                if (m_DebugLevel >= 5)
-                {
-                    printf("%s: Line %d: Subst text = '%s'\n", sFilename.c_str(),
-                            lineNo, sSubst.c_str());
-                }
-            }
-            else
-            {
-                break;
-            }
-        }
+    // Only an argument that is exactly one name can be a label
+    if (pExpr == NULL || (pSlot = pExpr->m_pSymbol) == NULL)
+        return NULL;
+
+    // Look the name up in the label map once
+    if (!pSlot->m_LabelBound)
+    {
+        labelIt = m_pSpec->m_LabelMap.find(pSlot->m_Name);
+        if (labelIt != m_pSpec->m_LabelMap.end())
+            pSlot->m_pLabel = labelIt->second;
+        pSlot->m_LabelBound = true;
     }
 
-    return err;
+    return pSlot->m_pLabel;
 }
 
 // =============================================================================
@@ -992,7 +760,7 @@ int32_t CAssembler::AssembleLabels(void)
                         labelIt = m_pSpec->m_LabelMap.find(pInst->name);
                         if (labelIt == m_pSpec->m_LabelMap.end())
                         {
-                          printf("Error looking up label %s\n", pInst->name.c_str());
+                          fprintf(m_pLog, "Error looking up label %s\n", pInst->name.c_str());
                           break;
                         }
                         // Assign the label an address
@@ -1008,15 +776,15 @@ int32_t CAssembler::AssembleLabels(void)
                         // Validate an arg given
                         if (pInst->args.size() == 0)
                         {
-                          printf("%s: Line %d: Expecting argument for .org\n",
+                          fprintf(m_pLog, "%s: Line %d: Expecting argument for .org\n",
                               pInst->filename.c_str(), pInst->line);
                           break; 
                         }
-                        err = EvaluateToken(pInst->args.front(), tempVal, pInst->filename, pInst->line);
+                        err = EvaluateExpression(pInst->exprs.front(), tempVal, pInst->filename, pInst->line);
                         if (err == ERROR_NONE)
                           pSection->address = tempVal;
                         else
-                          printf("%s: Line %d: Unable to evaluate %s\n",
+                          fprintf(m_pLog, "%s: Line %d: Unable to evaluate %s\n",
                               pInst->filename.c_str(), pInst->line,
                               pInst->args.front().c_str());
                         break;
@@ -1025,15 +793,15 @@ int32_t CAssembler::AssembleLabels(void)
                         // Validate an arg given
                         if (pInst->args.size() == 0)
                         {
-                          printf("%s: Line %d: Expecting argument for ds directive\n",
+                          fprintf(m_pLog, "%s: Line %d: Expecting argument for ds directive\n",
                               pInst->filename.c_str(), pInst->line);
                           break; 
                         }
-                        err = EvaluateToken(pInst->args.front(), tempVal, pInst->filename, pInst->line);
+                        err = EvaluateExpression(pInst->exprs.front(), tempVal, pInst->filename, pInst->line);
                         if (err == ERROR_NONE)
                           pSection->address += tempVal;
                         else
-                          printf("%s: Line %d: Unable to evaluate %s\n",
+                          fprintf(m_pLog, "%s: Line %d: Unable to evaluate %s\n",
                               pInst->filename.c_str(), pInst->line,
                               pInst->args.front().c_str());
                         break;
@@ -1042,7 +810,7 @@ int32_t CAssembler::AssembleLabels(void)
                         // Validate an arg given
                         if (pInst->args.size() == 0)
                         {
-                          printf("%s: Line %d: Expecting argument for db directive\n",
+                          fprintf(m_pLog, "%s: Line %d: Expecting argument for db directive\n",
                               pInst->filename.c_str(), pInst->line);
                           break; 
                         }
@@ -1069,6 +837,11 @@ int32_t CAssembler::AssembleLabels(void)
                             sit++;
                         }
                         break;
+
+                     case TYPE_DW:
+                        // Each argument is an LSB and MSB
+                        pSection->address += 2 * pInst->args.size();
+                        break;
                 }
             }
 
@@ -1082,7 +855,7 @@ int32_t CAssembler::AssembleLabels(void)
     auto labelIter = m_pSpec->m_LabelMap.begin();
     while (labelIter != m_pSpec->m_LabelMap.end())
     {
-      printf("Label: %s, Type 0x%05X, Addr %d\n", labelIter->first.c_str(),
+      fprintf(m_pLog, "Label: %s, Type 0x%05X, Addr %d\n", labelIter->first.c_str(),
           labelIter->second->m_Type, labelIter->second->m_Address);
 
       // Next label
@@ -1106,7 +879,7 @@ int32_t CAssembler::CreateOutputBuffer(void)
     pPtr = m_pData;
     if (m_pData == NULL)
     {
-        printf("%s: Unable to allocate memory\n", m_pSpec->m_Filename.c_str());
+        fprintf(m_pLog, "%s: Unable to allocate memory\n", m_pSpec->m_Filename.c_str());
         return ERROR_OUT_OF_MEMORY;
     }
 
@@ -1125,11 +898,12 @@ int32_t CAssembler::CreateOutputFile(const char *filename)
     char      * pStr;
     char      * pExt;
 
-    // Allocate the output buffer
-    m_pOutFile = fopen(filename, "w+");
+    // Allocate the output buffer.  Binary objects are converted from the
+    // text records at the end, so those are kept in a temporary file.
+    m_pOutFile = m_BinaryRel ? tmpfile() : fopen(filename, "w+");
     if (m_pOutFile == NULL)
     {
-       printf("%s: Unable to open file for writing\n", filename);
+       fprintf(m_pLog, "%s: Unable to open file for writing\n", filename);
        return ERROR_CANT_OPEN_FILE;
     }
 
@@ -1146,13 +920,34 @@ int32_t CAssembler::CreateOutputFile(const char *filename)
 
 // =============================================================================
 
+int32_t CAssembler::WriteBinaryObject(const char *filename)
+{
+    CRelObject  obj;
+    int32_t     err;
+
+    // Read back the text records and write them in binary form
+    obj.m_pLog = m_pLog;
+    fflush(m_pOutFile);
+    rewind(m_pOutFile);
+    if ((err = obj.ReadText(m_pOutFile, filename)) != ERROR_NONE)
+        return err;
+
+    fclose(m_pOutFile);
+    m_pOutFile = NULL;
+
+    return obj.WriteBin(filename);
+}
+
+// =============================================================================
+
 int32_t CAssembler::AddDataToSection(ResourceSection_t* pSection, CResource* pRes)
 {
     ResourceData_t*     pData = pRes->m_pData;
     uint32_t            offset;
     uint32_t            value;
     int32_t             err, ret = ERROR_NONE;
-    int                 commaValue;
+    CExpression*        pExpr;
+    std::string         sError;
     StrList_t::iterator it;
     
     // Start at beginning offset of data section
@@ -1161,11 +956,22 @@ int32_t CAssembler::AddDataToSection(ResourceSection_t* pSection, CResource* pRe
     // Loop for all elements
     for (it = pData->elements.begin(); it != pData->elements.end(); it++)
     {
-        // Evaluate the expression
-        err = EvaluateExpression(*it, value, pData->spec_filename, pData->spec_line, commaValue);
+        // Compile and evaluate the expression
+        pExpr = CExpression::Compile(*it, m_Width, false, m_pSpec->m_Symbols, sError);
+        if (pExpr == NULL)
+        {
+            fprintf(m_pLog, "%s: Line %d: %s\n", pData->spec_filename.c_str(), pData->spec_line,
+                    sError.c_str());
+            err = ERROR_INVALID_SYNTAX;
+        }
+        else
+        {
+            err = EvaluateExpression(pExpr, value, pData->spec_filename, pData->spec_line);
+            delete pExpr;
+        }
         if (err != ERROR_NONE)
         {
-            printf("Error evaluating expression '%s'\n", (*it).c_str());
+            fprintf(m_pLog, "Error evaluating expression '%s'\n", (*it).c_str());
             // Save the error as the return value and keep parsing to find more errors
             ret = err;
             continue;
@@ -1173,7 +979,7 @@ int32_t CAssembler::AddDataToSection(ResourceSection_t* pSection, CResource* pRe
 
         if (m_DebugLevel >=4 )
         {
-            printf("Adding 0x%0X to %s at 0x%0X\n", value, pData->name.c_str(),
+            fprintf(m_pLog, "Adding 0x%0X to %s at 0x%0X\n", value, pData->name.c_str(),
                     offset);
         }
 
@@ -1218,7 +1024,7 @@ int32_t CAssembler::AddDataToSection(ResourceSection_t* pSection, CResource* pRe
             break;
 
         default:
-            printf("Invalid element size %d\n", pData->elementSize);
+            fprintf(m_pLog, "Invalid element size %d\n", pData->elementSize);
             ret = ERROR_PARSER_ERROR;
             break;
         }
@@ -1235,7 +1041,7 @@ int32_t CAssembler::AddDataAllocationToSection(ResourceSection_t* pSection, CRes
 
     // Print debug info
     if (m_DebugLevel >= 2)
-        printf("Adding data %s at address 0x%0X\n", pData->name.c_str(), pSection->currentOffset +
+        fprintf(m_pLog, "Adding data %s at address 0x%0X\n", pData->name.c_str(), pSection->currentOffset +
             pSection->address + m_pSpec->m_BaseAddress);
     
     // Save the current section offset as our offset
@@ -1246,7 +1052,7 @@ int32_t CAssembler::AddDataAllocationToSection(ResourceSection_t* pSection, CRes
     if (pSection->currentOffset + pData->size > m_pSpec->m_FileSize) 
     {
         // Image output size too small
-        printf("%s: Line %d: Image file too small for data section %s\n",
+        fprintf(m_pLog, "%s: Line %d: Image file too small for data section %s\n",
                 pData->spec_filename.c_str(), pData->spec_line, pData->name.c_str());
         return ERROR_RESOURCE_TOO_BIG;
     }
@@ -1290,7 +1096,7 @@ int32_t CAssembler::AddAlignToSection(ResourceSection_t* pSection, CResource* pR
 
     // Create START variable for this data section
     if (m_DebugLevel >= 2)
-        printf("Aligning to address 0x%0X\n", pSection->currentOffset + pSection->address +
+        fprintf(m_pLog, "Aligning to address 0x%0X\n", pSection->currentOffset + pSection->address +
                 m_pSpec->m_BaseAddress);
 
     return ERROR_NONE;
@@ -1335,7 +1141,7 @@ int32_t CAssembler::TestOverlappingSections(void)
             if (pSection1->address + pSection1->size > pSection2->address)
             {
                 // Sections overlap
-                printf("Sections %s and %s overlap by %d bytes!\n", s1.c_str(), 
+                fprintf(m_pLog, "Sections %s and %s overlap by %d bytes!\n", s1.c_str(), 
                     s2.c_str(), pSection1->address + pSection1->size - pSection2->address);
                 ret = ERROR_SEGMENTS_OVERLAP;
             }
@@ -1355,14 +1161,14 @@ void CAssembler::AddVariable(std::string sVarName, uint32_t value)
     sTempVal << value;
     m_pSpec->m_Variables.insert(std::pair<std::string, std::string>(sTempName.str(), sTempVal.str()));
     if (m_DebugLevel >= 3)
-        printf("Adding variable %s=0x%0X\n", sVarName.c_str(), value);
+        fprintf(m_pLog, "Adding variable %s=0x%0X\n", sVarName.c_str(), value);
 
     sTempName << ".HEX";
     sTempVal.str("");
     sTempVal << "0x" << hex << value;
     m_pSpec->m_Variables.insert(std::pair<std::string, std::string>(sTempName.str(), sTempVal.str()));
     if (m_DebugLevel >= 3)
-        printf("Adding variable %s=0x%0X\n", sTempName.str().c_str(), value);
+        fprintf(m_pLog, "Adding variable %s=0x%0X\n", sTempName.str().c_str(), value);
 }
 
 // =============================================================================
@@ -1434,31 +1240,35 @@ int32_t CAssembler::Assemble(char * pOutputFilename, CParseCtx *pSpec)
     // Create output file 
     if ((err = CreateOutputFile(pOutputFilename)) != ERROR_NONE)
     {
-        printf("Error creating output file\n");
+        fprintf(m_pLog, "Error creating output file\n");
         return err;
     }
 
     // Locate all section files and data
     if ((err = ReadAllSectionFiles()) != ERROR_NONE)
     {
-        printf("Error reading sections\n");
+        fprintf(m_pLog, "Error reading sections\n");
         return err;
     }
 
     // Populate 'data' blocks in all sections
     if ((err = PopulateAllDataBlocks()) != ERROR_NONE)
     {
-        printf("Error populating data blocks\n");
+        fprintf(m_pLog, "Error populating data blocks\n");
         return err;
     }
     
     // Test for overlapping sections
     if ((err = TestOverlappingSections()) != ERROR_NONE)
     {
-        printf("Error testing overlapping sections\n");
+        fprintf(m_pLog, "Error testing overlapping sections\n");
         return err;
     }
 
+    // Write the binary object if requested
+    if (m_BinaryRel && (err = WriteBinaryObject(pOutputFilename)) != ERROR_NONE)
+        return err;
+
     return ERROR_NONE;
 }
 
@@ -27,7 +27,7 @@
 
 #include "parsectx.h"
 
-class CAssembler
+class CAssembler : public CSymbolResolver
 {
     public:
         CAssembler();
@@ -47,6 +47,7 @@ class CAssembler
         uint32_t            m_DebugLevel;
 
         bool                m_Mixed;
+        bool                m_BinaryRel;        // Write a binary .rel object
         int                 m_Width;
 
     private:
@@ -61,19 +62,16 @@ class CAssembler
         /// Iterates through all sections and reads in files and creates data
         int32_t             PopulateAllDataBlocks(void);
 
-        /// Evaluates an expression which may contain a $(VARIABLE)
-        int32_t             EvaluateExpression(std::string& sExpr, uint32_t& value, 
-                                std::string& sFilename, uint32_t lineNo,
-                                int& commaValue, bool isStxx = false);
-
-        /// Evaluates a token
-        int32_t             EvaluateToken(std::string& sExpr, uint32_t& value, 
+        /// Evaluates a compiled expression
+        int32_t             EvaluateExpression(CExpression* pExpr, uint32_t& value, 
                                 std::string& sFilename, uint32_t lineNo);
 
-        /// Replaces all occurances of variables withing sExpr and returns sSubst
-        int32_t             SubstituteVariables(std::string& sExpr, std::string& sSubst, 
-                                std::string& sFilename, uint32_t lineNo,
-                                int& commaValue, bool isStxx);
+        /// Binds and evaluates a symbol referenced by a compiled expression
+        virtual int32_t     ResolveSymbol(CSymbolSlot* pSlot, uint32_t& value,
+                                const std::string& sFilename, uint32_t lineNo);
+
+        /// Returns the label an argument names, if any
+        CLabel*             FindArgLabel(CExpression* pExpr);
 
         /// Validate all labels
         int32_t             AssembleLabels(void);
@@ -84,6 +82,9 @@ class CAssembler
         /// Creates the output buffer for the image data & fills with fill character
         int32_t             CreateOutputFile(const char *filename);
 
+        /// Converts the text records written so far to a binary object
+        int32_t             WriteBinaryObject(const char *filename);
+
         /// Adds the specified data resource to the section
         int32_t             AddDataToSection(ResourceSection_t* pSection,
                                 CResource* pRes);
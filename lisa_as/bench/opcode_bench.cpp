@@ -0,0 +1,148 @@
+// ------------------------------------------------------------------------------
+// (c) Copyright, Ken Pettit, BSD License
+//         All Rights Reserved
+// ------------------------------------------------------------------------------
+//
+//  File        : opcode_bench.cpp
+//  Revision    : 1.0
+//  Author      : Ken Pettit
+//  Created     : 10/16/2026
+//
+// Description:  
+//    Micro-benchmark for the assembler opcode lookup.  Generates a large
+//    synthetic opcode-heavy source file, then reports the lookup rate of
+//    the original linear strcmp scan versus the sorted table binary search
+//    and the overall parse rate in lines/sec.
+//
+// Modifications:
+//
+//    Author            Date        Ver  Description
+//    ================  ==========  ===  =======================================
+//    Ken Pettit        10/16/2026  1.0  Initial version
+//
+// ------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <chrono>
+#include <vector>
+#include <string>
+
+#include "parser.h"
+#include "errors.h"
+
+using namespace std::chrono;
+
+/*
+=============================================================================
+Original lookup:  linear strcmp scan of the opcode table
+=============================================================================
+*/
+static const Opcode_t* LinearFindOpcode(const char *pName)
+{
+    int     x;
+
+    for (x = 0; x < gOpcodeCount; x++)
+        if (strcmp(gOpcodes[x].name, pName) == 0)
+            return &gOpcodes[x];
+
+    return NULL;
+}
+
+/*
+=============================================================================
+Generate a synthetic source file and return the opcode names used
+=============================================================================
+*/
+static int GenerateSource(const char *pFilename, int lines, std::vector<std::string>& names)
+{
+    FILE   *fd;
+    int     x, label = 0;
+
+    if ((fd = fopen(pFilename, "w")) == NULL)
+    {
+        printf("Unable to create %s\n", pFilename);
+        return ERROR_CANT_OPEN_FILE;
+    }
+
+    fprintf(fd, "    .segment .text\n");
+    for (x = 0; x < lines; x++)
+    {
+        const Opcode_t *pOp = &gOpcodes[(x * 7) % gOpcodeCount];
+
+        // Sprinkle in labels every 16 lines
+        if ((x & 15) == 0)
+            fprintf(fd, "_L%d:\n", label++);
+
+        names.push_back(pOp->name);
+        if (pOp->size & SIZE_LABEL)
+            fprintf(fd, "    %-8s  _L%d\n", pOp->name, label > 1 ? label - 1 : 0);
+        else if (pOp->args)
+            fprintf(fd, "    %-8s  %d\n", pOp->name, x & 0x3F);
+        else
+            fprintf(fd, "    %s\n", pOp->name);
+    }
+
+    fclose(fd);
+    return ERROR_NONE;
+}
+
+/*
+=============================================================================
+Main entry point
+=============================================================================
+*/
+int main(int argc, char* argv[])
+{
+    const char     *pFilename = "/tmp/lisa_opcode_bench.S";
+    int             lines = 200000;
+    int             repeat = 20;
+    int             x, r, found;
+    double          secs;
+    std::vector<std::string> names;
+
+    if (argc > 1)
+        lines = atoi(argv[1]);
+
+    if (GenerateSource(pFilename, lines, names) != ERROR_NONE)
+        return 1;
+
+    // Time the original linear lookup
+    auto start = steady_clock::now();
+    for (found = 0, r = 0; r < repeat; r++)
+        for (x = 0; x < (int) names.size(); x++)
+            found += LinearFindOpcode(names[x].c_str()) != NULL;
+    secs = duration<double>(steady_clock::now() - start).count();
+    printf("Linear lookup:      %10.0f lookups/sec\n", found / secs);
+
+    // Time the binary search lookup
+    start = steady_clock::now();
+    for (found = 0, r = 0; r < repeat; r++)
+        for (x = 0; x < (int) names.size(); x++)
+            found += FindOpcode(names[x].c_str()) != NULL;
+    secs = duration<double>(steady_clock::now() - start).count();
+    printf("Binary lookup:      %10.0f lookups/sec\n", found / secs);
+
+    // Now time a full parse of the generated file
+    CParseCtx   spec;
+    CParser     parser(&spec);
+    parser.m_Width = 16;
+    parser.m_DebugLevel = 0;
+
+    start = steady_clock::now();
+    if (parser.ParseFile(pFilename, &spec) != ERROR_NONE)
+    {
+        printf("Error parsing %s\n", pFilename);
+        return 1;
+    }
+    secs = duration<double>(steady_clock::now() - start).count();
+    printf("Parse:              %10.0f lines/sec (%d lines)\n", lines / secs, lines);
+
+    unlink(pFilename);
+    return 0;
+}
+
+// vim: sw=4 ts=4
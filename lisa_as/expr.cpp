@@ -0,0 +1,568 @@
+// ------------------------------------------------------------------------------
+// (c) Copyright, Ken Pettit, BSD License
+//         All Rights Reserved
+// ------------------------------------------------------------------------------
+//
+//  File        : expr.cpp
+//  Revision    : 1.0
+//  Author      : Ken Pettit
+//  Created     : 10/16/2026
+//
+// Description:
+//    Compiles assembler operand expressions to a folded postfix program and
+//    evaluates them against a CSymbolResolver.
+//
+//    Operators (lowest to highest precedence):
+//        |   ^   &   << >>   + -   * /   unary - +   ( )
+//
+// Modifications:
+//
+//    Author            Date        Ver  Description
+//    ================  ==========  ===  =======================================
+//    Ken Pettit        10/16/2026  1.0  Initial version
+//
+// ------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "expr.h"
+#include "errors.h"
+
+/// Maximum evaluation stack depth of a compiled expression
+#define EXPR_MAX_DEPTH  32
+
+/// Characters that terminate a name or number token
+#define EXPR_DELIMS     " \t()|^&+-*/<>"
+
+/*
+=============================================================================
+Recursive descent compiler state.  Each Parse function appends the postfix
+code for its sub-expression to m_pExpr->m_Code.
+=============================================================================
+*/
+class CExprCompiler
+{
+public:
+    CExprCompiler(CExpression* pExpr, const char* pText, StrSymbolMap_t& symbols) :
+        m_pExpr(pExpr), m_pPos(pText), m_Symbols(symbols) {}
+
+    bool            ParseBinary(int level);
+    bool            ParseUnary(void);
+    bool            ParsePrimary(void);
+    bool            AtEnd(void) { SkipWhite(); return *m_pPos == '\0'; }
+    int             MaxDepth(void);
+    void            Emit(int op, int32_t value = 0, CSymbolSlot* pSlot = NULL);
+
+    std::string     m_Error;
+
+private:
+    void            SkipWhite(void) { while (*m_pPos == ' ' || *m_pPos == '\t') m_pPos++; }
+    int             MatchOperator(int level);
+    void            EmitSymbol(const std::string& sName, bool subst);
+    bool            Fold(size_t start, int op);
+
+    CExpression*    m_pExpr;
+    const char*     m_pPos;
+    StrSymbolMap_t& m_Symbols;
+};
+
+/*
+=============================================================================
+Tests if the text at the current position is an operator of the given
+precedence level.  Returns the EXPR_* opcode (consuming it) or 0.
+=============================================================================
+*/
+int CExprCompiler::MatchOperator(int level)
+{
+    SkipWhite();
+    switch (level)
+    {
+        case 0:
+            if (*m_pPos == '|') { m_pPos++; return EXPR_OR; }
+            break;
+        case 1:
+            if (*m_pPos == '^') { m_pPos++; return EXPR_XOR; }
+            break;
+        case 2:
+            if (*m_pPos == '&') { m_pPos++; return EXPR_AND; }
+            break;
+        case 3:
+            if (strncmp(m_pPos, "<<", 2) == 0) { m_pPos += 2; return EXPR_SHL; }
+            if (strncmp(m_pPos, ">>", 2) == 0) { m_pPos += 2; return EXPR_SHR; }
+            break;
+        case 4:
+            if (*m_pPos == '+') { m_pPos++; return EXPR_ADD; }
+            if (*m_pPos == '-') { m_pPos++; return EXPR_SUB; }
+            break;
+        case 5:
+            if (*m_pPos == '*') { m_pPos++; return EXPR_MUL; }
+            if (*m_pPos == '/') { m_pPos++; return EXPR_DIV; }
+            break;
+    }
+
+    return 0;
+}
+
+/*
+=============================================================================
+Appends an operation to the program.
+=============================================================================
+*/
+void CExprCompiler::Emit(int op, int32_t value, CSymbolSlot* pSlot)
+{
+    ExprOp_t    code;
+
+    code.op = op;
+    code.value = value;
+    code.pSlot = pSlot;
+    m_pExpr->m_Code.push_back(code);
+}
+
+/*
+=============================================================================
+Emits a reference to the slot of the named symbol.
+=============================================================================
+*/
+void CExprCompiler::EmitSymbol(const std::string& sName, bool subst)
+{
+    Emit(EXPR_SYMBOL, 0, CExpression::InternSymbol(sName, subst, m_Symbols));
+}
+
+/*
+=============================================================================
+Folds the operation just parsed if all of its operands (the code emitted
+since 'start') are constants.  Returns false on a constant division by 0.
+=============================================================================
+*/
+bool CExprCompiler::Fold(size_t start, int op)
+{
+    std::vector<ExprOp_t>&  code = m_pExpr->m_Code;
+    uint32_t                a, b;
+
+    // Unary operation on a constant
+    if (op == EXPR_NEG)
+    {
+        if (code.size() == start + 1 && code[start].op == EXPR_CONST)
+        {
+            a = code[start].value;
+            code[start].value = -a;
+            return true;
+        }
+        Emit(op);
+        return true;
+    }
+
+    // Binary operation on two constants
+    if (code.size() != start + 2 || code[start].op != EXPR_CONST ||
+        code[start+1].op != EXPR_CONST)
+    {
+        Emit(op);
+        return true;
+    }
+
+    a = code[start].value;
+    b = code[start+1].value;
+    switch (op)
+    {
+        case EXPR_MUL:  a = (int32_t) a * (int32_t) b; break;
+        case EXPR_ADD:  a += b; break;
+        case EXPR_SUB:  a -= b; break;
+        case EXPR_SHL:  a <<= b; break;
+        case EXPR_SHR:  a >>= b; break;
+        case EXPR_AND:  a &= b; break;
+        case EXPR_XOR:  a ^= b; break;
+        case EXPR_OR:   a |= b; break;
+        case EXPR_DIV:
+            if (b == 0)
+            {
+                m_Error = "Division by zero";
+                return false;
+            }
+            a = (int32_t) a / (int32_t) b;
+            break;
+    }
+    code.pop_back();
+    code[start].value = a;
+    return true;
+}
+
+/*
+=============================================================================
+Parses a left-associative chain of binary operators at the given
+precedence level (0 = '|' ... 5 = '*' '/').
+=============================================================================
+*/
+bool CExprCompiler::ParseBinary(int level)
+{
+    size_t      start = m_pExpr->m_Code.size();
+    int         op;
+
+    if (!(level == 5 ? ParseUnary() : ParseBinary(level + 1)))
+        return false;
+
+    while ((op = MatchOperator(level)) != 0)
+    {
+        if (!(level == 5 ? ParseUnary() : ParseBinary(level + 1)))
+            return false;
+        if (!Fold(start, op))
+            return false;
+    }
+
+    return true;
+}
+
+/*
+=============================================================================
+Parses unary '-' and '+' prefixes.
+=============================================================================
+*/
+bool CExprCompiler::ParseUnary(void)
+{
+    size_t      start;
+
+    SkipWhite();
+    if (*m_pPos == '-' || *m_pPos == '+')
+    {
+        char ch = *m_pPos++;
+        start = m_pExpr->m_Code.size();
+        if (!ParseUnary())
+            return false;
+        return ch == '-' ? Fold(start, EXPR_NEG) : true;
+    }
+
+    return ParsePrimary();
+}
+
+/*
+=============================================================================
+Parses a parenthesized expression, $(VARIABLE), literal or symbol name.
+=============================================================================
+*/
+bool CExprCompiler::ParsePrimary(void)
+{
+    const char*     pStart;
+    std::string     sToken;
+    uint32_t        value;
+    size_t          x;
+
+    SkipWhite();
+
+    // Parenthesized sub-expression
+    if (*m_pPos == '(')
+    {
+        m_pPos++;
+        if (!ParseBinary(0))
+            return false;
+        SkipWhite();
+        if (*m_pPos != ')')
+        {
+            m_Error = "Unbalanced parenthesis";
+            return false;
+        }
+        m_pPos++;
+        return true;
+    }
+
+    // $(VARIABLE) reference
+    if (m_pPos[0] == '$' && m_pPos[1] == '(')
+    {
+        pStart = m_pPos + 2;
+        for (m_pPos = pStart; *m_pPos != '\0' && *m_pPos != ')'; m_pPos++)
+            ;
+        if (*m_pPos != ')')
+        {
+            m_Error = "Unbalanced parenthesis";
+            return false;
+        }
+        EmitSymbol(std::string(pStart, m_pPos - pStart), true);
+        m_pPos++;
+        return true;
+    }
+
+    // Binary literal b'0101_1100'
+    if ((m_pPos[0] == 'b' || m_pPos[0] == 'B') && m_pPos[1] == '\'')
+    {
+        value = 0;
+        for (m_pPos += 2; *m_pPos != '\'' && *m_pPos != '\0'; m_pPos++)
+        {
+            if (*m_pPos == '0' || *m_pPos == '1')
+                value = (value << 1) | (*m_pPos - '0');
+            else if (*m_pPos != '_')
+                break;
+        }
+        while (*m_pPos != '\'' && *m_pPos != '\0')
+            m_pPos++;
+        if (*m_pPos == '\'')
+            m_pPos++;
+        Emit(EXPR_CONST, value);
+        return true;
+    }
+
+    // Numeric literal h'1234'
+    if ((m_pPos[0] == 'h' || m_pPos[0] == 'H') && m_pPos[1] == '\'')
+    {
+        m_pPos += 2;
+        value = strtol(m_pPos, NULL, 0);
+        while (*m_pPos != '\'' && *m_pPos != '\0')
+            m_pPos++;
+        if (*m_pPos == '\'')
+            m_pPos++;
+        Emit(EXPR_CONST, value);
+        return true;
+    }
+
+    // Gather a name or number token
+    pStart = m_pPos;
+    while (*m_pPos != '\0' && strchr(EXPR_DELIMS, *m_pPos) == NULL)
+        m_pPos++;
+    if (m_pPos == pStart)
+    {
+        m_Error = "Invalid equation";
+        return false;
+    }
+    sToken.assign(pStart, m_pPos - pStart);
+
+    // Hex literal
+    if (strncmp(sToken.c_str(), "0x", 2) == 0)
+    {
+        Emit(EXPR_CONST, strtoul(sToken.c_str() + 2, NULL, 16));
+        return true;
+    }
+
+    // Decimal (or octal with a leading 0) literal
+    for (x = 0; x < sToken.length(); x++)
+        if (sToken[x] < '0' || sToken[x] > '9')
+            break;
+    if (x == sToken.length())
+    {
+        Emit(EXPR_CONST, strtoul(sToken.c_str(), NULL, 0));
+        return true;
+    }
+
+    // Anything else is a variable or label name
+    EmitSymbol(sToken, false);
+    return true;
+}
+
+/*
+=============================================================================
+Returns the maximum evaluation stack depth of the compiled program.
+=============================================================================
+*/
+int CExprCompiler::MaxDepth(void)
+{
+    std::vector<ExprOp_t>::iterator it;
+    int     depth = 0, maxDepth = 0;
+
+    for (it = m_pExpr->m_Code.begin(); it != m_pExpr->m_Code.end(); ++it)
+    {
+        if (it->op == EXPR_CONST || it->op == EXPR_SYMBOL)
+        {
+            if (++depth > maxDepth)
+                maxDepth = depth;
+        }
+        else if (it->op != EXPR_NEG)
+            depth--;
+    }
+
+    return maxDepth;
+}
+
+/*
+=============================================================================
+Returns the slot of the named symbol, adding it if new.  $(NAME) references
+are kept in separate slots since they also search the environment and never
+bind to labels.
+=============================================================================
+*/
+CSymbolSlot* CExpression::InternSymbol(const std::string& sName, bool subst,
+        StrSymbolMap_t& symbols)
+{
+    std::string                 sKey = subst ? "$(" + sName + ")" : sName;
+    StrSymbolMap_t::iterator    it = symbols.find(sKey);
+    CSymbolSlot*                pSlot;
+
+    if (it == symbols.end())
+    {
+        pSlot = new CSymbolSlot;
+        pSlot->m_Name = sName;
+        pSlot->m_Subst = subst;
+        symbols.insert(std::pair<std::string, CSymbolSlot *>(sKey, pSlot));
+    }
+    else
+        pSlot = it->second;
+
+    return pSlot;
+}
+
+/*
+=============================================================================
+Builds the program of an operand that is a single constant, for operands
+that are handed over already decoded.
+=============================================================================
+*/
+CExpression* CExpression::Constant(int32_t value)
+{
+    CExpression*    pExpr = new CExpression;
+    ExprOp_t        code;
+
+    code.op = EXPR_CONST;
+    code.value = value;
+    code.pSlot = NULL;
+    pExpr->m_Code.push_back(code);
+
+    return pExpr;
+}
+
+/*
+=============================================================================
+Builds the program of an operand that is exactly one symbol name.
+=============================================================================
+*/
+CExpression* CExpression::Symbol(CSymbolSlot* pSlot)
+{
+    CExpression*    pExpr = new CExpression;
+    ExprOp_t        code;
+
+    code.op = EXPR_SYMBOL;
+    code.value = 0;
+    code.pSlot = pSlot;
+    pExpr->m_Code.push_back(code);
+    pExpr->m_pSymbol = pSlot;
+
+    return pExpr;
+}
+
+/*
+=============================================================================
+Compiles an operand expression.  The operand decorations understood by the
+assembler are resolved here, once:
+
+    arg@N       N is saved in m_CommaValue and removed from the expression
+    N(ix)       The (ix) is removed
+    N(sp)       The (sp) is removed for ldxx/stxx, otherwise it ORs in the
+                SP-relative addressing bit for the target width
+=============================================================================
+*/
+CExpression* CExpression::Compile(const std::string& sExpr, int width, bool isStxx,
+        StrSymbolMap_t& symbols, std::string& sError)
+{
+    CExpression*    pExpr = new CExpression;
+    std::string     sText = sExpr;
+    size_t          found;
+
+    // Search for comma
+    found = sText.find("@");
+    if (found != std::string::npos)
+    {
+        pExpr->m_CommaValue = atoi(&sText.c_str()[found+1]);
+        sText.replace(found, std::string::npos, "");
+    }
+
+    // Search for (ix) in the expression
+    found = sText.find("(ix)");
+    if (found != std::string::npos)
+        sText.replace(found, 4, "");
+
+    // Search for (sp) in the expression
+    found = sText.find("(sp)");
+    if (found != std::string::npos)
+    {
+        if (isStxx)
+            sText.replace(found, 4, "");
+        else if (width == 16)
+            sText.replace(found, 4, " | 512");
+        else
+            sText.replace(found, 4, " | 128");
+    }
+
+    CExprCompiler   compiler(pExpr, sText.c_str(), symbols);
+
+    // An empty expression evaluates to zero
+    if (compiler.AtEnd())
+        compiler.Emit(EXPR_CONST, 0);
+    else if (compiler.ParseBinary(0) && !compiler.AtEnd())
+        compiler.m_Error = "Invalid equation";
+
+    if (compiler.m_Error.empty() && compiler.MaxDepth() > EXPR_MAX_DEPTH)
+        compiler.m_Error = "Expression too complex";
+
+    if (!compiler.m_Error.empty())
+    {
+        sError = compiler.m_Error;
+        delete pExpr;
+        return NULL;
+    }
+
+    // Remember operands that are exactly one symbol name (label candidates)
+    if (pExpr->m_Code.size() == 1 && pExpr->m_Code[0].op == EXPR_SYMBOL &&
+        !pExpr->m_Code[0].pSlot->m_Subst && sExpr == pExpr->m_Code[0].pSlot->m_Name)
+    {
+        pExpr->m_pSymbol = pExpr->m_Code[0].pSlot;
+    }
+
+    return pExpr;
+}
+
+/*
+=============================================================================
+Evaluates the compiled program.
+=============================================================================
+*/
+int32_t CExpression::Evaluate(CSymbolResolver* pResolver, uint32_t& value,
+        const std::string& sFilename, uint32_t lineNo)
+{
+    uint32_t        stack[EXPR_MAX_DEPTH];
+    int             sp = 0;
+    int32_t         err;
+    uint32_t        b;
+    std::vector<ExprOp_t>::const_iterator it;
+
+    for (it = m_Code.begin(); it != m_Code.end(); ++it)
+    {
+        switch (it->op)
+        {
+            case EXPR_CONST:
+                stack[sp++] = it->value;
+                continue;
+
+            case EXPR_SYMBOL:
+                if ((err = pResolver->ResolveSymbol(it->pSlot, stack[sp],
+                        sFilename, lineNo)) != ERROR_NONE)
+                    return err;
+                sp++;
+                continue;
+
+            case EXPR_NEG:  stack[sp-1] = -stack[sp-1]; continue;
+        }
+
+        // Binary operations
+        b = stack[--sp];
+        switch (it->op)
+        {
+            case EXPR_MUL:  stack[sp-1] = (int32_t) stack[sp-1] * (int32_t) b; break;
+            case EXPR_ADD:  stack[sp-1] += b; break;
+            case EXPR_SUB:  stack[sp-1] -= b; break;
+            case EXPR_SHL:  stack[sp-1] <<= b; break;
+            case EXPR_SHR:  stack[sp-1] >>= b; break;
+            case EXPR_AND:  stack[sp-1] &= b; break;
+            case EXPR_XOR:  stack[sp-1] ^= b; break;
+            case EXPR_OR:   stack[sp-1] |= b; break;
+            case EXPR_DIV:
+                if (b == 0)
+                {
+                    fprintf(pResolver->m_pLog, "%s: Line %d: Division by zero\n",
+                            sFilename.c_str(), lineNo);
+                    return ERROR_INVALID_SYNTAX;
+                }
+                stack[sp-1] = (int32_t) stack[sp-1] / (int32_t) b;
+                break;
+        }
+    }
+
+    // An empty operand, such as one holding only a comment, is zero
+    value = sp ? stack[0] : 0;
+    return ERROR_NONE;
+}
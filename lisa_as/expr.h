@@ -0,0 +1,131 @@
+// ------------------------------------------------------------------------------
+// (c) Copyright, Ken Pettit, BSD License
+//         All Rights Reserved
+// ------------------------------------------------------------------------------
+//
+//  File        : expr.h
+//  Revision    : 1.0
+//  Author      : Ken Pettit
+//  Created     : 10/16/2026
+//
+// Description:
+//    Pre-compiled assembler expressions.  Operand strings are parsed once
+//    into a small postfix program with constants folded and symbol names
+//    interned to slots, so evaluating an operand during assembly no longer
+//    re-scans and re-substitutes its text.
+//
+// Modifications:
+//
+//    Author            Date        Ver  Description
+//    ================  ==========  ===  =======================================
+//    Ken Pettit        10/16/2026  1.0  Initial version
+//
+// ------------------------------------------------------------------------------
+
+#ifndef EXPR_H
+#define EXPR_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <stdint.h>
+#include <stdio.h>
+
+class CResource;
+class CLabel;
+class CExpression;
+
+/// Symbol slot binding states
+#define SYM_UNBOUND     0
+#define SYM_VARIABLE    1
+#define SYM_LABEL       2
+#define SYM_EXTERN      3
+
+/// A named symbol referenced from compiled expressions.  The slot is bound
+/// to its definition the first time it is successfully evaluated.
+class CSymbolSlot
+{
+public:
+    CSymbolSlot() { m_Kind = SYM_UNBOUND, m_Subst = false, m_pRes = NULL,
+                    m_pValue = NULL, m_pLabel = NULL, m_LabelBound = false,
+                    m_Busy = false; }
+
+    std::string         m_Name;
+    int                 m_Kind;         // SYM_* binding state
+    bool                m_Subst;        // True for $(NAME) references
+    CResource*          m_pRes;         // Label resource when SYM_LABEL
+    CExpression*        m_pValue;       // Compiled value when SYM_VARIABLE
+    CLabel*             m_pLabel;       // Entry in the label map (if any)
+    bool                m_LabelBound;   // m_pLabel has been looked up
+    bool                m_Busy;         // Recursion guard during evaluation
+};
+
+/// Map of interned symbol names to their slots
+typedef std::map<std::string, CSymbolSlot *> StrSymbolMap_t;
+
+/// Interface used by CExpression to obtain the value of a symbol slot
+class CSymbolResolver
+{
+public:
+    CSymbolResolver() { m_pLog = stdout; }
+    virtual             ~CSymbolResolver() {}
+    virtual int32_t     ResolveSymbol(CSymbolSlot* pSlot, uint32_t& value,
+                            const std::string& sFilename, uint32_t lineNo) = 0;
+
+    /// Where diagnostics are written
+    FILE*               m_pLog;
+};
+
+/// Expression program opcodes
+#define EXPR_CONST      1
+#define EXPR_SYMBOL     2
+#define EXPR_NEG        3
+#define EXPR_MUL        4
+#define EXPR_DIV        5
+#define EXPR_ADD        6
+#define EXPR_SUB        7
+#define EXPR_SHL        8
+#define EXPR_SHR        9
+#define EXPR_AND        10
+#define EXPR_XOR        11
+#define EXPR_OR         12
+
+typedef struct ExprOp_s
+{
+    int             op;             // EXPR_* opcode
+    int32_t         value;          // Constant for EXPR_CONST
+    CSymbolSlot*    pSlot;          // Slot for EXPR_SYMBOL
+} ExprOp_t;
+
+class CExpression
+{
+public:
+    CExpression() { m_CommaValue = -1, m_pSymbol = NULL; }
+
+    /// Compiles sExpr.  Returns NULL and fills sError on a syntax error.
+    static CExpression* Compile(const std::string& sExpr, int width, bool isStxx,
+                            StrSymbolMap_t& symbols, std::string& sError);
+
+    /// Returns the slot of a symbol name (or $(NAME) if subst), adding it if new
+    static CSymbolSlot* InternSymbol(const std::string& sName, bool subst,
+                            StrSymbolMap_t& symbols);
+
+    /// Build the program of an operand handed over already decoded
+    static CExpression* Constant(int32_t value);
+    static CExpression* Symbol(CSymbolSlot* pSlot);
+
+    /// Evaluates the compiled program
+    int32_t             Evaluate(CSymbolResolver* pResolver, uint32_t& value,
+                            const std::string& sFilename, uint32_t lineNo);
+
+    /// Value following an '@' in the operand (-1 if none)
+    int                 m_CommaValue;
+
+    /// Slot of the operand when it is exactly one bare symbol name
+    CSymbolSlot*        m_pSymbol;
+
+    /// Postfix program
+    std::vector<ExprOp_t> m_Code;
+};
+
+#endif  // EXPR_H
@@ -22,7 +22,14 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <getopt.h>
+#include <atomic>
+#include <chrono>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include "parser.h"
 #include "assembler.h"
@@ -33,11 +40,172 @@
 void usage(const char *name)
 {
     printf("\nusage:  %s [-DIgo] input_file [input_file]...\n", name);
+    printf("        %s -j threads [-DIgo] input_file [input_file]...\n", name);
     printf("\nOptions:\n");
     printf("   -I path         Add path to the include dirctory search list\n");
     printf("   -D name[=value] Define name in the define symbol table\n");
     printf("   -g level        Set the debug level\n");
-    printf("   -o filename     Set the output filename\n\n");
+    printf("   -b              Write the output as a binary .rel object\n");
+    printf("   -j threads      Assemble each input to its own .rel in parallel\n");
+    printf("                   (0 = one thread per CPU)\n");
+    printf("   -o filename     Set the output filename (output directory with -j)\n\n");
+}
+
+/// Options applied to every parse context
+typedef struct AsmOptions_s
+{
+    std::vector<const char *>   defines;
+    std::vector<const char *>   includes;
+    uint32_t                    debugLevel;
+    bool                        mixed;
+    bool                        binaryOutput;
+    int                         width;
+} AsmOptions_t;
+
+/// One input file of a parallel (-j) run
+typedef struct AsmJob_s
+{
+    const char*     pIn;
+    std::string     sOut;
+    char*           pLog;           // Diagnostics written by the job
+    size_t          logSize;
+    uint32_t        err;
+    double          parseMs;
+    double          asmMs;
+} AsmJob_t;
+
+/*
+================================================================================
+Parse and assemble one input file with its own parse context.  Everything
+the job prints is captured so it can be replayed in file order.
+================================================================================
+*/
+static void assemble_job(AsmJob_t *pJob, const AsmOptions_t *pOpts)
+{
+    CParseCtx       spec;
+    CParser         parser(&spec);
+    CAssembler      assembler;
+    FILE*           pLog;
+    size_t          x;
+
+    pJob->pLog = NULL;
+    pJob->logSize = 0;
+    if ((pLog = open_memstream(&pJob->pLog, &pJob->logSize)) == NULL)
+        pLog = stdout;
+
+    parser.m_pLog = pLog;
+    assembler.m_pLog = pLog;
+    for (x = 0; x < pOpts->defines.size(); x++)
+        parser.AddDefine(pOpts->defines[x]);
+    for (x = 0; x < pOpts->includes.size(); x++)
+        parser.AddInclude(pOpts->includes[x]);
+    parser.m_Width = pOpts->width;
+    parser.m_DebugLevel = pOpts->debugLevel;
+
+    auto start = std::chrono::steady_clock::now();
+    pJob->err = parser.ParseFile(pJob->pIn, &spec);
+    auto parsed = std::chrono::steady_clock::now();
+    pJob->parseMs = std::chrono::duration<double, std::milli>(parsed - start).count();
+    pJob->asmMs = 0;
+
+    if (pJob->err == ERROR_NONE)
+    {
+        assembler.m_Width = pOpts->width;
+        assembler.m_DebugLevel = pOpts->debugLevel;
+        assembler.m_Mixed = pOpts->mixed;
+        assembler.m_BinaryRel = pOpts->binaryOutput;
+        pJob->err = assembler.Assemble((char *) pJob->sOut.c_str(), &spec);
+        if (pJob->err != ERROR_NONE)
+            fprintf(pLog, "Asm error = %d\n", pJob->err);
+        pJob->asmMs = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - parsed).count();
+    }
+
+    if (pLog != stdout)
+        fclose(pLog);
+}
+
+/*
+================================================================================
+Assemble each input to its own .rel on a pool of threads.  The output for
+"dir/name.S" is "name.rel" in pOutDir, or next to the input if pOutDir is
+NULL.  Diagnostics are printed in input order followed by a timing summary.
+================================================================================
+*/
+static int assemble_parallel(char * const *ppInputs, int count, const char *pOutDir,
+        int threads, const AsmOptions_t& opts)
+{
+    std::vector<AsmJob_t>       jobs(count);
+    std::vector<std::thread>    pool;
+    std::set<std::string>       outputs;
+    std::atomic<int>            next(0);
+    const char*                 pBase;
+    const char*                 pExt;
+    uint32_t                    err = ERROR_NONE;
+    int                         x;
+
+    // Name each output
+    for (x = 0; x < count; x++)
+    {
+        jobs[x].pIn = ppInputs[x];
+        pBase = strrchr(ppInputs[x], '/');
+        pBase = pBase ? pBase + 1 : ppInputs[x];
+        pExt = strrchr(pBase, '.');
+
+        if (pOutDir != NULL)
+            jobs[x].sOut = std::string(pOutDir) + "/";
+        else
+            jobs[x].sOut = std::string(ppInputs[x], pBase - ppInputs[x]);
+        jobs[x].sOut.append(pBase, pExt ? pExt - pBase : strlen(pBase));
+        jobs[x].sOut += ".rel";
+
+        if (!outputs.insert(jobs[x].sOut).second)
+        {
+            printf("%s: Output %s would be written twice\n", ppInputs[x],
+                    jobs[x].sOut.c_str());
+            return ERROR_CANT_OPEN_FILE;
+        }
+    }
+
+    if (threads <= 0)
+        threads = std::thread::hardware_concurrency();
+    if (threads <= 0)
+        threads = 1;
+    if (threads > count)
+        threads = count;
+
+    // Each worker takes the next file until none are left
+    auto start = std::chrono::steady_clock::now();
+    for (x = 0; x < threads; x++)
+        pool.push_back(std::thread([&]()
+        {
+            int     job;
+
+            while ((job = next++) < count)
+                assemble_job(&jobs[job], &opts);
+        }));
+    for (x = 0; x < threads; x++)
+        pool[x].join();
+    double wallMs = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+
+    // Report in input order
+    for (x = 0; x < count; x++)
+    {
+        if (jobs[x].logSize)
+            fwrite(jobs[x].pLog, 1, jobs[x].logSize, stdout);
+        free(jobs[x].pLog);
+        if (err == ERROR_NONE)
+            err = jobs[x].err;
+    }
+
+    printf("\n%-40s %10s %12s\n", "File", "Parse ms", "Assemble ms");
+    for (x = 0; x < count; x++)
+        printf("%-40s %10.3f %12.3f%s\n", jobs[x].pIn, jobs[x].parseMs,
+                jobs[x].asmMs, jobs[x].err != ERROR_NONE ? "  (error)" : "");
+    printf("%d files on %d threads in %.3f ms\n", count, threads, wallMs);
+
+    return err;
 }
 
 /*
@@ -50,6 +218,7 @@ int main(int argc, char* argv[])
     CParseCtx       spec;
     CParser         parser(&spec);
     CAssembler      assembler;
+    AsmOptions_t    opts;
     uint32_t        err;
     char*           pIn = NULL;
     char*           pOut = NULL;
@@ -59,6 +228,7 @@ int main(int argc, char* argv[])
     bool            binaryOutput = false;
     bool            mixed = false;
     int             width = 14;
+    int             threads = -1;
     int             c;
 
     // Test if resource script provided
@@ -69,7 +239,7 @@ int main(int argc, char* argv[])
     }
 
     // Parse options
-    while ((c = getopt(argc, argv, "D:g:hI:mo:w:")) != -1)
+    while ((c = getopt(argc, argv, "bD:g:hI:j:mo:w:")) != -1)
     {
         switch (c)
         {
@@ -78,11 +248,15 @@ int main(int argc, char* argv[])
             break;
 
         case 'D':
-            parser.AddDefine(optarg);
+            opts.defines.push_back(optarg);
             break;
 
         case 'I':
-            parser.AddInclude(optarg);
+            opts.includes.push_back(optarg);
+            break;
+
+        case 'j':
+            threads = atoi(optarg);
             break;
 
         case 'o':
@@ -95,6 +269,11 @@ int main(int argc, char* argv[])
             mixed = true;
             break;
 
+        case 'b':
+            // Write a binary relocatable object
+            binaryOutput = true;
+            break;
+
         case 'w':
             width = atoi(optarg);
             break;
@@ -119,12 +298,32 @@ int main(int argc, char* argv[])
         }
     }
 
+    // Assemble each file separately on a thread pool
+    if (threads >= 0)
+    {
+        if (optind >= argc)
+        {
+            printf("Expected input files\n");
+            return 1;
+        }
+        opts.debugLevel = debugLevel;
+        opts.mixed = mixed;
+        opts.binaryOutput = binaryOutput;
+        opts.width = width;
+        return assemble_parallel(&argv[optind], argc - optind, pOut, threads, opts);
+    }
+
     if (pOut == NULL)
     {
        printf("Please specify output file with '-o filename' option\n");
        return 1;
     }
 
+    for (c = 0; c < (int) opts.defines.size(); c++)
+        parser.AddDefine(opts.defines[c]);
+    for (c = 0; c < (int) opts.includes.size(); c++)
+        parser.AddInclude(opts.includes[c]);
+
     parser.m_Width = width;
     assembler.m_Width = width;
 
@@ -141,6 +340,7 @@ int main(int argc, char* argv[])
     // Build the image
     assembler.m_DebugLevel = debugLevel;
     assembler.m_Mixed = mixed;
+    assembler.m_BinaryRel = binaryOutput;
     err = assembler.Assemble(pOut, &spec);
     if (err != ERROR_NONE)
     {
@@ -25,6 +25,9 @@
 #include <string>
 #include <map>
 #include <list>
+#include <vector>
+
+#include "expr.h"
 
 #define     OPCODE_NOP      0x281C
 #define     OPCODE_NOTZ     0x281D
@@ -204,7 +207,8 @@ typedef struct Opcode_s
 {
     const char *name;
     int         args;
-    int         value;
+    int         value;          // 14-bit encoding
+    int         value16;        // 16-bit encoding
     int         size;
 } Opcode_t;
 
@@ -240,6 +244,7 @@ typedef struct Instruction_s
     int             type;           // Type of instruction 
     std::string     name;           // Name associated with instruction
     StrList_t       args;           // List of comma separated arguments
+    std::vector<CExpression *> exprs;   // Compiled args (NULL if not an expression)
     std::string     filename;
     int32_t         value;
     int32_t         size;           // Size of this instruction
@@ -352,6 +357,9 @@ public:
     /// Map of all known labels or referenced labels
     StrLabelMap_t       m_LabelMap;
 
+    /// Symbol slots referenced by compiled expressions
+    StrSymbolMap_t      m_Symbols;
+
     enum endian {
         ENDIAN_UNKNOWN = 0,
         ENDIAN_BIG,
@@ -28,193 +28,152 @@
 #include "parser.h"
 #include "errors.h"
 
-// Define our opcodes
-Opcode_t gOpcodes[] = 
+// Define our opcodes.  Each entry carries both the 14-bit and 16-bit
+// encodings.  The table MUST be kept sorted by name (strcmp order) as
+// FindOpcode() performs a binary search on it.  This is verified at
+// compile time by the static_assert below.
+constexpr Opcode_t gOpcodes[] = 
 {
-//    Name      args   value           size
-    { "ldx",       1, OPCODE_LDX,        2 | SIZE_LABEL | SIZE_ABSOLUTE },
-    { "jal",       1, OPCODE_JAL,        1 | SIZE_LABEL | SIZE_ABSOLUTE },
-    { "ldi",       1, OPCODE_LDI,        1 },
-    { "reti",      1, OPCODE_RETI,       1 },
-    { "ret",       0, OPCODE_RET,        1 },
-    { "rets",      0, OPCODE_RETS,       1 },
-    { "rc",        0, OPCODE_RC,         1 },
-    { "rz",        0, OPCODE_RZ,         1 },
-    { "call_ix",   0, OPCODE_CALL_IX,    1 },
-    { "jmp_ix",    0, OPCODE_JMP_IX,     1 },
-    { "push_ix",   0, OPCODE_PUSH_IX,    1 },
-    { "pop_ix",    0, OPCODE_POP_IX,     1 },
-    { "xchg",      1, OPCODE_XCHG,       1 },
-    { "xchg_ra",   0, OPCODE_XCHG_RA,    1 },
-    { "xchg_ia",   0, OPCODE_XCHG_IA,    1 },
-    { "xchg_sp",   0, OPCODE_XCHG_SP,    1 },
-    { "spix",      0, OPCODE_SPIX,       1 },
-    { "adc",       1, OPCODE_ADC,        1 },
-    { "adx",       1, OPCODE_ADX,        1 },
-    { "addax",     0, OPCODE_ADDAX,      1 },
-    { "addaxu",    0, OPCODE_ADDAXU,     1 },
-    { "subax",     0, OPCODE_SUBAX,      1 },
-    { "subaxu",    0, OPCODE_SUBAXU,     1 },
-    { "ads",       1, OPCODE_ADS,        1 },
-    { "shl",       0, OPCODE_SHL,        1 },
-    { "shr",       0, OPCODE_SHR,        1 },
-    { "shl16",     0, OPCODE_SHL16,      1 },
-    { "shr16",     0, OPCODE_SHR16,      1 },
-    { "ldc",       1, OPCODE_LDC,        1 },
-    { "ldz",       1, OPCODE_LDZ,        1 },
-    { "txa",       0, OPCODE_TXA,        1 },
-    { "txau",      0, OPCODE_TXAU,       1 },
-    { "btst",      1, OPCODE_BTST,       1 },
-    { "tax",       0, OPCODE_TAX,        1 },
-    { "taxu",      0, OPCODE_TAXU,       1 },
-    { "amode",     1, OPCODE_AMODE,      1 },
-    { "sra",       0, OPCODE_SRA,        1 },
-    { "lra",       0, OPCODE_LRA,        1 },
-    { "cpi",       1, OPCODE_CPI,        1 },
-    { "push_a",    0, OPCODE_PUSH_A,     1 },
-    { "pop_a",     0, OPCODE_POP_A,      1 },
-    { "br",        1, OPCODE_BR,         1 | SIZE_LABEL },
-    { "bnz",       1, OPCODE_BNZ,        1 | SIZE_LABEL },
-    { "bz",        1, OPCODE_BZ,         1 | SIZE_LABEL },
-    { "add",       1, OPCODE_ADD,        1 },
-    { "mul",       1, OPCODE_MUL,        1 },
-    { "mulu",      1, OPCODE_MULU,       1 },
-    { "sub",       1, OPCODE_SUB,        1 },
-    { "if",        1, OPCODE_IF,         1 },
-    { "iftt",      1, OPCODE_IFTT,       1 },
-    { "ifte",      1, OPCODE_IFTE,       1 },
-    { "and",       1, OPCODE_AND,        1 },
-    { "andi",      1, OPCODE_ANDI,       1 },
-    { "or",        1, OPCODE_OR,         1 },
-    { "swapi",     1, OPCODE_SWAPI,      1 },
-    { "xor",       1, OPCODE_XOR,        1 },
-    { "cmp",       1, OPCODE_CMP,        1 },
-    { "swap",      1, OPCODE_SWAP,       1 },
-    { "lda",       1, OPCODE_LDA,        1 },
-    { "ldax",      1, OPCODE_LDAX,       1 },
-    { "stax",      1, OPCODE_STAX,       1 },
-    { "ldxx",      1, OPCODE_LDXX,       1 },
-    { "stxx",      1, OPCODE_STXX,       1 },
-    { "sta",       1, OPCODE_STA,        1 },
-    { "nop",       0, OPCODE_NOP,        1 },
-    { "notz",      0, OPCODE_NOTZ,       1 },
-    { "dcx",       1, OPCODE_DCX,        1 },
-    { "inx",       1, OPCODE_INX,        1 },
-    { "cpx",       1, OPCODE_CPX,        1 },
-    { "div",       1, OPCODE_DIV,        1 },
-    { "rem",       1, OPCODE_REM,        1 },
-    { "lddiv",     1, OPCODE_LDDIV,      1 },
-    { "savec",     0, OPCODE_SAVEC,      1 },
-    { "restc",     0, OPCODE_RESTC,      1 },
-    { "taf",       0, OPCODE16_TAF,      1 },
-    { "tafu",      0, OPCODE16_TAFU,     1 },
-    { "tfa",       0, OPCODE16_TFA,      1 },
-    { "tfau",      0, OPCODE16_TFAU,     1 },
-    { "fmul",      1, OPCODE16_FMUL,     1 },
-    { "fdiv",      1, OPCODE16_FDIV,     1 },
-    { "fadd",      1, OPCODE16_FADD,     1 },
-    { "fswap",     1, OPCODE16_FSWAP,    1 },
-    { "fcmp",      1, OPCODE16_FCMP,     1 },
-    { "itof",      0, OPCODE16_ITOF,     1 },
-    { "ftoi",      0, OPCODE16_FTOI,     1 },
-    { "di",        0, OPCODE16_DI,       1 },
-    { "ei",        0, OPCODE16_EI,       1 }
+//    Name      args   value              value16             size
+    { "adc",       1, OPCODE_ADC,        OPCODE16_ADC,       1 },
+    { "add",       1, OPCODE_ADD,        OPCODE16_ADD,       1 },
+    { "addax",     0, OPCODE_ADDAX,      OPCODE16_ADDAX,     1 },
+    { "addaxu",    0, OPCODE_ADDAXU,     OPCODE16_ADDAXU,    1 },
+    { "ads",       1, OPCODE_ADS,        OPCODE16_ADS,       1 },
+    { "adx",       1, OPCODE_ADX,        OPCODE16_ADX,       1 },
+    { "amode",     1, OPCODE_AMODE,      OPCODE16_AMODE,     1 },
+    { "and",       1, OPCODE_AND,        OPCODE16_AND,       1 },
+    { "andi",      1, OPCODE_ANDI,       OPCODE16_ANDI,      1 },
+    { "bnz",       1, OPCODE_BNZ,        OPCODE16_BNZ,       1 | SIZE_LABEL },
+    { "br",        1, OPCODE_BR,         OPCODE16_BR,        1 | SIZE_LABEL },
+    { "btst",      1, OPCODE_BTST,       OPCODE16_BTST,      1 },
+    { "bz",        1, OPCODE_BZ,         OPCODE16_BZ,        1 | SIZE_LABEL },
+    { "call_ix",   0, OPCODE_CALL_IX,    OPCODE16_CALL_IX,   1 },
+    { "cmp",       1, OPCODE_CMP,        OPCODE16_CMP,       1 },
+    { "cpi",       1, OPCODE_CPI,        OPCODE16_CPI,       1 },
+    { "cpx",       1, OPCODE_CPX,        OPCODE16_CPX,       1 },
+    { "dcx",       1, OPCODE_DCX,        OPCODE16_DCX,       1 },
+    { "di",        0, OPCODE16_DI,       OPCODE16_DI,        1 },
+    { "div",       1, OPCODE_DIV,        OPCODE16_DIV,       1 },
+    { "ei",        0, OPCODE16_EI,       OPCODE16_EI,        1 },
+    { "fadd",      1, OPCODE16_FADD,     OPCODE16_FADD,      1 },
+    { "fcmp",      1, OPCODE16_FCMP,     OPCODE16_FCMP,      1 },
+    { "fdiv",      1, OPCODE16_FDIV,     OPCODE16_FDIV,      1 },
+    { "fmul",      1, OPCODE16_FMUL,     OPCODE16_FMUL,      1 },
+    { "fswap",     1, OPCODE16_FSWAP,    OPCODE16_FSWAP,     1 },
+    { "ftoi",      0, OPCODE16_FTOI,     OPCODE16_FTOI,      1 },
+    { "if",        1, OPCODE_IF,         OPCODE16_IF,        1 },
+    { "ifte",      1, OPCODE_IFTE,       OPCODE16_IFTE,      1 },
+    { "iftt",      1, OPCODE_IFTT,       OPCODE16_IFTT,      1 },
+    { "inx",       1, OPCODE_INX,        OPCODE16_INX,       1 },
+    { "itof",      0, OPCODE16_ITOF,     OPCODE16_ITOF,      1 },
+    { "jal",       1, OPCODE_JAL,        OPCODE16_JAL,       1 | SIZE_LABEL | SIZE_ABSOLUTE },
+    { "jmp_ix",    0, OPCODE_JMP_IX,     OPCODE16_JMP_IX,    1 },
+    { "lda",       1, OPCODE_LDA,        OPCODE16_LDA,       1 },
+    { "ldax",      1, OPCODE_LDAX,       OPCODE16_LDAX,      1 },
+    { "ldc",       1, OPCODE_LDC,        OPCODE16_LDC,       1 },
+    { "lddiv",     1, OPCODE_LDDIV,      OPCODE16_LDDIV,     1 },
+    { "ldi",       1, OPCODE_LDI,        OPCODE16_LDI,       1 },
+    { "ldx",       1, OPCODE_LDX,        OPCODE16_LDX,       2 | SIZE_LABEL | SIZE_ABSOLUTE },
+    { "ldxx",      1, OPCODE_LDXX,       OPCODE16_LDXX,      1 },
+    { "ldz",       1, OPCODE_LDZ,        OPCODE16_LDZ,       1 },
+    { "lra",       0, OPCODE_LRA,        OPCODE16_LRA,       1 },
+    { "mul",       1, OPCODE_MUL,        OPCODE16_MUL,       1 },
+    { "mulu",      1, OPCODE_MULU,       OPCODE16_MULU,      1 },
+    { "nop",       0, OPCODE_NOP,        OPCODE16_NOP,       1 },
+    { "notz",      0, OPCODE_NOTZ,       OPCODE16_NOTZ,      1 },
+    { "or",        1, OPCODE_OR,         OPCODE16_OR,        1 },
+    { "pop_a",     0, OPCODE_POP_A,      OPCODE16_POP_A,     1 },
+    { "pop_ix",    0, OPCODE_POP_IX,     OPCODE16_POP_IX,    1 },
+    { "push_a",    0, OPCODE_PUSH_A,     OPCODE16_PUSH_A,    1 },
+    { "push_ix",   0, OPCODE_PUSH_IX,    OPCODE16_PUSH_IX,   1 },
+    { "rc",        0, OPCODE_RC,         OPCODE16_RC,        1 },
+    { "rem",       1, OPCODE_REM,        OPCODE16_REM,       1 },
+    { "restc",     0, OPCODE_RESTC,      OPCODE16_RESTC,     1 },
+    { "ret",       0, OPCODE_RET,        OPCODE16_RET,       1 },
+    { "reti",      1, OPCODE_RETI,       OPCODE16_RETI,      1 },
+    { "rets",      0, OPCODE_RETS,       OPCODE16_RETS,      1 },
+    { "rz",        0, OPCODE_RZ,         OPCODE16_RZ,        1 },
+    { "savec",     0, OPCODE_SAVEC,      OPCODE16_SAVEC,     1 },
+    { "shl",       0, OPCODE_SHL,        OPCODE16_SHL,       1 },
+    { "shl16",     0, OPCODE_SHL16,      OPCODE16_SHL16,     1 },
+    { "shr",       0, OPCODE_SHR,        OPCODE16_SHR,       1 },
+    { "shr16",     0, OPCODE_SHR16,      OPCODE16_SHR16,     1 },
+    { "spix",      0, OPCODE_SPIX,       OPCODE16_SPIX,      1 },
+    { "sra",       0, OPCODE_SRA,        OPCODE16_SRA,       1 },
+    { "sta",       1, OPCODE_STA,        OPCODE16_STA,       1 },
+    { "stax",      1, OPCODE_STAX,       OPCODE16_STAX,      1 },
+    { "stxx",      1, OPCODE_STXX,       OPCODE16_STXX,      1 },
+    { "sub",       1, OPCODE_SUB,        OPCODE16_SUB,       1 },
+    { "subax",     0, OPCODE_SUBAX,      OPCODE16_SUBAX,     1 },
+    { "subaxu",    0, OPCODE_SUBAXU,     OPCODE16_SUBAXU,    1 },
+    { "swap",      1, OPCODE_SWAP,       OPCODE16_SWAP,      1 },
+    { "swapi",     1, OPCODE_SWAPI,      OPCODE16_SWAPI,     1 },
+    { "taf",       0, OPCODE16_TAF,      OPCODE16_TAF,       1 },
+    { "tafu",      0, OPCODE16_TAFU,     OPCODE16_TAFU,      1 },
+    { "tax",       0, OPCODE_TAX,        OPCODE16_TAX,       1 },
+    { "taxu",      0, OPCODE_TAXU,       OPCODE16_TAXU,      1 },
+    { "tfa",       0, OPCODE16_TFA,      OPCODE16_TFA,       1 },
+    { "tfau",      0, OPCODE16_TFAU,     OPCODE16_TFAU,      1 },
+    { "txa",       0, OPCODE_TXA,        OPCODE16_TXA,       1 },
+    { "txau",      0, OPCODE_TXAU,       OPCODE16_TXAU,      1 },
+    { "xchg",      1, OPCODE_XCHG,       OPCODE16_XCHG,      1 },
+    { "xchg_ia",   0, OPCODE_XCHG_IA,    OPCODE16_XCHG_IA,   1 },
+    { "xchg_ra",   0, OPCODE_XCHG_RA,    OPCODE16_XCHG_RA,   1 },
+    { "xchg_sp",   0, OPCODE_XCHG_SP,    OPCODE16_XCHG_SP,   1 },
+    { "xor",       1, OPCODE_XOR,        OPCODE16_XOR,       1 }
 };
-int gOpcodeCount = sizeof(gOpcodes) / sizeof(Opcode_t);
+const int gOpcodeCount = sizeof(gOpcodes) / sizeof(Opcode_t);
 
-// Define our opcodes
-Opcode_t gOpcodes16[] = 
+// Compile time strcmp used to validate the ordering of gOpcodes[]
+static constexpr int ConstStrcmp(const char *a, const char *b)
 {
-//    Name      args   value           size
-    { "ldx",       1, OPCODE16_LDX,        2 | SIZE_LABEL | SIZE_ABSOLUTE },
-    { "jal",       1, OPCODE16_JAL,        1 | SIZE_LABEL | SIZE_ABSOLUTE },
-    { "ldi",       1, OPCODE16_LDI,        1 },
-    { "reti",      1, OPCODE16_RETI,       1 },
-    { "ret",       0, OPCODE16_RET,        1 },
-    { "rets",      0, OPCODE16_RETS,       1 },
-    { "rc",        0, OPCODE16_RC,         1 },
-    { "rz",        0, OPCODE16_RZ,         1 },
-    { "call_ix",   0, OPCODE16_CALL_IX,    1 },
-    { "jmp_ix",    0, OPCODE16_JMP_IX,     1 },
-    { "push_ix",   0, OPCODE16_PUSH_IX,    1 },
-    { "pop_ix",    0, OPCODE16_POP_IX,     1 },
-    { "xchg",      1, OPCODE16_XCHG,       1 },
-    { "xchg_ra",   0, OPCODE16_XCHG_RA,    1 },
-    { "xchg_ia",   0, OPCODE16_XCHG_IA,    1 },
-    { "xchg_sp",   0, OPCODE16_XCHG_SP,    1 },
-    { "spix",      0, OPCODE16_SPIX,       1 },
-    { "adc",       1, OPCODE16_ADC,        1 },
-    { "adx",       1, OPCODE16_ADX,        1 },
-    { "addax",     0, OPCODE16_ADDAX,      1 },
-    { "addaxu",    0, OPCODE16_ADDAXU,     1 },
-    { "subax",     0, OPCODE16_SUBAX,      1 },
-    { "subaxu",    0, OPCODE16_SUBAXU,     1 },
-    { "ads",       1, OPCODE16_ADS,        1 },
-    { "shl",       0, OPCODE16_SHL,        1 },
-    { "shr",       0, OPCODE16_SHR,        1 },
-    { "shl16",     0, OPCODE16_SHL16,      1 },
-    { "shr16",     0, OPCODE16_SHR16,      1 },
-    { "ldc",       1, OPCODE16_LDC,        1 },
-    { "ldz",       1, OPCODE16_LDZ,        1 },
-    { "txa",       0, OPCODE16_TXA,        1 },
-    { "txau",      0, OPCODE16_TXAU,       1 },
-    { "btst",      1, OPCODE16_BTST,       1 },
-    { "tax",       0, OPCODE16_TAX,        1 },
-    { "taxu",      0, OPCODE16_TAXU,       1 },
-    { "amode",     1, OPCODE16_AMODE,      1 },
-    { "sra",       0, OPCODE16_SRA,        1 },
-    { "lra",       0, OPCODE16_LRA,        1 },
-    { "cpi",       1, OPCODE16_CPI,        1 },
-    { "push_a",    0, OPCODE16_PUSH_A,     1 },
-    { "pop_a",     0, OPCODE16_POP_A,      1 },
-    { "br",        1, OPCODE16_BR,         1 | SIZE_LABEL },
-    { "bnz",       1, OPCODE16_BNZ,        1 | SIZE_LABEL },
-    { "bz",        1, OPCODE16_BZ,         1 | SIZE_LABEL },
-    { "add",       1, OPCODE16_ADD,        1 },
-    { "mul",       1, OPCODE16_MUL,        1 },
-    { "mulu",      1, OPCODE16_MULU,       1 },
-    { "sub",       1, OPCODE16_SUB,        1 },
-    { "if",        1, OPCODE16_IF,         1 },
-    { "iftt",      1, OPCODE16_IFTT,       1 },
-    { "ifte",      1, OPCODE16_IFTE,       1 },
-    { "and",       1, OPCODE16_AND,        1 },
-    { "andi",      1, OPCODE16_ANDI,       1 },
-    { "or",        1, OPCODE16_OR,         1 },
-    { "swapi",     1, OPCODE16_SWAPI,      1 },
-    { "xor",       1, OPCODE16_XOR,        1 },
-    { "cmp",       1, OPCODE16_CMP,        1 },
-    { "swap",      1, OPCODE16_SWAP,       1 },
-    { "lda",       1, OPCODE16_LDA,        1 },
-    { "ldax",      1, OPCODE16_LDAX,       1 },
-    { "stax",      1, OPCODE16_STAX,       1 },
-    { "ldxx",      1, OPCODE16_LDXX,       1 },
-    { "stxx",      1, OPCODE16_STXX,       1 },
-    { "sta",       1, OPCODE16_STA,        1 },
-    { "nop",       0, OPCODE16_NOP,        1 },
-    { "notz",      0, OPCODE16_NOTZ,       1 },
-    { "dcx",       1, OPCODE16_DCX,        1 },
-    { "inx",       1, OPCODE16_INX,        1 },
-    { "cpx",       1, OPCODE16_CPX,        1 },
-    { "div",       1, OPCODE16_DIV,        1 },
-    { "rem",       1, OPCODE16_REM,        1 },
-    { "lddiv",     0, OPCODE16_LDDIV,      1 },
-    { "savec",     0, OPCODE16_SAVEC,      1 },
-    { "restc",     0, OPCODE16_RESTC,      1 },
-    { "taf",       0, OPCODE16_TAF,        1 },
-    { "tafu",      0, OPCODE16_TAFU,       1 },
-    { "tfa",       0, OPCODE16_TFA,        1 },
-    { "tfau",      0, OPCODE16_TFAU,       1 },
-    { "fmul",      1, OPCODE16_FMUL,       1 },
-    { "fdiv",      1, OPCODE16_FDIV,     1 },
-    { "fadd",      1, OPCODE16_FADD,       1 },
-    { "fswap",     1, OPCODE16_FSWAP,      1 },
-    { "fcmp",      1, OPCODE16_FCMP,       1 },
-    { "itof",      0, OPCODE16_ITOF,       1 },
-    { "ftoi",      0, OPCODE16_FTOI,       1 },
-    { "di",        0, OPCODE16_DI,         1 },
-    { "ei",        0, OPCODE16_EI,         1 }
-};
-int gOpcodeCount16 = sizeof(gOpcodes16) / sizeof(Opcode_t);
+    while (*a != '\0' && *a == *b)
+    {
+        a++;
+        b++;
+    }
+    return (unsigned char) *a - (unsigned char) *b;
+}
+
+// Compile time test that the opcode table is sorted with no duplicates
+static constexpr bool OpcodesSorted(const Opcode_t *pTable, int count)
+{
+    for (int x = 1; x < count; x++)
+        if (ConstStrcmp(pTable[x-1].name, pTable[x].name) >= 0)
+            return false;
+    return true;
+}
+
+static_assert(OpcodesSorted(gOpcodes, sizeof(gOpcodes) / sizeof(Opcode_t)),
+        "gOpcodes[] must be sorted by name for FindOpcode()");
+
+/* 
+=============================================================================
+Find an opcode by name using a binary search of the sorted opcode table.
+Returns NULL if the opcode is not known.
+=============================================================================
+*/
+const Opcode_t* FindOpcode(const char *pName)
+{
+    int     lo = 0;
+    int     hi = gOpcodeCount - 1;
+    int     mid, cmp;
+
+    while (lo <= hi)
+    {
+        mid = (lo + hi) >> 1;
+        cmp = strcmp(pName, gOpcodes[mid].name);
+        if (cmp == 0)
+            return &gOpcodes[mid];
+        if (cmp < 0)
+            hi = mid - 1;
+        else
+            lo = mid + 1;
+    }
+
+    return NULL;
+}
 
 // Define array of pointers to keyword handlers
 CParserFuncPtr CParser::m_pKeywords[] = { 
@@ -251,6 +210,7 @@ uint32_t CParser::m_keywordCount = sizeof(CParser::m_pKeywords) / sizeof (CParse
 
 CParser::CParser(CParseCtx *pSpec) : m_pSpec(pSpec)
 {
+    m_pLog = stdout;
     m_ParseState = 0;
     m_LastSegment = NULL;
     m_LastResData = NULL;
@@ -551,7 +511,7 @@ int32_t CParser::SubstituteVariables(std::string& sExpr, std::string& sSubst,
                 }
                 else
                 {
-                    printf("%s: Line %d: Variable %s not defined\n", sFilename.c_str(), lineNo, varName.c_str());
+                    fprintf(m_pLog, "%s: Line %d: Variable %s not defined\n", sFilename.c_str(), lineNo, varName.c_str());
                     err = ERROR_VARIABLE_NOT_FOUND;
                     break;
                 }
@@ -571,7 +531,7 @@ int32_t CParser::SubstituteVariables(std::string& sExpr, std::string& sSubst,
 
                 if (m_DebugLevel >= 5)
                 {
-                    printf("%s: Line %d: Subst text = '%s'\n", sFilename.c_str(),
+                    fprintf(m_pLog, "%s: Line %d: Subst text = '%s'\n", sFilename.c_str(),
                             lineNo, sSubst.c_str());
                 }
             }
@@ -1363,6 +1323,10 @@ bool CParser::TestForOrg(char* sLine, CParserFile* pFile, int32_t& err)
         // Address will be calculated by assembler
         pInst->address = 0;
 
+        // Compile the arguments once for the assembler
+        if ((err = CompileArgs(pInst, pFile, false)) != ERROR_NONE)
+            return true;
+
         // Add resource to the parse context
         m_LastSegment->resources.push_back(pRes);
         
@@ -1620,6 +1584,10 @@ bool CParser::TestForDs(char* sLine, CParserFile* pFile, int32_t& err)
         // Address will be calculated by assembler
         pInst->address = 0;
 
+        // Compile the arguments once for the assembler
+        if ((err = CompileArgs(pInst, pFile, false)) != ERROR_NONE)
+            return true;
+
         // Add resource to the parse context
         m_LastSegment->resources.push_back(pRes);
         
@@ -1735,6 +1703,10 @@ bool CParser::TestForDb(char* sLine, CParserFile* pFile, int32_t& err)
         // Address will be calculated by assembler
         pInst->address = 0;
 
+        // Compile the arguments once for the assembler
+        if ((err = CompileArgs(pInst, pFile, false)) != ERROR_NONE)
+            return true;
+
         // Add resource to the parse context
         m_LastSegment->resources.push_back(pRes);
         
@@ -1808,6 +1780,10 @@ bool CParser::TestForDw(char* sLine, CParserFile* pFile, int32_t& err)
         // Address will be calculated by assembler
         pInst->address = 0;
 
+        // Compile the arguments once for the assembler
+        if ((err = CompileArgs(pInst, pFile, false)) != ERROR_NONE)
+            return true;
+
         // Add resource to the parse context
         m_LastSegment->resources.push_back(pRes);
         
@@ -2091,6 +2067,42 @@ bool CParser::isConst(char *pBuf)
     return isConst;
 }
 
+/* 
+=============================================================================
+Compiles each argument of pInst to a CExpression in pInst->exprs.  Quoted
+strings and '%' extern references are not expressions and get NULL entries.
+=============================================================================
+*/
+int32_t CParser::CompileArgs(Instruction_t* pInst, CParserFile* pFile, bool isStxx)
+{
+    StrList_t::iterator it;
+    std::stringstream   err_str;
+    std::string         sError;
+    CExpression*        pExpr;
+
+    for (it = pInst->args.begin(); it != pInst->args.end(); ++it)
+    {
+        // Test for arguments that are not expressions
+        if ((*it)[0] == '%' || (*it)[0] == '"')
+        {
+            pInst->exprs.push_back(NULL);
+            continue;
+        }
+
+        pExpr = CExpression::Compile(*it, m_Width, isStxx, m_pSpec->m_Symbols, sError);
+        if (pExpr == NULL)
+        {
+            err_str << pFile->m_Filename << ": Line " << pFile->m_Line << 
+                ": " << sError << " in '" << *it << "'";
+            m_Error = err_str.str();
+            return ERROR_INVALID_SYNTAX;
+        }
+        pInst->exprs.push_back(pExpr);
+    }
+
+    return ERROR_NONE;
+}
+
 /* 
 =============================================================================
 Handle detection of opcodes in the code
@@ -2103,9 +2115,11 @@ bool CParser::TestForOpcode(char* sLine, CParserFile* pFile, int32_t& err)
     std::stringstream   err_str;
     std::string         sOpcode;
     std::string         sArg;
-    int                 x, y, len;
+    int                 y, len;
+    const Opcode_t*     pOpcode;
     char                buf[512];
     char*               pBuf;
+    bool                isStxx;
 
     // Ensure this isn't a variable declaration
     if (strchr(sLine, '=') == NULL)
@@ -2132,17 +2146,10 @@ bool CParser::TestForOpcode(char* sLine, CParserFile* pFile, int32_t& err)
         sOpcode = sToken;
 
         // Find the opcode in our table
-        for (x = 0; x < gOpcodeCount; x++)
-        {
-            if (strcmp(gOpcodes[x].name, sToken) == 0)
-            {
-                // Opcode found!  break and process it
-                break;
-            }
-        }
+        pOpcode = FindOpcode(sToken);
 
         // Test if opcode found or not
-        if (x == gOpcodeCount)
+        if (pOpcode == NULL)
         {
             // Opcode not found
             err_str << pFile->m_Filename << ": Line " << pFile->m_Line << 
@@ -2156,7 +2163,7 @@ bool CParser::TestForOpcode(char* sLine, CParserFile* pFile, int32_t& err)
         Instruction_t *pInst = new Instruction_t;
 
         // Get all opcode arguments from the input string
-        for (y = 0; y < gOpcodes[x].args; y++)
+        for (y = 0; y < pOpcode->args; y++)
         {
             // Get the next argument
             sToken = strtok_r(NULL, ",\n", &sNextToken);
@@ -2166,7 +2173,7 @@ bool CParser::TestForOpcode(char* sLine, CParserFile* pFile, int32_t& err)
             {
                 // Not enough arguments provided
                 err_str << pFile->m_Filename << ": Line " << pFile->m_Line << 
-                    ": Expected " << gOpcodes[x].args << " arguments for opcode '" <<
+                    ": Expected " << pOpcode->args << " arguments for opcode '" <<
                     sOpcode << "'";
                 m_Error = err_str.str();
                 err = ERROR_INVALID_OPCODE_SYNTAX;
@@ -2185,30 +2192,9 @@ bool CParser::TestForOpcode(char* sLine, CParserFile* pFile, int32_t& err)
             // Add the argument to the instruction arg list
             pInst->args.push_back(pBuf);
 
-            if (y == 0 && (gOpcodes[x].size & SIZE_LABEL) == SIZE_LABEL)
-            {
-                if (!isConst(pBuf))
-                {
-                    // This is a label argument.  Find label in our list
-                    std::string labelName = pBuf;
-                    auto labelIter = m_pSpec->m_LabelMap.find(labelName);
-                    if (labelIter == m_pSpec->m_LabelMap.end())
-                    {
-                        CLabel *pLabel = new CLabel();
-                        pLabel->m_Name = labelName;
-                        pLabel->m_Defined = 0;
-                        pLabel->m_Type = gOpcodes[x].size & SIZE_ABSOLUTE;
-                        pLabel->m_Line = 0;
-                        m_pSpec->m_LabelMap.insert(std::pair<std::string, CLabel *>(labelName, pLabel));
-                        m_LastSegment->labels.insert(std::pair<std::string, CLabel *>(labelName, pLabel));
-                    }
-                    else
-                    {
-                        // Mark the label as ABSOLUTE if defined by the opcode
-                        labelIter->second->m_Type |= (gOpcodes[x].size & SIZE_ABSOLUTE);
-                    }
-                }
-            }
+            // This is a label argument
+            if (y == 0 && (pOpcode->size & SIZE_LABEL) == SIZE_LABEL && !isConst(pBuf))
+                AddLabelRef(pBuf, pOpcode);
         }
 
         // Test for additional decription argument
@@ -2224,28 +2210,13 @@ bool CParser::TestForOpcode(char* sLine, CParserFile* pFile, int32_t& err)
             }
         }
         
-        // Create a resource for the instruction object
-        CResource* pRes = new CResource;
-        pRes->m_pInst = pInst;
-
-        // Populate with our opcode data
-        pInst->type = TYPE_OPCODE;
-        if (m_Width == 16)
-            pInst->value = gOpcodes16[x].value;
-        else
-            pInst->value = gOpcodes[x].value;
-        pInst->size = gOpcodes[x].size;
-        pInst->name = sOpcode;
-        pInst->argc = gOpcodes[x].args;
-        pInst->filename = pFile->m_Filename;
-        pInst->line = pFile->m_Line;
-        m_LastSegment->address += gOpcodes[x].size;
-
-        // Address will be calculated by assembler
-        pInst->address = 0;
+        // Compile the arguments once for the assembler.  The (sp) offset
+        // of ldxx / stxx does not carry the SP-relative bit.
+        isStxx = pOpcode->value == OPCODE_STXX || pOpcode->value == OPCODE_LDXX;
+        if ((err = CompileArgs(pInst, pFile, isStxx)) != ERROR_NONE)
+            return true;
 
-        // Add resource to the parse context
-        m_LastSegment->resources.push_back(pRes);
+        AddOpcode(pInst, pOpcode, pFile);
         
         err = ERROR_NONE;
         return true;
@@ -2255,6 +2226,64 @@ bool CParser::TestForOpcode(char* sLine, CParserFile* pFile, int32_t& err)
     return false;
 }
 
+/* 
+=============================================================================
+Add a label used as the operand of pOpcode to the label map, or mark it
+ABSOLUTE if it is already there and the opcode needs it to be.
+=============================================================================
+*/
+void CParser::AddLabelRef(const std::string& labelName, const Opcode_t* pOpcode)
+{
+    auto labelIter = m_pSpec->m_LabelMap.find(labelName);
+    if (labelIter == m_pSpec->m_LabelMap.end())
+    {
+        CLabel *pLabel = new CLabel();
+        pLabel->m_Name = labelName;
+        pLabel->m_Defined = 0;
+        pLabel->m_Type = pOpcode->size & SIZE_ABSOLUTE;
+        pLabel->m_Line = 0;
+        m_pSpec->m_LabelMap.insert(std::pair<std::string, CLabel *>(labelName, pLabel));
+        m_LastSegment->labels.insert(std::pair<std::string, CLabel *>(labelName, pLabel));
+    }
+    else
+    {
+        // Mark the label as ABSOLUTE if defined by the opcode
+        labelIter->second->m_Type |= (pOpcode->size & SIZE_ABSOLUTE);
+    }
+}
+
+/* 
+=============================================================================
+Fill in the opcode data of pInst, whose arguments are already compiled, and
+add it to the current segment.
+=============================================================================
+*/
+void CParser::AddOpcode(Instruction_t* pInst, const Opcode_t* pOpcode, CParserFile* pFile)
+{
+    // Create a resource for the instruction object
+    CResource* pRes = new CResource;
+    pRes->m_pInst = pInst;
+
+    // Populate with our opcode data
+    pInst->type = TYPE_OPCODE;
+    if (m_Width == 16)
+        pInst->value = pOpcode->value16;
+    else
+        pInst->value = pOpcode->value;
+    pInst->size = pOpcode->size;
+    pInst->name = pOpcode->name;
+    pInst->argc = pOpcode->args;
+    pInst->filename = pFile->m_Filename;
+    pInst->line = pFile->m_Line;
+    m_LastSegment->address += pOpcode->size;
+
+    // Address will be calculated by assembler
+    pInst->address = 0;
+
+    // Add resource to the parse context
+    m_LastSegment->resources.push_back(pRes);
+}
+
 /* 
 =============================================================================
 Handle 'data' keyword in the assembled source
@@ -2540,13 +2569,14 @@ void CParser::AddDefine(const char *name)
     char sMutable[1024];
     const char *var;
     const char *value;
+    char *pNext;
 
     // Copy to a mutable string
     strncpy(sMutable, name, sizeof(sMutable));
 
     // Split out value from define (this is a command line operation)
-    var = strtok(sMutable, "=");
-    value = strtok(NULL, "=");
+    var = strtok_r(sMutable, "=", &pNext);
+    value = strtok_r(NULL, "=", &pNext);
 
     // If no value given, default it to 1
     if (value == NULL)
@@ -2583,7 +2613,9 @@ int32_t CParser::ParseLine(const char* sLine, CParserFile* pFile)
             return ERROR_NONE;
         }
 
-        // Test all keyword handlers for known keywords
+        // Test all keyword handlers for known keywords.  Not every handler
+        // sets err when it accepts a line.
+        err = ERROR_NONE;
         for (c = 0; c < m_keywordCount; c++)
         {
             char *ptr = sMutable;
@@ -2623,7 +2655,7 @@ int32_t CParser::ParseLine(const char* sLine, CParserFile* pFile)
         {
             err_str << pFile->m_Filename << ": Line " << pFile->m_Line << 
                 ": Expecting '}' at end of data statement";
-            printf("%s\n", err_str.str().c_str());
+            fprintf(m_pLog, "%s\n", err_str.str().c_str());
             m_ParseState = STATE_IDLE;
             
             // Re-parse this line in STATE_IDLE mode
@@ -2647,6 +2679,84 @@ int32_t CParser::ParseLine(const char* sLine, CParserFile* pFile)
     return ERROR_PARSER_ERROR;
 }
 
+/* 
+=============================================================================
+Strip comments from one source line and parse it.  commentBlock carries an
+open '/*' comment from one line to the next.
+=============================================================================
+*/
+int32_t CParser::ParseSourceLine(char* sLine, CParserFile* pFile, bool& commentBlock)
+{
+    int32_t     err;
+    char*       pComment;
+
+    // Increment the line number for this file
+    pFile->m_Line++;
+
+    // Remove trailing \n if it exists
+    int len = strlen(sLine);
+    if (len > 0 && sLine[len - 1] == '\n')
+        sLine[len - 1] = '\0';
+
+    // Search for a comment in the line "//" and remove it
+    if ((pComment = strstr(sLine, "//")) != NULL)
+        *pComment = '\0';
+
+    // Search for 'c' style comment or continuation of same
+    while (((pComment = strstr(sLine, "/*")) != NULL) || (m_ParseState == STATE_COMMENT))
+    {
+        // Test for lines between open and close comment
+        if (pComment == NULL)
+        {
+            // Test for close comment
+            pComment = strstr(sLine, "*/");
+            if (pComment == NULL)
+            {
+                *sLine = '\0';
+                break;
+            }
+            else
+               pComment = sLine;
+        }
+
+        // Change comment bytes to spaces (whitespace)
+        while (*pComment && strncmp(pComment, "*/", 2) != 0)
+        {
+            // Change anything in the comment to whitespace
+            *pComment++ = ' ';
+        }
+
+        // Test if end of comment found above
+        if (strncmp(pComment, "*/", 2) == 0)
+        {
+            // Remove the end comment
+            *pComment++ = ' ';
+            *pComment++ = ' ';
+            m_ParseState = STATE_IDLE;
+            commentBlock = false;
+        }
+        else
+        {
+            commentBlock = true;
+        }
+    }
+
+    // Parse the line
+    if ((err = ParseLine(sLine, pFile)) != ERROR_NONE)
+    {
+        fprintf(m_pLog, "%s\n", m_Error.c_str());
+        m_Error = "";
+    }
+
+    // Test if we need to transition to comment block mode
+    if (commentBlock)
+    {
+        m_ParseState = STATE_COMMENT;
+    }
+
+    return err;
+}
+
 /* 
 =============================================================================
 Parse an input file.  This may be called recursively in the case an 
@@ -2659,14 +2769,12 @@ int32_t CParser::ParseFile(const char *pFilename, CParseCtx* pSpec)
     char        sLine[512];
     FILE*       fd;
     int32_t     err, lastErr;
-    bool        parseFailed;
-    char*       pComment;
     bool        comment_block = false;
 
     // Try to open the file
     if ((fd = fopen(pFilename, "r")) == NULL)
     {
-        printf("Error opening file %s\n", pFilename);
+        fprintf(m_pLog, "Error opening file %s\n", pFilename);
         return ERROR_CANT_OPEN_FILE;
     }
 
@@ -2680,81 +2788,134 @@ int32_t CParser::ParseFile(const char *pFilename, CParseCtx* pSpec)
     m_pSpec->m_Filename = pFilename;
 
     // Read all lines from the input file and parse each
-    parseFailed = false;
     lastErr = ERROR_NONE;
     while (fgets(sLine, sizeof sLine, fd) != NULL)
     {
-        // Increment the line number for this file
-        file.m_Line++;
+        if ((err = ParseSourceLine(sLine, &file, comment_block)) != ERROR_NONE)
+            lastErr = err;
+    }
 
-        // Remove trailing \n if it exists
-        int len = strlen(sLine);
-        if (sLine[len - 1] == '\n')
-            sLine[len - 1] = '\0';
+    // Close the file
+    fclose(fd);
 
-        // Search for a comment in the line "//" and remove it
-        if ((pComment = strstr(sLine, "//")) != NULL)
-            *pComment = '\0';
+    return lastErr;
+}
 
-        // Search for 'c' style comment or continuation of same
-        while (((pComment = strstr(sLine, "/*")) != NULL) || (m_ParseState == STATE_COMMENT))
-        {
-            // Test for lines between open and close comment
-            if (pComment == NULL)
-            {
-                // Test for close comment
-                pComment = strstr(sLine, "*/");
-                if (pComment == NULL)
-                {
-                    *sLine = '\0';
-                    break;
-                }
-                else
-                   pComment = sLine;
-            }
+/* 
+=============================================================================
+Start a source that is handed to the parser one line at a time from memory
+instead of being read from a file.  pName is used in diagnostics.
+=============================================================================
+*/
+void CParser::BeginSource(const char *pName, CParseCtx* pSpec)
+{
+    m_Source.m_Filename = pName;
+    m_Source.m_Line = 0;
+    m_SourceComment = false;
+    m_SourceErr = ERROR_NONE;
 
-            // Change comment bytes to spaces (whitespace)
-            while (*pComment && strncmp(pComment, "*/", 2) != 0)
-            {
-                // Change anything in the comment to whitespace
-                *pComment++ = ' ';
-            }
+    if (pSpec != NULL)
+        m_pSpec = pSpec;
+    m_pSpec->m_Filename = pName;
+}
 
-            // Test if end of comment found above
-            if (strncmp(pComment, "*/", 2) == 0)
-            {
-                // Remove the end comment
-                *pComment++ = ' ';
-                *pComment++ = ' ';
-                m_ParseState = STATE_IDLE;
-                comment_block = false;
-            }
-            else
-            {
-                comment_block = true;
-            }
-        }
+/* 
+=============================================================================
+Parse the next line of the source started by BeginSource.  The text may
+omit its trailing newline; embedded newlines separate lines just as they
+do in a file.
+=============================================================================
+*/
+int32_t CParser::ParseSource(const char *pLine)
+{
+    char        sLine[512];
+    const char* pEnd;
+    size_t      len;
+    int32_t     err, lastErr = ERROR_NONE;
 
-        // Parse the line
-        if ((err = ParseLine(sLine, &file)) != ERROR_NONE)
-        {
-            parseFailed = true;
-            lastErr = err;
-            printf("%s\n", m_Error.c_str());
-            m_Error = "";
-        }
+    do
+    {
+        pEnd = strchr(pLine, '\n');
+        len = pEnd ? pEnd - pLine : strlen(pLine);
+        if (len > sizeof sLine - 1)
+            len = sizeof sLine - 1;
+        memcpy(sLine, pLine, len);
+        sLine[len] = '\0';
+
+        if ((err = ParseSourceLine(sLine, &m_Source, m_SourceComment)) != ERROR_NONE)
+            m_SourceErr = lastErr = err;
+        pLine = pEnd + 1;
+    } while (pEnd != NULL);
 
-        // Test if we need to transition to comment block mode
-        if (comment_block)
-        {
-            m_ParseState = STATE_COMMENT;
-        }
+    return lastErr;
+}
+
+/* 
+=============================================================================
+Add an opcode to the source started by BeginSource from its decoded fields.
+It takes the place of one source line, but nothing is tokenized or compiled:
+the argument is a constant, an N(sp) stack offset or a symbol, and its text
+is only formatted for the listing comments of the .rel.
+=============================================================================
+*/
+int32_t CParser::ParseOpcode(const Opcode_t* pOpcode, int argKind, int32_t value,
+        CSymbolSlot* pSymbol)
+{
+    Instruction_t*      pInst;
+    char                sArg[24];
+
+    m_Source.m_Line++;
+
+    // Do opcode assembly only if in an assemble state
+    if (m_IfStat[m_IfDepth] != IF_STAT_ASSEMBLE)
+        return ERROR_NONE;
+
+    if (pOpcode->args > (argKind != OPARG_NONE))
+    {
+        fprintf(m_pLog, "%s: Line %d: Expected %d arguments for opcode '%s'\n",
+            m_Source.m_Filename.c_str(), m_Source.m_Line, pOpcode->args, pOpcode->name);
+        return m_SourceErr = ERROR_INVALID_OPCODE_SYNTAX;
     }
 
-    // Close the file
-    fclose(fd);
+    pInst = new Instruction_t;
+    switch (argKind)
+    {
+        case OPARG_CONST:
+            snprintf(sArg, sizeof sArg, "%d", value);
+            pInst->args.push_back(sArg);
+            pInst->exprs.push_back(CExpression::Constant(value));
+            break;
 
-    return lastErr;
+        case OPARG_STACK:
+            // As in CExpression::Compile, the (sp) offset of ldxx / stxx
+            // does not carry the SP-relative bit
+            snprintf(sArg, sizeof sArg, "%d(sp)", value);
+            if (pOpcode->value != OPCODE_STXX && pOpcode->value != OPCODE_LDXX)
+                value |= m_Width == 16 ? 512 : 128;
+            pInst->args.push_back(sArg);
+            pInst->exprs.push_back(CExpression::Constant(value));
+            break;
+
+        case OPARG_SYMBOL:
+            pInst->args.push_back(pSymbol->m_Name);
+            pInst->exprs.push_back(CExpression::Symbol(pSymbol));
+            if ((pOpcode->size & SIZE_LABEL) == SIZE_LABEL)
+                AddLabelRef(pSymbol->m_Name, pOpcode);
+            break;
+    }
+
+    AddOpcode(pInst, pOpcode, &m_Source);
+    return ERROR_NONE;
+}
+
+/* 
+=============================================================================
+End the in-memory source and return the last parse error in it, if any.
+=============================================================================
+*/
+int32_t CParser::EndSource(void)
+{
+    return m_SourceErr;
 }
 
 // vim: sw=4 ts=4
@@ -42,6 +42,19 @@
 #define     COND_GT         6
 #define     COND_BINARY     7
 
+/// Operand kinds of CParser::ParseOpcode (the same as LISA_ASM_ARG_*)
+#define     OPARG_NONE      0
+#define     OPARG_CONST     1
+#define     OPARG_STACK     2
+#define     OPARG_SYMBOL    3
+
+/// Sorted table of all known opcodes (see parser.cpp)
+extern const Opcode_t gOpcodes[];
+extern const int      gOpcodeCount;
+
+/// Binary search of gOpcodes[] by name.  Returns NULL if not found.
+const Opcode_t*     FindOpcode(const char *pName);
+
 class CParserFile
 {
     public:
@@ -62,6 +75,16 @@ class CParser
 
         int32_t             ParseFile(const char * pFilename, CParseCtx *pSpec = NULL);
 
+        /// Parses a source handed over one line at a time from memory
+        void                BeginSource(const char *pName, CParseCtx *pSpec = NULL);
+        int32_t             ParseSource(const char *pLine);
+        int32_t             EndSource(void);
+
+        /// Adds an opcode to the in-memory source from its decoded fields
+        /// instead of from its text
+        int32_t             ParseOpcode(const Opcode_t* pOpcode, int argKind,
+                                int32_t value, CSymbolSlot* pSymbol);
+
         /// Debug print level
         uint32_t            m_DebugLevel;
 
@@ -72,7 +95,13 @@ class CParser
 
         int                 m_Width;
 
+        /// Where diagnostics are written
+        FILE*               m_pLog;
+
     private:
+        /// Strips comments from a source line and parses it
+        int32_t             ParseSourceLine(char* sLine, CParserFile* pFile, bool& commentBlock);
+
         /// Parses a single line from a CParseCtx file
         virtual int32_t     ParseLine(const char* pLine, CParserFile* pFile);
 
@@ -109,6 +138,16 @@ class CParser
         int                 directive_if(char* sExpr, CParserFile* pFile, int32_t& err, int instIsIf);
         bool                isConst(char *pStr);
 
+        /// Adds a label operand of pOpcode to the label map
+        void                AddLabelRef(const std::string& labelName, const Opcode_t* pOpcode);
+
+        /// Adds an instruction with its arguments to the current segment
+        void                AddOpcode(Instruction_t* pInst, const Opcode_t* pOpcode,
+                                CParserFile* pFile);
+
+        /// Compiles the instruction's arguments to expressions
+        int32_t             CompileArgs(Instruction_t* pInst, CParserFile* pFile, bool isStxx);
+
         /// Evaluates an expression which may contain a $(VARIABLE)
         int32_t             EvaluateExpression(std::string& sExpr, uint32_t& value, 
                                 std::string& sFilename, uint32_t lineNo);
@@ -145,6 +184,11 @@ class CParser
         int                 m_IfDepth;
         int                 m_LastIfElseLine;   // Line number of last #if, #ifdef, IF, or else
         int                 m_LastIfElseIsIf;   // True if last was #if or #ifdef
+
+        /// State of the source being fed through ParseSource
+        CParserFile         m_Source;
+        bool                m_SourceComment;
+        int32_t             m_SourceErr;
 };
 
 #endif  // PARSER_H
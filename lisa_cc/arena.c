@@ -0,0 +1,101 @@
+// Copyright 2026 Ken Pettit <pettitkd@gmail.com>
+// Released under the MIT license.
+
+// Arenas are bump allocators for objects that share a lifetime.  Tokens,
+// AST nodes and types, and the asm lines of the function being generated
+// are each carved out of large chunks instead of being malloc'ed one at a
+// time, which keeps objects that are walked together close in memory.
+//
+// Nothing allocated from an arena is freed on its own.  The whole arena is
+// released at once when its phase ends: tokens once the translation unit
+// is parsed and asm lines after each toplevel is written.  The AST and
+// interned strings are kept until the compiler exits.
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include "lisacc.h"
+
+#define CHUNK_SIZE (64 * 1024)
+
+typedef struct Chunk {
+    struct Chunk *next;
+    size_t size;
+} Chunk;
+
+#define CHUNK_HEADER ((sizeof(Chunk) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+Arena token_arena = { "token" };
+Arena ast_arena = { "ast" };
+Arena asm_arena = { "asm" };
+bool memreport = false;
+
+static Arena *arenas[] = { &token_arena, &ast_arena, &asm_arena, &intern_arena };
+
+static void *new_chunk(Arena *a, size_t size) {
+    Chunk *c = malloc(CHUNK_HEADER + size);
+    if (!c)
+        error("out of memory");
+    c->next = a->chunks;
+    c->size = size;
+    a->chunks = c;
+    a->reserved += size;
+    if (a->reserved > a->peak)
+        a->peak = a->reserved;
+    return (char *)c + CHUNK_HEADER;
+}
+
+void *arena_alloc(Arena *a, size_t size) {
+    size_t chunksize = a->chunksize ? a->chunksize : CHUNK_SIZE;
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    a->allocated += size;
+    a->nalloc++;
+    if (size > (size_t)(a->end - a->p)) {
+        // Large objects get a chunk of their own so the current one is kept
+        if (size > chunksize / 4)
+            return new_chunk(a, size);
+        a->p = new_chunk(a, chunksize);
+        a->end = a->p + chunksize;
+    }
+    void *r = a->p;
+    a->p += size;
+    return r;
+}
+
+void *arena_calloc(Arena *a, size_t size) {
+    return memset(arena_alloc(a, size), 0, size);
+}
+
+char *arena_strdup(Arena *a, char *s) {
+    size_t len = strlen(s) + 1;
+    return memcpy(arena_alloc(a, len), s, len);
+}
+
+void arena_release(Arena *a) {
+    Chunk *c = a->chunks;
+    while (c) {
+        Chunk *next = c->next;
+        free(c);
+        c = next;
+    }
+    a->chunks = NULL;
+    a->p = a->end = NULL;
+    a->reserved = 0;
+    a->releases++;
+}
+
+// Prints the bytes allocated from each arena for -fmem-report
+void print_mem_report(void) {
+    struct rusage ru;
+
+    fprintf(stderr, "memory report:\n");
+    fprintf(stderr, "  %-8s %12s %10s %12s %12s %9s\n",
+            "arena", "allocated", "objects", "peak", "held", "releases");
+    for (int i = 0; i < sizeof(arenas) / sizeof(*arenas); i++) {
+        Arena *a = arenas[i];
+        fprintf(stderr, "  %-8s %12zu %10zu %12zu %12zu %9d\n",
+                a->name, a->allocated, a->nalloc, a->peak, a->reserved, a->releases);
+    }
+    if (getrusage(RUSAGE_SELF, &ru) == 0)
+        fprintf(stderr, "  peak rss %ld KB\n", ru.ru_maxrss);
+}
@@ -0,0 +1,259 @@
+// Copyright 2026 Ken Pettit <pettitkd@gmail.com>
+// Released under the MIT license.
+
+// Front end benchmark.  Reports the lexer's throughput in MB/s on a large
+// generated source file.  Then generates a header-heavy translation unit
+// -- many guarded headers full of macros, typedefs, structs, enums and
+// commented prototypes, each included several times -- and reports the
+// time to preprocess it and to parse it, without and with a warm token
+// cache for the headers (-ftoken-cache).  The lexer, preprocessor and
+// parser keep their state in globals, so every run is done in a forked
+// child.  It also times Map lookups through a chain of scopes, by an
+// interned identifier as the lexer produces them and by a plain copy of
+// the same name.
+//
+// To run, type "make bench" from the lisa_cc directory.
+
+#include <dirent.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "lisacc.h"
+
+#define HEADERS     40
+#define MACROS      60
+#define TYPES       20
+#define FUNCS       200
+#define INCLUDES    3
+#define RUNS        5
+#define LEX_LINES   100000
+
+#define NAMES       2000
+#define SCOPES      4
+#define LOOKUPS     4000000
+
+enum { LEX, PREPROCESS, PARSE };
+
+// Normally provided by main.c
+char *gpToolPath = BUILD_DIR;
+char gOptimizationLevel = '1';
+static char *infile;
+
+char *get_base_file() {
+    return infile;
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void write_header(char *dir, int h) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/h%d.h", dir, h);
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        perror(path);
+        exit(1);
+    }
+    fprintf(fp, "#ifndef H%d_H\n#define H%d_H\n\n", h, h);
+    fprintf(fp, "#define H%d_M0 %d\n", h, h);
+    for (int i = 1; i < MACROS; i++)
+        fprintf(fp, "#define H%d_M%d (H%d_M%d + %d)\n", h, i, h, i - 1, i);
+    fprintf(fp, "#define H%d_ADD(a, b) ((a) + (b) + H%d_M%d)\n\n", h, h, MACROS / 2);
+    fprintf(fp, "enum h%d_e {", h);
+    for (int i = 0; i < TYPES; i++)
+        fprintf(fp, "%s H%d_E%d", i ? "," : "", h, i);
+    fprintf(fp, " };\n\n");
+    for (int i = 0; i < TYPES; i++) {
+        fprintf(fp, "\n/*\n * Type %d of header %d and the function that fills one in.\n"
+                " * Returns the number of fields set, or -1 on error.\n */\n", i, h);
+        fprintf(fp, "typedef struct h%d_s%d { int a; char b; long c; } h%d_t%d;\n", h, i, h, i);
+        fprintf(fp, "int h%d_f%d(h%d_t%d *p, int x);\n", h, i, h, i);
+    }
+    fprintf(fp, "\n#endif\n");
+    fclose(fp);
+}
+
+// Writes a large file of plain C for the lexer: comments, identifiers,
+// numbers, strings and indentation, with no preprocessor work to do
+static char *write_lex_input(char *dir) {
+    char *path = format("%s/lex.c", dir);
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        perror(path);
+        exit(1);
+    }
+    for (int i = 0; i < LEX_LINES; i += 10) {
+        fprintf(fp, "/*\n * Function number %d of the lexer benchmark input.\n */\n", i);
+        fprintf(fp, "static unsigned long lex_function_%d(struct lex_state *state, int count)\n{\n", i);
+        fprintf(fp, "    unsigned long total = 0x%xUL; // running total\n", i * 7919);
+        fprintf(fp, "    for (int index = 0; index < count; index++)\n");
+        fprintf(fp, "        total += state->values[index] * %d + %d.%de-3;\n", i % 97, i, i % 10);
+        fprintf(fp, "    return report(state, \"function %d done\\n\", total);\n}\n", i);
+    }
+    fclose(fp);
+    return path;
+}
+
+static char *write_input(char *dir) {
+    for (int h = 0; h < HEADERS; h++)
+        write_header(dir, h);
+    char *path = format("%s/main.c", dir);
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        perror(path);
+        exit(1);
+    }
+    for (int n = 0; n < INCLUDES; n++)
+        for (int h = 0; h < HEADERS; h++)
+            fprintf(fp, "#include \"h%d.h\"\n", h);
+    for (int i = 0; i < FUNCS; i++) {
+        int h = i % HEADERS, t = i % TYPES;
+        fprintf(fp, "\nint f%d(int x) {\n", i);
+        fprintf(fp, "    h%d_t%d v;\n", h, t);
+        fprintf(fp, "    v.a = H%d_ADD(x, H%d_M%d);\n", h, h, i % MACROS);
+        fprintf(fp, "    if (v.a > H%d_E%d)\n        v.b = h%d_f%d(&v, x);\n", h, t, h, t);
+        fprintf(fp, "    return v.a + v.b;\n}\n");
+    }
+    fclose(fp);
+    return path;
+}
+
+// Lexes, preprocesses or parses the input in this process and returns
+// the elapsed time.  *count is the number of tokens or toplevels.
+static double run_once(int mode, int *count) {
+    lex_init(infile);
+    if (mode != LEX) {
+        cpp_init();
+        parse_init();
+    }
+    double start = now();
+    *count = 0;
+    if (mode == PARSE) {
+        *count = vec_len(read_toplevels());
+    } else if (mode == PREPROCESS) {
+        while (read_token()->kind != TEOF)
+            (*count)++;
+    } else {
+        while (lex()->kind != TEOF)
+            (*count)++;
+    }
+    return now() - start;
+}
+
+// Returns the best time of RUNS forked runs
+static double run(int mode, int *count) {
+    double best = 0;
+    for (int i = 0; i < RUNS; i++) {
+        int fds[2];
+        if (pipe(fds) < 0) {
+            perror("pipe");
+            exit(1);
+        }
+        pid_t pid = fork();
+        if (pid == 0) {
+            struct { double t; int n; } r;
+            r.t = run_once(mode, &r.n);
+            write(fds[1], &r, sizeof(r));
+            _exit(0);
+        }
+        struct { double t; int n; } r;
+        close(fds[1]);
+        if (read(fds[0], &r, sizeof(r)) != sizeof(r)) {
+            fprintf(stderr, "benchmark run failed\n");
+            exit(1);
+        }
+        close(fds[0]);
+        waitpid(pid, NULL, 0);
+        if (i == 0 || r.t < best)
+            best = r.t;
+        *count = r.n;
+    }
+    return best;
+}
+
+// Times map_get of every name through SCOPES nested maps, where the name
+// is defined in the outermost one
+static double time_lookups(char **names) {
+    Map *m = make_map();
+    for (int i = 0; i < NAMES; i++)
+        map_put(m, names[i], names[i]);
+    for (int i = 0; i < SCOPES; i++)
+        m = make_map_parent(m);
+
+    int found = 0;
+    double start = now();
+    for (int i = 0; i < LOOKUPS; i++)
+        found += map_get(m, names[i % NAMES]) != NULL;
+    double t = now() - start;
+    if (found != LOOKUPS)
+        fprintf(stderr, "lookup failed\n");
+    return t;
+}
+
+int main(int argc, char **argv) {
+    char dir[] = "/tmp/parse_benchXXXXXX";
+    int count;
+
+    if (!mkdtemp(dir)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    struct stat st;
+    infile = write_lex_input(dir);
+    stat(infile, &st);
+    double t = run(LEX, &count);
+    printf("Lexer input: %d lines, %.2f MB\n\n", LEX_LINES, st.st_size / 1e6);
+    printf("  lex               %8.2f ms  %8d tokens  %6.2f MB/s\n\n",
+           t * 1e3, count, st.st_size / t / 1e6);
+    unlink(infile);
+
+    infile = write_input(dir);
+    printf("Input: %d headers, each included %d times, %d functions\n\n",
+           HEADERS, INCLUDES, FUNCS);
+
+    t = run(PREPROCESS, &count);
+    printf("  preprocess        %8.2f ms  %8d tokens  %6.2f Mtok/s\n",
+           t * 1e3, count, count / t / 1e6);
+    t = run(PARSE, &count);
+    printf("  preprocess+parse  %8.2f ms  %8d toplevels\n", t * 1e3, count);
+
+    // The first run fills the cache, so the best one is a warm run
+    token_cache_dir = format("%s/cache", dir);
+    t = run(PREPROCESS, &count);
+    printf("\nWith a warm token cache:\n");
+    printf("  preprocess        %8.2f ms  %8d tokens  %6.2f Mtok/s\n",
+           t * 1e3, count, count / t / 1e6);
+    t = run(PARSE, &count);
+    printf("  preprocess+parse  %8.2f ms  %8d toplevels\n", t * 1e3, count);
+
+    char **interned = malloc(NAMES * sizeof(char *));
+    char **copies = malloc(NAMES * sizeof(char *));
+    for (int i = 0; i < NAMES; i++) {
+        interned[i] = intern(format("name_%d", i));
+        copies[i] = format("name_%d", i);
+    }
+    double ti = time_lookups(interned);
+    double tc = time_lookups(copies);
+    printf("\nMap lookup through %d scopes:\n", SCOPES);
+    printf("  interned key      %8.2f ns\n", ti / LOOKUPS * 1e9);
+    printf("  plain string key  %8.2f ns\n", tc / LOOKUPS * 1e9);
+
+    DIR *dp = opendir(token_cache_dir);
+    for (struct dirent *ent; dp && (ent = readdir(dp));)
+        if (ent->d_name[0] != '.')
+            unlink(format("%s/%s", token_cache_dir, ent->d_name));
+    if (dp)
+        closedir(dp);
+    rmdir(token_cache_dir);
+    for (int h = 0; h < HEADERS; h++)
+        unlink(format("%s/h%d.h", dir, h));
+    unlink(infile);
+    rmdir(dir);
+    return 0;
+}
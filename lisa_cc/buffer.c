@@ -39,8 +39,10 @@ void buf_write(Buffer *b, char c) {
 }
 
 void buf_append(Buffer *b, char *s, int len) {
-    for (int i = 0; i < len; i++)
-        buf_write(b, s[i]);
+    while (b->nalloc < b->len + len + 1)
+        realloc_body(b);
+    memcpy(b->body + b->len, s, len);
+    b->len += len;
 }
 
 void buf_printf(Buffer *b, char *fmt, ...) {
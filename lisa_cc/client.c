@@ -0,0 +1,140 @@
+// Copyright 2026 Ken Pettit <pettitkd@gmail.com>
+// Released under the MIT license.
+
+// lisa_cc_client: a drop-in replacement for the lisa_cc command line that
+// hands the compile to a running compile server (lisa_cc --server).  The
+// server is found through $LISA_CC_SERVER or the per-user default socket,
+// and is only used if it runs as the same user.  When no server answers,
+// the client runs lisa_cc itself, so build rules can use it
+// unconditionally.
+
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "server.h"
+
+static int connect_server(void) {
+    struct sockaddr_un addr;
+    char path[sizeof(addr.sun_path)];
+    if (!server_socket_path(path, sizeof(path), false))
+        return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    // The server gets our stdio, so it must be our own
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || !server_peer_ok(fd)) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Runs the compiler directly: the lisa_cc next to this binary, else
+// the one on $PATH.
+static void run_local(char **argv) {
+    char self[PATH_MAX];
+    ssize_t len = readlink("/proc/self/exe", self, sizeof(self) - 1);
+    if (len > 0) {
+        self[len] = '\0';
+        char *slash = strrchr(self, '/');
+        if (slash && slash - self + sizeof("/lisa_cc") <= sizeof(self)) {
+            strcpy(slash, "/lisa_cc");
+            execv(self, argv);
+        }
+    }
+    execvp("lisa_cc", argv);
+    fprintf(stderr, "lisa_cc_client: cannot run lisa_cc: %s\n", strerror(errno));
+    exit(1);
+}
+
+static int write_full(int fd, const void *buf, size_t len) {
+    const char *p = buf;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -1;
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+// Sends the request header with our stdio descriptors attached, then
+// the working directory and arguments.
+static int send_request(int fd, int argc, char **argv) {
+    char cwd[PATH_MAX];
+    if (!getcwd(cwd, sizeof(cwd)))
+        return -1;
+    size_t size = strlen(cwd) + 1;
+    for (int i = 0; i < argc; i++)
+        size += strlen(argv[i]) + 1;
+    if (size > SERVER_MAX_REQUEST)
+        return -1;
+    char *body = malloc(size);
+    char *p = body;
+    p = stpcpy(p, cwd) + 1;
+    for (int i = 0; i < argc; i++)
+        p = stpcpy(p, argv[i]) + 1;
+
+    ServerRequest req;
+    memcpy(req.magic, SERVER_MAGIC, 4);
+    req.argc = argc;
+    req.size = size;
+
+    int fds[SERVER_NFDS] = { 0, 1, 2 };
+    char cbuf[CMSG_SPACE(sizeof(fds))];
+    struct iovec iov = { &req, sizeof(req) };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    memset(cbuf, 0, sizeof(cbuf));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cbuf;
+    msg.msg_controllen = sizeof(cbuf);
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    int r = -1;
+    if (sendmsg(fd, &msg, 0) == sizeof(req))
+        r = write_full(fd, body, size);
+    free(body);
+    return r;
+}
+
+int main(int argc, char **argv) {
+    int fd = connect_server();
+    if (fd < 0)
+        run_local(argv);
+    if (send_request(fd, argc, argv) < 0) {
+        close(fd);
+        run_local(argv);
+    }
+
+    int32_t status;
+    size_t got = 0;
+    while (got < sizeof(status)) {
+        ssize_t n = read(fd, (char *)&status + got, sizeof(status) - got);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0) {
+            fprintf(stderr, "lisa_cc_client: compile server closed the connection\n");
+            return 1;
+        }
+        got += n;
+    }
+    close(fd);
+    return status;
+}
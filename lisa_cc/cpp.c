@@ -6,10 +6,12 @@
  */
 
 #include <ctype.h>
+#include <dirent.h>
 #include <libgen.h>
 #include <locale.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <time.h>
 #include <unistd.h>
 #include "lisacc.h"
@@ -20,6 +22,7 @@ static Map *keywords = &EMPTY_MAP;
 static Map *include_guard = &EMPTY_MAP;
 static Vector *cond_incl_stack = &EMPTY_VECTOR;
 static Vector *std_include_path = &EMPTY_VECTOR;
+static Map *header_cache;
 static struct tm now;
 static Token *cpp_token_zero = &(Token){ .kind = TNUMBER, .sval = "0" };
 static Token *cpp_token_one = &(Token){ .kind = TNUMBER, .sval = "1" };
@@ -51,19 +54,27 @@ static void define_obj_macro(char *name, Token *value);
 static void read_directive(Token *hash);
 static Token *read_expand(void);
 
+typedef struct {
+    char *text;
+    off_t size;
+    time_t mtime;
+    char *guard;    // include guard of a header that only defines macros
+    Map *defs;      // the macros it defines, or NULL if it must be read
+} CachedHeader;
+
 /*
  * Constructors
  */
 
 static CondIncl *make_cond_incl(bool wastrue) {
-    CondIncl *r = calloc(1, sizeof(CondIncl));
+    CondIncl *r = arena_calloc(&token_arena, sizeof(CondIncl));
     r->ctx = IN_THEN;
     r->wastrue = wastrue;
     return r;
 }
 
 static Macro *make_macro(Macro *tmpl) {
-    Macro *r = malloc(sizeof(Macro));
+    Macro *r = arena_alloc(&token_arena, sizeof(Macro));
     *r = *tmpl;
     return r;
 }
@@ -82,7 +93,7 @@ static Macro *make_special_macro(SpecialMacroHandler *fn) {
 }
 
 static Token *make_macro_token(int position, bool is_vararg) {
-    Token *r = malloc(sizeof(Token));
+    Token *r = arena_alloc(&token_arena, sizeof(Token));
     r->kind = TMACRO_PARAM;
     r->is_vararg = is_vararg;
     r->hideset = NULL;
@@ -93,7 +104,7 @@ static Token *make_macro_token(int position, bool is_vararg) {
 }
 
 static Token *copy_token(Token *tok) {
-    Token *r = malloc(sizeof(Token));
+    Token *r = arena_alloc(&token_arena, sizeof(Token));
     *r = *tok;
     return r;
 }
@@ -676,18 +687,60 @@ static bool guarded(char *path) {
     return r;
 }
 
+// Returns the header read by cache_headers, or NULL if it isn't cached
+// or has changed on disk since.
+static CachedHeader *find_cached_header(char *path) {
+    if (!header_cache)
+        return NULL;
+    CachedHeader *h = map_get(header_cache, path);
+    if (!h)
+        return NULL;
+    struct stat st;
+    if (stat(path, &st) == -1 || st.st_size != h->size || st.st_mtime != h->mtime)
+        return NULL;
+    return h;
+}
+
+static File *open_cached_header(char *path, CachedHeader *h) {
+    File *f = make_file_string(h->text);
+    f->name = path;
+    f->mtime = h->mtime;
+    return f;
+}
+
+// Includes a header the compile server preprocessed when it started.  Its
+// macros are defined unless its guard already is, as reading it would.
+static void include_preprocessed(char *path, CachedHeader *h) {
+    if (!map_get(macros, h->guard))
+        map_put_all(macros, h->defs);
+    map_put(include_guard, path, h->guard);
+}
+
 static bool try_include(char *dir, char *filename, bool isimport) {
     char *path = fullpath(format("%s/%s", dir, filename));
     if (map_get(once, path))
         return true;
     if (guarded(path))
         return true;
-    FILE *fp = fopen(path, "r");
-    if (!fp)
-        return false;
+    CachedHeader *h = find_cached_header(path);
+    if (h && h->defs) {
+        include_preprocessed(path, h);
+        if (isimport)
+            map_put(once, path, (void *)1);
+        return true;
+    }
+    File *f = h ? open_cached_header(path, h) : NULL;
+    if (!f) {
+        FILE *fp = fopen(path, "r");
+        if (!fp)
+            return false;
+        f = make_file(fp, path);
+    }
     if (isimport)
         map_put(once, path, (void *)1);
-    stream_push(make_file(fp, path));
+    if (token_cache_dir)
+        tcache_attach(f);
+    stream_push(f);
     return true;
 }
 
@@ -935,12 +988,11 @@ static void init_keywords() {
 #undef op
 }
 
-static void init_predefined_macros() {
-    char    str[512];
-
-    snprintf(str, sizeof(str)-1, "%s/include", gpToolPath);
-    vec_push(std_include_path, strdup(str));
+static void init_tool_include_path() {
+    vec_push(std_include_path, format("%s/include", gpToolPath));
+}
 
+static void init_predefined_macros() {
     define_special_macro("__LISA__", handle_date_macro);
     define_special_macro("__DATE__", handle_date_macro);
     define_special_macro("__TIME__", handle_time_macro);
@@ -961,13 +1013,106 @@ void init_now() {
     localtime_r(&timet, &now);
 }
 
+// Returns true if each directive in text is a #define, or the one #ifndef
+// and #endif an include guard needs.  Such a header defines the same
+// macros whatever was defined before it, except its guard.
+static bool only_defines(char *text) {
+    int nifndef = 0;
+    for (char *p = text; p; p = strchr(p, '\n')) {
+        p += strspn(p, " \t\n");
+        if (*p != '#')
+            continue;
+        p += 1 + strspn(p + 1, " \t");
+        int len = strcspn(p, " \t\n");
+        if (len == 6 && !strncmp(p, "ifndef", len))
+            nifndef++;
+        else if (!(len == 6 && !strncmp(p, "define", len)) &&
+                 !(len == 5 && !strncmp(p, "endif", len)))
+            return false;
+    }
+    return nifndef == 1;
+}
+
+// Preprocesses a cached header that only defines macros under its include
+// guard and keeps those macros, so that the compile server's workers
+// inherit them and include the header without reading it.
+static void preprocess_header(char *path, CachedHeader *h) {
+    if (!only_defines(h->text))
+        return;
+    Map *saved = macros;
+    macros = make_map_parent(saved);
+    stream_stash(open_cached_header(path, h));
+    bool tokens = false;
+    while (read_token()->kind != TEOF)
+        tokens = true;
+    stream_unstash();
+    h->guard = map_get(include_guard, path);
+    if (h->guard && !tokens)
+        h->defs = macros;
+    map_remove(include_guard, path);
+    macros = saved;
+}
+
+// Reads every header in dir into header_cache so the compile server's
+// workers don't reopen the standard headers for each request.
+static void cache_headers(char *dir) {
+    DIR *dp = opendir(dir);
+    if (!dp)
+        return;
+    struct dirent *ent;
+    while ((ent = readdir(dp))) {
+        char *path = fullpath(format("%s/%s", dir, ent->d_name));
+        struct stat st;
+        if (map_get(header_cache, path) || stat(path, &st) == -1 || !S_ISREG(st.st_mode))
+            continue;
+        FILE *fp = fopen(path, "r");
+        if (!fp)
+            continue;
+        CachedHeader *h = calloc(1, sizeof(CachedHeader));
+        h->text = malloc(st.st_size + 1);
+        h->size = fread(h->text, 1, st.st_size, fp);
+        h->text[h->size] = '\0';
+        h->mtime = st.st_mtime;
+        fclose(fp);
+        if (h->size != st.st_size) {
+            free(h->text);
+            free(h);
+            continue;
+        }
+        map_put(header_cache, path, h);
+        preprocess_header(path, h);
+    }
+    closedir(dp);
+}
+
 void cpp_init() {
     setlocale(LC_ALL, "C");
     init_keywords();
     init_now();
+    init_tool_include_path();
     init_predefined_macros();
 }
 
+// The request independent part of cpp_init, run once by the compile
+// server.  The builtin macros and lisacc.h typedefs it defines, and the
+// cached headers with their preprocessed macros, are inherited by every
+// worker.
+void cpp_init_server() {
+    setlocale(LC_ALL, "C");
+    init_keywords();
+    header_cache = make_map();
+    cache_headers(format("%s/include", gpToolPath));
+    cache_headers(BUILD_DIR "/include");
+    init_predefined_macros();
+}
+
+// The per-request part of cpp_init.  The tool include path goes after
+// the request's -I paths, as it does for a normal run.
+void cpp_init_request() {
+    init_now();
+    init_tool_include_path();
+}
+
 /*
  * Public intefaces
  */
@@ -287,6 +287,20 @@ void do_node2s(Buffer *b, Node *node, int indent) {
 
         buf_printf(b, "goto(%s)", node->label);
         break;
+    case AST_SWITCH_TABLE:
+        if (indent != -1)
+        {
+            buf_printf(b, sIndent, " ");
+            buf_printf(b, "AST_SWITCH_TABLE\n");
+            buf_printf(b, sIndent2, " ");
+            nextIndent += 2;
+        }
+
+        buf_printf(b, "(goto-table %s", node2s(node->tableidx, nextIndent));
+        for (int i = 0; i < vec_len(node->tablelabels); i++)
+            buf_printf(b, " %s", vec_get(node->tablelabels, i));
+        buf_printf(b, ")");
+        break;
     case AST_DECL:
         if (indent != -1)
         {
@@ -2,8 +2,11 @@
 
 /*
  * This file provides character input stream for C source code.
- * An input stream is either backed by stdio's FILE * or
- * backed by a string.
+ * An input stream is either backed by a file, whose whole contents
+ * are memory-mapped (or read, if the file can't be mapped), or
+ * backed by a string.  Either way the characters are read from
+ * contiguous memory, and the lexer can take runs of ordinary
+ * characters in bulk with read_span.
  * The following input processing is done at this stage.
  *
  * - C11 5.1.1.2p1: "\r\n" or "\r" are canonicalized to "\n".
@@ -19,6 +22,7 @@
 #include <errno.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -27,6 +31,23 @@
 static Vector *files = &EMPTY_VECTOR;
 static Vector *stashed = &EMPTY_VECTOR;
 
+// Reads the rest of a stream that can't be mapped, such as a pipe
+static char *read_all(FILE *file, size_t *len) {
+    size_t size = 4096;
+    char *buf = malloc(size);
+    *len = 0;
+    for (;;) {
+        *len += fread(buf + *len, 1, size - *len, file);
+        if (*len < size)
+            break;
+        size *= 2;
+        buf = realloc(buf, size);
+    }
+    if (ferror(file))
+        error("read failed: %s", strerror(errno));
+    return buf;
+}
+
 File *make_file(FILE *file, char *name) {
     File *r = calloc(1, sizeof(File));
     r->file = file;
@@ -37,6 +58,21 @@ File *make_file(FILE *file, char *name) {
     if (fstat(fileno(file), &st) == -1)
         error("fstat failed: %s", strerror(errno));
     r->mtime = st.st_mtime;
+
+    size_t len;
+    char *p = NULL;
+    if (S_ISREG(st.st_mode) && st.st_size > 0) {
+        len = st.st_size;
+        p = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+        if (p == MAP_FAILED)
+            p = NULL;
+        else
+            r->map = p, r->maplen = len;
+    }
+    if (!p)
+        p = read_all(file, &len);
+    r->begin = r->p = p;
+    r->end = p + len;
     return r;
 }
 
@@ -44,40 +80,31 @@ File *make_file_string(char *s) {
     File *r = calloc(1, sizeof(File));
     r->line = 1;
     r->column = 1;
-    r->p = s;
+    r->begin = r->p = s;
+    r->end = s + strlen(s);
     return r;
 }
 
 static void close_file(File *f) {
+    if (f->tcache)
+        tcache_close(f);
+    if (f->map)
+        munmap(f->map, f->maplen);
     if (f->file)
         fclose(f->file);
 }
 
-static int readc_file(File *f) {
-    int c = getc(f->file);
-    if (c == EOF) {
-        c = (f->last == '\n' || f->last == EOF) ? EOF : '\n';
-    } else if (c == '\r') {
-        int c2 = getc(f->file);
-        if (c2 != '\n')
-            ungetc(c2, f->file);
-        c = '\n';
-    }
-    f->last = c;
-    return c;
-}
-
-static int readc_string(File *f) {
+static int readc_buffer(File *f) {
     int c;
-    if (*f->p == '\0') {
+    if (f->p == f->end) {
         c = (f->last == '\n' || f->last == EOF) ? EOF : '\n';
     } else if (*f->p == '\r') {
         f->p++;
-        if (*f->p == '\n')
+        if (f->p < f->end && *f->p == '\n')
             f->p++;
         c = '\n';
     } else {
-        c = *f->p++;
+        c = (unsigned char)*f->p++;
     }
     f->last = c;
     return c;
@@ -88,10 +115,8 @@ static int get() {
     int c;
     if (f->buflen > 0) {
         c = f->buf[--f->buflen];
-    } else if (f->file) {
-        c = readc_file(f);
     } else {
-        c = readc_string(f);
+        c = readc_buffer(f);
     }
     if (c == '\n') {
         f->line++;
@@ -135,6 +160,33 @@ void unreadc(int c) {
     }
 }
 
+// Consumes the run of characters at the current position for which
+// set[c] is true and returns its length, with *start pointing at it.
+// Nothing is read while characters are pushed back, and a run stops at
+// the end of the stream.  set must not contain '\\' or '\r', so a run
+// never contains a line splice; newlines in it are counted.
+int read_span(const char *set, char **start) {
+    File *f = vec_tail(files);
+    char *p = f->p;
+    char *bol = NULL;
+    if (f->buflen > 0)
+        return 0;
+    for (; p < f->end && set[(unsigned char)*p]; p++) {
+        if (*p == '\n') {
+            f->line++;
+            bol = p + 1;
+        }
+    }
+    int len = p - f->p;
+    if (len > 0) {
+        f->column = bol ? 1 + (p - bol) : f->column + len;
+        f->last = (unsigned char)p[-1];
+    }
+    *start = f->p;
+    f->p = p;
+    return len;
+}
+
 File *current_file() {
     return vec_tail(files);
 }
@@ -11,9 +11,12 @@
 #include <signal.h>
 #include <unistd.h>
 #include "lisacc.h"
+#include "asmlib.h"
 
 bool dumpstack = false;
 bool dumpsource = true;
+bool peepstats = false;
+bool static_frames = false;
 
 char *localFuncs[1024];
 int nLocalFuncs = 0;
@@ -32,22 +35,179 @@ typedef struct lvar_s
     char *  name;
 } lvar_t;
 
+// Opcodes of asm_line_t lines
+enum {
+    ASM_NONE = 0,
+#define asmop(id, name, flags) id,
+#include "asmop.inc"
+#undef asmop
+    ASM_COUNT
+};
+
+// Opcode flags
+#define ASMF_BRANCH     1       // Operand is a jump target
+#define ASMF_COND       2       // Operand may be a condition code
+
+// Kinds of asm_line_t lines
+enum {
+    LINE_TEXT = 0,              // Anything else, kept as text
+    LINE_OP,                    // "    op        operand"
+    LINE_LABEL,                 // "name:"
+    LINE_DIRECTIVE,             // "    .directive"
+    LINE_COMMENT,               // "    // comment"
+};
+
+// Comment and directive lines, which the peephole passes step over
+#define is_skip_line(p)     ((p)->kind == LINE_DIRECTIVE || (p)->kind == LINE_COMMENT)
+
+// Label lines and any other text that is not indented
+#define is_unindented(p)    ((p)->kind == LINE_LABEL || \
+                             ((p)->kind == LINE_TEXT && (p)->pText[0] != ' '))
+
+// Opcode tests
+#define is_if_op(p)         ((p)->op == ASM_IF || (p)->op == ASM_IFTT || (p)->op == ASM_IFTE)
+#define is_cond(p, op_, cond) ((p)->op == (op_) && (p)->argKind == ARG_COND && \
+                               (p)->argVal == (cond))
+#define is_stack_arg(p, op_, off) ((p)->op == (op_) && (p)->argKind == ARG_STACK && \
+                               !(p)->paramRel && (p)->argVal == (off))
+#define is_local_jump(p, op_) ((p)->op == (op_) && (p)->argKind == ARG_SYMBOL && \
+                               is_local_label((p)->labelId))
+
+// Kinds of opcode operands
+enum {
+    ARG_NONE = 0,
+    ARG_IMM,                    // Integer in argVal
+    ARG_STACK,                  // "argVal(sp)", "$argVal(sp)" when paramRel
+    ARG_COND,                   // Condition code COND_* in argVal
+    ARG_SYMBOL,                 // Label or other name in labelId
+    ARG_TEXT,                   // Anything else, kept in pText
+};
+
+// Condition codes of if, iftt, ifte, ldz, etc.
+enum {
+    COND_Z = 0, COND_NZ, COND_EQ, COND_NE, COND_LT, COND_GT, COND_GE, COND_LE,
+    COND_SLT, COND_SGT, COND_SGE, COND_SLE, COND_C, COND_NC, COND_NOTZ,
+    COND_COUNT
+};
+
+/*
+ * One line of function assembly.  Code generation builds these as typed
+ * records (decoded once from the emitted text) so the peephole passes match
+ * and rewrite opcodes and operands directly.  The text is only formatted
+ * again when the function is written out.
+ */
 typedef struct asm_line_s
 {
     struct asm_line_s *pNext;
     struct asm_line_s *pPrev;
-    char              *pLine;
+    int                kind;            // LINE_*
+    int                op;              // ASM_* of a LINE_OP, else ASM_NONE
+    int                argKind;         // ARG_* of a LINE_OP
+    int                argVal;          // ARG_IMM / ARG_STACK value or COND_*
+    int                paramRel;        // ARG_STACK had a '$' modifier
+    int                labelId;         // LINE_LABEL name or ARG_SYMBOL operand
+    char              *pText;           // LINE_TEXT, directive, comment or ARG_TEXT
+    char              *pNote;           // -fdump-stack annotation
     int                stackRelative;
+    unsigned           pending;         // Peephole passes to re-examine the line
+    long               seq;             // Position key while optimizing
+    int                useId;           // Label operand in the peephole use lists
+    struct asm_line_s *pNextUse;        // Other lines using the same label
+    struct asm_line_s *pPrevUse;
+    int                tableEntry;      // br of a jump table, kept one word in place
 } asm_line_t;
 
+/*
+ * Label table entry of the current function, indexed by label id
+ */
 typedef struct label_ref_s
 {
-    struct label_ref_s  *pNext;
-    asm_line_t          *pAsmLine;
-    char                label[256];
-    int                 refCount;
+    int                 valid;          // Emitted or branched to by the function
+    asm_line_t          *pAsmLine;      // Line emitted by emit_label
+    int                 refCount;       // jal, br, bnc and bnz references
+    asm_line_t          *pDefLine;      // Label line, while optimizing, if there
+    int                 defCount;       //   is exactly one (defCount == 1)
 } label_ref_t;
 
+// Peephole passes, in the order perform_asm_optimizations runs them
+enum {
+    PEEP_ADS0 = 0,
+    PEEP_UNUSED_LABELS,
+    PEEP_MULTI_LABELS,
+    PEEP_ORPHANED_JAL,
+    PEEP_CPI_ZERO,
+    PEEP_JAL_TO_BR,
+    PEEP_IF_BR,
+    PEEP_NOTZ_BR,
+    PEEP_BZ_BR,
+    PEEP_SRA_LRA,
+    PEEP_LABEL_JUMPS,
+    PEEP_LOGAND_LOGOR,
+    PEEP_STRUCT_MASKING,
+    PEEP_FOR_IFTT,
+    PEEP_LITERAL_INIT,
+    PEEP_ACC_DATAFLOW,
+    PEEP_COUNT
+};
+
+// Passes that only match a few lines around each anchor line.  They
+// re-examine just the lines near a change.  The other passes read state
+// from anywhere in the function and rescan it if anything has changed.
+#define PEEP_LOCAL      ((1 << PEEP_ADS0) | (1 << PEEP_MULTI_LABELS) | \
+                         (1 << PEEP_ORPHANED_JAL) | (1 << PEEP_CPI_ZERO) | \
+                         (1 << PEEP_IF_BR) | (1 << PEEP_NOTZ_BR) | \
+                         (1 << PEEP_BZ_BR) | (1 << PEEP_FOR_IFTT))
+
+// Opcode lines re-examined on each side of a change.  This covers the
+// widest local pass (optimize_for_iftt reads the 'if' and three lines on).
+#define PEEP_RADIUS     4
+
+// Spacing of the position keys of asm lines
+#define PEEP_SEQ_STEP   65536
+
+// Worklist state of the peephole optimizer for the current function
+typedef struct peep_s
+{
+    int         active;
+    unsigned    gen;                    // Count of changes to the line list
+    unsigned    lastRun[PEEP_COUNT];    // gen when each pass last started
+    asm_line_t *pFirst[PEEP_COUNT];     // First and last lines pending
+    asm_line_t *pLast[PEEP_COUNT];      // for each local pass
+    int        *pUses;                  // Operand references per label id
+    asm_line_t **ppUsers;               // Lines with each label as operand
+    int         nUses;
+    int         lines;
+    int         rounds;
+    int         runs[PEEP_COUNT];
+    int         visits[PEEP_COUNT];
+    int         rewrites[PEEP_COUNT];
+} peep_t;
+
+// Memory locations optimize_acc_dataflow tracks: "off(sp)", or "off(ix)" with IX
+// holding the address of a symbol
+#define DF_MAX_LOCS     4
+
+typedef struct df_loc_s
+{
+    int         base;                   // 0 for the stack, else symbol label id
+    int         off;
+    int         paramRel;               // Stack offset had a '$' modifier
+} df_loc_t;
+
+// What optimize_acc_dataflow knows the registers hold at a point in the function
+typedef struct df_state_s
+{
+    int         reached;                // Some path reaches this point
+    int         accConst;               // Acc holds accVal
+    int         accVal;
+    int         nLocs;                  // Memory locations holding the acc value
+    df_loc_t    locs[DF_MAX_LOCS];
+    int         ixKnown;                // IX holds the address of ixSym + ixOff
+    int         ixSym;
+    int         ixOff;
+    int         flagsOp;                // ASM_LDI / ASM_LDAX that last set the flags
+} df_state_t;
+
 // Define optimizations struct
 typedef struct opt_s
 {
@@ -57,6 +217,7 @@ typedef struct opt_s
     int         logand_logor;
     int         struct_masking;
     int         label_jumps;
+    int         acc_dataflow;
 } opts_t;
 
 typedef struct stack_frame_s
@@ -82,8 +243,6 @@ typedef struct stack_frame_s
     char        ixVar[256];
     int         accModified;
     int         ixModified;
-    int         nlocalLabels;
-    char       *localLabels[1024];
     int         nexternLabels;
     char       *externLabels[1024];
     int         preserveVars;
@@ -94,14 +253,20 @@ typedef struct stack_frame_s
     asm_line_t *pLastRetLine;
     asm_line_t *pLastSwapLine;
     label_ref_t *pLabelRefs;
+    int         nLabelRefs;
     opts_t      opts;
+    Vector     *staticVars;             // Locals moved to the static frame
+    Vector     *probes;                 // -fprofile-generate probe labels
 } stack_frame_t;
 
-static int TAB = 8;
 static Vector *functions = &EMPTY_VECTOR;
 static int numgp;
 static int numfp;
 static FILE *outputfp;
+static LisaAsm_t *asm_out;              // In-process assembler, if any
+static int asm_out_ops[ASM_COUNT];      // Its opcode id of each ASM_* + 1, -1 if none
+static int asm_out_conds[COND_COUNT];   // Its symbol id of each COND_* + 1
+static Vector *asm_out_syms;            // Label id - 1 -> its symbol id + 1
 static Map *source_files = &EMPTY_MAP;
 static Map *source_lines = &EMPTY_MAP;
 static char *last_loc = "";
@@ -111,15 +276,18 @@ static const char *gpCurrSegment = "";
 static int gLastEmitWasRet = 0;
 static int gLastEmitWasJal = 0;
 static stack_frame_t *pFrame = NULL;
+static peep_t peep;
 static int gEmitToDataSection = 0;
 extern char gOptimizationLevel;
 
 static void emit_addr(Node *node);
 static int emit_expr(Node *node);
-static void emit_decl_init(Vector *inits, int off, int totalsize);
+static void emit_label(char *label);
+static void emit_decl_init(char *varname, Vector *inits, int off, int totalsize);
 static void do_emit_data(Vector *inits, int size, int off, int depth);
 static void emit_data(Node *v, int off, int depth);
 void do_node2s(Buffer *b, Node *node, int indent);
+static void peep_touch(asm_line_t *pLine);
 
 #define REGAREA_SIZE 176
 
@@ -155,981 +323,1766 @@ void set_output_file(FILE *fp) {
     outputfp = fp;
 }
 
-void close_output_file() {
-    fclose(outputfp);
+// Also hands the output to the in-process assembler pAsm.  The output
+// file may then be NULL.
+void set_output_asm(LisaAsm_t *pAsm) {
+    asm_out = pAsm;
+    memset(asm_out_ops, 0, sizeof(asm_out_ops));
+    memset(asm_out_conds, 0, sizeof(asm_out_conds));
+    asm_out_syms = make_vector();
 }
 
+void close_output_file() {
+    if (outputfp)
+        fclose(outputfp);
+}
+
+// Writes one line of assembly (without its newline)
+void output_line(char *line) {
+    if (outputfp)
+        fprintf(outputfp, "%s\n", line);
+    if (asm_out)
+        lisa_asm_line(asm_out, line);
+}
+
+static char *asm_opnames[] = {
+    "",
+#define asmop(id, name, flags) name,
+#include "asmop.inc"
+#undef asmop
+};
+
+static int asm_opflags[] = {
+    0,
+#define asmop(id, name, flags) flags,
+#include "asmop.inc"
+#undef asmop
+};
+
+static char *asm_conds[] = {
+    "z", "nz", "eq", "ne", "lt", "gt", "ge", "le",
+    "slt", "sgt", "sge", "sle", "c", "nc", "~z",
+};
+
+// Opposite of each condition code, or -1
+static const int asm_cond_inverse[] = {
+    [COND_Z] = COND_NZ, [COND_NZ] = COND_Z, [COND_EQ] = COND_NE,
+    [COND_NE] = COND_EQ, [COND_LT] = COND_GE, [COND_GT] = COND_LE,
+    [COND_GE] = COND_LT, [COND_LE] = COND_GT, [COND_SLT] = COND_SGE,
+    [COND_SGT] = COND_SLE, [COND_SGE] = COND_SLT, [COND_SLE] = COND_SGT,
+    [COND_C] = COND_NC, [COND_NC] = COND_C, [COND_NOTZ] = -1,
+};
+
+#define IDENT_CHARS "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_"
+
+static Map *asm_ops;                                // Mnemonic -> ASM_*
+static Map *asm_label_ids = &EMPTY_MAP;             // Label name -> id
+static Vector *asm_label_names = &EMPTY_VECTOR;     // Label id - 1 -> name
+
 /*
 ==========================================================================================
-Add an asm_line_t to the end of the linked list with the text pStr
+Get the id of a label or symbol name, adding it to the label table if new.  Ids start
+at 1 and are never reused, so passes compare labels as integers.
 ==========================================================================================
 */
-void add_asm_line(char *pStr)
+static int asm_label_id(char *pName)
 {
-    asm_line_t *pLine = (asm_line_t *) malloc(sizeof(asm_line_t));
-
-    // Setup the asm line
-    pLine->pNext = NULL;
-    pLine->pPrev = NULL;
-    pLine->pLine = strdup(pStr);
-    pLine->stackRelative = 0;
+    int     id = (int) (intptr_t) map_get(asm_label_ids, pName);
 
-    // Add it to the stack frame
-    if (pFrame->pAsmLines == NULL)
-    {
-        // Add it as the first entry
-        pFrame->pAsmLines = pLine;
-        pLine->pNext = pLine;
-        pLine->pPrev = pLine;
-    }
-    else
+    if (id == 0)
     {
-        // Add it to the tail
-        pLine->pNext = pFrame->pAsmLines;
-        pLine->pPrev = pFrame->pAsmLines->pPrev;
-        pFrame->pAsmLines->pPrev = pLine;
-        pLine->pPrev->pNext = pLine;
+        pName = intern(pName);
+        vec_push(asm_label_names, pName);
+        id = vec_len(asm_label_names);
+        map_put(asm_label_ids, pName, (void *) (intptr_t) id);
     }
+
+    return id;
 }
 
-/*
-==========================================================================================
-Add a new line to the .data section linked list.  We don't want these interleaved
-with the .code section, so we store them and emit them at the end of the current function.
-==========================================================================================
-*/
-void add_data_line(char *pStr)
+static char *asm_label_name(int id)
 {
-    asm_line_t *pLine = (asm_line_t *) malloc(sizeof(asm_line_t));
-
-    // Setup the asm line
-    pLine->pNext = NULL;
-    pLine->pPrev = NULL;
-    pLine->pLine = strdup(pStr);
-
-    // Add it to the stack frame
-    if (pFrame->pDataLines == NULL)
-    {
-        // Add it as the first entry
-        pFrame->pDataLines = pLine;
-        pLine->pNext = pLine;
-        pLine->pPrev = pLine;
-    }
-    else
-    {
-        // Add it to the tail
-        pLine->pNext = pFrame->pDataLines;
-        pLine->pPrev = pFrame->pDataLines->pPrev;
-        pFrame->pDataLines->pPrev = pLine;
-        pLine->pPrev->pNext = pLine;
-    }
+    return vec_get(asm_label_names, id - 1);
 }
 
 /*
 ==========================================================================================
-Delete the specified ASM line
+Test if a label id is a compiler generated "_L" label
 ==========================================================================================
 */
-void delete_asm_line(asm_line_t *pLine)
+static int is_local_label(int id)
 {
-    // Free the line text
-    free(pLine->pLine);
-
-    // Remove it from the linked list
-    pLine->pPrev->pNext = pLine->pNext;
-    pLine->pNext->pPrev = pLine->pPrev;
+    char    *pName = asm_label_name(id);
 
-    if (pLine == pFrame->pAsmLines)
-        pFrame->pAsmLines = pLine->pNext;
-    free(pLine);
+    return pName[0] == '_' && pName[1] == 'L';
 }
 
 /*
 ==========================================================================================
-Insert an asm_line_t before the specified pBefore asm_line
+Look up the mnemonic at the start of pStr.  Returns ASM_NONE if it is not a known opcode.
 ==========================================================================================
 */
-void insert_asm_line_before(asm_line_t *pLine, asm_line_t *pBefore)
+static int lookup_asm_op(char *pStr, int *pLen)
 {
-    // Insert pLine into the linked list
-    pLine->pNext = pBefore;
-    pLine->pPrev = pBefore->pPrev;
-    pBefore->pPrev->pNext = pLine;
-    pBefore->pPrev = pLine;
+    char    mnemonic[16];
+    int     len;
 
-    // Test if pBefore was the first item
-    if (pBefore == pFrame->pAsmLines)
-        pFrame->pAsmLines = pLine;
-}
+    if (asm_ops == NULL)
+    {
+        asm_ops = make_map();
+        for (int i = 1; i < ASM_COUNT; i++)
+            map_put(asm_ops, asm_opnames[i], (void *) (intptr_t) i);
+    }
 
-/*
-==========================================================================================
-Move the given asm_line to after the specified pAfter line
-==========================================================================================
-*/
-void move_asm_line_after(asm_line_t *pLine, asm_line_t *pAfter)
-{
-    // First remove pLine from the linked list
-    if (pLine == pFrame->pAsmLines)
-        pFrame->pAsmLines = pLine->pNext;
-    pLine->pPrev->pNext = pLine->pNext;
-    pLine->pNext->pPrev = pLine->pPrev;
+    len = strspn(pStr, "abcdefghijklmnopqrstuvwxyz0123456789_");
+    if (len == 0 || len >= sizeof(mnemonic) || (pStr[len] != ' ' && pStr[len] != 0))
+        return ASM_NONE;
 
-    // Now insert the pLine after the pAfter line
-    pLine->pNext = pAfter->pNext;
-    pAfter->pNext = pLine;
-    pLine->pPrev = pAfter;
-    pLine->pNext->pPrev = pLine;
+    memcpy(mnemonic, pStr, len);
+    mnemonic[len] = 0;
+    *pLen = len;
+    return (int) (intptr_t) map_get(asm_ops, mnemonic);
 }
 
 /*
 ==========================================================================================
-Get the next asm line after the give line
+Decode the operand text of an opcode line
 ==========================================================================================
 */
-asm_line_t * get_next_asm_line(asm_line_t *pLine)
+static void decode_asm_arg(asm_line_t *pLine, char *pArg)
 {
-    asm_line_t  *pNext;
-
-    if (pLine == NULL)
-        return NULL;
+    char    *pNum = pArg;
+    char    *pEnd;
+    char    num[24];
+    long    val;
 
-    pNext = pLine->pNext;
+    // Condition codes
+    if (asm_opflags[pLine->op] & ASMF_COND)
+    {
+        for (int i = 0; i < COND_COUNT; i++)
+            if (strcmp(pArg, asm_conds[i]) == 0)
+            {
+                pLine->argKind = ARG_COND;
+                pLine->argVal = i;
+                return;
+            }
+    }
 
-    while (pNext != pFrame->pAsmLines)
+    // Integers and "N(sp)" stack offsets.  Only numbers that format back to
+    // the same text are decoded.
+    if (*pNum == '$')
+        pNum++;
+    val = strtol(pNum, &pEnd, 10);
+    if (pEnd != pNum && val == (int) val && pEnd - pNum < sizeof(num) &&
+        sprintf(num, "%ld", val) == pEnd - pNum && strncmp(num, pNum, pEnd - pNum) == 0)
     {
-        // Test for comment or .loc lines
-        if (!(strncmp(pNext->pLine, "    .", 5) == 0 ||
-            strncmp(pNext->pLine, "    //", 6) == 0))
+        if (strcmp(pEnd, "(sp)") == 0)
         {
-            return pNext;
+            pLine->argKind = ARG_STACK;
+            pLine->argVal = val;
+            pLine->paramRel = pNum != pArg;
+            return;
         }
+        if (*pEnd == 0 && pNum == pArg)
+        {
+            pLine->argKind = ARG_IMM;
+            pLine->argVal = val;
+            return;
+        }
+    }
 
-        pNext = pNext->pNext;
+    // Labels and other symbol names
+    if ((isalpha(*pArg) || *pArg == '_') && pArg[strspn(pArg, IDENT_CHARS)] == 0)
+    {
+        pLine->argKind = ARG_SYMBOL;
+        pLine->labelId = asm_label_id(pArg);
+        return;
     }
 
-    return NULL;
+    pLine->argKind = ARG_TEXT;
+    pLine->pText = arena_strdup(&asm_arena, pArg);
 }
 
 /*
 ==========================================================================================
-Get the previous asm line before the give line
+Decode an emitted line of text into the fields of pLine
 ==========================================================================================
 */
-asm_line_t * get_prev_asm_line(asm_line_t *pLine)
+static void decode_asm_line(asm_line_t *pLine, char *pStr)
 {
-    asm_line_t  *pPrev;
+    int     len;
+    int     op;
 
-    if (pLine == NULL)
-        return NULL;
+    pLine->kind = LINE_TEXT;
+    pLine->op = ASM_NONE;
+    pLine->argKind = ARG_NONE;
+    pLine->argVal = 0;
+    pLine->paramRel = 0;
+    pLine->labelId = 0;
+    pLine->pText = NULL;
 
-    pPrev = pLine->pPrev;
+    if (strncmp(pStr, "    .", 5) == 0)
+        pLine->kind = LINE_DIRECTIVE;
 
-    while (pPrev != pFrame->pAsmLines)
+    else if (strncmp(pStr, "    //", 6) == 0)
+        pLine->kind = LINE_COMMENT;
+
+    // Opcode lines are "    %-10s%s" or just "    %s"
+    else if (strncmp(pStr, "    ", 4) == 0 &&
+             (op = lookup_asm_op(&pStr[4], &len)) != ASM_NONE)
     {
-        // Test for comment or .loc lines
-        if (!(strncmp(pPrev->pLine, "    .", 5) == 0 ||
-            strncmp(pPrev->pLine, "    //", 6) == 0))
+        char    *pArg = &pStr[4 + len];
+
+        if (*pArg == 0)
         {
-            return pPrev;
+            pLine->kind = LINE_OP;
+            pLine->op = op;
+            return;
         }
+        if (len < 10 && strspn(pArg, " ") >= 10 - len && pArg[10 - len] != 0)
+        {
+            pLine->kind = LINE_OP;
+            pLine->op = op;
+            decode_asm_arg(pLine, &pArg[10 - len]);
+            return;
+        }
+    }
 
-        // Test for label
-        if (strncmp(pPrev->pLine, "_L", 2) == 0)
-            return NULL;
+    // Labels
+    else if (pStr[0] != ' ' && pStr[0] != '\n' && (len = strlen(pStr)) > 1 &&
+             strcspn(pStr, " \t:") == len - 1 && pStr[len - 1] == ':')
+    {
+        char    name[256];
 
-        pPrev = pPrev->pPrev;
+        snprintf(name, sizeof(name), "%.*s", len - 1, pStr);
+        pLine->kind = LINE_LABEL;
+        pLine->labelId = asm_label_id(name);
+        return;
     }
 
-    return NULL;
+    pLine->pText = arena_strdup(&asm_arena, pStr);
 }
 
 /*
 ==========================================================================================
-Get the next asm line after the give line
+Allocate an asm line from emitted text
 ==========================================================================================
 */
-asm_line_t * get_next_asm_line_no_label(asm_line_t *pLine)
+static asm_line_t *new_asm_line(char *pStr)
 {
-    asm_line_t  *pNext;
-
-    if (pLine == NULL)
-        return NULL;
-
-    pNext = pLine->pNext;
-
-    while (pNext != pFrame->pAsmLines)
-    {
-        // Test for comment or .loc lines
-        if (!(strncmp(pNext->pLine, "    .", 5) == 0 ||
-            strncmp(pNext->pLine, "    //", 6) == 0 ||
-            pNext->pLine[0] != ' '))
-        {
-            return pNext;
-        }
-
-        pNext = pNext->pNext;
-    }
+    asm_line_t *pLine = (asm_line_t *) arena_alloc(&asm_arena, sizeof(asm_line_t));
 
-    return NULL;
+    pLine->pNext = NULL;
+    pLine->pPrev = NULL;
+    pLine->pNote = NULL;
+    pLine->stackRelative = 0;
+    pLine->pending = 0;
+    pLine->seq = 0;
+    pLine->useId = 0;
+    pLine->pNextUse = NULL;
+    pLine->pPrevUse = NULL;
+    pLine->tableEntry = 0;
+    decode_asm_line(pLine, pStr);
+    return pLine;
 }
 
 /*
 ==========================================================================================
-Get the last asm line with an opcode, skipping comments and .loc / .file directives
+Allocate a label line for the given label id
 ==========================================================================================
 */
-asm_line_t * get_last_asm_line(void)
+static asm_line_t *new_label_line(int labelId)
 {
-    asm_line_t  *pLine;
-
-    pLine = pFrame->pAsmLines->pPrev;
-
-    while (pLine != pFrame->pAsmLines)
-    {
-        // Test for comment or .loc lines
-        if (!(strncmp(pLine->pLine, "    .", 5) == 0 ||
-            strncmp(pLine->pLine, "    //", 6) == 0))
-        {
-            return pLine;
-        }
-
-        pLine = pLine->pPrev;
-    }
+    asm_line_t *pLine = (asm_line_t *) arena_calloc(&asm_arena, sizeof(asm_line_t));
 
-    return NULL;
+    pLine->kind = LINE_LABEL;
+    pLine->labelId = labelId;
+    return pLine;
 }
 
 /*
 ==========================================================================================
-Calculate the jal distance to it's label
+Replace the contents of pLine with new emitted text
 ==========================================================================================
 */
-int calc_jal_distance(asm_line_t *pLine)
+static void set_asm_text(asm_line_t *pLine, char *pStr)
 {
-    asm_line_t  *pNext;
-    asm_line_t  *pPrev;
-    char        label[256];
-    int         distance;
-
-    if (pLine == NULL)
-        return 999999;
-
-    // Generate the label search text
-    sprintf(label, "%s:", &pLine->pLine[14]);
-
-    // Search forward for the label
-    pNext = pLine->pNext;
-    distance = 0;
-    while (pNext != pFrame->pAsmLines)
-    {
-        // Test if this is the label
-        if (strcmp(pNext->pLine, label) == 0)
-            return distance;
-
-        // Test for non-asm line
-        if (pNext->pLine[0] != ' ' ||
-            (!(strncmp(pNext->pLine, "    .", 5) == 0 ||
-               strncmp(pNext->pLine, "    //", 6) == 0)))
-        {
-            distance++;
-        }
-
-        // Get next line
-        pNext = pNext->pNext;
-    }
-
-    // Search forward for the label
-    pPrev = pLine->pPrev;
-    distance = 0;
-    while (pPrev != pFrame->pAsmLines)
-    {
-        // Test if this is the label
-        if (strcmp(pPrev->pLine, label) == 0)
-            return distance;
-
-        // Test for non-asm line
-        if (pPrev->pLine[0] != ' ' ||
-            (!(strncmp(pPrev->pLine, "    .", 5) == 0 ||
-               strncmp(pPrev->pLine, "    //", 6) == 0)))
-        {
-            distance--;
-        }
-
-        // Get next line
-        pPrev = pPrev->pPrev;
-    }
-
-    return 99999;
+    decode_asm_line(pLine, pStr);
 }
 
 /*
 ==========================================================================================
-Set the name of the current variable in IX
+Change the operand of an opcode line to a label
 ==========================================================================================
 */
-static void set_ix_var(char *varname, ...)
+static void set_asm_symbol(asm_line_t *pLine, int labelId)
 {
-    char    sLine[512];
-    va_list args;
-
-    va_start(args, varname);
-    vsprintf(sLine, varname, args);
-    va_end(args);
-
-    // Test if acc has a modified var
-
-    // Set the acc var
-    strcpy(pFrame->ixVar, sLine);
-    pFrame->ixModified = 0;
+    pLine->pText = NULL;
+    pLine->argKind = ARG_SYMBOL;
+    pLine->labelId = labelId;
+    peep_touch(pLine);
 }
 
 /*
 ==========================================================================================
-Clear the variable in IX
+Get the numeric value of an operand the way atoi() would read its text
 ==========================================================================================
 */
-static void clear_ix_var(void)
+static int asm_arg_int(asm_line_t *pLine)
 {
-    // Test if IX has a modified var
-
-    // Clear the acc var
-    pFrame->ixVar[0] = 0;
-    pFrame->ixModified = 0;
+    switch (pLine->argKind)
+    {
+        case ARG_IMM:
+            return pLine->argVal;
+        case ARG_STACK:
+            return pLine->paramRel ? 0 : pLine->argVal;
+        case ARG_TEXT:
+            return atoi(pLine->pText);
+    }
+    return 0;
 }
 
 /*
 ==========================================================================================
-Set the name of the current variable in ACC / 1(sp)
+Test if the text of an asm line contains a ':'
 ==========================================================================================
 */
-static void set_acc_var(char *varname)
+static int asm_line_has_colon(asm_line_t *pLine)
 {
-    // Test if acc has a modified var
-
-    // Set the acc var
-    strcpy(pFrame->accVar, varname);
-    pFrame->accModified = 0;
+    return pLine->kind == LINE_LABEL ||
+           (pLine->pText != NULL && strchr(pLine->pText, ':') != NULL);
 }
 
 /*
 ==========================================================================================
-Mark the ACC variable as damaged / no loaded variable name
+Format the text of an asm line into pBuf.  Stack '$' modifiers are not written.
 ==========================================================================================
 */
-static void clear_acc_var(void)
+static char *format_asm_line(asm_line_t *pLine, char *pBuf)
 {
-    pFrame->accVal = -1000;
-    if (pFrame->accVar[0] == 0)
-        return;
+    char    *pOut;
 
-    // Test if acc has a modified var and save it if needed
-    
-    // Clear the accVar
-    pFrame->accVar[0] = 0;
-    pFrame->accModified = 0;
+    switch (pLine->kind)
+    {
+        case LINE_LABEL:
+            sprintf(pBuf, "%s:", asm_label_name(pLine->labelId));
+            break;
+
+        case LINE_OP:
+            if (pLine->argKind == ARG_NONE)
+            {
+                sprintf(pBuf, "    %s", asm_opnames[pLine->op]);
+                break;
+            }
+
+            pOut = pBuf + sprintf(pBuf, "    %-10s", asm_opnames[pLine->op]);
+            switch (pLine->argKind)
+            {
+                case ARG_IMM:
+                    sprintf(pOut, "%d", pLine->argVal);
+                    break;
+                case ARG_STACK:
+                    sprintf(pOut, "%d(sp)", pLine->argVal);
+                    break;
+                case ARG_COND:
+                    strcpy(pOut, asm_conds[pLine->argVal]);
+                    break;
+                case ARG_SYMBOL:
+                    strcpy(pOut, asm_label_name(pLine->labelId));
+                    break;
+                default:
+                    strcpy(pOut, pLine->pText[0] == '$' ? &pLine->pText[1] : pLine->pText);
+                    break;
+            }
+            break;
+
+        default:
+            strcpy(pBuf, pLine->pText);
+            break;
+    }
+
+    return pBuf;
 }
 
 /*
 ==========================================================================================
-Test if the given string is a load ACC opcode
+Get the in-process assembler's symbol id of a label id
 ==========================================================================================
 */
-static bool isAccLoad(char *op) {
-    if (strncmp(op, "lda", 3) == 0 ||
-        strncmp(op, "ldi", 3) == 0 ||
-        strncmp(op, "txa", 3) == 0 ||
-        strncmp(op, "reti", 4) == 0 ||
-        strncmp(op, "pop_a", 5) == 0)
+static int asm_out_symbol(int labelId)
+{
+    while (vec_len(asm_out_syms) < labelId)
+        vec_push(asm_out_syms, NULL);
+
+    int id = (int) (intptr_t) vec_get(asm_out_syms, labelId - 1);
+    if (id == 0)
     {
-        return true;
+        id = lisa_asm_symbol(asm_out, asm_label_name(labelId)) + 1;
+        vec_set(asm_out_syms, labelId - 1, (void *) (intptr_t) id);
     }
-    return false;
+    return id - 1;
 }
 
 /*
 ==========================================================================================
-Test if the given string is an opcode that uses the value in ACC
+Hand an opcode line to the in-process assembler as a record.  Returns false if the
+line has to be given as text instead.
 ==========================================================================================
 */
-static bool isAccUse(char *op) {
-    if (strncmp(op, "sta", 3) == 0 ||
-        strncmp(op, "ret", 3) == 0 ||
-        strncmp(op, "rc", 2)  == 0 ||
-        strncmp(op, "rz", 2)  == 0 ||
-        strncmp(op, "adc", 3) == 0 ||
-        strncmp(op, "shl", 3) == 0 ||
-        strncmp(op, "shr", 3) == 0 ||
-        strncmp(op, "tax", 3) == 0 ||
-        strncmp(op, "cpi", 3) == 0 ||
-        strncmp(op, "add", 3) == 0 ||
-        strncmp(op, "mul", 3) == 0 ||
-        strncmp(op, "sub", 3) == 0 ||
-        strncmp(op, "or",  2) == 0 ||
-        strncmp(op, "xor", 3) == 0 ||
-        strncmp(op, "cmp", 3) == 0)
-    {
-        return true;
-    }
+static int assemble_asm_op(asm_line_t *pLine)
+{
+    int     *pOp = &asm_out_ops[pLine->op];
+    int     *pCond;
 
-    return false;
+    if (*pOp == 0)
+        *pOp = lisa_asm_opcode(asm_opnames[pLine->op]) + 1;
+    if (*pOp <= 0)
+        return 0;
+
+    switch (pLine->argKind)
+    {
+        case ARG_NONE:
+            lisa_asm_op(asm_out, *pOp - 1, LISA_ASM_ARG_NONE, 0, 0);
+            return 1;
+        case ARG_IMM:
+            lisa_asm_op(asm_out, *pOp - 1, LISA_ASM_ARG_CONST, 0, pLine->argVal);
+            return 1;
+        case ARG_STACK:
+            lisa_asm_op(asm_out, *pOp - 1, LISA_ASM_ARG_STACK, 0, pLine->argVal);
+            return 1;
+        case ARG_COND:
+            pCond = &asm_out_conds[pLine->argVal];
+            if (*pCond == 0)
+                *pCond = lisa_asm_symbol(asm_out, asm_conds[pLine->argVal]) + 1;
+            lisa_asm_op(asm_out, *pOp - 1, LISA_ASM_ARG_SYMBOL, *pCond - 1, 0);
+            return 1;
+        case ARG_SYMBOL:
+            lisa_asm_op(asm_out, *pOp - 1, LISA_ASM_ARG_SYMBOL,
+                        asm_out_symbol(pLine->labelId), 0);
+            return 1;
+    }
+    return 0;
 }
 
 /*
 ==========================================================================================
-Do a formatted emit of opcode, label, etc.
+Write an asm line to the output, with its -fdump-stack annotation.  Opcodes go to the
+in-process assembler as records, so their text is only needed for the .s.
 ==========================================================================================
 */
-static void emitf(int line, char *fmt, ...) {
-    // Replace "#" with "%%" so that vfprintf prints out "#" as "%".
-    char buf[256];
-    char sLine[512];
-    char retTest[256];
-    int i = 0;
-
-    for (char *p = fmt; *p; p++) {
-        assert(i < sizeof(buf) - 3);
-        if (*p == '#' && *(p+1) == '#') {
-            p++;
-            buf[i++] = *p;
-        }
-        else if (*p == '#') {
-            buf[i++] = '%';
-            buf[i++] = '%';
-        } else {
-            buf[i++] = *p;
-        }
-    }
-    buf[i] = '\0';
+static void write_asm_line(asm_line_t *pLine)
+{
+    char    sLine[1024];
+    int     col;
+    int     assembled = asm_out && pLine->kind == LINE_OP && assemble_asm_op(pLine);
 
-#if 0
-    if (strlen(gMaybeEmitLoc) > 0)
-      fprintf(outputfp, "\n%s\n", gMaybeEmitLoc);
-    gMaybeEmitLoc = "";
-    if (strlen(gMaybeEmitLine) > 0)
-      fprintf(outputfp, "%s\n", gMaybeEmitLine);
-    gMaybeEmitLine = "";
-#endif
+    if (assembled && !outputfp)
+        return;
 
-    /* Test if we can remove the last optional swap */
-    if (pFrame->lastSwapOptional)
+    format_asm_line(pLine, sLine);
+    if (pLine->pNote)
     {
-        /* Test for opcodes that load acc */
-        if (isAccLoad(&fmt[4]))
-        {
-            /* Delete the last optional swap */
-            delete_asm_line(pFrame->pLastSwapLine);
-            pFrame->pLastSwapLine = NULL;
-            pFrame->lastSwapOptional = 0;
-        }
-
-        /* Test for opcodes that use acc after the last optional swap */
-        else if (isAccUse(&fmt[4]))
-        {
-            /* Last optional swap actually needed. */
-            pFrame->pLastSwapLine = NULL;
-            pFrame->lastSwapOptional = 0;
-        }
-    }
-
-    va_list args;
-    va_start(args, fmt);
-    int col = vsprintf(sLine, buf, args);
-    va_end(args);
-
-    if (dumpstack) {
-        for (char *p = fmt; *p; p++)
-            if (*p == '\t')
-                col += TAB - 1;
+        col = strlen(sLine);
         int space = (28 - col) > 0 ? (30 - col) : 2;
-        sprintf(&sLine[strlen(sLine)], "%*c %s:%d", space, '#', get_caller_list(), line);
+        sprintf(&sLine[col], "%*c %s", space, '#', pLine->pNote);
     }
-    if (gEmitToDataSection)
-        add_data_line(sLine);
+    if (assembled)
+        fprintf(outputfp, "%s\n", sLine);
     else
-        add_asm_line(sLine);
-
-    sprintf(retTest, "    jal       _L%s_ret", pFrame->fname);
-    if (strncmp(sLine, "    .", 5) != 0)
-    {
-        gLastEmitWasRet = strcmp(sLine, retTest) == 0;
-        if (gLastEmitWasRet)
-            pFrame->pLastRetLine = pFrame->pAsmLines->pPrev;
-        else
-            pFrame->pLastRetLine = NULL;
-        gLastEmitWasJal = strncmp(sLine, "    jal", 7) == 0;
-        if (gLastEmitWasJal)
-            pFrame->raDestroyed = 1;
-    }
+        output_line(sLine);
 }
 
-static void emit_nostack(char *fmt, ...) {
-    char  sLine[512];
-    sprintf(sLine, "    ");
-    va_list args;
-    va_start(args, fmt);
-    vsprintf(&sLine[strlen(sLine)], fmt, args);
-    va_end(args);
-    add_asm_line(sLine);
-}
+static char *peep_names[] = {
+    "ads0", "unused_labels", "multi_labels", "orphaned_jal", "cpi_zero",
+    "jal_to_br", "if_br", "notz_br", "bz_br", "sra_lra", "label_jumps",
+    "logand_logor", "struct_masking", "for_iftt", "literal_init", "acc_dataflow",
+};
 
 /*
 ==========================================================================================
-Test if the given name is an LVAR and return it's offset or -1 if not LVAR.
+Get the label table entry of a label id, growing the table as needed
 ==========================================================================================
 */
-static int find_lvar_offset(char *pVarName)
+static label_ref_t *get_label_ref(int labelId)
 {
-  int   x;
+    if (labelId >= pFrame->nLabelRefs)
+    {
+        int n = labelId * 2 + 64;
 
-  // Test if it is a local
-  for (x = 0; x < pFrame->nlvars; x++)
-  {
-    if (strcmp(pFrame->lvars[x].name, pVarName) == 0)
-      return x;
-  }
+        pFrame->pLabelRefs = realloc(pFrame->pLabelRefs, n * sizeof(label_ref_t));
+        memset(&pFrame->pLabelRefs[pFrame->nLabelRefs], 0,
+               (n - pFrame->nLabelRefs) * sizeof(label_ref_t));
+        pFrame->nLabelRefs = n;
+    }
 
-  return -1;
+    return &pFrame->pLabelRefs[labelId];
 }
 
 /*
 ==========================================================================================
-Test if the given name is a function param and return it's offset or -1 if not LVAR.
+Find the specified label reference
 ==========================================================================================
 */
-static int find_param_offset(char *pVarName)
+label_ref_t * find_label_ref(int labelId)
 {
-  int   x;
-
-  // Test if it is a local
-  for (x = 0; x < pFrame->nparam; x++)
-  {
-    if (strcmp(pFrame->param[x].name, pVarName) == 0)
-      return x;
-  }
+    if (labelId <= 0 || labelId >= pFrame->nLabelRefs || !pFrame->pLabelRefs[labelId].valid)
+        return NULL;
 
-  return -1;
+    return &pFrame->pLabelRefs[labelId];
 }
 
 /*
 ==========================================================================================
-Mark the curent function as using a minimum of depth bytes of stack.  The function
-stack depth can grow but not shrink.
-
-If growth occurs, walk through all existing asm_lines to find any with #(sp) arguments
-and add the growth to the index offset numbers (for any line marked as stackRelative).
+Record a label line entering (delta 1) or leaving (delta -1) the line list
 ==========================================================================================
 */
-static void mark_stack_operations(int depth)
+static void count_label_def(asm_line_t *pLine, int delta)
 {
-  char        str[32];
-  asm_line_t  *pLine;
-  int           diff;
-
-  if (pFrame->stackOps >= depth)
-    return;
-
-  // Mark stack as using stack ops
-  diff = depth - pFrame->stackOps;
-  pFrame->stackOps = depth;
-  
-  // Add 2 to stackPos to account for 16-bit op
-  pFrame->localArea += diff;
-
-  // Change the ads line to add 2 
-  free(pFrame->pAdsLine->pLine);
-  sprintf(str, "    ads       %d", -pFrame->localArea);
-  pFrame->pAdsLine->pLine = strdup(str);
-
-  // Add two to all stack relative operations
-  pLine = pFrame->pAdsLine->pNext;
-  while (pLine != pFrame->pAsmLines)
-  {
-    char *pSt;
-
-    // Test if this is a stack relative access
-    if (pLine->stackRelative)
-    {
-      int   off;
-      int   idx = 14;
-      pSt = strstr(pLine->pLine, "(sp)");
-
-      if (pSt)
-          *pSt = 0;
-      strncpy(str, pLine->pLine, idx);
-      str[idx] = 0;
-      if (pLine->pLine[idx] == '$')
-      {
-        idx++;
-        strcat(str, "$");
-      }
-
-      off = atoi(&pLine->pLine[idx]);
-      if (pSt)
-          sprintf(&str[idx], "%d(sp)", off + diff);
-      else
-          sprintf(&str[idx], "%d", off + diff);
-      free(pLine->pLine);
-      pLine->pLine = strdup(str);
-    }
-
-    // Point to next line
-    pLine = pLine->pNext;
-  }
-
-  // Loop for all frame params and add 2 to their offset
-  for (int i = 0; i < pFrame->nparam; i++) {
-      Node *v = vec_get(pFrame->func->params, i);
-      v->loff += diff;
-      pFrame->param[i].stackPos += diff;
-  }
-
-  // Loop for all frame lvars and add 2 to their offset
-  for (int i = 0; i < pFrame->nlvars; i++) {
-      Node *v = vec_get(pFrame->func->localvars, i);
-      v->loff += diff;
-      pFrame->lvars[i].stackPos += diff;
-  }
-}
-
-static int align(int n, int m) {
-    int rem = n % m;
-    return (rem == 0) ? n : n - rem + m;
-}
-
-static void push_xmm(int reg) {
-    SAVE;
-    emit("sub $8, #rsp");
-    emit("movsd #xmm%d, (#rsp)", reg);
-//    stackPos += 8;
-}
+    label_ref_t *pRef = get_label_ref(pLine->labelId);
 
-static void pop_xmm(int reg) {
-    SAVE;
-    emit("movsd (#rsp), #xmm%d", reg);
-    emit("add $8, #rsp");
-//    stackPos -= 8;
-//    assert(stackPos >= 0);
+    pRef->defCount += delta;
+    if (delta > 0)
+        pRef->pDefLine = pRef->defCount == 1 ? pLine : NULL;
+    else if (pRef->pDefLine == pLine)
+        pRef->pDefLine = NULL;
 }
 
 /*
 ==========================================================================================
-Push the specified register to the stack, keeping track of stackPos location to the
-generator can correctly calculate LVAR and param stack offsets.
+Move pLine from the use list of its old label operand to that of useId (0 for none)
 ==========================================================================================
 */
-static void push(char *reg) {
-    SAVE;
-    if (strcmp(reg, "ix") == 0)
+static void peep_count_use(asm_line_t *pLine, int useId)
+{
+    if (useId >= peep.nUses)
     {
-      emit("push_ix");
-      pFrame->stackPos += 2;
+        int n = useId * 2 + 64;
+
+        peep.pUses = realloc(peep.pUses, n * sizeof(int));
+        peep.ppUsers = realloc(peep.ppUsers, n * sizeof(asm_line_t *));
+        memset(&peep.pUses[peep.nUses], 0, (n - peep.nUses) * sizeof(int));
+        memset(&peep.ppUsers[peep.nUses], 0, (n - peep.nUses) * sizeof(asm_line_t *));
+        peep.nUses = n;
     }
-    else if (strcmp(reg, "a") == 0)
+
+    if (pLine->useId != 0)
     {
-      emit("push_a");
-      pFrame->stackPos += 1;
+        peep.pUses[pLine->useId]--;
+        if (pLine->pPrevUse)
+            pLine->pPrevUse->pNextUse = pLine->pNextUse;
+        else
+            peep.ppUsers[pLine->useId] = pLine->pNextUse;
+        if (pLine->pNextUse)
+            pLine->pNextUse->pPrevUse = pLine->pPrevUse;
     }
-    else
+
+    if (useId != 0)
     {
-      emit("push      %s", reg);
-      pFrame->stackPos += 8;
+        peep.pUses[useId]++;
+        pLine->pPrevUse = NULL;
+        pLine->pNextUse = peep.ppUsers[useId];
+        if (pLine->pNextUse)
+            pLine->pNextUse->pPrevUse = pLine;
+        peep.ppUsers[useId] = pLine;
     }
+    pLine->useId = useId;
 }
 
 /*
 ==========================================================================================
-Pop the specified register from the stack, keeping track of stackPos.
+Get the number of operands using a label
 ==========================================================================================
 */
-static void pop(char *reg) {
-    SAVE;
-    if (strcmp(reg, "ix") == 0)
-    {
-      emit("pop_ix");
-      pFrame->stackPos -= 2;
-    }
-    else if (strcmp(reg, "a") == 0)
-    {
-      emit("pop       a");
-      pFrame->stackPos -= 1;
-      pFrame->accVal = -10000;
-    }
-    else
-    {
-      emit("pop       %s", reg);
-      pFrame->stackPos -= 8;
-    }
+static int peep_label_uses(int labelId)
+{
+    return labelId < peep.nUses ? peep.pUses[labelId] : 0;
 }
 
 /*
 ==========================================================================================
-Push a struct to the stack.  This is generally a bad idea in LISA architecture unless
-it is a very small struct.
+Mark a line to be re-examined by all of the local passes
 ==========================================================================================
 */
-static int push_struct(int size) {
-    SAVE;
-    int aligned = align(size, 8);
-    emit("sub $%d, #rsp", aligned);
-    emit("mov #rcx, -8(#rsp)");
-    emit("mov #r11, -16(#rsp)");
-    emit("mov #rax, #rcx");
-    int i = 0;
-    for (; i < size; i += 8) {
-        emit("movq %d(#rcx), #r11", i);
-        emit("mov #r11, %d(#rsp)", i);
-    }
-    for (; i < size; i += 4) {
-        emit("movl %d(#rcx), #r11", i);
-        emit("movl #r11d, %d(#rsp)", i);
-    }
-    for (; i < size; i++) {
-        emit("movb %d(#rcx), #r11", i);
-        emit("movb #r11b, %d(#rsp)", i);
-    }
-    emit("mov -8(#rsp), #rcx");
-    emit("mov -16(#rsp), #r11");
-//    stackPos += aligned;
-    return aligned;
-}
-
-static void maybe_emit_bitshift_load(Type *ty) {
-    SAVE;
-    if (ty->bitsize <= 0)
+static void peep_mark_line(asm_line_t *pLine)
+{
+    // The first line is never examined by the passes
+    if (pLine == pFrame->pAsmLines)
         return;
-    int x;
-    int mask;
-    for (x = 0; x < ty->bitoff; x++)
-    {
-        if (ty->size == 1)
-            emit("shr");
-        else
-            emit("shr16");
-        pFrame->accVal = -10000;
-    }
 
-    mask = (1 << ty->bitsize) - 1;
-    emit("andi      %d", mask & 0xFF);
-    if (ty->size > 1)
+    pLine->pending = PEEP_LOCAL;
+    for (int pass = 0; pass < PEEP_COUNT; pass++)
     {
-        emit("swap      1(sp)");
-        emit("andi      %d", (mask >> 8) & 0xFF);
-        emit("swap      1(sp)");
-        pFrame->accVal = -10000;
+        if (!(PEEP_LOCAL & (1 << pass)))
+            continue;
+
+        if (peep.pFirst[pass] == NULL || pLine->seq < peep.pFirst[pass]->seq)
+            peep.pFirst[pass] = pLine;
+        if (peep.pLast[pass] == NULL || pLine->seq > peep.pLast[pass]->seq)
+            peep.pLast[pass] = pLine;
     }
 }
 
-static int maybe_emit_bitshift_save(Type *ty, int off, char *idx, char *modifier) {
-    SAVE;
-    int     x;
-
-    if (ty->bitsize <= 0)
-        return 0;
+/*
+==========================================================================================
+Mark the lines around a change, from pBefore backwards and pAfter forwards, up to
+PEEP_RADIUS opcode lines each way.  Labels, comments and directives in between are
+marked too but not counted.
+==========================================================================================
+*/
+static void peep_mark_near(asm_line_t *pBefore, asm_line_t *pAfter)
+{
+    int     count;
 
-    if (!pFrame->noBitShiftStruc)
+    count = 0;
+    while (pBefore != pFrame->pAsmLines && count < PEEP_RADIUS)
     {
-        emit("andi      %d", ((1 << (long)ty->bitsize) - 1) & 0xFF);
-        pFrame->accVal = -10000;
-        for (x = 0; x < ty->bitoff; x++)
-        {
-            if (ty->size == 1)
-                emit("shl");
-            else
-                emit("shl16");
-        }
+        peep_mark_line(pBefore);
+        if (!is_skip_line(pBefore) && !is_unindented(pBefore))
+            count++;
+        pBefore = pBefore->pPrev;
     }
-    emit("swap      %s%d(%s)", modifier, off, idx);
-    pFrame->pAsmLines->pPrev->stackRelative = 1;
-    emit("andi      %d", ~(((1 << (long)ty->bitsize) - 1) << ty->bitoff) & 0xFF);
-    emit("or        %s%d(%s)", modifier, off, idx);
-    pFrame->pAsmLines->pPrev->stackRelative = 1;
-    emit("stax      %s%d(%s)", modifier, off, idx);
-    pFrame->pAsmLines->pPrev->stackRelative = 1;
 
-    if (ty->size > 1 && ty->bitsize + ty->bitoff > 8)
+    count = 0;
+    while (pAfter != pFrame->pAsmLines && count < PEEP_RADIUS)
     {
-        emit("ldax      1(%s)", idx);
-        emit("andi      %d", (((1 << (long)ty->bitsize) - 1) >> 8) & 0xFF);
-        emit("swap      %s%d(%s)", modifier, off, idx);
-        pFrame->pAsmLines->pPrev->stackRelative = 1;
-        emit("andi      %d", (~(((1 << (long)ty->bitsize) - 1) << ty->bitoff) >> 8) & 0xFF);
-        emit("or        %s%d(%s)", modifier, off, idx);
-        pFrame->pAsmLines->pPrev->stackRelative = 1;
-        emit("stax      %s%d(%s)", modifier, off, idx);
-        pFrame->pAsmLines->pPrev->stackRelative = 1;
+        peep_mark_line(pAfter);
+        if (!is_skip_line(pAfter) && !is_unindented(pAfter))
+            count++;
+        pAfter = pAfter->pNext;
     }
-    clear_acc_var();
-    return 1;
 }
 
 /*
 ==========================================================================================
-Emit code to save a global variable (access, SFR, other).
+Give every line a position key in list order
 ==========================================================================================
 */
-static void emit_gload(Type *ty, char *label, int off) {
-    SAVE;
-    char        str[512];
+static void peep_number_lines(void)
+{
+    asm_line_t  *pLine = pFrame->pAsmLines;
+    long        seq = 0;
 
-    // Test if acc already has this var
-    if (strcmp(pFrame->accVar, label) == 0)
-        return;
-    clear_acc_var();
+    do
+    {
+        pLine->seq = seq;
+        seq += PEEP_SEQ_STEP;
+        pLine = pLine->pNext;
+    } while (pLine != pFrame->pAsmLines);
+}
 
-    if (ty->kind == KIND_ARRAY) {
-        sprintf(str, "&%s", label);
-        if (strcmp(str, pFrame->ixVar) != 0)
-        {
-            emit("spix");
-            if (off)
-            {
-                emit("adx       %d", off);
-                pFrame->pAsmLines->pPrev->stackRelative = 1;
-            }
-            set_ix_var(str);
-        }
-        return;
-    }
+/*
+==========================================================================================
+Give a newly linked line a position key between those of its neighbours
+==========================================================================================
+*/
+static void peep_place_line(asm_line_t *pLine)
+{
+    long    prev = pLine->pPrev->seq;
+    long    next = pLine->pNext->seq;
 
-    if (ty->issfr)
-    {
-        set_acc_var(label);
-        emit("lda       %s", label);
-    }
-    else if (ty->isaccess)
-    {
-        set_acc_var(label);
-        emit("lda       %s", label);
-    }
+    if (pLine == pFrame->pAsmLines)
+        pLine->seq = next - PEEP_SEQ_STEP;
+    else if (pLine->pNext == pFrame->pAsmLines)
+        pLine->seq = prev + PEEP_SEQ_STEP;
+    else if (next - prev > 1)
+        pLine->seq = prev + (next - prev) / 2;
     else
-    {
-        set_acc_var(label);
-        sprintf(str, "&%s", label);
-        if (strcmp(str, pFrame->ixVar) != 0)
-        {
-            emit("ldx       %s", label);
-            set_ix_var("&%s", label);
-        }
-        if (ty->size == 2)
-        {
-            emit("ldax      1(ix)");
-            emit("stax      1(sp)");
-            mark_stack_operations(2);
-        }
-        emit("ldax      0(ix)");
-    }
-    maybe_emit_bitshift_load(ty);
+        peep_number_lines();
 }
 
 /*
 ==========================================================================================
-Add an extern label line at the top of the function
+Record a change to the fields of pLine while optimizing.  The passes call this after
+rewriting a line in place.
 ==========================================================================================
 */
-static void emit_extern(char *pStr) {
-    int         x;
-    asm_line_t  *pLine;
-    char        str[256];
+static void peep_touch(asm_line_t *pLine)
+{
+    if (!peep.active)
+        return;
 
-    for (x = 0; x < pFrame->nexternLabels; x++)
-    {
-        if (strcmp(pFrame->externLabels[x], pStr) == 0)
-            return;
-    }
+    peep.gen++;
+    peep_count_use(pLine, pLine->argKind == ARG_SYMBOL ? pLine->labelId : 0);
+    peep_mark_line(pLine);
+    peep_mark_near(pLine->pPrev, pLine->pNext);
+}
 
-    // Add the extern label
-    pFrame->externLabels[pFrame->nexternLabels++] = strdup(pStr);
+/*
+==========================================================================================
+Record a line that was just linked into the list
+==========================================================================================
+*/
+static void peep_insert(asm_line_t *pLine)
+{
+    if (!peep.active)
+        return;
 
-    sprintf(str, "    .extern %s", pStr);
-    pLine = (asm_line_t *) malloc(sizeof(asm_line_t));
-    pLine->pLine = strdup(str);
-    insert_asm_line_before(pLine, pFrame->pAsmLines->pNext);
+    peep_place_line(pLine);
+    if (pLine->kind == LINE_LABEL)
+        count_label_def(pLine, 1);
+    peep_touch(pLine);
 }
 
 /*
 ==========================================================================================
-Emit code to convert to an int.
+Record a line that is about to be unlinked from the list
 ==========================================================================================
 */
-static void emit_intcast(Type *ty) {
-    char    func[16];
-    char    fromSign = ty->usig ? 'u' : 's';
-
-    switch(ty->kind) {
-    case KIND_BOOL:
-    case KIND_CHAR:
-        sprintf(func, "__%cctoint", fromSign);
-        emit("jal       %s", func);
-        emit_extern(func);
-        return;
-    case KIND_INT:
-        return;
-    case KIND_LONG:
-        sprintf(func, "__%cltoint", fromSign);
-        emit("jal       %s", func);
-        emit_extern(func);
-        return;
-    case KIND_LLONG:
+static void peep_unlink(asm_line_t *pLine)
+{
+    if (!peep.active)
         return;
+
+    peep.gen++;
+    peep_count_use(pLine, 0);
+    if (pLine->kind == LINE_LABEL)
+        count_label_def(pLine, -1);
+
+    // Keep the pending bounds on lines that stay in the list
+    for (int pass = 0; pass < PEEP_COUNT; pass++)
+    {
+        if (peep.pFirst[pass] == pLine)
+            peep.pFirst[pass] = pLine->pNext != pFrame->pAsmLines ? pLine->pNext : NULL;
+        if (peep.pLast[pass] == pLine)
+            peep.pLast[pass] = pLine->pPrev != pFrame->pAsmLines ? pLine->pPrev : NULL;
     }
+    pLine->pending = 0;
+
+    peep_mark_near(pLine->pPrev, pLine->pNext);
 }
 
 /*
 ==========================================================================================
-Convert a floating point type to an int
+Get the first line a local pass must examine.  The pass walks from here while
+peep_more() and only matches at lines where peep_visit() is true.
 ==========================================================================================
 */
-static void emit_toint(Type *ty) {
-    SAVE;
-    if (ty->kind == KIND_FLOAT)
-        emit("cvttss2si #xmm0, #eax");
-    else if (ty->kind == KIND_DOUBLE)
-        emit("cvttsd2si #xmm0, #eax");
+static asm_line_t *peep_first(int pass)
+{
+    asm_line_t  *pLine = peep.pFirst[pass];
+
+    // Lines marked from now on are collected for the next round
+    peep.pFirst[pass] = NULL;
+
+    if (pLine == NULL)
+        return pFrame->pAsmLines;
+    if (pLine == pFrame->pAsmLines)
+        return pLine->pNext;
+    return pLine;
+}
+
+static int peep_more(int pass, asm_line_t *pLine)
+{
+    return pLine != pFrame->pAsmLines && peep.pLast[pass] != NULL &&
+           pLine->seq <= peep.pLast[pass]->seq;
+}
+
+static int peep_visit(int pass, asm_line_t *pLine)
+{
+    if (!(pLine->pending & (1 << pass)))
+        return 0;
+
+    pLine->pending &= ~(1 << pass);
+    peep.visits[pass]++;
+    return 1;
 }
 
 /*
 ==========================================================================================
-Emit code to load a local variable (LVAR or func param).
+Add an asm_line_t to the end of the linked list with the text pStr
 ==========================================================================================
 */
-static void emit_lload(Node* node, Type *ty, char *base, int off) {
-    SAVE;
-    int     stackOff;
-    int     isSP;
-    char    varName[256];
-    
-    if (strcmp(base, "sp") == 0)
+asm_line_t *add_asm_line(char *pStr)
+{
+    asm_line_t *pLine = new_asm_line(pStr);
+
+    // Add it to the stack frame
+    if (pFrame->pAsmLines == NULL)
     {
-        isSP = 1;
-        stackOff = pFrame->stackPos;
+        // Add it as the first entry
+        pFrame->pAsmLines = pLine;
+        pLine->pNext = pLine;
+        pLine->pPrev = pLine;
     }
     else
     {
-        isSP = 0;
-        stackOff = 0;
+        // Add it to the tail
+        pLine->pNext = pFrame->pAsmLines;
+        pLine->pPrev = pFrame->pAsmLines->pPrev;
+        pFrame->pAsmLines->pPrev = pLine;
+        pLine->pPrev->pNext = pLine;
+    }
+
+    peep_insert(pLine);
+    return pLine;
+}
+
+/*
+==========================================================================================
+Add a new line to the .data section linked list.  We don't want these interleaved
+with the .code section, so we store them and emit them at the end of the current function.
+==========================================================================================
+*/
+asm_line_t *add_data_line(char *pStr)
+{
+    asm_line_t *pLine = new_asm_line(pStr);
+
+    // Add it to the stack frame
+    if (pFrame->pDataLines == NULL)
+    {
+        // Add it as the first entry
+        pFrame->pDataLines = pLine;
+        pLine->pNext = pLine;
+        pLine->pPrev = pLine;
+    }
+    else
+    {
+        // Add it to the tail
+        pLine->pNext = pFrame->pDataLines;
+        pLine->pPrev = pFrame->pDataLines->pPrev;
+        pFrame->pDataLines->pPrev = pLine;
+        pLine->pPrev->pNext = pLine;
+    }
+
+    return pLine;
+}
+
+/*
+==========================================================================================
+Delete the specified ASM line
+==========================================================================================
+*/
+void delete_asm_line(asm_line_t *pLine)
+{
+    label_ref_t *pRef;
+
+    peep_unlink(pLine);
+
+    // Forget a deleted emit_label line
+    if (pLine->kind == LINE_LABEL && (pRef = find_label_ref(pLine->labelId)) != NULL &&
+        pRef->pAsmLine == pLine)
+    {
+        pRef->pAsmLine = NULL;
+    }
+
+    // Remove it from the linked list
+    pLine->pPrev->pNext = pLine->pNext;
+    pLine->pNext->pPrev = pLine->pPrev;
+
+    if (pLine == pFrame->pAsmLines)
+        pFrame->pAsmLines = pLine->pNext;
+
+    // The line itself stays in the asm arena until the toplevel is written
+}
+
+/*
+==========================================================================================
+Insert an asm_line_t before the specified pBefore asm_line
+==========================================================================================
+*/
+void insert_asm_line_before(asm_line_t *pLine, asm_line_t *pBefore)
+{
+    // Insert pLine into the linked list
+    pLine->pNext = pBefore;
+    pLine->pPrev = pBefore->pPrev;
+    pBefore->pPrev->pNext = pLine;
+    pBefore->pPrev = pLine;
+
+    // Test if pBefore was the first item
+    if (pBefore == pFrame->pAsmLines)
+        pFrame->pAsmLines = pLine;
+
+    peep_insert(pLine);
+}
+
+/*
+==========================================================================================
+Move the given asm_line to after the specified pAfter line
+==========================================================================================
+*/
+void move_asm_line_after(asm_line_t *pLine, asm_line_t *pAfter)
+{
+    // First remove pLine from the linked list
+    peep_unlink(pLine);
+    if (pLine == pFrame->pAsmLines)
+        pFrame->pAsmLines = pLine->pNext;
+    pLine->pPrev->pNext = pLine->pNext;
+    pLine->pNext->pPrev = pLine->pPrev;
+
+    // Now insert the pLine after the pAfter line
+    pLine->pNext = pAfter->pNext;
+    pAfter->pNext = pLine;
+    pLine->pPrev = pAfter;
+    pLine->pNext->pPrev = pLine;
+
+    peep_insert(pLine);
+}
+
+/*
+==========================================================================================
+Get the next asm line after the give line
+==========================================================================================
+*/
+asm_line_t * get_next_asm_line(asm_line_t *pLine)
+{
+    asm_line_t  *pNext;
+
+    if (pLine == NULL)
+        return NULL;
+
+    pNext = pLine->pNext;
+
+    while (pNext != pFrame->pAsmLines)
+    {
+        // Test for comment or .loc lines
+        if (!is_skip_line(pNext))
+            return pNext;
+
+        pNext = pNext->pNext;
+    }
+
+    return NULL;
+}
+
+/*
+==========================================================================================
+Get the previous asm line before the give line
+==========================================================================================
+*/
+asm_line_t * get_prev_asm_line(asm_line_t *pLine)
+{
+    asm_line_t  *pPrev;
+
+    if (pLine == NULL)
+        return NULL;
+
+    pPrev = pLine->pPrev;
+
+    while (pPrev != pFrame->pAsmLines)
+    {
+        // Test for comment or .loc lines
+        if (!is_skip_line(pPrev))
+            return pPrev;
+
+        pPrev = pPrev->pPrev;
+    }
+
+    return NULL;
+}
+
+/*
+==========================================================================================
+Get the next asm line after the give line
+==========================================================================================
+*/
+asm_line_t * get_next_asm_line_no_label(asm_line_t *pLine)
+{
+    asm_line_t  *pNext;
+
+    if (pLine == NULL)
+        return NULL;
+
+    pNext = pLine->pNext;
+
+    while (pNext != pFrame->pAsmLines)
+    {
+        // Test for comment, .loc or label lines
+        if (!(is_skip_line(pNext) || is_unindented(pNext)))
+            return pNext;
+
+        pNext = pNext->pNext;
+    }
+
+    return NULL;
+}
+
+/*
+==========================================================================================
+Get the last asm line with an opcode, skipping comments and .loc / .file directives
+==========================================================================================
+*/
+asm_line_t * get_last_asm_line(void)
+{
+    asm_line_t  *pLine;
+
+    pLine = pFrame->pAsmLines->pPrev;
+
+    while (pLine != pFrame->pAsmLines)
+    {
+        // Test for comment or .loc lines
+        if (!is_skip_line(pLine))
+            return pLine;
+
+        pLine = pLine->pPrev;
+    }
+
+    return NULL;
+}
+
+/*
+==========================================================================================
+Find the first line with label labelId from pLine onwards
+==========================================================================================
+*/
+static asm_line_t *find_label_after(int labelId, asm_line_t *pLine)
+{
+    asm_line_t  *pDef;
+
+    if (labelId == 0 || pLine == NULL)
+        return NULL;
+
+    // A single label line is found directly
+    pDef = get_label_ref(labelId)->pDefLine;
+    if (peep.active && pDef != NULL)
+        return pDef->seq >= pLine->seq ? pDef : NULL;
+
+    while (pLine != NULL && !(pLine->kind == LINE_LABEL && pLine->labelId == labelId))
+        pLine = get_next_asm_line(pLine);
+
+    return pLine;
+}
+
+/*
+==========================================================================================
+Calculate the jal distance to it's label
+==========================================================================================
+*/
+int calc_jal_distance(asm_line_t *pLine)
+{
+    asm_line_t  *pNext;
+    asm_line_t  *pPrev;
+    asm_line_t  *pDef;
+    int         distance;
+
+    if (pLine == NULL || pLine->argKind != ARG_SYMBOL)
+        return 999999;
+
+    // When optimizing, a single label line tells which way to search
+    pDef = peep.active ? get_label_ref(pLine->labelId)->pDefLine : NULL;
+
+    // Search forward for the label
+    pNext = pDef != NULL && pDef->seq < pLine->seq ? pFrame->pAsmLines : pLine->pNext;
+    distance = 0;
+    while (pNext != pFrame->pAsmLines)
+    {
+        // Test if this is the label
+        if (pNext->kind == LINE_LABEL && pNext->labelId == pLine->labelId)
+            return distance;
+
+        // Test for non-asm line
+        if (!is_skip_line(pNext))
+            distance++;
+
+        // Get next line
+        pNext = pNext->pNext;
+    }
+
+    // Search forward for the label
+    pPrev = pLine->pPrev;
+    distance = 0;
+    while (pPrev != pFrame->pAsmLines)
+    {
+        // Test if this is the label
+        if (pPrev->kind == LINE_LABEL && pPrev->labelId == pLine->labelId)
+            return distance;
+
+        // Test for non-asm line
+        if (!is_skip_line(pPrev))
+            distance--;
+
+        // Get next line
+        pPrev = pPrev->pPrev;
+    }
+
+    return 99999;
+}
+
+/*
+==========================================================================================
+Set the name of the current variable in IX
+==========================================================================================
+*/
+static void set_ix_var(char *varname, ...)
+{
+    char    sLine[512];
+    va_list args;
+
+    va_start(args, varname);
+    vsprintf(sLine, varname, args);
+    va_end(args);
+
+    // Test if acc has a modified var
+
+    // Set the acc var
+    strcpy(pFrame->ixVar, sLine);
+    pFrame->ixModified = 0;
+}
+
+/*
+==========================================================================================
+Clear the variable in IX
+==========================================================================================
+*/
+static void clear_ix_var(void)
+{
+    // Test if IX has a modified var
+
+    // Clear the acc var
+    pFrame->ixVar[0] = 0;
+    pFrame->ixModified = 0;
+}
+
+/*
+==========================================================================================
+Set the name of the current variable in ACC / 1(sp)
+==========================================================================================
+*/
+static void set_acc_var(char *varname)
+{
+    // Test if acc has a modified var
+
+    // Set the acc var
+    strcpy(pFrame->accVar, varname);
+    pFrame->accModified = 0;
+}
+
+/*
+==========================================================================================
+Mark the ACC variable as damaged / no loaded variable name
+==========================================================================================
+*/
+static void clear_acc_var(void)
+{
+    pFrame->accVal = -1000;
+    if (pFrame->accVar[0] == 0)
+        return;
+
+    // Test if acc has a modified var and save it if needed
+    
+    // Clear the accVar
+    pFrame->accVar[0] = 0;
+    pFrame->accModified = 0;
+}
+
+/*
+==========================================================================================
+Test if the given string is a load ACC opcode
+==========================================================================================
+*/
+static bool isAccLoad(char *op) {
+    if (strncmp(op, "lda", 3) == 0 ||
+        strncmp(op, "ldi", 3) == 0 ||
+        strncmp(op, "txa", 3) == 0 ||
+        strncmp(op, "reti", 4) == 0 ||
+        strncmp(op, "pop_a", 5) == 0)
+    {
+        return true;
+    }
+    return false;
+}
+
+/*
+==========================================================================================
+Test if the given string is an opcode that uses the value in ACC
+==========================================================================================
+*/
+static bool isAccUse(char *op) {
+    if (strncmp(op, "sta", 3) == 0 ||
+        strncmp(op, "ret", 3) == 0 ||
+        strncmp(op, "rc", 2)  == 0 ||
+        strncmp(op, "rz", 2)  == 0 ||
+        strncmp(op, "adc", 3) == 0 ||
+        strncmp(op, "shl", 3) == 0 ||
+        strncmp(op, "shr", 3) == 0 ||
+        strncmp(op, "tax", 3) == 0 ||
+        strncmp(op, "cpi", 3) == 0 ||
+        strncmp(op, "add", 3) == 0 ||
+        strncmp(op, "mul", 3) == 0 ||
+        strncmp(op, "sub", 3) == 0 ||
+        strncmp(op, "or",  2) == 0 ||
+        strncmp(op, "xor", 3) == 0 ||
+        strncmp(op, "cmp", 3) == 0)
+    {
+        return true;
+    }
+
+    return false;
+}
+
+/*
+==========================================================================================
+Do a formatted emit of opcode, label, etc.
+==========================================================================================
+*/
+static void emitf(int line, char *fmt, ...) {
+    // Replace "#" with "%%" so that vfprintf prints out "#" as "%".
+    char buf[256];
+    char sLine[512];
+    char retTest[256];
+    asm_line_t *pLine;
+    int i = 0;
+
+    for (char *p = fmt; *p; p++) {
+        assert(i < sizeof(buf) - 3);
+        if (*p == '#' && *(p+1) == '#') {
+            p++;
+            buf[i++] = *p;
+        }
+        else if (*p == '#') {
+            buf[i++] = '%';
+            buf[i++] = '%';
+        } else {
+            buf[i++] = *p;
+        }
+    }
+    buf[i] = '\0';
+
+#if 0
+    if (strlen(gMaybeEmitLoc) > 0)
+      fprintf(outputfp, "\n%s\n", gMaybeEmitLoc);
+    gMaybeEmitLoc = "";
+    if (strlen(gMaybeEmitLine) > 0)
+      fprintf(outputfp, "%s\n", gMaybeEmitLine);
+    gMaybeEmitLine = "";
+#endif
+
+    /* Test if we can remove the last optional swap */
+    if (pFrame->lastSwapOptional)
+    {
+        /* Test for opcodes that load acc */
+        if (isAccLoad(&fmt[4]))
+        {
+            /* Delete the last optional swap */
+            delete_asm_line(pFrame->pLastSwapLine);
+            pFrame->pLastSwapLine = NULL;
+            pFrame->lastSwapOptional = 0;
+        }
+
+        /* Test for opcodes that use acc after the last optional swap */
+        else if (isAccUse(&fmt[4]))
+        {
+            /* Last optional swap actually needed. */
+            pFrame->pLastSwapLine = NULL;
+            pFrame->lastSwapOptional = 0;
+        }
+    }
+
+    va_list args;
+    va_start(args, fmt);
+    vsprintf(sLine, buf, args);
+    va_end(args);
+
+    if (gEmitToDataSection)
+        pLine = add_data_line(sLine);
+    else
+        pLine = add_asm_line(sLine);
+
+    // The caller annotation is kept apart from the line so the
+    // optimizer sees the same code with and without -fdump-stack
+    if (dumpstack) {
+        pLine->pNote = arena_strdup(&asm_arena, format("%s:%d", get_caller_list(), line));
+    }
+
+    sprintf(retTest, "    jal       _L%s_ret", pFrame->fname);
+    if (strncmp(sLine, "    .", 5) != 0)
+    {
+        gLastEmitWasRet = strcmp(sLine, retTest) == 0;
+        if (gLastEmitWasRet)
+            pFrame->pLastRetLine = pFrame->pAsmLines->pPrev;
+        else
+            pFrame->pLastRetLine = NULL;
+        gLastEmitWasJal = strncmp(sLine, "    jal", 7) == 0;
+        if (gLastEmitWasJal)
+            pFrame->raDestroyed = 1;
+    }
+}
+
+static void emit_nostack(char *fmt, ...) {
+    char  sLine[512];
+    sprintf(sLine, "    ");
+    va_list args;
+    va_start(args, fmt);
+    vsprintf(&sLine[strlen(sLine)], fmt, args);
+    va_end(args);
+    add_asm_line(sLine);
+}
+
+/*
+==========================================================================================
+Test if the given name is an LVAR and return it's offset or -1 if not LVAR.
+==========================================================================================
+*/
+static int find_lvar_offset(char *pVarName)
+{
+  int   x;
+
+  // Test if it is a local
+  for (x = 0; x < pFrame->nlvars; x++)
+  {
+    if (strcmp(pFrame->lvars[x].name, pVarName) == 0)
+      return x;
+  }
+
+  return -1;
+}
+
+/*
+==========================================================================================
+Test if the given name is a function param and return it's offset or -1 if not LVAR.
+==========================================================================================
+*/
+static int find_param_offset(char *pVarName)
+{
+  int   x;
+
+  // Test if it is a local
+  for (x = 0; x < pFrame->nparam; x++)
+  {
+    if (strcmp(pFrame->param[x].name, pVarName) == 0)
+      return x;
+  }
+
+  return -1;
+}
+
+/*
+==========================================================================================
+Mark the curent function as using a minimum of depth bytes of stack.  The function
+stack depth can grow but not shrink.
+
+If growth occurs, walk through all existing asm_lines to find any with #(sp) arguments
+and add the growth to the index offset numbers (for any line marked as stackRelative).
+==========================================================================================
+*/
+static void mark_stack_operations(int depth)
+{
+  asm_line_t  *pLine;
+  int           diff;
+
+  if (pFrame->stackOps >= depth)
+    return;
+
+  // Mark stack as using stack ops
+  diff = depth - pFrame->stackOps;
+  pFrame->stackOps = depth;
+  
+  // Add 2 to stackPos to account for 16-bit op
+  pFrame->localArea += diff;
+
+  // Change the ads line to add 2 
+  pFrame->pAdsLine->argVal = -pFrame->localArea;
+
+  // Add two to all stack relative operations
+  pLine = pFrame->pAdsLine->pNext;
+  while (pLine != pFrame->pAsmLines)
+  {
+    // Test if this is a stack relative access
+    if (pLine->stackRelative &&
+        (pLine->argKind == ARG_STACK || pLine->argKind == ARG_IMM))
+    {
+      pLine->argVal += diff;
+    }
+
+    // Point to next line
+    pLine = pLine->pNext;
+  }
+
+  // Loop for all frame params and add 2 to their offset
+  for (int i = 0; i < pFrame->nparam; i++) {
+      Node *v = vec_get(pFrame->func->params, i);
+      v->loff += diff;
+      pFrame->param[i].stackPos += diff;
+  }
+
+  // Loop for all frame lvars and add 2 to their offset.  The lvars are the
+  // AST_LVAR locals only, not those moved to a static frame.
+  for (int i = 0, n = 0; n < vec_len(pFrame->func->localvars); n++) {
+      Node *v = vec_get(pFrame->func->localvars, n);
+      if (v->kind != AST_LVAR)
+          continue;
+      v->loff += diff;
+      pFrame->lvars[i++].stackPos += diff;
+  }
+}
+
+/*
+==========================================================================================
+Reserve the 0(sp) and 1(sp) scratch bytes for any use of them not yet marked.  Without
+the reserve they are the first bytes of the frame, or the saved ra of a function with no
+frame, such as one whose locals all moved to its static frame.
+==========================================================================================
+*/
+static void reserve_stack_scratch(void)
+{
+  asm_line_t  *pLine;
+  int         depth = 0;
+
+  if (pFrame->stackOps >= 2 || (!pFrame->raDestroyed && pFrame->localArea == 0))
+    return;
+
+  // Find the deepest scratch byte used by a line not relative to the frame
+  pLine = pFrame->pAdsLine->pNext;
+  while (pLine != pFrame->pAsmLines)
+  {
+    if (pLine->argKind == ARG_STACK && !pLine->stackRelative && !pLine->paramRel &&
+        pLine->argVal < 2 && pLine->argVal >= depth)
+    {
+      depth = pLine->argVal + 1;
+    }
+    pLine = pLine->pNext;
+  }
+
+  if (depth > 0)
+    mark_stack_operations(depth);
+}
+
+static int align(int n, int m) {
+    int rem = n % m;
+    return (rem == 0) ? n : n - rem + m;
+}
+
+static void push_xmm(int reg) {
+    SAVE;
+    emit("sub $8, #rsp");
+    emit("movsd #xmm%d, (#rsp)", reg);
+//    stackPos += 8;
+}
+
+static void pop_xmm(int reg) {
+    SAVE;
+    emit("movsd (#rsp), #xmm%d", reg);
+    emit("add $8, #rsp");
+//    stackPos -= 8;
+//    assert(stackPos >= 0);
+}
+
+/*
+==========================================================================================
+Push the specified register to the stack, keeping track of stackPos location to the
+generator can correctly calculate LVAR and param stack offsets.
+==========================================================================================
+*/
+static void push(char *reg) {
+    SAVE;
+    if (strcmp(reg, "ix") == 0)
+    {
+      emit("push_ix");
+      pFrame->stackPos += 2;
+    }
+    else if (strcmp(reg, "a") == 0)
+    {
+      emit("push_a");
+      pFrame->stackPos += 1;
+    }
+    else
+    {
+      emit("push      %s", reg);
+      pFrame->stackPos += 8;
+    }
+}
+
+/*
+==========================================================================================
+Pop the specified register from the stack, keeping track of stackPos.
+==========================================================================================
+*/
+static void pop(char *reg) {
+    SAVE;
+    if (strcmp(reg, "ix") == 0)
+    {
+      emit("pop_ix");
+      pFrame->stackPos -= 2;
+    }
+    else if (strcmp(reg, "a") == 0)
+    {
+      emit("pop       a");
+      pFrame->stackPos -= 1;
+      pFrame->accVal = -10000;
+    }
+    else
+    {
+      emit("pop       %s", reg);
+      pFrame->stackPos -= 8;
+    }
+}
+
+/*
+==========================================================================================
+Push a struct to the stack.  This is generally a bad idea in LISA architecture unless
+it is a very small struct.
+==========================================================================================
+*/
+static int push_struct(int size) {
+    SAVE;
+    int aligned = align(size, 8);
+    emit("sub $%d, #rsp", aligned);
+    emit("mov #rcx, -8(#rsp)");
+    emit("mov #r11, -16(#rsp)");
+    emit("mov #rax, #rcx");
+    int i = 0;
+    for (; i < size; i += 8) {
+        emit("movq %d(#rcx), #r11", i);
+        emit("mov #r11, %d(#rsp)", i);
+    }
+    for (; i < size; i += 4) {
+        emit("movl %d(#rcx), #r11", i);
+        emit("movl #r11d, %d(#rsp)", i);
+    }
+    for (; i < size; i++) {
+        emit("movb %d(#rcx), #r11", i);
+        emit("movb #r11b, %d(#rsp)", i);
+    }
+    emit("mov -8(#rsp), #rcx");
+    emit("mov -16(#rsp), #r11");
+//    stackPos += aligned;
+    return aligned;
+}
+
+static void maybe_emit_bitshift_load(Type *ty) {
+    SAVE;
+    if (ty->bitsize <= 0)
+        return;
+    int x;
+    int mask;
+    for (x = 0; x < ty->bitoff; x++)
+    {
+        if (ty->size == 1)
+            emit("shr");
+        else
+            emit("shr16");
+        pFrame->accVal = -10000;
+    }
+
+    mask = (1 << ty->bitsize) - 1;
+    emit("andi      %d", mask & 0xFF);
+    if (ty->size > 1)
+    {
+        emit("swap      1(sp)");
+        emit("andi      %d", (mask >> 8) & 0xFF);
+        emit("swap      1(sp)");
+        pFrame->accVal = -10000;
+    }
+}
+
+static int maybe_emit_bitshift_save(Type *ty, int off, char *idx, char *modifier) {
+    SAVE;
+    int     x;
+
+    if (ty->bitsize <= 0)
+        return 0;
+
+    if (!pFrame->noBitShiftStruc)
+    {
+        emit("andi      %d", ((1 << (long)ty->bitsize) - 1) & 0xFF);
+        pFrame->accVal = -10000;
+        for (x = 0; x < ty->bitoff; x++)
+        {
+            if (ty->size == 1)
+                emit("shl");
+            else
+                emit("shl16");
+        }
+    }
+    emit("swap      %s%d(%s)", modifier, off, idx);
+    pFrame->pAsmLines->pPrev->stackRelative = 1;
+    emit("andi      %d", ~(((1 << (long)ty->bitsize) - 1) << ty->bitoff) & 0xFF);
+    emit("or        %s%d(%s)", modifier, off, idx);
+    pFrame->pAsmLines->pPrev->stackRelative = 1;
+    emit("stax      %s%d(%s)", modifier, off, idx);
+    pFrame->pAsmLines->pPrev->stackRelative = 1;
+
+    if (ty->size > 1 && ty->bitsize + ty->bitoff > 8)
+    {
+        emit("ldax      1(%s)", idx);
+        emit("andi      %d", (((1 << (long)ty->bitsize) - 1) >> 8) & 0xFF);
+        emit("swap      %s%d(%s)", modifier, off, idx);
+        pFrame->pAsmLines->pPrev->stackRelative = 1;
+        emit("andi      %d", (~(((1 << (long)ty->bitsize) - 1) << ty->bitoff) >> 8) & 0xFF);
+        emit("or        %s%d(%s)", modifier, off, idx);
+        pFrame->pAsmLines->pPrev->stackRelative = 1;
+        emit("stax      %s%d(%s)", modifier, off, idx);
+        pFrame->pAsmLines->pPrev->stackRelative = 1;
     }
+    clear_acc_var();
+    return 1;
+}
+
+/*
+==========================================================================================
+Emit code to save a global variable (access, SFR, other).
+==========================================================================================
+*/
+static void emit_gload(Type *ty, char *label, int off) {
+    SAVE;
+    char        str[512];
+    char        *var = off ? format("%s+%d", label, off) : label;
 
     // Test if acc already has this var
-    if (ty->kind != KIND_PTR && strcmp(pFrame->accVar, node->varname) == 0)
+    if (strcmp(pFrame->accVar, var) == 0)
         return;
+    clear_acc_var();
 
-    if (ty->kind == KIND_PTR && strcmp(pFrame->ixVar, node->varname) == 0)
+    if (ty->kind == KIND_ARRAY) {
+        sprintf(str, "&%s", var);
+        if (strcmp(str, pFrame->ixVar) != 0)
+        {
+            emit("ldx       %s", label);
+            if (off)
+                emit("adx       %d", off);
+            set_ix_var(str);
+        }
         return;
+    }
 
-    if (pFrame->emitCompZero)
+    if (ty->issfr)
     {
-        if (ty->kind == KIND_PTR)
-            clear_ix_var();
-        else
-            clear_acc_var();
+        set_acc_var(label);
+        emit("lda       %s", label);
+    }
+    else if (ty->isaccess)
+    {
+        set_acc_var(label);
+        emit("lda       %s", label);
+    }
+    else
+    {
+        set_acc_var(var);
+        sprintf(str, "&%s", label);
+        if (strcmp(str, pFrame->ixVar) != 0)
+        {
+            emit("ldx       %s", label);
+            set_ix_var("&%s", label);
+        }
+        if (ty->size == 2)
+        {
+            emit("ldax      %d(ix)", off + 1);
+            emit("stax      1(sp)");
+            mark_stack_operations(2);
+        }
+        emit("ldax      %d(ix)", off);
+    }
+    maybe_emit_bitshift_load(ty);
+}
+
+/*
+==========================================================================================
+Add an extern label line at the top of the function
+==========================================================================================
+*/
+static void emit_extern(char *pStr) {
+    int         x;
+    asm_line_t  *pLine;
+    char        str[256];
+
+    for (x = 0; x < pFrame->nexternLabels; x++)
+    {
+        if (strcmp(pFrame->externLabels[x], pStr) == 0)
+            return;
+    }
+
+    // Add the extern label
+    pFrame->externLabels[pFrame->nexternLabels++] = strdup(pStr);
+
+    sprintf(str, "    .extern %s", pStr);
+    pLine = new_asm_line(str);
+    insert_asm_line_before(pLine, pFrame->pAsmLines->pNext);
+}
+
+/*
+==========================================================================================
+Emit code to convert to an int.
+==========================================================================================
+*/
+static void emit_intcast(Type *ty) {
+    char    func[16];
+    char    fromSign = ty->usig ? 'u' : 's';
+
+    switch(ty->kind) {
+    case KIND_BOOL:
+    case KIND_CHAR:
+        sprintf(func, "__%cctoint", fromSign);
+        emit("jal       %s", func);
+        emit_extern(func);
+        return;
+    case KIND_INT:
+        return;
+    case KIND_LONG:
+        sprintf(func, "__%cltoint", fromSign);
+        emit("jal       %s", func);
+        emit_extern(func);
+        return;
+    case KIND_LLONG:
+        return;
+    }
+}
+
+/*
+==========================================================================================
+Convert a floating point type to an int
+==========================================================================================
+*/
+static void emit_toint(Type *ty) {
+    SAVE;
+    if (ty->kind == KIND_FLOAT)
+        emit("cvttss2si #xmm0, #eax");
+    else if (ty->kind == KIND_DOUBLE)
+        emit("cvttsd2si #xmm0, #eax");
+}
+
+/*
+==========================================================================================
+Emit code to load a local variable (LVAR or func param).
+==========================================================================================
+*/
+static void emit_lload(Node* node, Type *ty, char *base, int off) {
+    SAVE;
+    int     stackOff;
+    int     isSP;
+    char    varName[256];
+    
+    if (strcmp(base, "sp") == 0)
+    {
+        isSP = 1;
+        stackOff = pFrame->stackPos;
+    }
+    else
+    {
+        isSP = 0;
+        stackOff = 0;
+    }
+
+    if (strcmp(base, "ix") == 0)
+    {
+        // A load through ix is of whatever ix points to, which the name of
+        // the node does not tell, so it is not cached
+        clear_acc_var();
     }
     else
     {
-        if (ty->kind == KIND_PTR)
-            set_ix_var(node->varname);
+        // Test if acc already has this var.  A compare to zero must still
+        // set Z, so it loads the var again
+        if (!pFrame->emitCompZero && ty->kind != KIND_PTR &&
+            strcmp(pFrame->accVar, node->varname) == 0)
+            return;
+
+        if (!pFrame->emitCompZero && ty->kind == KIND_PTR &&
+            strcmp(pFrame->ixVar, node->varname) == 0)
+            return;
+
+        if (pFrame->emitCompZero)
+        {
+            if (ty->kind == KIND_PTR)
+                clear_ix_var();
+            else
+                clear_acc_var();
+        }
         else
-            set_acc_var(node->varname);
+        {
+            if (ty->kind == KIND_PTR)
+                set_ix_var(node->varname);
+            else
+                set_acc_var(node->varname);
+        }
     }
 
     if (ty->kind == KIND_ARRAY) {
@@ -1142,8 +2095,26 @@ static void emit_lload(Node* node, Type *ty, char *base, int off) {
             pFrame->pAsmLines->pPrev->stackRelative = 1;
             set_ix_var(varName);
         }
+    } else if (ty->kind == KIND_PTR && !isSP) {
+        // ldxx is only sp relative, so the pointer is staged in 0(sp) and 1(sp)
+        emit("ldax      %d(%s)", off + 1, base);
+        emit("stax      1(sp)");
+        emit("ldax      %d(%s)", off, base);
+        emit("stax      0(sp)");
+        emit("ldxx      0(sp)");
+        mark_stack_operations(2);
+        pFrame->accVal = -1000;
+        clear_acc_var();
+        clear_ix_var();
+    } else if (ty->kind == KIND_PTR && pFrame->emitCompZero) {
+        // Only the test of the pointer against zero is needed, as for an int
+        emit("ldax      %s%d(sp)", ty->isparam ? "$" : "", off + stackOff + 1);
+        pFrame->pAsmLines->pPrev->stackRelative = 1;
+        emit("or        %s%d(sp)", ty->isparam ? "$" : "", off + stackOff);
+        pFrame->pAsmLines->pPrev->stackRelative = 1;
+        pFrame->accVal = -10000;
     } else if (ty->kind == KIND_PTR) {
-        emit("ldxx      %s%d(sp)", ty->isparam ? "$" : "", off);
+        emit("ldxx      %s%d(sp)", ty->isparam ? "$" : "", off + stackOff);
         if (isSP)
             pFrame->pAsmLines->pPrev->stackRelative = 1;
         strcpy(pFrame->ixVar, node->varname);
@@ -1169,10 +2140,11 @@ static void emit_lload(Node* node, Type *ty, char *base, int off) {
             pFrame->pAsmLines->pPrev->stackRelative = 1;
           if (!pFrame->emitCompZero)
           {
+              int localArea = pFrame->localArea;
               emit("stax      1(sp)");
               mark_stack_operations(2);
               if (isSP)
-                  off += 2;
+                  off += pFrame->localArea - localArea;
           }
         }
 
@@ -1213,7 +2185,11 @@ static void emit_gsave(char *varname, Type *ty, int off) {
     assert(ty->kind != KIND_ARRAY);
     maybe_convert_bool(ty);
 
-    set_acc_var(varname);
+    // acc holds the var only if this is not a field of it
+    if (off == 0)
+        set_acc_var(varname);
+    else
+        clear_acc_var();
     if (ty->issfr | ty->isaccess)
     {
         emit("sta       %s\n", varname);
@@ -1226,7 +2202,16 @@ static void emit_gsave(char *varname, Type *ty, int off) {
             emit("ldx       %s", varname);
             set_ix_var(varName);
         }
-        emit("stax      0(ix)");
+
+        // The offset is that of any field of the var
+        emit("stax      %d(ix)", off);
+        if (ty->size == 2)
+        {
+            emit("swap      1(sp)");
+            emit("stax      %d(ix)", off + 1);
+            emit("swap      1(sp)");
+            mark_stack_operations(2);
+        }
     }
 }
 
@@ -1250,15 +2235,16 @@ static void emit_lsave(char *varname, Type *ty, int off) {
         int  offset = 0xFFFFFFFF;
         char modifier[2] = {0,};
 
+        // The offset is that of the var plus any field or element in it
         if (lvarIdx != -1)
-          offset = pFrame->lvars[lvarIdx].stackPos + pFrame->stackPos;
+          offset = off + pFrame->stackPos;
         else
         {
           // See if it is a parameter
           lvarIdx = find_param_offset(varname);
           if (lvarIdx != -1)
           {
-            offset = pFrame->param[lvarIdx].stackPos + pFrame->stackPos;
+            offset = off + pFrame->stackPos;
             modifier[0] = '$';
           }
         }
@@ -1274,7 +2260,7 @@ static void emit_lsave(char *varname, Type *ty, int off) {
         {
           emit("stax      %s%d(sp)", modifier, offset);
           pFrame->pAsmLines->pPrev->stackRelative = 1;
-          if (pFrame->lvars[lvarIdx].size == 2)
+          if (ty->size == 2)
           {
             emit("swap      1(sp)");
             emit("stax      %s%d(sp)", modifier, offset + 1);
@@ -1291,17 +2277,17 @@ static void emit_lsave(char *varname, Type *ty, int off) {
 
 /*
 ==========================================================================================
-Generate code to DEREF store a variable (simple or struct)
+Generate code to DEREF store a variable (simple or struct) of size bytes
 ==========================================================================================
 */
-static void do_emit_assign_deref(Type *ty, int off) {
+static void do_emit_assign_deref(int size, int off) {
     if (pFrame->accOnStack)
     {
         emit("ldax      0(sp)");
         pFrame->accOnStack = 0;
     }
     emit("stax      %d(ix)", off);
-    if (ty->ptr->size > 1)
+    if (size > 1)
     {
         emit("swap      1(sp)");
         emit("stax      %d(ix)", off + 1);
@@ -1320,7 +2306,7 @@ static void emit_assign_deref(Node *var, Node *simpleLoad) {
     emit_expr(var->operand);
     if (simpleLoad)
         emit_expr(simpleLoad);
-    do_emit_assign_deref(var->operand->ty, var->operand->ty->offset);
+    do_emit_assign_deref(var->operand->ty->ptr->size, var->operand->ty->offset);
 }
 
 /*
@@ -1349,6 +2335,7 @@ static void emit_pointer_arith(char kind, Node *left, Node *right) {
         emit("stxx      0(sp)");
         emit("ads       -2");
         pFrame->stackPos += 2;
+        mark_stack_operations(2);
     }
     emit_expr(right);
     size = left->ty->ptr->size;
@@ -1357,7 +2344,11 @@ static void emit_pointer_arith(char kind, Node *left, Node *right) {
         if (right->ty->size == 1)
             emit("shl");
         else if (right->ty->size == 2)
+        {
             emit("shl16");
+            if (size == 4)
+                emit("shl16");
+        }
         pFrame->accVal = -10000;
     }
     else if (size > 1)
@@ -1369,10 +2360,10 @@ static void emit_pointer_arith(char kind, Node *left, Node *right) {
     }
     if (needPush)
     {
-        emit("ads       2");
-        emit("ldxx      0(sp)");
+        // The pointer is popped after the add, since the MSB of the index
+        // is in the 1(sp) below it
+        emit("ldxx      2(sp)");
         pFrame->ixVar[0] = 0;
-        pFrame->stackPos -= 2;
     }
     switch (kind) {
         case '+': op = "add"; break;
@@ -1383,26 +2374,34 @@ static void emit_pointer_arith(char kind, Node *left, Node *right) {
     if (size == 1 || size == 2 || size == 4)
     {
         if (size == 1 && right->ty->size == 1)
-            emit("%sax     nc", op);
+            emit("%sax", op);
         else if (right->ty->size == 1)
         {
-            emit("%sax     c", op);
-            if (size == 4)
-                emit("%sax     c", op);
+            // The index was doubled above, so add it once per two bytes
+            for (int i = 0; i < size / 2; i++)
+                emit("%sax", op);
         }
         else
         {
-            emit("%sax     nc", op);
+            emit("%sax", op);
             emit("ldax      1(sp)");
             emit("%saxu", op);
         }
     }
     else
     {
-        emit("%sax     nc", op);
+        emit("%sax", op);
         emit("ldi       %d", size);
         emit("mulu      0(sp)");
-        emit("%saxu    nc", op);
+        emit("%saxu", op);
+    }
+
+    // ix no longer holds the pointer var it was loaded from
+    clear_ix_var();
+    if (needPush)
+    {
+        emit("ads       2");
+        pFrame->stackPos -= 2;
     }
 }
 
@@ -1471,7 +2470,7 @@ static void ensure_lvar_init(Node *node) {
     SAVE;
     assert(node->kind == AST_LVAR);
     if (node->lvarinit)
-        emit_decl_init(node->lvarinit, node->loff, node->ty->size);
+        emit_decl_init(node->varname, node->lvarinit, node->loff, node->ty->size);
     node->lvarinit = NULL;
 }
 
@@ -1495,7 +2494,7 @@ static void emit_assign_struct_ref(Node *struc, Type *field, int off) {
         break;
     case AST_DEREF:
         emit_expr(struc->operand);
-        do_emit_assign_deref(field, field->offset + off);
+        do_emit_assign_deref(field->size, field->offset + off + struc->operand->ty->offset);
         break;
     default:
         error("internal error: %s", node2s(struc, 0));
@@ -1519,7 +2518,7 @@ static void emit_load_struct_ref(Node* node, Node *struc, Type *field, int off)
         break;
     case AST_DEREF:
         emit_expr(struc->operand);
-        emit_lload(node, field, "ix", field->offset + off);
+        emit_lload(node, field, "ix", field->offset + off + struc->operand->ty->offset);
         break;
     default:
         error("internal error: %s", node2s(struc, 0));
@@ -1578,14 +2577,10 @@ static void maybe_emit_bool_compare(Node *node) {
         {
             // Test for ldax/stax load of int
             pLine = get_last_asm_line();
-            if (strncmp(&pLine->pLine[4], "ldax", 4) == 0 &&
-                strcmp(pLine->pPrev->pLine, "    stax      1(sp)") == 0)
+            if (pLine->op == ASM_LDAX && is_stack_arg(pLine->pPrev, ASM_STAX, 1))
             {
                 // Convert the ldax line to "or" and delete the stax 1(sp)
-                pLine->pLine[4] = 'o';
-                pLine->pLine[5] = 'r';
-                pLine->pLine[6] = ' ';
-                pLine->pLine[7] = ' ';
+                pLine->op = ASM_OR;
                 delete_asm_line(pLine->pPrev);
             }
             else
@@ -1598,6 +2593,23 @@ static void maybe_emit_bool_compare(Node *node) {
             clear_acc_var();
         }
     }
+
+    // Any other value, such as *p, that is not itself a test
+    else if (node->kind != OP_LOGAND && node->kind != OP_LOGOR && node->kind != '!' &&
+             node->kind != '<' && node->kind != '>' && node->kind != OP_EQ &&
+             node->kind != OP_NE && node->kind != OP_LE && node->kind != OP_GE &&
+             !is_if_op(get_last_asm_line()))
+    {
+        if (node->ty && node->ty->size == 1)
+            emit("cpi       0");
+        else
+        {
+            emit("or        1(sp)");
+            pFrame->accVal = -1000;
+            clear_acc_var();
+        }
+        emit("if        z");
+    }
 }
 
 /*
@@ -1640,7 +2652,19 @@ static int emit_comp(char *usiginst, char *inst, Node *node) {
         else
             emit("ucomisd #xmm0, #xmm1");
     } else {
-        if (node->right->kind == AST_LITERAL)
+        if (node->right->kind == AST_LITERAL && node->left->ty->kind == KIND_PTR)
+        {
+            // A pointer is in ix, not acc
+            emit_expr(node->left);
+            emit("xchg      ra");
+            pFrame->raDestroyed = 1;
+            emit("ldx       %d", node->right->ival);
+            clear_ix_var();
+            emit("cpx       ra");
+            emit("if        %s", str);
+            return 0;
+        }
+        else if (node->right->kind == AST_LITERAL)
         {
             emit_expr(node->left);
             if (node->left->ty->kind == KIND_CHAR && node->right->ty->kind == KIND_CHAR)
@@ -1655,6 +2679,7 @@ static int emit_comp(char *usiginst, char *inst, Node *node) {
                 emit("stax      0(sp)");
                 emit("ads       -2");
                 pFrame->stackPos += 2;
+                mark_stack_operations(2);
                 emit_expr(node->right);
 
                 sprintf(lbl, "__cmpint%s", str);
@@ -1686,10 +2711,21 @@ static int emit_comp(char *usiginst, char *inst, Node *node) {
             emit_expr(node->left);
             emit_expr(node->right);
             pLine = get_last_asm_line();
-            pLine->pLine[4] = 'c';
-            pLine->pLine[5] = 'm';
-            pLine->pLine[6] = 'p';
-            pLine->pLine[7] = ' ';
+            if (pLine->op == ASM_LDA)
+            {
+                // cmp has no direct address form, so the right of a static
+                // frame or access var is swapped into 0(sp) with left
+                insert_asm_line_before(new_asm_line("    stax      0(sp)"), pLine);
+                emit("swap      0(sp)");
+                emit("cmp       0(sp)");
+                mark_stack_operations(1);
+            }
+            else
+                pLine->op = ASM_CMP;
+
+            // The load of right is now a cmp, so acc still has left
+            clear_acc_var();
+            pFrame->accVal = -1000;
             emit("if        %s", str);
         }
         else
@@ -1698,6 +2734,7 @@ static int emit_comp(char *usiginst, char *inst, Node *node) {
             emit("stax      0(sp)");
             emit("ads       -2");
             pFrame->stackPos += 2;
+            mark_stack_operations(2);
 
             emit_expr(node->right);
 
@@ -1771,13 +2808,15 @@ static void emit_binop_int_shift(Node *node) {
                 emit("swap      0(sp)");    // Restore LSB and save shift count
                 pFrame->lastSwapOptional = 0;
                 pFrame->pLastSwapLine = NULL;
+                char *loop = make_label();
+                emit_label(loop);
                 emit("dcx       0(sp)");    // Decrement shift count
                 emit("iftt      nc");       // If no underflow ...
                 if (node->kind == OP_SAL)
                     emit("shl16     1");    // Perform the shift ...
                 else
                     emit("shr16     1");
-                emit("br        -3");       // ... and branch to maybe shift again
+                emit("br        %s", loop); // ... and branch to maybe shift again
                 mark_stack_operations(2);
                 pFrame->accVal = -1000;
             }
@@ -1801,23 +2840,17 @@ static void emit_binop_int_shift(Node *node) {
             emit("amode     2");
 
         // Perform variable shift
+        char *loop = make_label();
+        emit_label(loop);
+        emit("dcx       0(sp)");
+        emit("iftt      nc");
         if (node->left->ty->kind == KIND_CHAR)
-        {
-            emit("dcx       0(sp)");
-            emit("iftt      nc");
             emit("%s", op);
-            emit("br        -3");
-        }
+        else if (node->kind == OP_SAL)
+            emit("shl16     1");
         else
-        {
-            emit("dcx       0(sp)");
-            emit("iftt      nc");
-            if (node->kind == OP_SAL)
-                emit("shl16     1");
-            else
-                emit("shr16     1");
-            emit("br        -3");
-        }
+            emit("shr16     1");
+        emit("br        %s", loop);
         pFrame->accVal = -1000;
 
         if (node->kind == OP_SAR)
@@ -1850,19 +2883,20 @@ static void emit_add(Node *node) {
         char modifier[2] = {0,};
 
         if (lvarIdx != -1)
-          offset = pFrame->lvars[lvarIdx].stackPos + pFrame->stackPos;
+          offset = pFrame->lvars[lvarIdx].stackPos;
         else
         {
           // See if it is a parameter
           lvarIdx = find_param_offset(node->left->varname);
           if (lvarIdx != -1)
           {
-            offset = pFrame->param[lvarIdx].stackPos + pFrame->stackPos;
+            offset = pFrame->param[lvarIdx].stackPos;
             modifier[0] = '$';
           }
         }
 
         emit("ldi       %d", node->right->ival);
+        emit("ldc       0");
         emit("add       %s%d(sp)", modifier, offset+pFrame->stackPos);
         pFrame->accVal = -1000;
         pFrame->pAsmLines->pPrev->stackRelative = 1;
@@ -1882,10 +2916,9 @@ static void emit_add(Node *node) {
             emit("ldi       %d", (node->right->ival >> 8) & 0xFF);
             emit("swap      0(sp)");        // 0(sp) now has MSB of literal
         }
-        else
-            emit("ldc       0");
 
         // Perform simple immediate add
+        emit("ldc       0");
         emit("adc       %d", node->right->ival & 0xFF);
 
         // Test for 16 bit add
@@ -1977,6 +3010,7 @@ static void emit_add(Node *node) {
         emit("stax      0(sp)");
         emit("ads       -2");
         pFrame->stackPos += 2;
+        mark_stack_operations(2);
         emit_expr(node->right);
         emit_jmp("__addint");
         emit_extern("__addint");
@@ -2033,7 +3067,7 @@ static void emit_sub(Node *node) {
         if (kind == AST_LVAR)
         {
             asm_line_t *pLine = get_last_asm_line();
-            if (strncmp(&pLine->pLine[4], "ldi", 3) != 0)
+            if (pLine->op != ASM_LDI)
                 emit("ldc       0");
             if (node->right->ty->isparam)
                 emit("sub       $%d(sp)", node->right->loff + pFrame->stackPos);
@@ -2056,43 +3090,36 @@ static void emit_sub(Node *node) {
         }
         else
         {
-            if (node->right->ty->issfr)
-            {
-                emit("stax      0(sp)");
-                emit("lda       %s", node->right->varname);
-                emit("ldc       0");        // Ensure C is clear
-                emit("sub       0(sp)");
-                mark_stack_operations(2);
+            // Unlike add, sub must keep left in acc and right in 0(sp)
+            emit("stax      0(sp)");
+            emit("lda       %s", node->right->varname);
+            emit("swap      0(sp)");        // Get left, save right
+            emit("ldc       0");            // Ensure C is clear
+            emit("sub       0(sp)");
+            mark_stack_operations(2);
 
-                // Test for 16-bit add
-                if (node->ty->kind == KIND_SHORT || node->ty->kind == KIND_INT)
-                {
-                    emit("stax      0(sp)");    // Save LSB
-                    emit("andi      0");        // Zero acc, keeping C flag
-                    emit("sub       1(sp)");    // Add zero + c to MSB
-                    emit("stax      1(sp)");    // Save MSB
-                    emit("ldax      0(sp)");    // Get LSB
-                }
-            }
-            else
+            // Test for 16-bit sub of an int var
+            if (!node->right->ty->issfr &&
+                (node->right->ty->kind == KIND_SHORT || node->right->ty->kind == KIND_INT))
             {
-                emit("stax      0(sp)");
-                emit("lda       %s", node->right->varname);
-                emit("ldc       0");        // Ensure C is clear
-                emit("sub       0(sp)");
-                mark_stack_operations(2);
+                emit("swap      1(sp)");    // Save LSB, get MSB
+                emit("ldx       %s", node->right->varname);
+                emit("sub       1(ix)");    // Sub MSB and borrow
+                emit("swap      1(sp)");    // Save MSB, get LSB
+                pFrame->lastSwapOptional = 0;
+                pFrame->pLastSwapLine = NULL;
+                set_ix_var(node->right->varname);
+            }
 
-                // Test for 16-bit add
-                if (node->right->ty->kind == KIND_SHORT || node->right->ty->kind == KIND_INT)
-                {
-                    emit("swap      1(sp)");    // Save LSB
-                    emit("ldx       %s", node->right->varname);
-                    emit("sub       1(ix)");    // Add zero + c to MSB
-                    emit("swap      1(sp)");    // Save MSB
-                    pFrame->lastSwapOptional = 0;
-                    pFrame->pLastSwapLine = NULL;
-                    set_ix_var(node->right->varname);
-                }
+            // Test for 16-bit sub of a char var
+            else if (node->ty->kind == KIND_SHORT || node->ty->kind == KIND_INT)
+            {
+                emit("stax      0(sp)");    // Save LSB
+                emit("ldi       0");        // Zero acc, keeping C flag
+                emit("swap      1(sp)");    // Get MSB
+                emit("sub       1(sp)");    // Sub zero + c from MSB
+                emit("stax      1(sp)");    // Save MSB
+                emit("ldax      0(sp)");    // Get LSB
             }
         }
         pFrame->accVal = -1000;
@@ -2103,6 +3130,7 @@ static void emit_sub(Node *node) {
         emit("stax      0(sp)");
         emit("ads       -2");
         pFrame->stackPos += 2;
+        mark_stack_operations(2);
         emit_expr(node->right);
         emit_jmp("__subint");
         emit_extern("__subint");
@@ -2177,6 +3205,11 @@ static void emit_binop_int_mult(Node *node) {
                 emit_jmp("__smulint");
                 emit_extern("__smulint");
             }
+
+            // Move the MSB of the product above the popped multiplicand
+            emit("swap      1(sp)");
+            emit("stax      3(sp)");
+            emit("swap      1(sp)");
             emit("ads       2");
             pFrame->stackPos -= 2;
         }
@@ -2286,6 +3319,7 @@ static void emit_binop_int_arith(Node *node) {
         }
         emit("stax      0(sp)");
         emit("ads       -2");
+        pFrame->stackPos += 2;
         mark_stack_operations(2);
 
         // Load dividend
@@ -2332,6 +3366,9 @@ static void emit_binop_int_arith(Node *node) {
                 emit_extern("__sremint");
             }
         }
+
+        // The library pops the divisor
+        pFrame->stackPos -= 2;
     }
 
     clear_ix_var();
@@ -2387,14 +3424,18 @@ static void emit_ret(int localArea, Type *ty, int raDestroyed) {
     int         lastWasLocalJal = 0;
     int         jalToLastLabel = 0;
     int         x;
-    char        lastLabel[256] = {0,};
+    char        lastLabel[1024] = {0,};
+    char        str[256];
 
     SAVE;
     if (gLastEmitWasRet)
     {
         //pFrame->retCount--;
         if (pFrame->retCount > 1)
-            sprintf(pFrame->pAsmLines->pPrev->pLine, "_L%s_ret:", pFrame->fname);
+        {
+            sprintf(str, "_L%s_ret:", pFrame->fname);
+            set_asm_text(pFrame->pAsmLines->pPrev, str);
+        }
         else
         {
             // Simply delete the last line
@@ -2411,13 +3452,13 @@ static void emit_ret(int localArea, Type *ty, int raDestroyed) {
         if (strlen(lastLabel) == 0)
         {
             // Test for jal after last label
-            if (strncmp(pLine->pLine, "    jal", 7) == 0)
+            if (pLine->op == ASM_JAL)
                 break;
 
             // Find first line with a label
-            if (strchr(pLine->pLine, ':') != NULL)
+            if (asm_line_has_colon(pLine))
             {
-                strcpy(lastLabel, pLine->pLine);
+                format_asm_line(pLine, lastLabel);
                 for (x = 0; x < strlen(lastLabel); x++)
                     if (lastLabel[x] == ':')
                     {
@@ -2429,9 +3470,9 @@ static void emit_ret(int localArea, Type *ty, int raDestroyed) {
         else
         {
             // Test for jal to the lastLabel
-            if (strncmp(pLine->pLine, "    jal", 7) == 0)
+            if (pLine->op == ASM_JAL && pLine->argKind == ARG_SYMBOL)
             {
-                if (strcmp(&pLine->pLine[14], lastLabel) == 0)
+                if (strcmp(asm_label_name(pLine->labelId), lastLabel) == 0)
                 {
                     jalToLastLabel = 1;
                     break;
@@ -2440,8 +3481,8 @@ static void emit_ret(int localArea, Type *ty, int raDestroyed) {
         }
 
         // Test if we rewound beyond the function entry
-        if (strstr(pLine->pLine, ".public") != NULL ||
-            strstr(pLine->pLine, ".extern") != NULL)
+        if (pLine->pText != NULL && (strstr(pLine->pText, ".public") != NULL ||
+            strstr(pLine->pText, ".extern") != NULL))
         {
             break;
         }
@@ -2457,18 +3498,14 @@ static void emit_ret(int localArea, Type *ty, int raDestroyed) {
         while (pLine != pFrame->pAsmLines)
         {
             // Skip any label lines
-            if (strchr(pLine->pLine, ':') == NULL)
+            if (!asm_line_has_colon(pLine))
             {
                 // Test for jal line
-                if (strncmp(pLine->pLine, "    jal", 7) == 0)
+                if (pLine->op == ASM_JAL && pLine->argKind == ARG_SYMBOL)
                 {
                     // Test if jump label is a local label
-                    for (x = 0; x < pFrame->nlocalLabels; x++)
-                        if (strcmp(&pLine->pLine[14], pFrame->localLabels[x]) == 0)
-                        {
-                            lastWasLocalJal = 1;
-                            break;
-                        }
+                    if (find_label_ref(pLine->labelId) != NULL)
+                        lastWasLocalJal = 1;
                 }
         
                 break;
@@ -2487,6 +3524,7 @@ static void emit_ret(int localArea, Type *ty, int raDestroyed) {
             if (ty->size > 1)
             {
                 // Returning multi-byte return value
+                int msbSaved = 0;
                 if (pFrame->retCount < 2)
                 {
                     asm_line_t *pLine = get_last_asm_line();
@@ -2495,30 +3533,24 @@ static void emit_ret(int localArea, Type *ty, int raDestroyed) {
                         char    str[32];
 
                         // Test for stax
-                        if (strcmp(&pLine->pLine[4], "stax      1(sp)") == 0)
+                        if (is_stack_arg(pLine, ASM_STAX, 1))
                         {
                             // Last opcode was store of MSB.  Simply change
                             // the offset to the return value offset
-                            sprintf(str, "    stax      %d(sp)", 1 + localArea + raDestroyed * 2);
-                            free(pLine->pLine);
-                            pLine->pLine = strdup(str);
+                            pLine->argVal = 1 + localArea + raDestroyed * 2;
+                            msbSaved = 1;
                         }
                         // Test for swap
-                        else if (strcmp(&pLine->pLine[4], "swap      1(sp)") == 0)
+                        else if (is_stack_arg(pLine, ASM_SWAP, 1))
                         {
                             // Insert store of MSB prior to swap with LSB
-                            asm_line_t *pStaxLine = (asm_line_t *) malloc(sizeof(asm_line_t));
                             sprintf(str, "    stax      %d(sp)", 1 + localArea + raDestroyed * 2);
-
-                            // Setup the asm line
-                            pStaxLine->pNext = NULL;
-                            pStaxLine->pPrev = NULL;
-                            pStaxLine->pLine = strdup(str);
-                            insert_asm_line_before(pStaxLine, pLine);
+                            insert_asm_line_before(new_asm_line(str), pLine);
+                            msbSaved = 1;
                         }
                     }
                 }
-                else
+                if (!msbSaved)
                 {
                     emit("swap      1(sp)");
                     emit("stax      %d(sp)", 1+localArea + raDestroyed * 2);
@@ -2665,7 +3697,11 @@ static void emit_addr(Node *node)
         break;
     case AST_STRUCT_REF:
         emit_addr(node->struc);
-        emit("add $%d, #rax", node->ty->offset);
+        if (node->ty->offset)
+        {
+            emit("adx       %d", node->ty->offset);
+            clear_ix_var();
+        }
         break;
     case AST_FUNCDESG:
         emit("ldx       %s", node->fname);
@@ -2676,27 +3712,26 @@ static void emit_addr(Node *node)
     }
 }
 
+/*
+==========================================================================================
+Copy a struct a byte at a time, with the source address in ra and the destination in ix
+==========================================================================================
+*/
 static void emit_copy_struct(Node *left, Node *right) {
-    push("rcx");
-    push("r11");
+    SAVE;
     emit_addr(right);
-    emit("mov #rax, #rcx");
+    emit("xchg      ra");
+    pFrame->raDestroyed = 1;
+    clear_ix_var();
     emit_addr(left);
-    int i = 0;
-    for (; i < left->ty->size; i += 8) {
-        emit("movq %d(#rcx), #r11", i);
-        emit("movq #r11, %d(#rax)", i);
-    }
-    for (; i < left->ty->size; i += 4) {
-        emit("movl %d(#rcx), #r11", i);
-        emit("movl #r11, %d(#rax)", i);
-    }
-    for (; i < left->ty->size; i++) {
-        emit("movb %d(#rcx), #r11", i);
-        emit("movb #r11, %d(#rax)", i);
+    for (int i = 0; i < left->ty->size; i++) {
+        emit("xchg      ra");
+        emit("ldax      %d(ix)", i);
+        emit("xchg      ra");
+        emit("stax      %d(ix)", i);
     }
-    pop("r11");
-    pop("rcx");
+    clear_ix_var();
+    clear_acc_var();
 }
 
 static int cmpinit(const void *x, const void *y) {
@@ -2725,11 +3760,12 @@ static void emit_fill_holes(Vector *inits, int off, int totalsize) {
         Node *node = buf[i];
         if (lastend < node->initoff)
         {
-            if (node->initval->ival == 0)
+            // Mark the init, not its value, which need not be a literal
+            if (node->initval->kind == AST_LITERAL && node->initval->ival == 0)
             {
                 emit_zero_filler(lastend + off, node->initoff + off +
                         node->initval->ty->size);
-                node->initval->initialized = true;
+                node->initialized = true;
             }
             else
                 emit_zero_filler(lastend + off, node->initoff + off);
@@ -2744,19 +3780,19 @@ static void emit_fill_holes(Vector *inits, int off, int totalsize) {
 Generate code for initialized variable declartion
 ==========================================================================================
 */
-static void emit_decl_init(Vector *inits, int off, int totalsize) {
+static void emit_decl_init(char *varname, Vector *inits, int off, int totalsize) {
     emit_fill_holes(inits, off, totalsize);
     for (int i = 0; i < vec_len(inits); i++) {
         Node *node = vec_get(inits, i);
         assert(node->kind == AST_INIT);
         bool isbitfield = (node->totype->bitsize > 0);
-        if (node->initval->initialized)
+        if (node->initialized)
             continue;
         if (node->initval->kind == AST_LITERAL && !isbitfield) {
             emit_save_literal(node->initval, node->totype, node->initoff + off);
         } else {
             emit_expr(node->initval);
-            emit_lsave(node->varname, node->totype, node->initoff + off);
+            emit_lsave(varname, node->totype, node->initoff + off);
         }
     }
 }
@@ -2781,11 +3817,14 @@ static void emit_post_inc_dec(Node *node, char *op) {
     SAVE;
     if (node->ty->ptr)
     {
+        int size = node->ty->ptr->size;
+
+        // Step by the size of the pointed to type
         emit_expr(node->operand);
         if (strcmp(op, "add") == 0)
-            emit("adx       1");
+            emit("adx       %d", size);
         else
-            emit("adx       -1");
+            emit("adx       %d", -size);
     }
     else
     {
@@ -2841,7 +3880,7 @@ static void emit_post_inc_dec(Node *node, char *op) {
             else
             {
                 // Global variable
-                emit("ldx       %s", n->slabel);
+                emit("ldx       %s", n->kind == AST_STRUCT_REF ? s->glabel : n->glabel);
                 clear_ix_var();
                 emit("%s       %d(ix)", xop, n->ty->offset);
                 if (n->ty->size > 1)
@@ -2878,6 +3917,20 @@ static void emit_post_inc_dec(Node *node, char *op) {
             }
             return;
         }
+        else if (n->kind == AST_DEREF && !n->ty->isaccess)
+        {
+            // Step the element in place, as storing the stepped value
+            // would load the address again over it
+            emit_expr(n->operand);
+            emit("%s       %d(ix)", xop, n->operand->ty->offset);
+            if (n->ty->size > 1)
+            {
+                emit("if        c");
+                emit("%s       %d(ix)", xop, n->operand->ty->offset + 1);
+            }
+            clear_acc_var();
+            return;
+        }
 
         else
         {
@@ -2901,6 +3954,15 @@ static void emit_post_inc_dec(Node *node, char *op) {
         }
     }
     emit_store(node->operand, NULL);
+
+    // The value of the expression is the pointer before the step
+    if (node->ty->ptr)
+    {
+        int size = node->ty->ptr->size;
+
+        emit("adx       %d", strcmp(op, "add") == 0 ? -size : size);
+        clear_ix_var();
+    }
 }
 
 static void emit_je(char *label) {
@@ -2915,7 +3977,6 @@ Add a local label line at the assembly
 static void emit_label(char *label) {
     label_ref_t *pRef;
 
-    pFrame->localLabels[pFrame->nlocalLabels++] = label;
     emit_noindent("%s:", label);
     if (!pFrame->preserveVars)
     {
@@ -2925,12 +3986,10 @@ static void emit_label(char *label) {
     pFrame->preserveVars = 0;
 
     // Create a label ref
-    pRef = (label_ref_t *) malloc(sizeof(label_ref_t));
+    pRef = get_label_ref(asm_label_id(label));
+    pRef->valid = 1;
     pRef->refCount = 0;
-    pRef->pNext = pFrame->pLabelRefs;
     pRef->pAsmLine = pFrame->pAsmLines->pPrev;
-    strcpy(pRef->label, label);
-    pFrame->pLabelRefs = pRef;
 }
 
 /*
@@ -3372,7 +4431,12 @@ no_lines:
                 ((kind == KIND_CHAR || kind == KIND_SHORT || kind == KIND_INT) &&
                  fmtChar == 'c'))
             {
-                push("a");
+                // Keep 0(sp) and 1(sp) free, as an int push does, so the
+                // MSB of the next arg does not land on this one
+                emit("stax      1(sp)");
+                emit("ads       -1");
+                pFrame->stackPos += 1;
+                mark_stack_operations(2);
                 r += 1;
             }
             else if (v->ty->kind == KIND_SHORT || v->ty->kind == KIND_INT ||
@@ -3383,6 +4447,7 @@ no_lines:
                 emit("stax      0(sp)");
                 emit("ads       -2");
                 pFrame->stackPos += 2;
+                mark_stack_operations(2);
                 r += 2;
             }
             else if (v->ty->kind == KIND_LONG)
@@ -3394,7 +4459,10 @@ no_lines:
             }
             else if (v->ty->kind == KIND_PTR || v->ty->kind == KIND_ARRAY)
             {
-                push("ix");
+                emit("stxx      0(sp)");
+                emit("ads       -2");
+                pFrame->stackPos += 2;
+                mark_stack_operations(2);
                 r += 2;
             }
         }
@@ -3515,9 +4583,18 @@ static void emit_decl(Node *node)
     if (!node->declinit)
         return;
 
+    // A local moved to the static frame
+    if (node->declvar->kind == AST_GVAR)
+    {
+        Node *init = vec_get(node->declinit, 0);
+        emit_expr(init->initval);
+        emit_gsave(node->declvar->glabel, node->declvar->ty, 0);
+        return;
+    }
+
     if (idx != -1)
         pFrame->lvars[idx].assigned = 1;
-    emit_decl_init(node->declinit, node->declvar->loff, node->declvar->ty->size);
+    emit_decl_init(node->declvar->varname, node->declinit, node->declvar->loff, node->declvar->ty->size);
 }
 
 static void emit_conv(Node *node)
@@ -3546,13 +4623,39 @@ static void emit_deref(Node *node)
     SAVE;
     printf("Emit DEFEF\n");
     emit_expr(node->operand);
-    emit_lload(node, node->operand->ty->ptr, "ix", 0);
+    emit_lload(node, node->operand->ty->ptr, "ix", node->operand->ty->offset);
     emit_load_convert(node->ty, node->operand->ty->ptr);
 }
 
+/*
+==========================================================================================
+Emit a probe label of a branch for -fprofile-generate.  The label is not a jump target,
+so what is known about acc and ix stays valid across it.  It is made public after the
+function, since emit_ret takes a .public line for the start of the function.
+==========================================================================================
+*/
+static void emit_probe(ProfSite *prof, char kind)
+{
+    char    *label = prof_label(prof, kind);
+
+    if (label == NULL)
+        return;
+    emit_noindent("%s:", label);
+    vec_push(pFrame->probes, label);
+}
+
 static void emit_ternary(Node *node)
 {
     SAVE;
+    ProfSite    *prof = NULL;
+
+    // Probe the branch once, should an AST pass have copied it
+    if (node->prof && !node->prof->emitted)
+    {
+        prof = node->prof;
+        prof->emitted = true;
+    }
+
     pFrame->isTernary++;
 
     // Test for "if (a)" syntax where a is 2-byte LVAR
@@ -3562,6 +4665,7 @@ static void emit_ternary(Node *node)
         pFrame->emitCompZero = 1;
     }
 
+    emit_probe(prof, 'c');
     emit_expr(node->cond);
     pFrame->emitCompZero = 0;
 
@@ -3602,7 +4706,17 @@ static void emit_ternary(Node *node)
         emit_je(ne);
         break;
     default:
-        if (node->cond->kind == AST_FUNCALL)
+        if (node->cond->ty->kind == KIND_PTR && node->cond->kind != AST_LVAR)
+        {
+            // Test the pointer in ix against zero
+            emit("stxx      0(sp)");
+            emit("ldax      0(sp)");
+            emit("or        1(sp)");
+            mark_stack_operations(2);
+            pFrame->accVal = -10000;
+            clear_acc_var();
+        }
+        else if (node->cond->kind == AST_FUNCALL)
         {
             if (node->cond->ty->size > 1)
                 emit("or        1(sp)");
@@ -3613,6 +4727,7 @@ static void emit_ternary(Node *node)
     }
 
     emit_jmp(ne);
+    emit_probe(prof, 't');
 
     if (node->then)
         emit_expr(node->then);
@@ -3647,7 +4762,9 @@ Emit a GOTO
 static void emit_goto(Node *node)
 {
     SAVE;
-    char        label[128];
+    char        sLine[1024];
+    char        *pOp;
+    int         labelId;
     int         labelFound = 0;
     asm_line_t  *pLine;
 
@@ -3656,8 +4773,7 @@ static void emit_goto(Node *node)
     if (!pFrame->isTernary && pFrame->lastSwapOptional)
     {
         // Test if the jump location performs a load of ACC prior to use
-        strcpy(label, &pFrame->pAsmLines->pPrev->pLine[14]);
-        strcat(label, ":");
+        labelId = pFrame->pAsmLines->pPrev->labelId;
         pLine = pFrame->pAsmLines->pNext;
         while (pLine != pFrame->pAsmLines)
         {
@@ -3665,7 +4781,8 @@ static void emit_goto(Node *node)
             // that either uses or changes Acc
             if (labelFound)
             {
-                if (isAccLoad(&pLine->pLine[4]))
+                pOp = strlen(format_asm_line(pLine, sLine)) > 4 ? &sLine[4] : "";
+                if (isAccLoad(pOp))
                 {
                     // We can delete the optional swap
                     delete_asm_line(pFrame->pLastSwapLine);
@@ -3673,7 +4790,7 @@ static void emit_goto(Node *node)
                     pFrame->lastSwapOptional = 0;
                     break;
                 }
-                else if (isAccUse(&pLine->pLine[4]))
+                else if (isAccUse(pOp))
                 {
                     // Last optional swap needed
                     pFrame->pLastSwapLine = NULL;
@@ -3683,7 +4800,7 @@ static void emit_goto(Node *node)
             }
             else
             {
-                if (strcmp(label, pLine->pLine) == 0)
+                if (pLine->kind == LINE_LABEL && pLine->labelId == labelId)
                     labelFound = 1;
             }
 
@@ -3718,43 +4835,13 @@ Reverse the if condition of the given line
 */
 static void reverse_if_comparison(asm_line_t *pLine)
 {
-    char        newComp[8];
-    char        newline[32];
-
     // Validate the last asm line was if
-    if (strncmp(&pLine->pLine[4], "if", 2) != 0)
+    if (!is_if_op(pLine) || pLine->argKind != ARG_COND)
         return;
 
-    // Test for eq
-    if (strcmp(&pLine->pLine[14], "eq") == 0)
-        strcpy(newComp, "ne");
-    else if (strcmp(&pLine->pLine[14], "ne") == 0)
-        strcpy(newComp, "eq");
-    else if (strcmp(&pLine->pLine[14], "nz") == 0)
-        strcpy(newComp, "z");
-    else if (strcmp(&pLine->pLine[14], "z") == 0)
-        strcpy(newComp, "nz");
-    else if (strcmp(&pLine->pLine[14], "lt") == 0)
-        strcpy(newComp, "ge");
-    else if (strcmp(&pLine->pLine[14], "gt") == 0)
-        strcpy(newComp, "le");
-    else if (strcmp(&pLine->pLine[14], "ge") == 0)
-        strcpy(newComp, "lt");
-    else if (strcmp(&pLine->pLine[14], "le") == 0)
-        strcpy(newComp, "gt");
-    else if (strcmp(&pLine->pLine[14], "slt") == 0)
-        strcpy(newComp, "sge");
-    else if (strcmp(&pLine->pLine[14], "sgt") == 0)
-        strcpy(newComp, "sle");
-    else if (strcmp(&pLine->pLine[14], "sge") == 0)
-        strcpy(newComp, "slt");
-    else if (strcmp(&pLine->pLine[14], "sle") == 0)
-        strcpy(newComp, "sgt");
-
-    pLine->pLine[14] = 0;
-    sprintf(newline, "%s%s", pLine->pLine, newComp);
-    free(pLine->pLine);
-    pLine->pLine = strdup(newline);
+    // A condition with no opposite is left as it is
+    if (asm_cond_inverse[pLine->argVal] != -1)
+        pLine->argVal = asm_cond_inverse[pLine->argVal];
 }
 
 /*
@@ -3774,11 +4861,10 @@ static void reverse_last_if_comparison(void)
 static int convert_if_to_iftt(asm_line_t *pLine)
 {
     // Validate the last asm line was if
-    if (strncmp(&pLine->pLine[4], "if", 2) != 0)
+    if (!is_if_op(pLine))
         return 0;
 
-    pLine->pLine[6] = 't';
-    pLine->pLine[7] = 't';
+    pLine->op = ASM_IFTT;
     return 1;
 }
 
@@ -3789,11 +4875,10 @@ static int convert_if_to_ifte(void)
     pLine = get_last_asm_line();
 
     // Validate the last asm line was if
-    if (strncmp(&pLine->pLine[4], "if", 2) != 0)
+    if (!is_if_op(pLine))
         return 0;
 
-    pLine->pLine[6] = 't';
-    pLine->pLine[7] = 'e';
+    pLine->op = ASM_IFTE;
     return 1;
 }
 
@@ -3812,7 +4897,7 @@ static void emit_logand(Node *node)
     emit_expr(node->left);
     maybe_emit_bool_compare(node->left);
     pLine = get_last_asm_line();
-    if (strcmp(&pLine->pLine[4], "if        z") != 0)
+    if (!is_cond(pLine, ASM_IF, COND_Z))
     {
         if (convert_if_to_iftt(pLine))
             emit("ldz       1");
@@ -3824,8 +4909,7 @@ static void emit_logand(Node *node)
     maybe_emit_bool_compare(node->right);
 
     pLine = get_last_asm_line();
-    if (strcmp(&pLine->pLine[4], "if        z") == 0 ||
-        strcmp(&pLine->pLine[4], "if        eq") == 0)
+    if (is_cond(pLine, ASM_IF, COND_Z) || is_cond(pLine, ASM_IF, COND_EQ))
     {
         delete_asm_line(pLine);
     }
@@ -3851,7 +4935,7 @@ static void emit_logor(Node *node)
     char *end = make_label();
     int  kind = node->left->kind;;
     asm_line_t  *pLine;
-    char  *comp;
+    int   comp;
     emit_expr(node->left);
     maybe_emit_bool_compare(node->left);
 
@@ -3869,9 +4953,9 @@ static void emit_logor(Node *node)
         // If the last comparison had an EQUAL, then we need to load z with 0
         // and convert the "if" to "iftt"
         pLine = get_last_asm_line();
-        comp = &pLine->pLine[14];
-        if (strcmp(comp, "z")  == 0 || strcmp(comp, "eq") == 0 ||
-            strstr(comp, "ge") != NULL || strstr(comp, "le") != NULL)
+        comp = pLine->argKind == ARG_COND ? pLine->argVal : -1;
+        if (comp == COND_Z || comp == COND_EQ || comp == COND_GE ||
+            comp == COND_SGE || comp == COND_LE || comp == COND_SLE)
         {
             // Convert the IF to IFTT
             convert_if_to_iftt(pLine);
@@ -3887,8 +4971,7 @@ static void emit_logor(Node *node)
     // If the last comparison had an EQUAL, then we need to load Z with 0
     // so the statement evaluates TRUE
     pLine = get_last_asm_line();
-    if (strcmp(&pLine->pLine[4], "if        z") == 0 ||
-        strcmp(&pLine->pLine[4], "if        eq") == 0)
+    if (is_cond(pLine, ASM_IF, COND_Z) || is_cond(pLine, ASM_IF, COND_EQ))
     {
         delete_asm_line(pLine);
     }
@@ -3943,6 +5026,7 @@ static void emit_bitand(Node *node)
             emit("stax      0(sp)");
             emit("ads       -2");
             pFrame->stackPos += 2;
+            mark_stack_operations(2);
             emit_expr(node->right);
 
             // Test if both left and right are 2 byte
@@ -3950,8 +5034,8 @@ static void emit_bitand(Node *node)
             {
                 // Test if we can easily remove loading of the MSB
                 asm_line_t *pL1 = get_last_asm_line();
-                if (strcmp(pL1->pPrev->pLine, "    stax      1(sp)") == 0 &&
-                    strncmp(pL1->pPrev->pPrev->pLine, "    ldax", 8) == 0)
+                if (is_stack_arg(pL1->pPrev, ASM_STAX, 1) &&
+                    pL1->pPrev->pPrev->op == ASM_LDAX)
                 {
                     delete_asm_line(pL1->pPrev->pPrev);
                     delete_asm_line(pL1->pPrev);
@@ -4039,9 +5123,15 @@ static void emit_bitor_xor(Node *node)
     
     emit_expr(node->left);
 
+    // A char side of an int op is widened, so its MSB is not that of
+    // whatever is next to it
+    if (node->ty->size == 2 && node->left->ty->size == 1)
+        emit_load_convert(node->ty, node->left->ty);
+
     // Test for right hand AST_LITERAL, AST_LVAR or AST_GVAR
     kind = node->right->kind;
-    if (kind == AST_LITERAL || kind == AST_LVAR || kind == AST_GVAR)
+    if (kind == AST_LITERAL || ((kind == AST_LVAR || kind == AST_GVAR) &&
+        node->right->ty->size == node->ty->size))
     {
         if (kind == AST_LITERAL)
         {
@@ -4051,6 +5141,7 @@ static void emit_bitor_xor(Node *node)
             mark_stack_operations(1);
             if (node->ty->kind == KIND_SHORT || node->ty->kind == KIND_INT)
             {
+                emit("stax      0(sp)");
                 emit("ldi       %d", (node->right->ival >> 8) & 0xFF);
                 emit("%-3s       1(sp)", op);
                 emit("stax      1(sp)");
@@ -4077,7 +5168,7 @@ static void emit_bitor_xor(Node *node)
         }
         else
         {
-            if (node->right->ty->issfr)
+            if (node->right->ty->issfr || node->right->ty->isaccess)
             {
                 emit("stax      0(sp)");
                 emit("lda       %s", node->right->varname);
@@ -4086,10 +5177,10 @@ static void emit_bitor_xor(Node *node)
             }
             else
             {
-                sprintf(varAddr, "&%s", node->left->varname);
+                sprintf(varAddr, "&%s", node->right->glabel);
                 if (strcmp(varAddr, pFrame->ixVar) != 0)        
                 {
-                    emit("ldx       %d", node->right->varname);
+                    emit("ldx       %s", node->right->glabel);
                     set_ix_var(varAddr);
                     pFrame->ixModified = 1;
                 }
@@ -4111,15 +5202,18 @@ static void emit_bitor_xor(Node *node)
         emit("stax      0(sp)");
         emit("ads       -2");
         pFrame->stackPos += 2;
+        mark_stack_operations(2);
         emit_expr(node->right);
+        if (node->ty->size == 2 && node->right->ty->size == 1)
+            emit_load_convert(node->ty, node->right->ty);
         emit("%-3s       2(sp)", op);
-        emit("sta       2(sp)");
         if (node->ty->kind == KIND_SHORT || node->ty->kind == KIND_INT)
         {
-            emit("lda       1(sp)");
+            emit("stax      2(sp)");
+            emit("ldax      1(sp)");
             emit("%-3s       3(sp)", op);
-            emit("sta       3(sp)");
-            emit("lda       2(sp)");
+            emit("stax      3(sp)");
+            emit("ldax      2(sp)");
         }
         emit("ads       2");
         pFrame->stackPos -= 2;
@@ -4194,8 +5288,7 @@ static void emit_assign(Node *node)
     char    varAddr[256];
 
     asm_line_t  *pLine;
-    if (node->left->ty->kind == KIND_STRUCT &&
-        node->left->ty->size > 8)
+    if (node->left->ty->kind == KIND_STRUCT)
     {
         emit_copy_struct(node->left, node->right);
     }
@@ -4293,7 +5386,7 @@ static void emit_assign(Node *node)
                 // to a BOOL type
                 emit_expr(node->right);
                 pLine = get_last_asm_line();
-                if (strncmp(&pLine->pLine[4], "if", 2) != 0)
+                if (!is_if_op(pLine))
                 {
                     emit("ldaz      z");
                 }
@@ -4302,10 +5395,7 @@ static void emit_assign(Node *node)
                     reverse_last_if_comparison();
 
                     // Convert the if to an ldac
-                    pLine->pLine[4] = 'l';
-                    pLine->pLine[5] = 'd';
-                    pLine->pLine[6] = 'a';
-                    pLine->pLine[7] = 'c';
+                    pLine->op = ASM_LDAC;
                 }
 
                 if (node->ty->kind != node->right->ty->kind)
@@ -4357,12 +5447,22 @@ static void emit_assign(Node *node)
                     else
                     {
                         Node *simpleLoad = NULL;
-                        if (node->right->kind == AST_LVAR)
+                        if (node->right->kind == AST_LVAR && node->left->kind == AST_DEREF)
                             simpleLoad = node->right;
                         else
                         {
                             emit_expr(node->right);
-                            if (node->left->kind == AST_DEREF ||
+                            if ((node->left->kind == AST_DEREF ||
+                                 node->left->kind == AST_STRUCT_REF) &&
+                                node->right->ty->kind == KIND_PTR)
+                            {
+                                // A pointer is in ix, which the address of the
+                                // store is loaded into, so it goes to 0(sp) and 1(sp)
+                                emit("stxx      0(sp)");
+                                mark_stack_operations(2);
+                                pFrame->accOnStack = 1;
+                            }
+                            else if (node->left->kind == AST_DEREF ||
                                 node->left->kind == AST_STRUCT_REF)
                             {
                                 emit("stax      0(sp)");
@@ -4373,6 +5473,9 @@ static void emit_assign(Node *node)
                         if (node->ty->kind != node->right->ty->kind)
                             emit_load_convert(node->ty, node->right->ty);
                         emit_store(node->left, simpleLoad);
+
+                        // A store to a struct field on the stack does not take it
+                        pFrame->accOnStack = 0;
                     }
                 }
             }
@@ -4414,6 +5517,33 @@ static void emit_computed_goto(Node *node)
     emit("jmp_ix");
 }
 
+/*
+==========================================================================================
+Emit a switch jump table.  The index is added to the address of a table of jumps, one
+word each, which jmp_ix enters.  Like other gotos they are jal until the peephole
+passes find the case close enough for a br.
+==========================================================================================
+*/
+static void emit_switch_table(Node *node)
+{
+    SAVE;
+    char    *table = make_label();
+
+    emit_expr(node->tableidx);
+    emit("ldx       %s", table);
+    emit("addax");
+    emit("jmp_ix");
+    set_ix_var("");
+    pFrame->ixDestroyed = 1;
+
+    emit_label(table);
+    for (int i = 0; i < vec_len(node->tablelabels); i++)
+    {
+        emit_jmp((char *) vec_get(node->tablelabels, i));
+        pFrame->pAsmLines->pPrev->tableEntry = 1;
+    }
+}
+
 /*
 ==========================================================================================
 Emit Expression
@@ -4470,6 +5600,7 @@ static int emit_expr(Node *node)
     case '=': emit_assign(node); return 0;
     case OP_LABEL_ADDR: emit_label_addr(node); return 0;
     case AST_COMPUTED_GOTO: emit_computed_goto(node); return 0;
+    case AST_SWITCH_TABLE: emit_switch_table(node); return 0;
     case AST_PRUNED: return 0;
     default:
         return emit_binop(node);
@@ -4704,7 +5835,8 @@ static void calc_func_params(Vector *params)
 {
     int xreg = 0;
     int arg = 2;
-    int off = 0;
+    // Args are pushed above the two scratch bytes of the caller
+    int off = 2;
 
     // Loop for all parameters
     pFrame->nparam = vec_len(params);
@@ -4753,21 +5885,19 @@ static void adjust_stack_for_ra_change(void)
 {
     asm_line_t  *pLine;
     asm_line_t  *pRef;
-    char        str[128];
 
     // Test if RA was changed in the routine
     if (pFrame->raDestroyed && pFrame->retCount > 0)
     {
         // We need to make the adjustment.  Add an "sra" instruction prior to the
         // "ads" line.
-        pLine = (asm_line_t *) malloc(sizeof(asm_line_t));
-        pLine->pLine = strdup("    sra");
+        pLine = new_asm_line("    sra");
 
         // Find the "ads" line
         pRef = pFrame->pAsmLines;
         while (pRef->pNext != pFrame->pAsmLines)
         {
-            if (strstr(pRef->pLine, "    ads  ") != NULL)
+            if (pRef->op == ASM_ADS)
                 break;
             pRef = pRef->pNext;
         }
@@ -4776,30 +5906,21 @@ static void adjust_stack_for_ra_change(void)
         
         // Add an 'lra' instruction at the end
         pRef = pFrame->pAsmLines->pPrev;
-        while (pRef != pFrame->pAsmLines && strncmp(pRef->pLine, "    ret", 8) != 0)
+        while (pRef != pFrame->pAsmLines && !(pRef->op == ASM_RET && pRef->argKind == ARG_NONE))
             pRef = pRef->pPrev;
         if (pRef != pFrame->pAsmLines)
         {
-            pLine = (asm_line_t *) malloc(sizeof(asm_line_t));
-            pLine->pLine = strdup("    lra");
+            pLine = new_asm_line("    lra");
 
             insert_asm_line_before(pLine, pRef);
         }
         
-        // Scan all lines and add 1 to any stack relative params (i.e. "%d(sp)")
+        // Scan all lines and add 2 to any stack relative params (i.e. "%d(sp)")
         pLine = pFrame->pAsmLines->pNext;
         while (pLine != pFrame->pAsmLines)
         {
-            if (pLine->pLine[14] == '$')
-            {
-                int     off = atoi(&pLine->pLine[15]);
-              
-                strncpy(str, pLine->pLine, 14);
-                str[14] = 0;
-                sprintf(&str[14], "$%d(sp)", off+1);
-                free(pLine->pLine);
-                pLine->pLine = strdup(str);
-            }
+            if (pLine->argKind == ARG_STACK && pLine->paramRel)
+                pLine->argVal += 2;
             
             // Next line
             pLine = pLine->pNext;
@@ -4812,14 +5933,8 @@ static void adjust_stack_for_ra_change(void)
         pLine = pFrame->pAsmLines->pNext;
         while (pLine != pFrame->pAsmLines)
         {
-            if (pLine->pLine[14] == '$')
-            {
-                strncpy(str, pLine->pLine, 14);
-                str[14] = 0;
-                strcat(&str[14], &pLine->pLine[15]);
-                free(pLine->pLine);
-                pLine->pLine = strdup(str);
-            }
+            if (pLine->argKind == ARG_STACK)
+                pLine->paramRel = 0;
       
             // Next line
             pLine = pLine->pNext;
@@ -4838,10 +5953,17 @@ static int remove_ads0_lines(void)
     asm_line_t  *pPrev;
     int         changes = 0;
 
-    pLine = pFrame->pAsmLines->pNext;
-    while (pLine != pFrame->pAsmLines)
+    pLine = peep_first(PEEP_ADS0);
+    while (peep_more(PEEP_ADS0, pLine))
     {
-        if (strstr(pLine->pLine, "ads       0") != NULL)
+        // Skip lines with no changes near them since this pass last ran
+        if (!peep_visit(PEEP_ADS0, pLine))
+        {
+            pLine = pLine->pNext;
+            continue;
+        }
+
+        if (pLine->op == ASM_ADS && pLine->argKind == ARG_IMM && pLine->argVal == 0)
         {
             // Delete the pLine, keeping our iteration valid
             pPrev = pLine->pPrev;
@@ -4857,6 +5979,67 @@ static int remove_ads0_lines(void)
     return changes;
 }
 
+/*
+==========================================================================================
+Move the char locals of a function to its static frame.  They become access
+variables, loaded and stored with direct lda / sta instead of SP relative ldax /
+stax, in a .<function>.overlay section the linker overlays with the frames of
+functions that are never active at the same time.  Locals whose address is taken
+stay on the stack.
+==========================================================================================
+*/
+static void alloc_static_frame(Node *func)
+{
+    char    *label;
+
+    for (int i = 0; i < vec_len(func->localvars); i++)
+    {
+        Node *v = vec_get(func->localvars, i);
+        Type *ty = v->ty;
+        if ((ty->kind != KIND_CHAR && ty->kind != KIND_BOOL) || v->addrtaken ||
+            v->lvarinit || ty->isaccess || ty->isregister || ty->isaccumulator)
+            continue;
+
+        // Locals of nested blocks may share a name
+        label = format("%s.%s", func->fname, v->varname);
+        for (int j = 0; j < vec_len(pFrame->staticVars); j++)
+            if (strcmp(((Node *) vec_get(pFrame->staticVars, j))->glabel, label) == 0)
+                label = format("%s.%s.%d", func->fname, v->varname, i);
+
+        ty->isaccess = true;
+        v->kind = AST_GVAR;
+        v->glabel = v->varname = label;
+        vec_push(pFrame->staticVars, v);
+    }
+}
+
+/*
+==========================================================================================
+Write the static frame of the function after its code
+==========================================================================================
+*/
+static void write_static_frame(void)
+{
+    char    str[1024];
+    char    label[1024];
+
+    output_line("");
+    sprintf(str, "    .section .%s.overlay", pFrame->fname);
+    output_line(str);
+    for (int i = 0; i < vec_len(pFrame->staticVars); i++)
+    {
+        Node *v = vec_get(pFrame->staticVars, i);
+        sprintf(str, "    .local %s", v->glabel);
+        output_line(str);
+        sprintf(label, "%s:", v->glabel);
+        sprintf(str, "%-30s", label);
+        output_line(str);
+        output_line("    .ds      1");
+    }
+    output_line("");
+    gpCurrSegment = "";
+}
+
 /*
 ==========================================================================================
 Generate the prolog code for a function.
@@ -4890,12 +6073,21 @@ static void emit_func_prologue(Node *func)
     }
 #endif
 
+    // Interrupt handlers can't have a static frame since they may run
+    // while any other function is active
+    if (static_frames && !func->ty->rettype->isisr)
+        alloc_static_frame(func);
+
     int size;
     int off = 0;
-    pFrame->nlvars = vec_len(func->localvars);
-    for (int i = 0; i < pFrame->nlvars; i++)
+    int i;
+    pFrame->nlvars = 0;
+    for (int n = 0; n < vec_len(func->localvars); n++)
     {
-        Node *v = vec_get(func->localvars, i);
+        Node *v = vec_get(func->localvars, n);
+        if (v->kind != AST_LVAR)
+            continue;
+        i = pFrame->nlvars++;
         size = v->ty->size;
         v->ty->isparam = false;
         pFrame->lvars[i].stackPos = off;
@@ -4919,6 +6111,7 @@ static void emit_func_prologue(Node *func)
     {
         Node *v = vec_get(func->params, i);
         v->loff += pFrame->localArea;
+        pFrame->param[i].stackPos += pFrame->localArea;
     }
 
     emit("ads       %d", -pFrame->localArea);
@@ -4928,80 +6121,31 @@ static void emit_func_prologue(Node *func)
 
 /*
 ==========================================================================================
-Count jal, br, bnz, bnc references to labels
-==========================================================================================
-*/
-void count_label_refs(void)
-{
-    asm_line_t  *pLine; 
-    label_ref_t *pRef;
-    char        *pS;
-
-    // Scan all lines seaching for iftt, ldz, jal sequence
-    pLine = pFrame->pAsmLines->pNext;
-    while (pLine != pFrame->pAsmLines)
-    {
-        pS = &pLine->pLine[4];
-
-        if (strncmp(pS, "jal", 3) == 0 ||
-            strncmp(pS, "br ", 3) == 0 ||
-            strncmp(pS, "bnc", 3) == 0 ||
-            strncmp(pS, "bnz", 3) == 0)
-        {
-            pRef = NULL;
-
-            // Test if branch / jump is non-numeric
-            if (!isdigit(pS[10]))
-            {
-                // Search for label in our references
-                pRef = pFrame->pLabelRefs;
-                while (pRef != NULL)
-                {
-                    if (strcmp(pRef->label, &pS[10]) == 0)
-                        break;
-                    pRef = pRef->pNext;
-                }
-            }
-
-            // Test if label found
-            if (pRef == NULL)
-            {
-                pRef = (label_ref_t *) malloc(sizeof(label_ref_t));
-                pRef->pNext = pFrame->pLabelRefs;
-                pRef->refCount = 0;
-                strcpy(pRef->label, &pS[10]);
-                pFrame->pLabelRefs = pRef;
-            }
-
-            if (pRef)
-                pRef->refCount++;
-        }
-
-        // Get the line
-        pLine = pLine->pNext;
-    }
-}
-
-/*
-==========================================================================================
-Find the specified label reference
+Count jal, br, bnz, bnc references to labels
 ==========================================================================================
 */
-label_ref_t * find_label_ref(char *pStr)
+void count_label_refs(void)
 {
+    asm_line_t  *pLine; 
     label_ref_t *pRef;
 
-    // Search through all label refs
-    pRef = pFrame->pLabelRefs;
-    while (pRef != NULL)
+    // Scan all lines seaching for iftt, ldz, jal sequence
+    pLine = pFrame->pAsmLines->pNext;
+    while (pLine != pFrame->pAsmLines)
     {
-        if (strcmp(pRef->label, pStr) == 0)
-            return pRef;
+        if ((pLine->op == ASM_JAL || pLine->op == ASM_BR ||
+             pLine->op == ASM_BNC || pLine->op == ASM_BNZ) &&
+            pLine->argKind == ARG_SYMBOL)
+        {
+            // Count it in the label's entry, adding one if new
+            pRef = get_label_ref(pLine->labelId);
+            pRef->valid = 1;
+            pRef->refCount++;
+        }
 
-        pRef = pRef->pNext;
+        // Get the line
+        pLine = pLine->pNext;
     }
-
-    return NULL;
 }
 
 /*
@@ -5013,42 +6157,17 @@ int optimize_unused_labels(void)
 {
     asm_line_t  *pL1; 
     asm_line_t  *pL2; 
-    char        *pStr;
-    char        jumpLabel[256];
     int         changes = 0;
-    int         x;
 
     // Scan all lines seaching for labels
     pL1 = pFrame->pAsmLines->pNext;
     while (pL1 != pFrame->pAsmLines)
     {
-        // Skip leading \n characters
-        for (x = 0; pL1->pLine[x] == '\n'; x++)
-            ;
-
         // Test if this line is a label
-        if (strncmp(&pL1->pLine[x], "_L", 2) == 0 && strchr(&pL1->pLine[x], ':') != NULL)
+        if (pL1->kind == LINE_LABEL && is_local_label(pL1->labelId))
         {
-            // Copy label and remove the ':'
-            strncpy(jumpLabel, &pL1->pLine[x], sizeof(jumpLabel));
-            jumpLabel[strlen(jumpLabel)-1] = 0;
-
-            // Scan through all lines and search for a jal / br to this label
-            pL2 = pFrame->pAsmLines->pNext;
-            while (pL2 != pFrame->pAsmLines)
-            {
-                if (pL2 != pL1 && (pStr = strstr(pL2->pLine, jumpLabel)) != NULL)
-                {
-                    if (strcmp(pStr, jumpLabel) == 0)
-                        break;
-                }
-
-                // Next asm line
-                pL2 = pL2->pNext;
-            }
-
-            // Test if we can remove this line
-            if (pL2 == pFrame->pAsmLines)
+            // Test if we can remove this line (no operand uses the label)
+            if (peep_label_uses(pL1->labelId) == 0)
             {
                 // Delete this unused label line
                 pL2 = pL1->pPrev;
@@ -5074,62 +6193,39 @@ int optimize_multi_labels(void)
 {
     asm_line_t  *pL1; 
     asm_line_t  *pL2; 
-    asm_line_t  *pL3; 
-    char        *pStr;
-    char        firstLabel[256];
-    char        secondLabel[256];
-    char        newLine[256];
     int         changes = 0;
-    int         x;
-    int         y;
 
-    // Scan all lines seaching for labels
-    pL1 = pFrame->pAsmLines->pNext;
-    while (pL1 != pFrame->pAsmLines)
+    // Scan the changed lines seaching for labels
+    pL1 = peep_first(PEEP_MULTI_LABELS);
+    while (peep_more(PEEP_MULTI_LABELS, pL1))
     {
-        // Skip leading \n characters
-        for (x = 0; pL1->pLine[x] == '\n'; x++)
-            ;
+        // Skip lines with no changes near them since this pass last ran
+        if (!peep_visit(PEEP_MULTI_LABELS, pL1))
+        {
+            pL1 = pL1->pNext;
+            continue;
+        }
 
         // Test if this line is a label
-        if (strncmp(&pL1->pLine[x], "_L", 2) == 0 && strchr(&pL1->pLine[x], ':') != NULL)
+        if (pL1->kind == LINE_LABEL && is_local_label(pL1->labelId))
         {
             // Get the next line to see if it is also a label
             pL2 = pL1->pNext;
 
-            // Skip leading \n characters
-            for (y = 0; pL2->pLine[y] == '\n'; y++)
-                ;
-
             // Test if next line is also a local label
-            if (strncmp(&pL2->pLine[y], "_L", 2) == 0 && strchr(&pL2->pLine[y], ':') != NULL)
+            if (pL2->kind == LINE_LABEL && is_local_label(pL2->labelId))
             {
-                // Copy the first label and remove the ':'
-                strncpy(firstLabel, &pL1->pLine[x], sizeof(firstLabel));
-                firstLabel[strlen(firstLabel)-1] = 0;
-
-                // Copy the second label and remove the ':'
-                strncpy(secondLabel, &pL2->pLine[y], sizeof(secondLabel));
-                secondLabel[strlen(secondLabel)-1] = 0;
-
-                // Scan through all lines and search for a jal / br to the second label
-                pL3 = pFrame->pAsmLines->pNext;
-                while (pL3 != pFrame->pAsmLines)
+                // Change each jal / br to the second label to jump to the
+                // first label.  This takes it off the second label's list.
+                if (pL2->labelId == pL1->labelId)
+                    changes += peep_label_uses(pL2->labelId);
+                else
                 {
-                    // Test for a jump to the second label
-                    if (pL3 != pL2 && (pStr = strstr(pL3->pLine, secondLabel)) != NULL)
+                    while (peep_label_uses(pL2->labelId) != 0)
                     {
-                        // Create new line with jump to firstLabel
-                        *pStr = 0;
-                        strncpy(newLine, pL3->pLine, sizeof(newLine));
-                        free(pL3->pLine);
-                        strcat(newLine, firstLabel);
-                        pL3->pLine = strdup(newLine);
+                        set_asm_symbol(peep.ppUsers[pL2->labelId], pL1->labelId);
                         changes++;
                     }
-
-                    // Next asm line
-                    pL3 = pL3->pNext;
                 }
                 
                 // Remove the pL2 label line
@@ -5154,24 +6250,25 @@ int optimize_label_jumps(void)
     asm_line_t  *pL1; 
     asm_line_t  *pL2; 
     label_ref_t *pLabelRef;
-    char        newLine[256];
-    char        *s1;
-    char        *s2;
     int         changes = 0;
 
     // Scan all lines seaching for iftt, ldz, jal sequence
     pL1 = pFrame->pAsmLines->pNext;
     while (pL1 != pFrame->pAsmLines)
     {
-        s1 = &pL1->pLine[4];
-        if (strncmp(s1, "jal       _L", 12) == 0 || strncmp(s1, "br        _L", 12) == 0 ||
-            strncmp(s1, "bnz       _L", 12) == 0 || strncmp(s1, "bz        _L", 12) == 0)
+        if (is_local_jump(pL1, ASM_JAL) || is_local_jump(pL1, ASM_BR) ||
+            is_local_jump(pL1, ASM_BNZ) || is_local_jump(pL1, ASM_BZ))
         {
             // Find the label reference
-            pLabelRef = find_label_ref(&s1[10]);
+            pLabelRef = find_label_ref(pL1->labelId);
 
             // Test if label is the very next line
-            if (pLabelRef->pAsmLine == pL1->pNext)
+            if (pLabelRef == NULL)
+            {
+                pL1 = pL1->pNext;
+                continue;
+            }
+            if (pLabelRef->pAsmLine == pL1->pNext && !pL1->tableEntry)
             {
                 pL2 = get_next_asm_line(pL1);
                 delete_asm_line(pL1);
@@ -5186,15 +6283,12 @@ int optimize_label_jumps(void)
                 pL2 = get_next_asm_line(pLabelRef->pAsmLine);
 
                 // Test if the next line is also a JAL 
-                s2 = &pL2->pLine[4];
-                if (strncmp(s2, "jal       _L", 12) == 0 || strncmp(s2, "br        _L", 12) == 0)
+                if (pL2 != NULL &&
+                    (is_local_jump(pL2, ASM_JAL) || is_local_jump(pL2, ASM_BR)))
                 {
                     // Change the label reference of the first jal to the
                     // reference of the 2nd
-                    pL1->pLine[14] = 0;
-                    sprintf(newLine, "%s%s", pL1->pLine, &pL2->pLine[14]);
-                    free(pL1->pLine);
-                    pL1->pLine = strdup(newLine);
+                    set_asm_symbol(pL1, pL2->labelId);
                     changes++;
                 }
             }
@@ -5217,18 +6311,23 @@ int optimize_orphaned_jal(void)
     asm_line_t  *pL1; 
     asm_line_t  *pL2; 
     asm_line_t  *pL3; 
-    char        *s2;
     int         changes = 0;
 
-    // Scan all lines seaching for "jal       _L"
-    pL1 = pFrame->pAsmLines->pNext;
-    while (pL1 != pFrame->pAsmLines)
+    // Scan the changed lines seaching for "jal       _L"
+    pL1 = peep_first(PEEP_ORPHANED_JAL);
+    while (peep_more(PEEP_ORPHANED_JAL, pL1))
     {
-        // Test if this line is a label
-        if (strncmp(&pL1->pLine[4], "jal       _L", 12) == 0 ||
-            strncmp(&pL1->pLine[4], "br        _L", 12) == 0)
+        // Skip lines with no changes near them since this pass last ran
+        if (!peep_visit(PEEP_ORPHANED_JAL, pL1))
+        {
+            pL1 = pL1->pNext;
+            continue;
+        }
+
+        // Test if this line is a label.  A jump table keeps all of its entries.
+        if ((is_local_jump(pL1, ASM_JAL) || is_local_jump(pL1, ASM_BR)) && !pL1->tableEntry)
         {
-            // Get the previous line to test for br or "jal       _L"
+            // Get the previous line to test for br or "jal       _L""
             pL2 = get_prev_asm_line(pL1);
             if (pL2 == NULL)
             {
@@ -5237,13 +6336,12 @@ int optimize_orphaned_jal(void)
             }
 
             // Test if previous line is br or jal to local label
-            s2 = &pL2->pLine[4];
-            if (strncmp(s2, "br ", 3) == 0 || strncmp(s2, "jal       _L", 12) == 0)
+            if ((pL2->op == ASM_BR && pL2->argKind != ARG_NONE) || is_local_jump(pL2, ASM_JAL))
             {
                 // We can remove this jal only if it is not part of an if,
                 // ifte or iftt
                 pL3 = get_prev_asm_line(pL2);
-                if (pL3 == NULL || strncmp(&pL3->pLine[4], "if", 2) == 0)
+                if (pL3 == NULL || is_if_op(pL3))
                 {
                     pL1 = pL1->pNext;
                     continue;
@@ -5251,8 +6349,7 @@ int optimize_orphaned_jal(void)
 
                 // Test next previous opcode for ifte or iftt
                 pL3 = get_prev_asm_line(pL3);
-                if (pL3 == NULL || strncmp(&pL3->pLine[4], "ifte", 4) == 0 ||
-                        strncmp(&pL3->pLine[4], "iftt", 4) == 0)
+                if (pL3 == NULL || pL3->op == ASM_IFTE || pL3->op == ASM_IFTT)
                 {
                     pL1 = pL1->pNext;
                     continue;
@@ -5272,6 +6369,23 @@ int optimize_orphaned_jal(void)
     return changes;
 }
 
+/*
+==========================================================================================
+Tests if the line is a branch or 'if' on the Z flag alone
+==========================================================================================
+*/
+static int tests_z_only(asm_line_t *pLine)
+{
+    if (pLine == NULL)
+        return 0;
+    if (pLine->op == ASM_BZ || pLine->op == ASM_BNZ)
+        return 1;
+    if (!is_if_op(pLine) || pLine->argKind != ARG_COND)
+        return 0;
+    return pLine->argVal == COND_EQ || pLine->argVal == COND_NE ||
+           pLine->argVal == COND_Z || pLine->argVal == COND_NZ;
+}
+
 /*
 ==========================================================================================
 Optimize cpi 0 that follows and, or, xor
@@ -5281,15 +6395,21 @@ int optimize_cpi_zero(void)
 {
     asm_line_t  *pL1; 
     asm_line_t  *pL2; 
-    char        *s2;
     int         changes = 0;
 
-    // Scan all lines seaching for "cpi       0"
-    pL1 = pFrame->pAsmLines->pNext;
-    while (pL1 != pFrame->pAsmLines)
+    // Scan the changed lines seaching for "cpi       0"
+    pL1 = peep_first(PEEP_CPI_ZERO);
+    while (peep_more(PEEP_CPI_ZERO, pL1))
     {
+        // Skip lines with no changes near them since this pass last ran
+        if (!peep_visit(PEEP_CPI_ZERO, pL1))
+        {
+            pL1 = pL1->pNext;
+            continue;
+        }
+
         // Test if this line is a label
-        if (strcmp(&pL1->pLine[4], "cpi       0") == 0)
+        if (pL1->op == ASM_CPI && pL1->argKind == ARG_IMM && pL1->argVal == 0)
         {
             // Get the previous line to test for and,or,xor
             pL2 = get_prev_asm_line(pL1);
@@ -5299,10 +6419,12 @@ int optimize_cpi_zero(void)
                 continue;
             }
 
-            // Test if previous line already updates flags
-            s2 = &pL2->pLine[4];
-            if (strncmp(s2, "and", 3) == 0 || strncmp(s2, "or ", 3) == 0 ||
-                strncmp(s2, "xor", 3) == 0 || strncmp(s2, "ldax", 4) == 0)
+            // Test if previous line already updates flags.  It only sets Z,
+            // so the test that follows must be of Z alone.
+            if ((pL2->op == ASM_AND || pL2->op == ASM_ANDI ||
+                 (pL2->op == ASM_OR && pL2->argKind != ARG_NONE) ||
+                 pL2->op == ASM_XOR || pL2->op == ASM_LDAX) &&
+                tests_z_only(get_next_asm_line(pL1)))
             {
                 // We can remove this cpi 0
                 delete_asm_line(pL1);
@@ -5328,6 +6450,8 @@ int optimize_extraneous_loc(void)
 {
     asm_line_t  *pL1; 
     asm_line_t  *pL2; 
+    char        sLine1[1024];
+    char        sLine2[1024];
     int         changes = 0;
 
     // Scan all lines seaching for "    .loc"
@@ -5335,23 +6459,26 @@ int optimize_extraneous_loc(void)
     while (pL1 != pFrame->pAsmLines)
     {
         // Test if this line is a .loc line
-        if (strncmp(pL1->pLine, "    .loc", 8) == 0)
+        if (pL1->kind == LINE_DIRECTIVE && strncmp(pL1->pText, "    .loc", 8) == 0)
         {
             // Get the line that is 2 lines after this
             pL2 = pL1->pNext->pNext;
 
             // Test if it is also a .loc line
-            if (strncmp(pL2->pLine, "    .loc", 8) == 0)
+            if (pL2->kind == LINE_DIRECTIVE && strncmp(pL2->pText, "    .loc", 8) == 0)
             {
+                format_asm_line(pL1->pNext, sLine1);
+                format_asm_line(pL2->pNext, sLine2);
+
                 // Test if one line has a declaration and the other has an 'if'
-                if (strstr(pL1->pNext->pLine, "if") != NULL ||
-                    strstr(pL1->pNext->pLine, "=") != NULL ||
-                    strstr(pL1->pNext->pLine, "(") != NULL)
+                if (strstr(sLine1, "if") != NULL ||
+                    strstr(sLine1, "=") != NULL ||
+                    strstr(sLine1, "(") != NULL)
                 {
                     // Test if the other line has int, char, etc.
-                    if (strstr(pL2->pNext->pLine, "int") != NULL ||
-                        strstr(pL2->pNext->pLine, "char") != NULL ||
-                        strstr(pL2->pNext->pLine, "float") != NULL)
+                    if (strstr(sLine2, "int") != NULL ||
+                        strstr(sLine2, "char") != NULL ||
+                        strstr(sLine2, "float") != NULL)
                     {
                         // We want to keep the first line
                         delete_asm_line(pL2->pNext);
@@ -5394,7 +6521,7 @@ int optimize_jal_to_br(void)
     while (pL1 != pFrame->pAsmLines)
     {
         // Test if this line is a "jal       _L" line
-        if (strncmp(&pL1->pLine[4], "jal       _L", 12) == 0)
+        if (is_local_jump(pL1, ASM_JAL))
         {
             // Get the jump distance
             distance = calc_jal_distance(pL1);
@@ -5403,9 +6530,8 @@ int optimize_jal_to_br(void)
             // convert to a br
             if (distance < 256 && distance > -257)
             {
-                pL1->pLine[4] = 'b';
-                pL1->pLine[5] = 'r';
-                pL1->pLine[6] = ' ';
+                pL1->op = ASM_BR;
+                peep_touch(pL1);
                 changes++;
             }
         }
@@ -5426,30 +6552,50 @@ int optimize_if_br(void)
 {
     asm_line_t  *pL1; 
     asm_line_t  *pL2; 
-    char        *s1;
-    char        *s2;
     int         changes = 0;
 
-    // Scan all lines seaching for "if "
-    pL1 = pFrame->pAsmLines->pNext;
-    while (pL1 != pFrame->pAsmLines)
+    // Scan the changed lines seaching for "if "
+    pL1 = peep_first(PEEP_IF_BR);
+    while (peep_more(PEEP_IF_BR, pL1))
     {
+        // Skip lines with no changes near them since this pass last ran
+        if (!peep_visit(PEEP_IF_BR, pL1))
+        {
+            pL1 = pL1->pNext;
+            continue;
+        }
+
         // Test if this line is a "if        nz" line
-        s1 = &pL1->pLine[4];
-        if (strcmp(s1, "if        nz") == 0 ||
-            strcmp(s1, "if        ne") == 0)
+        if (is_cond(pL1, ASM_IF, COND_NZ) || is_cond(pL1, ASM_IF, COND_NE))
+        {
+            // Get the next asm line
+            pL2 = get_next_asm_line(pL1);
+
+            // Test for br to local label
+            if (pL2 != NULL && is_local_jump(pL2, ASM_BR))
+            {
+                // Convert the br / jal to bnz
+                pL2->op = ASM_BNZ;
+                peep_touch(pL2);
+
+                // Delete the 'if'
+                delete_asm_line(pL1);
+                pL1 = pL2;
+                changes++;
+            }
+        }
+
+        else if (is_cond(pL1, ASM_IF, COND_Z) || is_cond(pL1, ASM_IF, COND_EQ))
         {
             // Get the next asm line
             pL2 = get_next_asm_line(pL1);
-            s2 = &pL2->pLine[4];
 
             // Test for br to local label
-            if (strncmp(s2, "br        _L", 12) == 0)
+            if (pL2 != NULL && is_local_jump(pL2, ASM_BR))
             {
                 // Convert the br / jal to bnz
-                pL2->pLine[4] = 'b';
-                pL2->pLine[5] = 'n';
-                pL2->pLine[6] = 'z';
+                pL2->op = ASM_BZ;
+                peep_touch(pL2);
 
                 // Delete the 'if'
                 delete_asm_line(pL1);
@@ -5458,26 +6604,251 @@ int optimize_if_br(void)
             }
         }
 
-        else if (strcmp(s1, "if        z") == 0 ||
-                 strcmp(s1, "if        eq") == 0)
+        // Next asm line
+        pL1 = pL1->pNext;
+    }
+
+    return changes;
+}
+
+/*
+==========================================================================================
+Convert notz conditional branch to just conditional ranch of opposite type
+==========================================================================================
+*/
+int optimize_notz_br(void)
+{
+    asm_line_t  *pL1; 
+    asm_line_t  *pL2; 
+    int         changes = 0;
+
+    // Scan the changed lines seaching for "ldz       ~z"
+    pL1 = peep_first(PEEP_NOTZ_BR);
+    while (peep_more(PEEP_NOTZ_BR, pL1))
+    {
+        // Skip lines with no changes near them since this pass last ran
+        if (!peep_visit(PEEP_NOTZ_BR, pL1))
+        {
+            pL1 = pL1->pNext;
+            continue;
+        }
+
+        // Test if this line is a "ldz       ~z" line
+        if (is_cond(pL1, ASM_LDZ, COND_NOTZ))
+        {
+            // Get the next asm line
+            pL2 = get_next_asm_line(pL1);
+
+            // Test for bz or bnz to local label
+            if (pL2 != NULL && (is_local_jump(pL2, ASM_BZ) || is_local_jump(pL2, ASM_BNZ)))
+            {
+                // Convert the bz to bnz or bnz to bz
+                pL2->op = pL2->op == ASM_BZ ? ASM_BNZ : ASM_BZ;
+                peep_touch(pL2);
+
+                // Delete the 'ldz       ~z'
+                delete_asm_line(pL1);
+                pL1 = pL2;
+                changes++;
+            }
+        }
+
+        else if (is_cond(pL1, ASM_IF, COND_Z) || is_cond(pL1, ASM_IF, COND_EQ))
         {
             // Get the next asm line
             pL2 = get_next_asm_line(pL1);
-            s2 = &pL2->pLine[4];
 
             // Test for br to local label
-            if (strncmp(s2, "br        _L", 12) == 0)
+            if (pL2 != NULL && is_local_jump(pL2, ASM_BR))
             {
                 // Convert the br / jal to bnz
-                pL2->pLine[4] = 'b';
-                pL2->pLine[5] = 'z';
-                pL2->pLine[6] = ' ';
+                pL2->op = ASM_BZ;
+                peep_touch(pL2);
+
+                // Delete the 'if'
+                delete_asm_line(pL1);
+                pL1 = pL2;
+                changes++;
+            }
+        }
+
+        // Next asm line
+        pL1 = pL1->pNext;
+    }
+
+    return changes;
+}
+
+/*
+==========================================================================================
+Convert bz around br to bnz, etc.  Also "if cc / br L1 / br L2 / L1:" to
+"if !cc / br L2 / L1:".
+==========================================================================================
+*/
+int optimize_bz_br(void)
+{
+    asm_line_t  *pL1; 
+    asm_line_t  *pL2; 
+    asm_line_t  *pL3; 
+    label_ref_t *pLabelRef;
+    int         changes = 0;
+
+    // Scan the changed lines seaching for "bz" or "bnz"
+    pL1 = peep_first(PEEP_BZ_BR);
+    while (peep_more(PEEP_BZ_BR, pL1))
+    {
+        // Skip lines with no changes near them since this pass last ran
+        if (!peep_visit(PEEP_BZ_BR, pL1))
+        {
+            pL1 = pL1->pNext;
+            continue;
+        }
+
+        // Test if this line is a bz / bnz
+        if ((pL1->op == ASM_BZ || pL1->op == ASM_BNZ) && pL1->argKind == ARG_SYMBOL)
+        {
+            // Get the next asm line
+            pL2 = get_next_asm_line(pL1);
+
+            // Test for bz or bnz to local label
+            if (pL2 != NULL && pL2->op == ASM_BR && pL2->argKind != ARG_NONE)
+            {
+                // Get pointer to the label
+                pLabelRef = find_label_ref(pL1->labelId);
+
+                // Test if line after br is this label
+                if (pLabelRef != NULL && pL2->pNext == pLabelRef->pAsmLine)
+                {
+                    // Convert the br to bnz/bz (opposite of what was there
+                    pL2->op = pL1->op == ASM_BZ ? ASM_BNZ : ASM_BZ;
+                    peep_touch(pL2);
+
+                    // Delete the "bz" / "bnz"
+                    delete_asm_line(pL1);
+                    pL1 = pL2;
+                    changes++;
+                }
+            }
+        }
+
+        // Test for an if around a br
+        else if (pL1->op == ASM_IF && pL1->argKind == ARG_COND &&
+                 asm_cond_inverse[pL1->argVal] != -1)
+        {
+            pL2 = get_next_asm_line(pL1);
+            pL3 = get_next_asm_line(pL2);
+            if (pL3 != NULL && is_local_jump(pL2, ASM_BR) && !pL2->tableEntry &&
+                is_local_jump(pL3, ASM_BR) && !pL3->tableEntry)
+            {
+                // Test if the line after the second br is the first one's label
+                pLabelRef = find_label_ref(pL2->labelId);
+                if (pLabelRef != NULL && pLabelRef->pAsmLine == get_next_asm_line(pL3))
+                {
+                    pL1->argVal = asm_cond_inverse[pL1->argVal];
+                    peep_touch(pL1);
+
+                    // Delete the br to the label
+                    delete_asm_line(pL2);
+                    changes++;
+                }
+            }
+        }
+
+        // Next asm line
+        pL1 = pL1->pNext;
+    }
+
+    return changes;
+}
+
+/*
+==========================================================================================
+Remove sra / lra if funciton no longer uses jal or swap ra after other optimizaitons.
+==========================================================================================
+*/
+int optimize_sra_lra(void)
+{
+    asm_line_t  *pL1; 
+    asm_line_t  *pL2; 
+    asm_line_t  *pSra; 
+    asm_line_t  *pLine;
+    int         raChangeCount;
+    int         changes = 0;
+
+    // Scan all lines seaching for "sra"
+    pL1 = pFrame->pAsmLines->pNext;
+    pSra = NULL;
+    raChangeCount = 0;
+
+    while (pL1 != pFrame->pAsmLines)
+    {
+        // Test if this line is an "sra" line
+        if (pL1->op == ASM_SRA && pL1->argKind == ARG_NONE)
+            pSra = pL1;
+
+        else if (pL1->op == ASM_JAL)
+            raChangeCount++;
+
+        else if ((pL1->op == ASM_SWAP || pL1->op == ASM_XCHG) &&
+                 pL1->argKind == ARG_SYMBOL &&
+                 strcmp(asm_label_name(pL1->labelId), "ra") == 0)
+            raChangeCount++;
+
+        else if (pL1->op == ASM_XCHG_RA)
+            raChangeCount++;
+
+        else if (pL1->op == ASM_MUL || pL1->op == ASM_MULU)
+            raChangeCount++;
+
+        // When we find the lra, decide if we can remove both it and the 
+        // associated sra depending if any raChange opcodes found
+        else if (pL1->op == ASM_LRA && pL1->argKind == ARG_NONE && pSra != NULL)
+        {
+            // If no raChange opcodes encountered, do processing
+            if (raChangeCount == 0)
+            {
+                // Delete the sra line
+                delete_asm_line(pSra);
+
+                // Test for code to save 16-bit return value on stack
+                if (pL1->pPrev->op == ASM_ADS &&
+                    (pL1->pPrev->pPrev->op == ASM_SWAP || pL1->pPrev->pPrev->op == ASM_SWAPI) &&
+                    pL1->pPrev->pPrev->pPrev->op == ASM_STAX)
+                {
+                    // We need to subtract 2 from the storage address since we
+                    // are removing 2 bytes of stack space usage by removing
+                    // the sra / lra opcodes
+                    pL2 = pL1->pPrev->pPrev->pPrev;
+                    pL2->argVal -= 2;
+                    peep_touch(pL2);
+                }
+
+                // Skip to the 'ret' opcode because we will delete this lra line
+                pL1 = pL1->pNext;
+
+                // Delete the 'lra' line
+                delete_asm_line(pL1->pPrev);
+
+                // Now we must adjust any stack relative variables because
+                // we just changed the stack by 2.
+                pLine = pFrame->pAsmLines->pNext;
+                while (pLine != pFrame->pAsmLines)
+                {
+                    if (pLine->argKind == ARG_STACK && pLine->paramRel)
+                    {
+                        pLine->argVal -= 2;
+                        peep_touch(pLine);
+                    }
+                    
+                    // Next line
+                    pLine = pLine->pNext;
+                }
 
-                // Delete the 'if'
-                delete_asm_line(pL1);
-                pL1 = pL2;
                 changes++;
             }
+
+            pSra = NULL;
+            raChangeCount = 0;
         }
 
         // Next asm line
@@ -5489,71 +6860,160 @@ int optimize_if_br(void)
 
 /*
 ==========================================================================================
-Convert notz conditional branch to just conditional ranch of opposite type
+Optimize iftt, ldz, jal code generated by LOGAND and LOGOR 
 ==========================================================================================
 */
-int optimize_notz_br(void)
+int optimize_logand_logor_iftt(void)
 {
     asm_line_t  *pL1; 
     asm_line_t  *pL2; 
-    char        *s1;
-    char        *s2;
+    asm_line_t  *pL3; 
+    asm_line_t  *pLt; 
+    asm_line_t  *pLt2; 
+    label_ref_t *pLabelRef;
+    int         loadZero;
+    int         jumpLabel;
+    int         resolved;
+    int         substFound;
     int         changes = 0;
 
-    // Scan all lines seaching for "ldz       ~z"
+    // Scan all lines seaching for iftt, ldz, jal sequence
     pL1 = pFrame->pAsmLines->pNext;
     while (pL1 != pFrame->pAsmLines)
     {
-        // Test if this line is a "ldz       ~z" line
-        s1 = &pL1->pLine[4];
-        if (strcmp(s1, "ldz       ~z") == 0)
+        // Get the next 2 lines
+        pL2 = get_next_asm_line(pL1);
+        pL3 = get_next_asm_line(pL2);
+
+        if (pL2 == NULL || pL3 == NULL)
+            break;
+
+        // Test for our sequence
+        if (pL1->op == ASM_IFTT && pL2->op == ASM_LDZ &&
+            (pL3->op == ASM_JAL || (pL3->op == ASM_BR && pL3->argKind != ARG_NONE)))
         {
-            // Get the next asm line
-            pL2 = get_next_asm_line(pL1);
-            s2 = &pL2->pLine[4];
+            // Found one!
+            jumpLabel = pL3->argKind == ARG_SYMBOL ? pL3->labelId : 0;
+            if ((pL2->argKind == ARG_IMM && pL2->argVal == 1) || is_cond(pL2, ASM_LDZ, COND_Z))
+                loadZero = 1;
+            else
+                loadZero = 0;
 
-            // Test for bz or bnz to local label
-            if (strncmp(s2, "bz        _L", 12) == 0 ||
-                strncmp(s2, "bnz       _L", 12) == 0)
+            resolved = 0;
+            substFound = 0;
+            pLt = pL3;
+            while (!resolved)
             {
-                // Convert the bz to bnz or bnz to bz
-                if (pL2->pLine[5] == 'z')
+                // Scan forward looking for the jumpLabel
+                pLt = find_label_after(jumpLabel, pLt);
+                
+                // Validate label found
+                if (!pLt)
+                    break;
+
+                // Get next line after the label line
+                pLt2 = get_next_asm_line(pLt);        
+                // Skip any additional labels
+                while (pLt2 != NULL && is_unindented(pLt2))
+                    pLt2 = get_next_asm_line(pLt2);
+                if (!pLt2)
+                    break;
+
+                // Test for "if        z" or "if        nz" line
+                if ((is_cond(pLt2, ASM_IF, COND_Z) || is_cond(pLt2, ASM_IF, COND_NZ)) &&
+                    pLt2->pNext->op == ASM_JAL)
                 {
-                    pL2->pLine[5] = 'n';
-                    pL2->pLine[6] = 'z';
+                    // Found a substitution!
+                    substFound = 1;
+
+                    // Test if this is a repeated hop to the next label
+                    if ((pLt2->argVal == COND_Z && loadZero) || 
+                        (pLt2->argVal != COND_Z && !loadZero))
+                    {
+                        // Setup to jump to the next label
+                        jumpLabel = pLt2->pNext->argKind == ARG_SYMBOL ? pLt2->pNext->labelId : 0;
+                        continue;
+                    }
+                    else
+                    {
+                        // We need to move or add a label after the pLt2->pNext jal,
+                        // change the original pL3 to jump there, and delete the
+                        // ldz line.  First get the label reference
+                        pLabelRef = find_label_ref(jumpLabel);
+                        if (pLabelRef != NULL && pLabelRef->refCount == 1 && pLabelRef->pAsmLine != NULL)
+                        {
+                            asm_line_t *pLbl = pLabelRef->pAsmLine;
+
+                            // We can simply move the label.  Remove from list
+                            peep_unlink(pLbl);
+                            pLbl->pPrev->pNext = pLbl->pNext;
+                            pLbl->pNext->pPrev = pLbl->pPrev;
+
+                            // And re-insert 
+                            insert_asm_line_before(pLbl, pLt2->pNext->pNext);
+                        }
+                        else
+                        {
+                            char    name[256];
+
+                            // Replace the pL3 jump label
+                            snprintf(name, sizeof(name), "%sb", asm_label_name(jumpLabel));
+        emit("//here");
+                            pL3->op = ASM_JAL;
+                            set_asm_symbol(pL3, asm_label_id(name));
+
+                            // Insert a new label
+                            insert_asm_line_before(new_label_line(pL3->labelId), pLt2->pNext->pNext);
+                        }
+
+                        // Delete the ldz line
+                        delete_asm_line(pL2);
+
+                        // Change the iftt to just an if
+                        pL1->op = ASM_IF;
+                        peep_touch(pL1);
+                        
+                        changes++;
+                        resolved = 1;
+                    }
                 }
-                else
+                else if (substFound)
                 {
-                    pL2->pLine[5] = 'z';
-                    pL2->pLine[6] = ' ';
-                }
+                    // Remove reference to the label
+                    pLabelRef = pL3->argKind == ARG_SYMBOL ? find_label_ref(pL3->labelId) : NULL;
+                    if (pLabelRef && pLabelRef->refCount)
+                    {
+                        pLabelRef->refCount--;
+                        if (pLabelRef->refCount == 0)
+                            delete_asm_line(pLabelRef->pAsmLine);
+                    }
 
-                // Delete the 'ldz       ~z'
-                delete_asm_line(pL1);
-                pL1 = pL2;
-                changes++;
-            }
-        }
+                    // Change the L3 line to jump to the new label
+                    pL3->op = ASM_JAL;
+                    set_asm_symbol(pL3, jumpLabel);
 
-        else if (strcmp(s1, "if        z") == 0 ||
-                 strcmp(s1, "if        eq") == 0)
-        {
-            // Get the next asm line
-            pL2 = get_next_asm_line(pL1);
-            s2 = &pL2->pLine[4];
+                    // Increment the ref count of the label we are jumping to
+                    pLabelRef = find_label_ref(jumpLabel);
+                    if (pLabelRef)
+                        pLabelRef->refCount++;
 
-            // Test for br to local label
-            if (strncmp(s2, "br        _L", 12) == 0)
-            {
-                // Convert the br / jal to bnz
-                pL2->pLine[4] = 'b';
-                pL2->pLine[5] = 'z';
-                pL2->pLine[6] = ' ';
+                    // Delete the "ldz" line
+                    delete_asm_line(pL2);
 
-                // Delete the 'if'
-                delete_asm_line(pL1);
-                pL1 = pL2;
-                changes++;
+                    // Change the iftt to just an if
+                    pL1->op = ASM_IF;
+                    peep_touch(pL1);
+                    changes++;
+
+                    // Advance the pL1 pointer
+                    pL1 = pL3;
+
+                    // Perform the substitution to the final label
+                    resolved = 1;
+                }
+                else
+                    // No changes
+                    break;
             }
         }
 
@@ -5566,57 +7026,58 @@ int optimize_notz_br(void)
 
 /*
 ==========================================================================================
-Convert bz around br to bnz, etc.
+Optimize shr, shr, andi 1, if z
 ==========================================================================================
 */
-int optimize_bz_br(void)
+int optimize_struct_masking(void)
 {
     asm_line_t  *pL1; 
     asm_line_t  *pL2; 
-    label_ref_t *pLabelRef;
-    char        *s1;
-    char        *s2;
+    asm_line_t  *pL3; 
+    int         shrCount = 0;
     int         changes = 0;
 
-    // Scan all lines seaching for "bz" or "bnz"
+    // Scan all lines seaching for shr, andi, if
     pL1 = pFrame->pAsmLines->pNext;
     while (pL1 != pFrame->pAsmLines)
     {
-        // Test if this line is a bz / bnz
-        s1 = &pL1->pLine[4];
-        if (strncmp(s1, "bz ", 3) == 0 || strncmp(s1, "bnz", 3) == 0)
+        // Get the next 2 lines
+        pL2 = get_next_asm_line_no_label(pL1);
+        pL3 = get_next_asm_line_no_label(pL2);
+
+        if (pL2 == NULL || pL3 == NULL)
+            break;
+
+        // Test for our sequence
+        if (pL1->op == ASM_SHR && pL1->argKind == ARG_NONE && pL2->op == ASM_ANDI &&
+            (is_cond(pL3, ASM_IF, COND_Z) || is_cond(pL3, ASM_IF, COND_NZ)))
         {
-            // Get the next asm line
-            pL2 = get_next_asm_line(pL1);
-            s2 = &pL2->pLine[4];
+            int     andVal; 
 
-            // Test for bz or bnz to local label
-            if (strncmp(s2, "br ", 3) == 0)
-            {
-                // Get pointer to the label
-                pLabelRef = find_label_ref(&s1[10]);
+            // We can remove the shr opcodes and just shift the andi value
+            // left for the comparison
+            while (pL2->pPrev->op == ASM_SHR && pL2->pPrev->argKind == ARG_NONE)
+                delete_asm_line(pL2->pPrev);
 
-                // Test if line after br is this label
-                if (pL2->pNext == pLabelRef->pAsmLine)
-                {
-                    // Convert the br to bnz/bz (opposite of what was there
-                    if (s1[1] == 'z')
-                    {
-                        s2[1] = 'n';
-                        s2[2] = 'z';
-                    }
-                    else
-                        s2[1] = 'z';
+            andVal = asm_arg_int(pL2);
 
-                    // Delete the "bz" / "bnz"
-                    delete_asm_line(pL1);
-                    pL1 = pL2;
-                    changes++;
-                }
-            }
+            pL2->pText = NULL;
+            pL2->argKind = ARG_IMM;
+            pL2->argVal = andVal << (shrCount + 1);
+            peep_touch(pL2);
+
+            changes++;
+
+            pL1 = pL3;
+        }
+        else
+        {
+            if (pL1->op == ASM_SHR && pL1->argKind == ARG_NONE)
+                shrCount++;
+            else
+                shrCount = 0;
         }
 
-        // Next asm line
         pL1 = pL1->pNext;
     }
 
@@ -5625,96 +7086,131 @@ int optimize_bz_br(void)
 
 /*
 ==========================================================================================
-Remove sra / lra if funciton no longer uses jal or swap ra after other optimizaitons.
+Optimize shr, shr, andi 1, if z
 ==========================================================================================
 */
-int optimize_sra_lra(void)
+int optimize_for_iftt(void)
 {
     asm_line_t  *pL1; 
     asm_line_t  *pL2; 
-    asm_line_t  *pSra; 
-    asm_line_t  *pLine;
-    int         raChangeCount;
-    int         stackOffset;
-    char        *s1;
+    asm_line_t  *pL3; 
+    int         jumpLabel;
     int         changes = 0;
 
-    // Scan all lines seaching for "sra"
-    pL1 = pFrame->pAsmLines->pNext;
-    pSra = NULL;
-    raChangeCount = 0;
-
-    while (pL1 != pFrame->pAsmLines)
+    // Scan the changed lines seaching for if, jal
+    pL1 = peep_first(PEEP_FOR_IFTT);
+    while (peep_more(PEEP_FOR_IFTT, pL1))
     {
-        // Test if this line is an "sra" line
-        s1 = &pL1->pLine[4];
-        if (strcmp(s1, "sra") == 0)
-            pSra = pL1;
-
-        else if (strncmp(s1, "jal", 3) == 0)
-            raChangeCount++;
+        // Skip lines with no changes near them since this pass last ran
+        if (!peep_visit(PEEP_FOR_IFTT, pL1))
+        {
+            pL1 = pL1->pNext;
+            continue;
+        }
 
-        else if (strcmp(s1, "swap      ra") == 0)
-            raChangeCount++;
+        // Get the next 2 lines
+        pL2 = get_next_asm_line_no_label(pL1);
 
-        else if (strncmp(s1, "mul", 3) == 0)
-            raChangeCount++;
+        if (pL2 == NULL)
+            break;
 
-        // When we find the lra, decide if we can remove both it and the 
-        // associated sra depending if any raChange opcodes found
-        else if (strcmp(s1, "lra") == 0 && pSra != NULL)
+        // Test for our sequence
+        if (pL1->op == ASM_IF && pL1->argKind != ARG_NONE &&
+            (pL2->op == ASM_JAL || (pL2->op == ASM_BR && pL2->argKind != ARG_NONE)))
         {
-            // If no raChange opcodes encountered, do processing
-            if (raChangeCount == 0)
+            // Get the jump label
+            jumpLabel = pL2->argKind == ARG_SYMBOL ? pL2->labelId : 0;
+
+            // Get next line after the jump
+            pL3 = get_next_asm_line(pL2);
+            if (!pL3)
+                break;
+            if (pL3->kind == LINE_LABEL && pL3->labelId == jumpLabel)
             {
-                // Delete the sra line
-                delete_asm_line(pSra);
+                // Jump to next line???  That means neither the if nor the jal are needed
+
+                pL1 = pL2;
+                continue;
+            }
+
+            // A label before _LBL, such as a -fprofile-generate probe, can't
+            // be in a predicated block
+            if (pL3->kind == LINE_LABEL)
+            {
+                pL1 = pL1->pNext;
+                continue;
+            }
+            
+            // Get the line two lines after the jal and test if it is the label
+            pL3 = get_next_asm_line(pL3);
+            if (!pL3)
+                break;
+            if (pL3->kind == LINE_LABEL && pL3->labelId == jumpLabel)
+            {
+                // So we found this:
+                //
+                // if       cond
+                // jal      _LBL
+                // someop
+                // _LBL:  
+                //
+                // We can reverse the if condition, delete the jal and let
+                // someop be the target of the reversed if condition.
+                reverse_if_comparison(pL1);
+                peep_touch(pL1);
 
-                // Test for code to save 16-bit return value on stack
-                if (strncmp(&pL1->pPrev->pLine[4], "ads", 3) == 0 &&
-                    strncmp(&pL1->pPrev->pPrev->pLine[4], "swap", 4) == 0 &&
-                    strncmp(&pL1->pPrev->pPrev->pPrev->pLine[4], "stax", 4) == 0)
-                {
-                    // We need to subtract 2 from the storage address since we
-                    // are removing 2 bytes of stack space usage by removing
-                    // the sra / lra opcodes
-                    pL2 = pL1->pPrev->pPrev->pPrev;
-                    stackOffset = atoi(&pL2->pLine[14]);
-                    sprintf(&pL2->pLine[14], "%d(sp)", stackOffset - 2);
-                }
+                // Reduce the jump label reference
+                label_ref_t *pRef = find_label_ref(jumpLabel);
+                if (pRef && pRef->refCount)
+                    pRef->refCount--;
+
+                // Delete the jal line, and the label if nothing else jumps to it
+                delete_asm_line(pL2);
+                if (peep_label_uses(jumpLabel) == 0)
+                    delete_asm_line(pL3);
+                changes++;
 
-                // Skip to the 'ret' opcode because we will delete this lra line
                 pL1 = pL1->pNext;
+                continue;
+            }
 
-                // Delete the 'lra' line
-                delete_asm_line(pL1->pPrev);
+            // Test for iftt conversion
+            // Get the line two lines after the jal and test if it is the label
+            if (pL3->kind == LINE_LABEL)
+            {
+                pL1 = pL1->pNext;
+                continue;
+            }
+            pL3 = get_next_asm_line(pL3);
+            if (!pL3)
+                break;
+            if (pL3->kind == LINE_LABEL && pL3->labelId == jumpLabel)
+            {
+                // So we found this:
+                //
+                // if       cond
+                // jal      _LBL
+                // someop
+                // otherop
+                // _LBL:  
+                //
+                // We can reverse the if condition change to iftt, delete the jal and let
+                // someop be the target of the reversed if condition.
+                reverse_if_comparison(pL1);
+                convert_if_to_iftt(pL1);
+                peep_touch(pL1);
 
-                // Now we must adjust any stack relative variables because
-                // we just changed the stack by 1.
-                pLine = pFrame->pAsmLines->pNext;
-                while (pLine != pFrame->pAsmLines)
-                {
-                    if (pLine->pLine[14] == '$')
-                    {
-                        int     off = atoi(&pLine->pLine[15]);
-                        char    str[128];
-                      
-                        strncpy(str, pLine->pLine, 14);
-                        str[14] = 0;
-                        sprintf(&str[14], "$%d(sp)", off-1);
-                        free(pLine->pLine);
-                        pLine->pLine = strdup(str);
-                    }
-                    
-                    // Next line
-                    pLine = pLine->pNext;
-                }
+                // Reduce the jump label reference
+                label_ref_t *pRef = find_label_ref(jumpLabel);
+                if (pRef && pRef->refCount)
+                    pRef->refCount--;
 
+                // Delete the jal line, and the label if nothing else jumps to it
+                delete_asm_line(pL2);
+                if (peep_label_uses(jumpLabel) == 0)
+                    delete_asm_line(pL3);
                 changes++;
             }
-
-            pSra = NULL;
-            raChangeCount = 0;
         }
 
         // Next asm line
@@ -5726,185 +7222,198 @@ int optimize_sra_lra(void)
 
 /*
 ==========================================================================================
-Optimize iftt, ldz, jal code generated by LOGAND and LOGOR 
+Optimize initializations with literals by re-arranging them so values with the same
+acc load value are together.
 ==========================================================================================
 */
-int optimize_logand_logor_iftt(void)
+int optimize_literal_init(void)
 {
     asm_line_t  *pL1; 
     asm_line_t  *pL2; 
     asm_line_t  *pL3; 
-    asm_line_t  *pLt; 
-    asm_line_t  *pLt2; 
-    label_ref_t *pLabelRef;
-    char        *s1;
-    char        *s2;
-    char        *s3;
-    int         loadZero;
-    char        jumpLabel[256];
-    int         resolved;
-    int         substFound;
+    asm_line_t  *pL4; 
+    asm_line_t  *pL3Prev; 
+    asm_line_t  *pLastLdi; 
     int         changes = 0;
+    int         duplicates;
+    int         ldiCount;
+    int         ldiVal;
+    int         asmLines;
+    int         ldiHist[256];
 
-    // Scan all lines seaching for iftt, ldz, jal sequence
+    // Scan all lines seaching for shr, andi, if
     pL1 = pFrame->pAsmLines->pNext;
     while (pL1 != pFrame->pAsmLines)
     {
-        // Get the next 2 lines
+        // Get the next line
         pL2 = get_next_asm_line(pL1);
-        pL3 = get_next_asm_line(pL2);
-
-        if (pL2 == NULL || pL3 == NULL)
+        if (pL2 == NULL)
             break;
 
-        // Test for our sequence
-        s1 = &pL1->pLine[4];
-        s2 = &pL2->pLine[4];
-        s3 = &pL3->pLine[4];
-        if (strncmp(s1, "iftt", 4) == 0 && strncmp(s2, "ldz", 3) == 0 &&
-            (strncmp(s3, "jal", 3) == 0 || strncmp(s3, "br ", 3) == 0))
+        // Search for ldi lines followed by stax
+        ldiCount = 0;
+        asmLines = 0;
+        duplicates = 0;
+        memset(ldiHist, 0, sizeof(ldiHist));
+        if (pL1->op == ASM_LDI && pL1->argKind != ARG_NONE && pL2->op == ASM_STAX)
         {
-            // Found one!
-            strcpy(jumpLabel, &s3[10]);
-            strcat(jumpLabel, ":");
-            if (strcmp(&s2[10], "1") == 0 || strcmp(&s2[10], "z") == 0)
-                loadZero = 1;
-            else
-                loadZero = 0;
+            // Found potential start of a block of initialization
+            ldiCount = 1;
+            asmLines = 2;
+            pLastLdi = pL1;
 
-            resolved = 0;
-            substFound = 0;
-            pLt = pL3;
-            while (!resolved)
+            ldiVal = asm_arg_int(pL1);
+            if (ldiVal < 256 && ldiVal >= -128)
             {
-                // Scan forward looking for the jumpLabel
-                while (pLt != NULL && strcmp(pLt->pLine, jumpLabel) != 0)
-                    pLt = get_next_asm_line(pLt);
-                
-                // Validate label found
-                if (!pLt)
-                    break;
-
-                // Get next line after the label line
-                pLt2 = get_next_asm_line(pLt);        
-                if (!pLt2)
-                    break;
-                // Skip any additional labels
-                while (pLt2->pLine[0] != ' ')
-                    pLt2 = get_next_asm_line(pLt2);
+                if (++ldiHist[labs(ldiVal)] > 1)
+                    duplicates++;
+            }
 
-                // Test for "if        z" or "if        nz" line
-                if ((strcmp(&pLt2->pLine[4], "if        z") == 0 ||
-                    strcmp(&pLt2->pLine[4], "if        nz") == 0) &&
-                    strncmp(&pLt2->pNext->pLine[4], "jal", 3) == 0)
+            pL3 = get_next_asm_line(pL2);
+            if (!pL3)
+                break;
+            pL3Prev = pL3;
+            while ((pL3->op == ASM_LDI && pL3->argKind != ARG_NONE) || pL3->op == ASM_STAX)
+            {
+                // Keep track of the number of ldi operations
+                if (pL3->op == ASM_LDI)
                 {
-                    // Found a substitution!
-                    substFound = 1;
-
-                    // Test if this is a repeated hop to the next label
-                    if ((pLt2->pLine[14] == 'z' && loadZero) || 
-                        (pLt2->pLine[14] != 'z' && !loadZero))
+                    ldiCount++;
+                    ldiVal = asm_arg_int(pL3);
+                    pLastLdi = pL3;
+                    if (ldiVal < 256 && ldiVal >= -128)
                     {
-                        // Setup to jump to the next label
-                        strcpy(jumpLabel, &pLt2->pNext->pLine[14]);
-                        strcat(jumpLabel, ":");
-                        continue;
+                        if (++ldiHist[labs(ldiVal)] > 1)
+                            duplicates++;
                     }
-                    else
-                    {
-                        // We need to move or add a label after the pLt2->pNext jal,
-                        // change the original pL3 to jump there, and delete the
-                        // ldz line.  First remove the trailing ':'
-                        jumpLabel[strlen(jumpLabel)-1] = 0;
-
-                        // Get the label reference
-                        pLabelRef = find_label_ref(jumpLabel);
-                        if (pLabelRef->refCount == 1)
-                        {
-                            asm_line_t *pLbl = pLabelRef->pAsmLine;
+                }
 
-                            // We can simply move the label.  Remove from list
-                            pLbl->pPrev->pNext = pLbl->pNext;
-                            pLbl->pNext->pPrev = pLbl->pPrev;
+                asmLines++;
+                pL3Prev = pL3;
+                pL3 = get_next_asm_line(pL3);
+                if (!pL3)
+                    break;
+            }
 
-                            // And re-insert 
-                            insert_asm_line_before(pLbl, pLt2->pNext->pNext);
-                        }
-                        else
-                        {
-                            // Replace the pL3 jump label
-                            free(pL3->pLine);
-                            strcat(jumpLabel, "b");
-                            char line[512];
-        emit("//here");
-                            sprintf(line, "    jal       %s", jumpLabel);
-                            pL3->pLine = strdup(line);
+            // Skip processing if no duplicates
+            if (duplicates == 0)
+            {
+                pL1 = pL3->pPrev;
+                continue;
+            }
 
-                            // Insert a new label
-                            asm_line_t *pLbl = (asm_line_t *) malloc(sizeof(asm_line_t));
-                            sprintf(line, "%s:", jumpLabel);
-                            pLbl->pLine = strdup(line);
-                            insert_asm_line_before(pLbl, pLt2->pNext->pNext);
-                        }
+            // Restore pL3 to the line with the last stax/ldi
+            pL3 = pL3Prev;
 
-                        // Delete the ldz line
-                        delete_asm_line(pL2);
+            // We must keep the final ldi intact because other code
+            // past the stax operation may also use that value.  So first
+            // find any other ldi/stax with the same value and move those 
+            // stax after the final ldi.
+            pL2 = pL1;
 
-                        // Change the iftt to just an if
-                        s1[2] = ' ';
-                        s1[3] = ' ';
-                        
-                        changes++;
-                        resolved = 1;
-                    }
-                }
-                else if (substFound)
+            // Get value of the LDI
+            ldiVal = asm_arg_int(pLastLdi);
+            while (pL2 != pLastLdi)
+            {
+                // Test if this ldi value is the same as the last
+                if (asm_arg_int(pL2) == ldiVal)
                 {
-                    // Remove reference to the label
-                    pLabelRef = find_label_ref(&s3[10]);
-                    if (pLabelRef && pLabelRef->refCount)
+                    // We can remove this ldi and move all of the following
+                    // stax to after the pLastLdi
+                    while (get_next_asm_line(pL2)->op == ASM_STAX)
                     {
-                        pLabelRef->refCount--;
-                        if (pLabelRef->refCount == 0)
-                            delete_asm_line(pLabelRef->pAsmLine);
+                        move_asm_line_after(get_next_asm_line(pL2), pLastLdi);
+                        changes++;
                     }
 
-                    // Change the L3 line to jump to the new label.  First
-                    // remove the ':'
-                    jumpLabel[strlen(jumpLabel)-1] = 0;
-
-                    // Delete the existing line
-                    free(pL3->pLine);
-                    char line[512];
-                    sprintf(line, "    jal       %s", jumpLabel);
-                    pL3->pLine = strdup(line);
+                    // Now delete the ldi line.  If we are deleting the first
+                    // line of the block, then we must reassign pL1
+                    if (pL2 == pL1)
+                        pL1 = get_next_asm_line(pL2);
+                    asm_line_t *pTemp = get_next_asm_line(pL2);
+                    delete_asm_line(pL2);
+                    pL2 = pTemp;
+                }
+                else
+                {
+                    // Value does not match.  Advance to next "ldi"
+                    pL2 = get_next_asm_line(pL2);
+                    while (pL2->op == ASM_STAX)
+                        pL2 = get_next_asm_line(pL2);
+                }
+            }
 
-                    // Increment the ref count of the label we are jumping to
-                    pLabelRef = find_label_ref(jumpLabel);
-                    if (pLabelRef)
-                        pLabelRef->refCount++;
+            // Now scan the block and move any other duplicate ldi/stax 
+            // together.
+            pL2 = pL1;
+            while (pL2 != pLastLdi)
+            {
+                // Get the value of this LDI
+                ldiVal = asm_arg_int(pL2);
 
-                    // Delete the "ldz" line
-                    delete_asm_line(pL2);
+                // Find the last stax after this ldi
+                pL3 = pL2;
+                while (get_next_asm_line(pL3)->op == ASM_STAX)
+                    pL3 = get_next_asm_line(pL3);
 
-                    // Change the iftt to just an if
-                    s1[2] = ' ';
-                    s1[3] = ' ';
-                    changes++;
+                // Find any matching ldi to pL2's ldi
+                pL4 = get_next_asm_line(pL3);
+                while (pL4 != pLastLdi)
+                {
+                    // Test if this ldi matches the pL2 LDI value
+                    if (asm_arg_int(pL4) == ldiVal)
+                    {
+                        // Test if the LDI has a .loc and comment line
+                        if (pL4->pPrev->pPrev->kind == LINE_DIRECTIVE &&
+                            strncmp(pL4->pPrev->pPrev->pText, "    .loc", 8) == 0)
+                        {
+                            // Move the .loc line
+                            move_asm_line_after(pL4->pPrev->pPrev, pL3);
+                            pL3 = pL3->pNext;
+                        }
+                        if (pL4->pPrev->kind == LINE_COMMENT &&
+                            strncmp(pL4->pPrev->pText, "    // ", 7) == 0)
+                        {
+                            // Move the comment line
+                            move_asm_line_after(pL4->pPrev, pL3);
+                            pL3 = pL3->pNext;
+                        }
 
-                    // Advance the pL1 pointer
-                    pL1 = pL3;
+                        // Move this LDI's stax line and delete the ldi
+                        while (get_next_asm_line(pL4)->op == ASM_STAX)
+                        {
+                            move_asm_line_after(get_next_asm_line(pL4), pL3);
+                            pL3 = pL3->pNext;
+                            changes++;
+                        }
 
-                    // Perform the substitution to the final label
-                    resolved = 1;
+                        asm_line_t *pTemp = get_next_asm_line(pL4);
+                        delete_asm_line(pL4);
+                        pL4 = pTemp;
+                    }
+                    else
+                    {
+                        // Advance to next "ldi"
+                        pL4 = get_next_asm_line(pL4);
+                        while (pL4->op == ASM_STAX)
+                            pL4 = get_next_asm_line(pL4);
+                    }
                 }
-                else
-                    // No changes
-                    break;
+
+                // Advance to next "ldi"
+                pL2 = get_next_asm_line(pL2);
+                while (pL2->op == ASM_STAX)
+                    pL2 = get_next_asm_line(pL2);
             }
+            
+            printf("Found block %d lines with %d ldi and %d duplicates\n", 
+                    asmLines, ldiCount, duplicates);
+
+            // Advance the search pointer
+            pL1 = pL3;
         }
 
-        // Next asm line
+        // Next line
         pL1 = pL1->pNext;
     }
 
@@ -5913,402 +7422,594 @@ int optimize_logand_logor_iftt(void)
 
 /*
 ==========================================================================================
-Optimize shr, shr, andi 1, if z
+Forget everything known about the acc, IX and flags
 ==========================================================================================
 */
-int optimize_struct_masking(void)
+static void df_clobber(df_state_t *pState)
 {
-    asm_line_t  *pL1; 
-    asm_line_t  *pL2; 
-    asm_line_t  *pL3; 
-    char        *s1;
-    char        *s2;
-    char        *s3;
-    int         shrCount = 0;
-    int         changes = 0;
+    pState->accConst = 0;
+    pState->nLocs = 0;
+    pState->ixKnown = 0;
+    pState->flagsOp = 0;
+}
 
-    // Scan all lines seaching for shr, andi, if
-    pL1 = pFrame->pAsmLines->pNext;
-    while (pL1 != pFrame->pAsmLines)
+/*
+==========================================================================================
+Test if the acc value is known to be in a memory location
+==========================================================================================
+*/
+static int df_has_loc(df_state_t *pState, df_loc_t *pLoc)
+{
+    for (int i = 0; i < pState->nLocs; i++)
+        if (pState->locs[i].base == pLoc->base && pState->locs[i].off == pLoc->off &&
+            pState->locs[i].paramRel == pLoc->paramRel)
+        {
+            return 1;
+        }
+
+    return 0;
+}
+
+/*
+==========================================================================================
+Forget the globals the acc value is known to be in
+==========================================================================================
+*/
+static void df_forget_globals(df_state_t *pState)
+{
+    int     n = 0;
+
+    for (int i = 0; i < pState->nLocs; i++)
+        if (pState->locs[i].base == 0)
+            pState->locs[n++] = pState->locs[i];
+    pState->nLocs = n;
+}
+
+/*
+==========================================================================================
+Merge the state of another path into pState.  Returns 1 if pState changed.
+==========================================================================================
+*/
+static int df_meet(df_state_t *pState, df_state_t *pOther)
+{
+    df_state_t  old = *pState;
+    int         n = 0;
+
+    if (!pOther->reached)
+        return 0;
+    if (!pState->reached)
     {
-        // Get the next 2 lines
-        pL2 = get_next_asm_line_no_label(pL1);
-        pL3 = get_next_asm_line_no_label(pL2);
+        *pState = *pOther;
+        return 1;
+    }
 
-        if (pL2 == NULL || pL3 == NULL)
-            break;
+    if (!pOther->accConst || pOther->accVal != pState->accVal)
+        pState->accConst = 0;
+    for (int i = 0; i < pState->nLocs; i++)
+        if (df_has_loc(pOther, &pState->locs[i]))
+            pState->locs[n++] = pState->locs[i];
+    pState->nLocs = n;
+    if (!pOther->ixKnown || pOther->ixSym != pState->ixSym || pOther->ixOff != pState->ixOff)
+        pState->ixKnown = 0;
+    if (pOther->flagsOp != pState->flagsOp)
+        pState->flagsOp = 0;
 
-        // Test for our sequence
-        s1 = &pL1->pLine[4];
-        s2 = &pL2->pLine[4];
-        s3 = &pL3->pLine[4];
-        if (strcmp(s1, "shr") == 0 && strncmp(s2, "andi", 4) == 0 &&
-            (strcmp(s3, "if        z") == 0 || strcmp(s3, "if        nz") == 0))
+    return pState->accConst != old.accConst || pState->nLocs != old.nLocs ||
+           pState->ixKnown != old.ixKnown || pState->flagsOp != old.flagsOp;
+}
+
+/*
+==========================================================================================
+Get the memory location of an "off(sp)" or "off(ix)" operand.  Returns 0 if it is
+not known.
+==========================================================================================
+*/
+static int df_line_loc(df_state_t *pState, asm_line_t *pLine, df_loc_t *pLoc)
+{
+    char    *pEnd;
+    long    off;
+
+    if (pLine->argKind == ARG_STACK)
+    {
+        pLoc->base = 0;
+        pLoc->off = pLine->argVal;
+        pLoc->paramRel = pLine->paramRel;
+        return 1;
+    }
+
+    if (pLine->argKind == ARG_TEXT && pState->ixKnown)
+    {
+        off = strtol(pLine->pText, &pEnd, 10);
+        if (pEnd != pLine->pText && strcmp(pEnd, "(ix)") == 0)
         {
-            int     andVal; 
+            pLoc->base = pState->ixSym;
+            pLoc->off = pState->ixOff + off;
+            pLoc->paramRel = 0;
+            return 1;
+        }
+    }
 
-            // We can remove the shr opcodes and just shift the andi value
-            // left for the comparison
-            while (strcmp(&pL2->pPrev->pLine[4], "shr") == 0)
-                delete_asm_line(pL2->pPrev);
+    return 0;
+}
 
-            andVal = atoi(&s2[10]);
+/*
+==========================================================================================
+Store the acc to a memory location, or to somewhere unknown when pLoc is NULL
+==========================================================================================
+*/
+static void df_store(df_state_t *pState, df_loc_t *pLoc)
+{
+    int     n = 0;
 
-            free(pL2->pLine);
-            char line[32];
-            sprintf(line, "    andi      %d", andVal << (shrCount + 1));
-            pL2->pLine = strdup(line);
+    if (pLoc == NULL)
+    {
+        pState->nLocs = 0;
+        return;
+    }
 
-            changes++;
+    // Drop the locations the store may overwrite.  Stack offsets with and without
+    // a '$' modifier are only comparable to each other.
+    for (int i = 0; i < pState->nLocs; i++)
+    {
+        df_loc_t *pOld = &pState->locs[i];
 
-            pL1 = pL3;
-        }
-        else
+        if (pOld->base == pLoc->base && pOld->off == pLoc->off &&
+            pOld->paramRel == pLoc->paramRel)
         {
-            if (strcmp(s1, "shr") == 0)
-                shrCount++;
-            else
-                shrCount = 0;
+            continue;
         }
-
-        pL1 = pL1->pNext;
+        if (pOld->base == 0 && pLoc->base == 0 && pOld->paramRel != pLoc->paramRel)
+            continue;
+        pState->locs[n++] = *pOld;
     }
+    pState->nLocs = n;
 
-    return changes;
+    if (n < DF_MAX_LOCS)
+        pState->locs[pState->nLocs++] = *pLoc;
 }
 
 /*
 ==========================================================================================
-Optimize shr, shr, andi 1, if z
+Update the state for the execution of pLine.  Opcodes that are not listed forget
+everything.  The code generator relies on ldx, stax and ads keeping the flags
+(e.g. "ldx c / stax 0(ix) / bz"), so they do here as well.
 ==========================================================================================
 */
-int optimize_for_iftt(void)
+static void df_transfer(df_state_t *pState, asm_line_t *pLine)
 {
-    asm_line_t  *pL1; 
-    asm_line_t  *pL2; 
-    asm_line_t  *pL3; 
-    char        *s1;
-    char        *s2;
-    char        jumpLabel[64];
-    int         changes = 0;
+    df_loc_t    loc;
+    int         n = 0;
 
-    // Scan all lines seaching for shr, andi, if
-    pL1 = pFrame->pAsmLines->pNext;
-    while (pL1 != pFrame->pAsmLines)
+    if (pLine->kind != LINE_OP)
     {
-        // Get the next 2 lines
-        pL2 = get_next_asm_line_no_label(pL1);
+        if (pLine->kind == LINE_TEXT)
+            df_clobber(pState);
+        return;
+    }
 
-        if (pL2 == NULL)
+    switch (pLine->op)
+    {
+        case ASM_LDI:
+            pState->accConst = pLine->argKind == ARG_IMM;
+            pState->accVal = pLine->argVal;
+            pState->nLocs = 0;
+            pState->flagsOp = ASM_LDI;
             break;
 
-        // Test for our sequence
-        s1 = &pL1->pLine[4];
-        s2 = &pL2->pLine[4];
-        if (strncmp(s1, "if  ", 4) == 0 &&
-            (strncmp(s2, "jal", 3) == 0 || strncmp(s2, "br ", 3) == 0))
-        {
-            // Get the jump label
-            strcpy(jumpLabel, &s2[10]);
-            strcat(jumpLabel, ":");
+        case ASM_LDAX:
+            pState->accConst = 0;
+            pState->nLocs = 0;
+            if (df_line_loc(pState, pLine, &loc))
+                df_store(pState, &loc);
+            pState->flagsOp = ASM_LDAX;
+            break;
 
-            // Get next line after the jump
-            pL3 = get_next_asm_line(pL2);
-            if (!pL3)
-                break;
-            if (strcmp(pL3->pLine, jumpLabel) == 0)
-            {
-                // Jump to next line???  That means neither the if nor the jal are needed
+        case ASM_STAX:
+            df_store(pState, df_line_loc(pState, pLine, &loc) ? &loc : NULL);
+            break;
 
-                pL1 = pL2;
-                continue;
-            }
-            
-            // Get the line two lines after the jal and test if it is the label
-            pL3 = get_next_asm_line(pL3);
-            if (!pL3)
-                break;
-            if (strcmp(pL3->pLine, jumpLabel) == 0)
+        case ASM_STA:
+            df_store(pState, NULL);
+            pState->flagsOp = 0;
+            break;
+
+        case ASM_LDX:
+            pState->ixKnown = pLine->argKind == ARG_SYMBOL;
+            pState->ixSym = pLine->labelId;
+            pState->ixOff = 0;
+            break;
+
+        case ASM_ADX:
+            if (pLine->argKind == ARG_IMM)
+                pState->ixOff += pLine->argVal;
+            else
+                pState->ixKnown = 0;
+            pState->flagsOp = 0;
+            break;
+
+        case ASM_ADS:
+            // The stack pointer moves, so stack offsets change.  Anything below the
+            // stack pointer may be overwritten by an interrupt.
+            for (int i = 0; i < pState->nLocs; i++)
             {
-                // So we found this:
-                //
-                // if       cond
-                // jal      _LBL
-                // someop
-                // _LBL:  
-                //
-                // We can reverse the if condition, delete the jal and let
-                // someop be the target of the reversed if condition.
-                reverse_if_comparison(pL1);
+                df_loc_t *pLoc = &pState->locs[i];
 
-                // Reduce the jump label reference
-                label_ref_t *pRef = find_label_ref(&s2[10]);
-                if (pRef && pRef->refCount)
+                if (pLoc->base == 0)
                 {
-                    pRef->refCount--;
-                    if (pRef->refCount == 0)
-                    {
-                        // Delete the label line
-                        delete_asm_line(pL3);
-                    }
+                    if (pLine->argKind != ARG_IMM)
+                        continue;
+                    pLoc->off -= pLine->argVal;
+                    if (pLoc->off < 0)
+                        continue;
                 }
+                pState->locs[n++] = *pLoc;
+            }
+            pState->nLocs = n;
+            break;
 
-                // Delete the jal line
-                delete_asm_line(pL2);
-                changes++;
+        case ASM_CMP:
+        case ASM_CPI:
+        case ASM_CPX:
+        case ASM_LDC:
+            pState->flagsOp = 0;
+            break;
 
-                pL1 = pL1->pNext;
-                continue;
-            }
+        case ASM_BR:
+        case ASM_BZ:
+        case ASM_BNZ:
+        case ASM_BNC:
+        case ASM_IF:
+        case ASM_IFTT:
+        case ASM_IFTE:
+        case ASM_JMP_IX:
+        case ASM_NOP:
+        case ASM_RET:
+        case ASM_RETI:
+        case ASM_RETS:
+            break;
 
-            // Test for iftt conversion
-            // Get the line two lines after the jal and test if it is the label
-            pL3 = get_next_asm_line(pL3);
-            if (!pL3)
-                break;
-            if (strcmp(pL3->pLine, jumpLabel) == 0)
-            {
-                // So we found this:
-                //
-                // if       cond
-                // jal      _LBL
-                // someop
-                // otherop
-                // _LBL:  
-                //
-                // We can reverse the if condition change to iftt, delete the jal and let
-                // someop be the target of the reversed if condition.
-                reverse_if_comparison(pL1);
-                convert_if_to_iftt(pL1);
+        case ASM_TAX:
+        case ASM_TAXU:
+        case ASM_SPIX:
+            pState->ixKnown = 0;
+            pState->flagsOp = 0;
+            break;
 
-                // Reduce the jump label reference
-                label_ref_t *pRef = find_label_ref(&s2[10]);
-                if (pRef && pRef->refCount)
-                {
-                    pRef->refCount--;
-                    if (pRef->refCount == 0)
-                    {
-                        // Delete the label line
-                        delete_asm_line(pL3);
-                    }
-                }
+        case ASM_ADC:
+        case ASM_ADD:
+        case ASM_AND:
+        case ASM_ANDI:
+        case ASM_LDA:
+        case ASM_LDAC:
+        case ASM_LDAZ:
+        case ASM_LDZ:
+        case ASM_OR:
+        case ASM_SHL:
+        case ASM_SHR:
+        case ASM_SUB:
+        case ASM_TXA:
+        case ASM_TXAU:
+        case ASM_XOR:
+            pState->accConst = 0;
+            pState->nLocs = 0;
+            pState->flagsOp = 0;
+            break;
 
-                // Delete the jal line
-                delete_asm_line(pL2);
-                changes++;
+        default:
+            df_clobber(pState);
+            break;
+    }
+}
+
+/*
+==========================================================================================
+Test if an opcode may read the flags.  Calls and returns count as reading them, since
+the code generator passes conditions to and from functions in the flags.
+==========================================================================================
+*/
+static int df_reads_flags(asm_line_t *pLine)
+{
+    if (pLine->kind != LINE_OP)
+        return pLine->kind == LINE_TEXT;
+
+    switch (pLine->op)
+    {
+        case ASM_ADS:
+        case ASM_ADX:
+        case ASM_AND:
+        case ASM_ANDI:
+        case ASM_BR:
+        case ASM_CMP:
+        case ASM_CPI:
+        case ASM_CPX:
+        case ASM_LDA:
+        case ASM_LDAX:
+        case ASM_LDC:
+        case ASM_LDI:
+        case ASM_LDX:
+        case ASM_NOP:
+        case ASM_OR:
+        case ASM_SPIX:
+        case ASM_STA:
+        case ASM_STAX:
+        case ASM_TAX:
+        case ASM_TAXU:
+        case ASM_TXA:
+        case ASM_TXAU:
+        case ASM_XOR:
+            return 0;
+    }
+
+    return 1;
+}
+
+/*
+==========================================================================================
+Test if the flags may be read from pLine on, before a compare sets them again.
+pLive holds the answer at each label and pLocal tells which labels are in the function
+(2 for the head of a loop).
+==========================================================================================
+*/
+static int df_flags_live(asm_line_t *pLine, char *pLive, char *pLocal)
+{
+    for (; pLine != pFrame->pAsmLines; pLine = pLine->pNext)
+    {
+        if (is_skip_line(pLine))
+            continue;
+        if (pLine->kind == LINE_LABEL)
+            return pLive[pLine->labelId];
+
+        // An 'if' reads the flags, so the lines it skips are never reached here
+        if (pLine->op == ASM_BR)
+            return pLine->argKind != ARG_SYMBOL || !pLocal[pLine->labelId] ||
+                   pLive[pLine->labelId];
+        if (df_reads_flags(pLine))
+            return 1;
+        if (pLine->op == ASM_CMP || pLine->op == ASM_CPI)
+            return 0;
+    }
+
+    return 1;
+}
+
+/*
+==========================================================================================
+Test if pLine loads or stores a value the acc, IX or memory already hold, so that
+deleting it changes neither the registers nor any flags that are read afterwards
+==========================================================================================
+*/
+static int df_redundant(df_state_t *pState, asm_line_t *pLine, char *pLive, char *pLocal)
+{
+    df_loc_t    loc;
+
+    switch (pLine->op)
+    {
+        case ASM_LDI:
+            if (pLine->argKind != ARG_IMM || !pState->accConst ||
+                pState->accVal != pLine->argVal)
+            {
+                return 0;
             }
-        }
+            return pState->flagsOp == ASM_LDI || !df_flags_live(pLine->pNext, pLive, pLocal);
+
+        case ASM_LDAX:
+            if (!df_line_loc(pState, pLine, &loc) || !df_has_loc(pState, &loc))
+                return 0;
+            return pState->flagsOp == ASM_LDAX || !df_flags_live(pLine->pNext, pLive, pLocal);
+
+        case ASM_STAX:
+            return df_line_loc(pState, pLine, &loc) && df_has_loc(pState, &loc);
+
+        case ASM_LDX:
+            return pLine->argKind == ARG_SYMBOL && pState->ixKnown &&
+                   pState->ixSym == pLine->labelId && pState->ixOff == 0;
+    }
+
+    return 0;
+}
+
+/*
+==========================================================================================
+Mark the "_L" labels named in a line of text as entered with nothing known
+==========================================================================================
+*/
+static void df_mark_text_labels(char *pText, df_state_t *pIn, int nLabels)
+{
+    char    name[256];
+    int     len;
+    int     id;
 
-        // Next asm line
-        pL1 = pL1->pNext;
+    while (pText != NULL && (pText = strstr(pText, "_L")) != NULL)
+    {
+        len = strspn(pText, IDENT_CHARS);
+        snprintf(name, sizeof(name), "%.*s", len, pText);
+        if ((id = (int) (intptr_t) map_get(asm_label_ids, intern(name))) != 0 && id < nLabels)
+            pIn[id].reached = 1;
+        pText += len;
     }
-
-    return changes;
 }
 
 /*
 ==========================================================================================
-Optimize initializations with literals by re-arranging them so values with the same
-acc load value are together.
+Walk the function once, merging the state at each branch into the state of its
+target label.  With apply set, delete the lines df_redundant finds instead.  Returns
+the number of label states changed or lines deleted, or -1 if the function has
+lines the walk does not understand (a label inside an 'if').
 ==========================================================================================
 */
-int optimize_literal_init(void)
+static int df_walk(df_state_t *pIn, char *pLive, char *pLocal, int apply)
 {
-    asm_line_t  *pL1; 
-    asm_line_t  *pL2; 
-    asm_line_t  *pL3; 
-    asm_line_t  *pL4; 
-    asm_line_t  *pL3Prev; 
-    asm_line_t  *pLastLdi; 
-    char        *s1;
-    char        *s2;
-    char        *s3;
+    asm_line_t  *pLine;
+    asm_line_t  *pNext;
+    df_state_t  cur;
+    df_state_t  cond;
     int         changes = 0;
-    int         duplicates;
-    int         ldiCount;
-    int         ldiVal;
-    int         asmLines;
-    int         ldiHist[256];
+    int         shadow = 0;
 
-    // Scan all lines seaching for shr, andi, if
-    pL1 = pFrame->pAsmLines->pNext;
-    while (pL1 != pFrame->pAsmLines)
+    memset(&cur, 0, sizeof(cur));
+    cur.reached = 1;
+
+    for (pLine = pFrame->pAsmLines->pNext; pLine != pFrame->pAsmLines; pLine = pNext)
     {
-        // Get the next line
-        pL2 = get_next_asm_line(pL1);
-        if (pL2 == NULL)
-            break;
+        pNext = pLine->pNext;
+        if (is_skip_line(pLine))
+            continue;
 
-        // Search for ldi lines followed by stax
-        s1 = &pL1->pLine[4];
-        s2 = &pL2->pLine[4];
-        ldiCount = 0;
-        asmLines = 0;
-        duplicates = 0;
-        memset(ldiHist, 0, sizeof(ldiHist));
-        if (strncmp(s1, "ldi ", 4) == 0 && strncmp(s2, "stax", 4) == 0)
+        if (pLine->kind != LINE_OP)
         {
-            // Found potential start of a block of initialization
-            ldiCount = 1;
-            asmLines = 2;
-            pLastLdi = pL1;
-
-            ldiVal = atoi(&s1[10]);
-            if (ldiVal < 256 && ldiVal >= -128)
+            if (shadow)
+                return -1;
+            if (pLine->kind == LINE_LABEL)
             {
-                if (++ldiHist[labs(ldiVal)] > 1)
-                    duplicates++;
-            }
+                if (!apply)
+                    changes += df_meet(&pIn[pLine->labelId], &cur);
+                cur = pIn[pLine->labelId];
 
-            pL3 = get_next_asm_line(pL2);
-            if (!pL3)
-                break;
-            s3 = &pL3->pLine[4];
-            pL3Prev = pL3;
-            while (strncmp(s3, "ldi ", 4) == 0 || strncmp(s3, "stax", 4) == 0)
+                // An interrupt handler may change a global a loop waits on
+                if (pLocal[pLine->labelId] == 2)
+                    df_forget_globals(&cur);
+            }
+            else
             {
-                // Keep track of the number of ldi operations
-                if (strncmp(s3, "ldi ", 4) == 0)
-                {
-                    ldiCount++;
-                    ldiVal = atoi(&s3[10]);
-                    pLastLdi = pL3;
-                    if (ldiVal < 256 && ldiVal >= -128)
-                    {
-                        if (++ldiHist[labs(ldiVal)] > 1)
-                            duplicates++;
-                    }
-                }
-
-                asmLines++;
-                pL3Prev = pL3;
-                pL3 = get_next_asm_line(pL3);
-                if (!pL3)
-                    break;
-                s3 = &pL3->pLine[4];
+                df_transfer(&cur, pLine);
+                cur.reached = 1;
             }
+            continue;
+        }
 
-            // Skip processing if no duplicates
-            if (duplicates == 0)
-            {
-                pL1 = pL3->pPrev;
+        // The lines after an 'if' may or may not run
+        if (shadow)
+        {
+            shadow--;
+            if (!cur.reached)
                 continue;
+            if ((asm_opflags[pLine->op] & ASMF_BRANCH) && pLine->op != ASM_JAL &&
+                pLine->argKind == ARG_SYMBOL && !apply)
+            {
+                changes += df_meet(&pIn[pLine->labelId], &cur);
             }
+            if (is_if_op(pLine))
+                return -1;
+            cond = cur;
+            df_transfer(&cond, pLine);
+            df_meet(&cur, &cond);
+            continue;
+        }
 
-            // Restore pL3 to the line with the last stax/ldi
-            pL3 = pL3Prev;
+        if (!cur.reached)
+            continue;
 
-            // We must keep the final ldi intact because other code
-            // past the stax operation may also use that value.  So first
-            // find any other ldi/stax with the same value and move those 
-            // stax after the final ldi.
-            pL2 = pL1;
+        if (apply && df_redundant(&cur, pLine, pLive, pLocal))
+        {
+            delete_asm_line(pLine);
+            changes++;
+            continue;
+        }
 
-            // Get value of the LDI
-            ldiVal = atoi(&pLastLdi->pLine[14]);
-            while (pL2 != pLastLdi)
-            {
-                // Test if this ldi value is the same as the last
-                if (atoi(&pL2->pLine[14]) == ldiVal)
-                {
-                    // We can remove this ldi and move all of the following
-                    // stax to after the pLastLdi
-                    while (strncmp(&get_next_asm_line(pL2)->pLine[4], "stax", 4) == 0)
-                    {
-                        move_asm_line_after(get_next_asm_line(pL2), pLastLdi);
-                        changes++;
-                    }
+        if ((asm_opflags[pLine->op] & ASMF_BRANCH) && pLine->op != ASM_JAL &&
+            pLine->argKind == ARG_SYMBOL && !apply)
+        {
+            changes += df_meet(&pIn[pLine->labelId], &cur);
+        }
 
-                    // Now delete the ldi line.  If we are deleting the first
-                    // line of the block, then we must reassign pL1
-                    if (pL2 == pL1)
-                        pL1 = get_next_asm_line(pL2);
-                    asm_line_t *pTemp = get_next_asm_line(pL2);
-                    delete_asm_line(pL2);
-                    pL2 = pTemp;
-                }
-                else
-                {
-                    // Value does not match.  Advance to next "ldi"
-                    pL2 = get_next_asm_line(pL2);
-                    while (strncmp(&pL2->pLine[4], "stax", 4) == 0)
-                        pL2 = get_next_asm_line(pL2);
-                }
-            }
+        if (is_if_op(pLine))
+            shadow = pLine->op == ASM_IF ? 1 : 2;
 
-            // Now scan the block and move any other duplicate ldi/stax 
-            // together.
-            pL2 = pL1;
-            while (pL2 != pLastLdi)
-            {
-                // Get the value of this LDI
-                ldiVal = atoi(&pL2->pLine[14]);
+        df_transfer(&cur, pLine);
+        // The entries of a jump table are each entered from the jmp_ix
+        if ((pLine->op == ASM_BR && !pLine->tableEntry) || pLine->op == ASM_RET ||
+            pLine->op == ASM_RETI || pLine->op == ASM_RETS || pLine->op == ASM_JMP_IX)
+        {
+            cur.reached = 0;
+        }
+    }
 
-                // Find the last stax after this ldi
-                pL3 = pL2;
-                while (strncmp(&get_next_asm_line(pL3)->pLine[4], "stax ", 4) == 0)
-                    pL3 = get_next_asm_line(pL3);
+    return changes;
+}
 
-                // Find any matching ldi to pL2's ldi
-                pL4 = get_next_asm_line(pL3);
-                while (pL4 != pLastLdi)
-                {
-                    // Test if this ldi matches the pL2 LDI value
-                    if (atoi(&pL4->pLine[14]) == ldiVal)
-                    {
-                        // Test if the LDI has a .loc and comment line
-                        if (strncmp(pL4->pPrev->pPrev->pLine, "    .loc", 8) == 0)
-                        {
-                            // Move the .loc line
-                            move_asm_line_after(pL4->pPrev->pPrev, pL3);
-                            pL3 = pL3->pNext;
-                        }
-                        if (strncmp(pL4->pPrev->pLine, "    // ", 7) == 0)
-                        {
-                            // Move the comment line
-                            move_asm_line_after(pL4->pPrev, pL3);
-                            pL3 = pL3->pNext;
-                        }
+/*
+==========================================================================================
+Remove loads and stores of values that are already in place.  The code generator
+tracks the acc and IX only while emitting straight line code (set_acc_var, etc.), so
+loads are repeated after every label.  This pass builds the control flow between the
+function's labels and branches and finds what the acc, IX and flags hold at each
+label: a constant, stack locations or globals the acc was loaded from or stored to,
+and the symbol IX points into.  Then any ldi, ldax, ldx or stax that would not change
+them is deleted.
+==========================================================================================
+*/
+int optimize_acc_dataflow(void)
+{
+    asm_line_t  *pLine;
+    df_state_t  *pIn;
+    char        *pLive;
+    char        *pLocal;
+    int         nLabels = vec_len(asm_label_names) + 1;
+    int         changes;
 
-                        // Move this LDI's stax line and delete the ldi
-                        while (strncmp(&get_next_asm_line(pL4)->pLine[4], "stax", 4) == 0)
-                        {
-                            move_asm_line_after(get_next_asm_line(pL4), pL3);
-                            pL3 = pL3->pNext;
-                            changes++;
-                        }
+    pIn = calloc(nLabels, sizeof(df_state_t));
+    pLive = calloc(nLabels, 1);
+    pLocal = calloc(nLabels, 1);
 
-                        asm_line_t *pTemp = get_next_asm_line(pL4);
-                        delete_asm_line(pL4);
-                        pL4 = pTemp;
-                    }
-                    else
-                    {
-                        // Advance to next "ldi"
-                        pL4 = get_next_asm_line(pL4);
-                        while (strncmp(&pL4->pLine[4], "stax", 4) == 0)
-                            pL4 = get_next_asm_line(pL4);
-                    }
-                }
+    // Labels that are not branched to directly may be entered with anything in the
+    // registers.  Mark them reached with nothing known.
+    for (pLine = pFrame->pAsmLines->pNext; pLine != pFrame->pAsmLines; pLine = pLine->pNext)
+    {
+        if (pLine->kind == LINE_LABEL)
+        {
+            pLocal[pLine->labelId] = is_local_label(pLine->labelId);
+            if (!pLocal[pLine->labelId])
+                pIn[pLine->labelId].reached = 1;
+        }
+        else if (pLine->argKind == ARG_SYMBOL && pLine->op != ASM_BR &&
+                 pLine->op != ASM_BZ && pLine->op != ASM_BNZ && pLine->op != ASM_BNC)
+        {
+            pIn[pLine->labelId].reached = 1;
+        }
+        else if (pLine->argKind == ARG_SYMBOL && pLocal[pLine->labelId])
+        {
+            // A branch back to a loop head
+            pLocal[pLine->labelId] = 2;
+        }
+        else if (pLine->kind == LINE_TEXT || pLine->argKind == ARG_TEXT)
+        {
+            df_mark_text_labels(pLine->pText, pIn, nLabels);
+        }
+    }
+    for (pLine = pFrame->pDataLines; pLine != NULL; pLine = pLine->pNext)
+    {
+        df_mark_text_labels(pLine->pText, pIn, nLabels);
+        if (pLine->argKind == ARG_SYMBOL)
+            pIn[pLine->labelId].reached = 1;
+        if (pLine->pNext == pFrame->pDataLines)
+            break;
+    }
 
-                // Advance to next "ldi"
-                pL2 = get_next_asm_line(pL2);
-                while (strncmp(&pL2->pLine[4], "stax", 4) == 0)
-                    pL2 = get_next_asm_line(pL2);
+    // Liveness of the flags at each label, from none up
+    do
+    {
+        changes = 0;
+        for (pLine = pFrame->pAsmLines->pNext; pLine != pFrame->pAsmLines; pLine = pLine->pNext)
+            if (pLine->kind == LINE_LABEL && !pLive[pLine->labelId] &&
+                df_flags_live(pLine->pNext, pLive, pLocal))
+            {
+                pLive[pLine->labelId] = 1;
+                changes++;
             }
-            
-            printf("Found block %d lines with %d ldi and %d duplicates\n", 
-                    asmLines, ldiCount, duplicates);
+    } while (changes > 0);
 
-            // Advance the search pointer
-            pL1 = pL3;
-        }
+    // What the registers hold at each label, from everything down
+    do
+        changes = df_walk(pIn, pLive, pLocal, 0);
+    while (changes > 0);
 
-        // Next line
-        pL1 = pL1->pNext;
-    }
+    if (changes == 0)
+        changes = df_walk(pIn, pLive, pLocal, 1);
 
-    return changes;
+    free(pIn);
+    free(pLive);
+    free(pLocal);
+    return changes < 0 ? 0 : changes;
 }
 
 /*
@@ -6335,18 +8036,117 @@ static void populate_opts(opts_t *pOpt)
             pOpt->iftt = 1;
             pOpt->literal_init = 1;
             pOpt->label_jumps = 1;
+            pOpt->acc_dataflow = 1;
             break;
 
         case 's':
             pOpt->iftt = 1;
             pOpt->literal_init = 1;
+            pOpt->acc_dataflow = 1;
             break;
     }
 }
 
 /*
 ==========================================================================================
-Perform known ASM optimizations prior to writing to the file
+Start the peephole worklist for the current function.  Every line is pending for the
+local passes and every pass runs in the first round.
+==========================================================================================
+*/
+static void peep_begin(void)
+{
+    asm_line_t  *pLine;
+
+    memset(peep.pUses, 0, peep.nUses * sizeof(int));
+    memset(peep.ppUsers, 0, peep.nUses * sizeof(asm_line_t *));
+    memset(peep.pFirst, 0, sizeof(peep.pFirst));
+    memset(peep.pLast, 0, sizeof(peep.pLast));
+    memset(peep.runs, 0, sizeof(peep.runs));
+    memset(peep.visits, 0, sizeof(peep.visits));
+    memset(peep.rewrites, 0, sizeof(peep.rewrites));
+    peep.gen = 0;
+    for (int pass = 0; pass < PEEP_COUNT; pass++)
+        peep.lastRun[pass] = peep.gen - 1;
+    peep.lines = 0;
+    peep.rounds = 0;
+
+    peep_number_lines();
+    pLine = pFrame->pAsmLines->pNext;
+    while (pLine != pFrame->pAsmLines)
+    {
+        pLine->useId = 0;
+        peep_count_use(pLine, pLine->argKind == ARG_SYMBOL ? pLine->labelId : 0);
+        if (pLine->kind == LINE_LABEL)
+            count_label_def(pLine, 1);
+        peep_mark_line(pLine);
+        peep.lines++;
+        pLine = pLine->pNext;
+    }
+    peep.active = 1;
+}
+
+/*
+==========================================================================================
+Run one peephole pass if it has anything to look at.  A local pass runs when lines are
+pending for it.  Any other pass runs when the function changed since it last started.
+==========================================================================================
+*/
+static int peep_run(int pass, int (*pPassFunc)(void))
+{
+    int     changes;
+
+    if (PEEP_LOCAL & (1 << pass))
+    {
+        if (peep.pFirst[pass] == NULL)
+            return 0;
+    }
+    else
+    {
+        if (peep.lastRun[pass] == peep.gen)
+            return 0;
+        peep.lastRun[pass] = peep.gen;
+    }
+
+    peep.runs[pass]++;
+    changes = pPassFunc();
+    peep.rewrites[pass] += changes;
+
+    // Nothing was marked while the pass ran
+    if ((PEEP_LOCAL & (1 << pass)) && peep.pFirst[pass] == NULL)
+        peep.pLast[pass] = NULL;
+
+    return changes;
+}
+
+/*
+==========================================================================================
+Finish the peephole worklist, printing its statistics for -fpeep-stats
+==========================================================================================
+*/
+static void peep_end(void)
+{
+    peep.active = 0;
+    if (!peepstats)
+        return;
+
+    fprintf(stderr, "peephole %s: %d lines, %d rounds\n", pFrame->fname, peep.lines, peep.rounds);
+    fprintf(stderr, "    %-16s %6s %8s %8s\n", "pass", "runs", "visits", "rewrites");
+    for (int pass = 0; pass < PEEP_COUNT; pass++)
+    {
+        if (PEEP_LOCAL & (1 << pass))
+            fprintf(stderr, "    %-16s %6d %8d %8d\n", peep_names[pass], peep.runs[pass],
+                    peep.visits[pass], peep.rewrites[pass]);
+        else
+            fprintf(stderr, "    %-16s %6d %8s %8d\n", peep_names[pass], peep.runs[pass],
+                    "-", peep.rewrites[pass]);
+    }
+}
+
+/*
+==========================================================================================
+Perform known ASM optimizations prior to writing to the file.  The passes run in rounds
+until a round changes nothing, but a pass only looks again at what changed since it last
+ran (see peep_run), which gives the same result as rescanning the whole function.
 ==========================================================================================
 */
 static void perform_asm_optimizations(void)
@@ -6360,67 +8160,74 @@ static void perform_asm_optimizations(void)
     // Determine which opts to run based on optimization level
     populate_opts(&opt);
 
+    peep_begin();
     do
     {
         changes = 0;
+        peep.rounds++;
 
         // Remove unuseful "ads 0" lines
         if (opt.ads0)
-            changes += remove_ads0_lines();
+            changes += peep_run(PEEP_ADS0, remove_ads0_lines);
 
         // Remove unused labels
-        changes += optimize_unused_labels();
+        changes += peep_run(PEEP_UNUSED_LABELS, optimize_unused_labels);
         
         // Remove unused labels
-        changes += optimize_multi_labels();
+        changes += peep_run(PEEP_MULTI_LABELS, optimize_multi_labels);
         
         // Remove orphaned jal
-        changes += optimize_orphaned_jal();
+        changes += peep_run(PEEP_ORPHANED_JAL, optimize_orphaned_jal);
         
         // Remove orphaned jal
-        changes += optimize_cpi_zero();
+        changes += peep_run(PEEP_CPI_ZERO, optimize_cpi_zero);
         
         // Remove extraneous loc
         //changes += optimize_extraneous_loc();
         
         // Optimize jal to br
-        changes += optimize_jal_to_br();
+        changes += peep_run(PEEP_JAL_TO_BR, optimize_jal_to_br);
         
         // Optimize if followed by jal to br to local label
-        changes += optimize_if_br();
+        changes += peep_run(PEEP_IF_BR, optimize_if_br);
         
         // Optimize notz followed by conditional branch
-        changes += optimize_notz_br();
+        changes += peep_run(PEEP_NOTZ_BR, optimize_notz_br);
 
         // Optimize bz/bnz followed by br
-        changes += optimize_bz_br();
+        changes += peep_run(PEEP_BZ_BR, optimize_bz_br);
         
         // Optimize inclusion of sra / lra depending if any jal / swap ra
         // opcodes left after other optimizations
-        changes += optimize_sra_lra();
+        changes += peep_run(PEEP_SRA_LRA, optimize_sra_lra);
         
         // Optimize jump to jump
         if (opt.label_jumps)
-            changes += optimize_label_jumps();
+            changes += peep_run(PEEP_LABEL_JUMPS, optimize_label_jumps);
         
         // Optimize iftt, ldz, jal code generated by LOGAND and LOGOR 
         if (opt.logand_logor)
-            changes += optimize_logand_logor_iftt();
+            changes += peep_run(PEEP_LOGAND_LOGOR, optimize_logand_logor_iftt);
         
         // Optimize iftt, ldz, jal code generated by LOGAND and LOGOR 
         if (opt.struct_masking)
-            changes += optimize_struct_masking();
+            changes += peep_run(PEEP_STRUCT_MASKING, optimize_struct_masking);
 
         // Find if / jal where if target is only one or two opcodes
         if (opt.iftt)
-            changes += optimize_for_iftt();
+            changes += peep_run(PEEP_FOR_IFTT, optimize_for_iftt);
 
         // Perform literal initialization optimization (re-ordering literal
         // initialization based on same value in acc).
         if (opt.literal_init)
-            changes += optimize_literal_init();
+            changes += peep_run(PEEP_LITERAL_INIT, optimize_literal_init);
+
+        // Remove loads and stores of values the acc, IX or memory already hold
+        if (opt.acc_dataflow)
+            changes += peep_run(PEEP_ACC_DATAFLOW, optimize_acc_dataflow);
 
     } while (changes > 0);
+    peep_end();
 }
 
 /*
@@ -6431,6 +8238,7 @@ Generate code for a top level node.  This will be a global or a function.
 void emit_toplevel(Node *v) {
     stack_frame_t frame;
     asm_line_t    *pLine;
+    int           x;
 
     gLastEmitWasRet         = 0;
     gLastEmitWasJal         = 0;
@@ -6441,7 +8249,6 @@ void emit_toplevel(Node *v) {
     frame.nlvars            = 0;
     frame.nparam            = 0;
     frame.retCount          = 0;
-    frame.nlocalLabels      = 0;
     frame.preserveVars      = 0;
     frame.nexternLabels     = 0;
     frame.lastSwapOptional  = 0;
@@ -6451,16 +8258,24 @@ void emit_toplevel(Node *v) {
     frame.pAsmLines         = NULL;
     frame.pDataLines        = NULL;
     frame.pLabelRefs        = NULL;
+    frame.nLabelRefs        = 0;
     frame.accVal            = -1000;
     frame.accOnStack        = 0;
+    frame.accVar[0]         = 0;
+    frame.ixVar[0]          = 0;
     frame.fname             = v->fname;
     frame.func              = v;
+    frame.staticVars        = make_vector();
+    frame.probes            = make_vector();
     pFrame = &frame;
       
     if (v->kind == AST_FUNC) {
         emit_func_prologue(v);
         emit_expr(v->body);
+        reserve_stack_scratch();
         emit_ret(pFrame->localArea, v->ty->rettype, pFrame->raDestroyed);
+        for (x = 0; x < vec_len(pFrame->probes); x++)
+            emit(".public %s", vec_get(pFrame->probes, x));
 
         // Check if ra or ix changed and finalize SP variable offsets
         adjust_stack_for_ra_change();
@@ -6480,11 +8295,8 @@ void emit_toplevel(Node *v) {
     pLine = frame.pAsmLines;
     while (pLine)
     {
-        // Test for '$' stack modifiers
-        if (pLine->pLine[14] == '$')
-            memmove(&pLine->pLine[14], &pLine->pLine[15], 
-                    strlen(&pLine->pLine[15])+1);
-        fprintf(outputfp, "%s\n", pLine->pLine);
+        // Format the line text ('$' stack modifiers are dropped)
+        write_asm_line(pLine);
         pLine = pLine->pNext;
         if (pLine == frame.pAsmLines)
             pLine = NULL;
@@ -6496,17 +8308,23 @@ void emit_toplevel(Node *v) {
         if (strcmp(gpCurrSegment, ".data") != 0)
         {
           gpCurrSegment = ".data";
-          fprintf(outputfp, "\n    .section .data\n\n");
+          output_line("");
+          output_line("    .section .data");
+          output_line("");
         }
     while (pLine)
     {
-        fprintf(outputfp, "%s\n", pLine->pLine);
+        write_asm_line(pLine);
         pLine = pLine->pNext;
         if (pLine == frame.pDataLines)
             pLine = NULL;
     }
     if (frame.pDataLines)
-        fprintf(outputfp, "\n");
+        output_line("");
+    if (vec_len(frame.staticVars))
+        write_static_frame();
+    free(frame.pLabelRefs);
+    arena_release(&asm_arena);
 }
 
 // vim: sw=4 ts=4
@@ -0,0 +1,111 @@
+// Copyright 2026 Ken Pettit <pettitkd@gmail.com>
+// Released under the MIT license.
+
+// String interning.  Every distinct string is stored once, together with
+// its hash and a stable id, so two interned strings are equal exactly when
+// their pointers are.  The lexer interns identifiers as it reads them and
+// Map keys are interned, which lets map lookups by an identifier skip both
+// hashing and strcmp.
+//
+// Interned strings are never freed.  They live in their own arena, so each
+// Intern starts on an ARENA_ALIGN boundary, and the ids table points back
+// at it, which is how is_interned tells them apart from other strings.
+
+#include <stdlib.h>
+#include <string.h>
+#include "lisacc.h"
+
+#define INIT_SIZE 1024
+
+Arena intern_arena = { "intern", .chunksize = 1024 * 1024 };
+
+static Intern **table;     // open addressed by hash
+static int tablesize;
+static Intern **ids;       // id -> string
+static int nids;
+static int maxids;
+
+static uint32_t hash(char *p, int len) {
+    // FNV hash
+    uint32_t r = 2166136261;
+    for (int i = 0; i < len; i++) {
+        r ^= p[i];
+        r *= 16777619;
+    }
+    return r;
+}
+
+static void rehash(void) {
+    int newsize = tablesize ? tablesize * 2 : INIT_SIZE;
+    Intern **t = calloc(newsize, sizeof(Intern *));
+    int mask = newsize - 1;
+    for (int i = 0; i < nids; i++) {
+        int j = ids[i]->hash & mask;
+        while (t[j])
+            j = (j + 1) & mask;
+        t[j] = ids[i];
+    }
+    free(table);
+    table = t;
+    tablesize = newsize;
+}
+
+static Intern *find(char *p, int len, uint32_t h, int *slot) {
+    if (!table)
+        rehash();
+    int mask = tablesize - 1;
+    int i = h & mask;
+    for (; table[i]; i = (i + 1) & mask) {
+        Intern *s = table[i];
+        if (s->hash == h && s->len == len && !memcmp(s->str, p, len))
+            return s;
+    }
+    *slot = i;
+    return NULL;
+}
+
+// Returns the interned copy of the len bytes at p
+char *intern_len(char *p, int len) {
+    uint32_t h = hash(p, len);
+    int slot;
+    Intern *s = find(p, len, h, &slot);
+    if (s)
+        return s->str;
+
+    s = arena_alloc(&intern_arena, sizeof(Intern) + len + 1);
+    s->hash = h;
+    s->id = nids;
+    s->len = len;
+    memcpy(s->str, p, len);
+    s->str[len] = '\0';
+    if (nids == maxids) {
+        maxids = maxids ? maxids * 2 : INIT_SIZE;
+        ids = realloc(ids, maxids * sizeof(Intern *));
+    }
+    ids[nids++] = s;
+    table[slot] = s;
+    if (nids * 2 > tablesize)
+        rehash();
+    return s->str;
+}
+
+char *intern(char *s) {
+    return intern_len(s, strlen(s));
+}
+
+// Returns the interned copy of s, or NULL if s was never interned
+char *intern_find(char *s) {
+    int len = strlen(s);
+    int slot;
+    Intern *r = find(s, len, hash(s, len), &slot);
+    return r ? r->str : NULL;
+}
+
+// The header of an interned string is in the same ARENA_ALIGN block as its
+// first byte, so it is only read where it can be and never from another page
+bool is_interned(char *s) {
+    if ((uintptr_t)s % ARENA_ALIGN != offsetof(Intern, str))
+        return false;
+    Intern *r = INTERN_OF(s);
+    return (unsigned)r->id < (unsigned)nids && ids[r->id] == r;
+}
@@ -39,6 +39,34 @@ typedef struct {
 
 static Pos pos;
 
+// Warnings given so far, so a call that warns is not put in the token cache
+static int nwarnings;
+
+// Characters taken in bulk by read_span.  None of the sets contains '\\'
+// or '\r', which are left to readc so line splices are handled as before.
+static const char ident_chars[256] = {
+    ['0' ... '9'] = 1, ['A' ... 'Z'] = 1, ['a' ... 'z'] = 1,
+    ['_'] = 1, ['$'] = 1, [0x80 ... 0xFF] = 1,
+};
+static const char number_chars[256] = {
+    ['0' ... '9'] = 1, ['A' ... 'Z'] = 1, ['a' ... 'z'] = 1, ['.'] = 1,
+};
+static const char space_chars[256] = {
+    [' '] = 1, ['\t'] = 1, ['\f'] = 1, ['\v'] = 1,
+};
+static const char comment_chars[256] = {
+    [1 ... '\t'] = 1, ['\n'] = 1, [0x0B ... '\r' - 1] = 1, ['\r' + 1 ... '*' - 1] = 1,
+    ['*' + 1 ... '/' - 1] = 1, ['/' + 1 ... '\\' - 1] = 1, ['\\' + 1 ... 0xFF] = 1,
+};
+static const char line_chars[256] = {
+    [1 ... '\t'] = 1, [0x0B ... '\r' - 1] = 1, ['\r' + 1 ... '\\' - 1] = 1,
+    ['\\' + 1 ... 0xFF] = 1,
+};
+static const char string_chars[256] = {
+    [1 ... '\t'] = 1, [0x0B ... '\r' - 1] = 1, ['\r' + 1 ... '"' - 1] = 1,
+    ['"' + 1 ... '\\' - 1] = 1, ['\\' + 1 ... 0xFF] = 1,
+};
+
 static char *pos_string(Pos *p) {
     File *f = current_file();
     return format("%s:%d:%d", f ? f->name : "(unknown)", p->line, p->column);
@@ -53,9 +81,18 @@ static char *pos_string(Pos *p) {
 #endif
 
 static void skip_block_comment(void);
+static bool buffer_empty(void);
+static Token *copy_token(Token *tmpl);
+
+// Sets up the token buffer stack without opening an input file, so the
+// compile server can run cpp_init before any request arrives.
+void lex_init_buffers() {
+    if (vec_len(buffers) == 0)
+        vec_push(buffers, make_vector());
+}
 
 void lex_init(char *filename) {
-    vec_push(buffers, make_vector());
+    lex_init_buffers();
     if (!strcmp(filename, "-")) {
         stream_push(make_file(stdin, "-"));
         return;
@@ -76,7 +113,7 @@ static void mark() {
 }
 
 static Token *make_token(Token *tmpl) {
-    Token *r = malloc(sizeof(Token));
+    Token *r = arena_alloc(&token_arena, sizeof(Token));
     *r = *tmpl;
     r->hideset = NULL;
     File *f = current_file();
@@ -131,6 +168,8 @@ static bool next(int expect) {
 
 static void skip_line() {
     for (;;) {
+        char *s;
+        read_span(line_chars, &s);
         int c = readc();
         if (c == EOF)
             return;
@@ -142,6 +181,9 @@ static void skip_line() {
 }
 
 static bool do_skip_space() {
+    char *s;
+    if (read_span(space_chars, &s))
+        return true;
     int c = readc();
     if (c == EOF)
         return false;
@@ -190,6 +232,18 @@ static void skip_string() {
 // tokenize nor validate contents. We don't do that, too.
 // This function is to skip code until matching #endif as fast as we can.
 void skip_cond_incl() {
+    File *f = current_file();
+    LexCall call = { LEX_SKIP };
+    bool cache = f->tcache && buffer_empty();
+    if (cache && tcache_replay(f, &call)) {
+        pos = (Pos){ call.line, call.column };
+        unget_token(copy_token(&call.tok[0]));
+        unget_token(copy_token(&call.tok[1]));
+        return;
+    }
+    if (cache)
+        tcache_begin(f, &call);
+    int warned = nwarnings;
     int nest = 0;
     for (;;) {
         bool bol = (current_file()->column == 1);
@@ -217,6 +271,14 @@ void skip_cond_incl() {
             hash->bol = true;
             hash->column = column;
             unget_token(hash);
+            if (cache && current_file() == f && nwarnings == warned) {
+                call.tok[0] = *tok;
+                call.tok[1] = *hash;
+                call.ntok = 2;
+                call.line = pos.line;
+                call.column = pos.column;
+                tcache_record(f, &call);
+            }
             return;
         }
         if (is_ident(tok, "if") || is_ident(tok, "ifdef") || is_ident(tok, "ifndef"))
@@ -234,6 +296,12 @@ static Token *read_number(char c) {
     buf_write(b, c);
     char last = c;
     for (;;) {
+        char *s;
+        int n = read_span(number_chars, &s);
+        if (n > 0) {
+            buf_append(b, s, n);
+            last = s[n - 1];
+        }
         int c = readc();
         bool flonum = strchr("eEpP", last) && strchr("+-", c);
         if (!isdigit(c) && !isalpha(c) && c != '.' && !flonum) {
@@ -336,6 +404,7 @@ static int read_escaped_char() {
     case '0' ... '7': return read_octal_char(c);
     }
     warnp(p, "unknown escape character: \\%c", c);
+    nwarnings++;
     return c;
 }
 
@@ -354,6 +423,10 @@ static Token *read_char(int enc) {
 static Token *read_string(int enc) {
     Buffer *b = make_buffer();
     for (;;) {
+        char *s;
+        int n = read_span(string_chars, &s);
+        if (n > 0)
+            buf_append(b, s, n);
         int c = readc();
         if (c == EOF)
             errorp(pos, "unterminated string");
@@ -376,9 +449,17 @@ static Token *read_string(int enc) {
 }
 
 static Token *read_ident(char c) {
-    Buffer *b = make_buffer();
+    // The name is interned, so the buffer is reused for every identifier
+    static Buffer *b;
+    if (!b)
+        b = make_buffer();
+    b->len = 0;
     buf_write(b, c);
     for (;;) {
+        char *s;
+        int n = read_span(ident_chars, &s);
+        if (n > 0)
+            buf_append(b, s, n);
         c = readc();
         if (isalnum(c) || (c & 0x80) || c == '_' || c == '$') {
             buf_write(b, c);
@@ -392,7 +473,7 @@ static Token *read_ident(char c) {
         }
         unreadc(c);
         buf_write(b, '\0');
-        return make_ident(buf_body(b));
+        return make_ident(intern_len(buf_body(b), buf_len(b) - 1));
     }
 }
 
@@ -400,6 +481,9 @@ static void skip_block_comment() {
     Pos p = get_pos(-2);
     bool maybe_end = false;
     for (;;) {
+        char *s;
+        if (read_span(comment_chars, &s))
+            maybe_end = false;
         int c = readc();
         if (c == EOF)
             errorp(p, "premature end of block comment");
@@ -485,7 +569,7 @@ static Token *do_read_token() {
         if (next('.')) {
             if (next('.'))
                 return make_keyword(KELLIPSIS);
-            return make_ident("..");
+            return make_ident(intern(".."));
         }
         return make_keyword('.');
     case '(': case ')': case ',': case ';': case '[': case ']': case '{':
@@ -533,9 +617,7 @@ static bool buffer_empty() {
 // That the C preprocessor requires a special lexer behavior only for
 // #include is a violation of layering. Ideally, the lexer should be
 // agnostic about higher layers status. But we need this for the C grammar.
-char *read_header_file_name(bool *std) {
-    if (!buffer_empty())
-        return NULL;
+static char *read_header_name(bool *std) {
     skip_space();
     Pos p = get_pos(0);
     char close;
@@ -561,6 +643,27 @@ char *read_header_file_name(bool *std) {
     return buf_body(b);
 }
 
+char *read_header_file_name(bool *std) {
+    if (!buffer_empty())
+        return NULL;
+    File *f = current_file();
+    LexCall call = { LEX_HEADER_NAME };
+    if (f->tcache && tcache_replay(f, &call)) {
+        if (call.name)
+            *std = call.std;
+        return call.name;
+    }
+    if (f->tcache)
+        tcache_begin(f, &call);
+    char *name = read_header_name(std);
+    if (f->tcache && current_file() == f) {
+        call.name = name;
+        call.std = name && *std;
+        tcache_record(f, &call);
+    }
+    return name;
+}
+
 bool is_keyword(Token *tok, int c) {
     return (tok->kind == TKEYWORD) && (tok->id == c);
 }
@@ -598,18 +701,63 @@ Token *lex_string(char *s) {
     return r;
 }
 
-Token *lex() {
-    Vector *buf = vec_tail(buffers);
-    if (vec_len(buf) > 0)
-        return vec_pop(buf);
-    if (vec_len(buffers) > 1)
-        return eof_token;
+// Reads a token from the current file.  *spaced is set if it follows
+// spaces or comments.
+static Token *read_file_token(bool *spaced) {
     bool bol = (current_file()->column == 1);
+    bool space = false;
     Token *tok = do_read_token();
     while (tok->kind == TSPACE) {
         tok = do_read_token();
         tok->space = true;
+        space = true;
     }
     tok->bol = bol;
+    if (spaced)
+        *spaced = space;
+    return tok;
+}
+
+// Returns a token replayed from the token cache.  Newlines are the same
+// token object, as when they are lexed.
+static Token *copy_token(Token *tmpl) {
+    if (tmpl->kind == TNEWLINE) {
+        newline_token->bol = tmpl->bol;
+        if (tmpl->space)
+            newline_token->space = true;
+        return newline_token;
+    }
+    Token *r = arena_alloc(&token_arena, sizeof(Token));
+    *r = *tmpl;
+    return r;
+}
+
+Token *lex() {
+    Vector *buf = vec_tail(buffers);
+    if (vec_len(buf) > 0)
+        return vec_pop(buf);
+    if (vec_len(buffers) > 1)
+        return eof_token;
+    File *f = current_file();
+    if (!f->tcache)
+        return read_file_token(NULL);
+
+    LexCall call = { LEX_TOKEN };
+    if (tcache_replay(f, &call)) {
+        pos = (Pos){ call.line, call.column };
+        return copy_token(&call.tok[0]);
+    }
+    tcache_begin(f, &call);
+    int warned = nwarnings;
+    bool spaced;
+    Token *tok = read_file_token(&spaced);
+    if (current_file() == f && nwarnings == warned && tok != eof_token) {
+        call.tok[0] = *tok;
+        call.tok[0].space = spaced;
+        call.ntok = 1;
+        call.line = pos.line;
+        call.column = pos.column;
+        tcache_record(f, &call);
+    }
     return tok;
 }
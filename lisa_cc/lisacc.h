@@ -9,6 +9,7 @@
 #include <inttypes.h>
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdnoreturn.h>
 #include <time.h>
@@ -67,9 +68,31 @@ typedef struct {
     int len;
 } Buffer;
 
+// Every object allocated from an arena starts at a multiple of this
+#define ARENA_ALIGN 16
+
+typedef struct {
+    char *name;
+    size_t chunksize;     // 0 for the default
+    struct Chunk *chunks; // newest first
+    char *p;              // free space in the current chunk
+    char *end;
+    size_t allocated;     // bytes handed out, including released ones
+    size_t nalloc;        // objects handed out
+    size_t reserved;      // chunk bytes currently held
+    size_t peak;          // most chunk bytes ever held at once
+    int releases;
+} Arena;
+
+typedef struct TokenCache TokenCache;
+
 typedef struct {
-    FILE *file;  // stream backed by FILE *
-    char *p;     // stream backed by string
+    FILE *file;    // stream backed by FILE *
+    char *begin;   // first character of the file or string
+    char *p;       // next character of the file or string
+    char *end;     // end of the characters
+    char *map;     // mmap'ed contents of file, if any
+    size_t maplen;
     char *name;
     int line;
     int column;
@@ -78,6 +101,7 @@ typedef struct {
     int buf[3];   // push-back buffer for unread operations
     int buflen;   // push-back buffer size
     time_t mtime; // last modified time. 0 if string-backed file
+    TokenCache *tcache; // recorded lexer calls, with -ftoken-cache
 } File;
 
 typedef struct {
@@ -129,6 +153,7 @@ enum {
     AST_STRUCT_REF,
     AST_GOTO,
     AST_COMPUTED_GOTO,
+    AST_SWITCH_TABLE,
     AST_LABEL,
     AST_NOP,
     AST_PRUNED,
@@ -205,6 +230,15 @@ typedef struct {
     int line;
 } SourceLoc;
 
+// A branch of the source in a profile (profile.c)
+typedef struct ProfSite {
+    char *name;
+    bool swapped;   // then and els were exchanged by an AST pass
+    bool emitted;   // its probe labels are in the output
+    long count;     // times the branch ran, -1 if not in the profile
+    long taken;     // times its condition, as written, was true
+} ProfSite;
+
 typedef struct Node {
     int kind;
     Type *ty;
@@ -228,6 +262,7 @@ typedef struct Node {
             // local
             int loff;
             int isParam;
+            bool addrtaken;
             Vector *lvarinit;
             // global
             char *glabel;
@@ -271,12 +306,18 @@ typedef struct Node {
             struct Node *cond;
             struct Node *then;
             struct Node *els;
+            ProfSite *prof;
         };
         // Goto and label
         struct {
             char *label;
             char *newlabel;
         };
+        // Switch jump table, indexed by an unsigned char
+        struct {
+            struct Node *tableidx;
+            Vector *tablelabels;
+        };
         // Return statement
         struct Node *retval;
         // Compound statement
@@ -288,6 +329,11 @@ typedef struct Node {
             Type *fieldtype;
         };
     };
+    // AST optimizer state of a statement (opt_lisa.c)
+    unsigned optClean;
+    int optEpoch;
+    int optAssignChar;
+    struct Node *optSibling;
 } Node;
 
 extern Type *type_void;
@@ -314,6 +360,17 @@ Buffer *to_utf16(char *p, int len);
 Buffer *to_utf32(char *p, int len);
 void write_utf8(Buffer *b, uint32_t rune);
 
+// arena.c
+extern Arena token_arena;
+extern Arena ast_arena;
+extern Arena asm_arena;
+extern bool memreport;
+void *arena_alloc(Arena *a, size_t size);
+void *arena_calloc(Arena *a, size_t size);
+char *arena_strdup(Arena *a, char *s);
+void arena_release(Arena *a);
+void print_mem_report(void);
+
 // buffer.c
 Buffer *make_buffer(void);
 char *buf_body(Buffer *b);
@@ -334,6 +391,8 @@ void expect_newline(void);
 void add_include_path(char *path);
 void init_now(void);
 void cpp_init(void);
+void cpp_init_server(void);
+void cpp_init_request(void);
 Token *peek_token(void);
 Token *read_token(void);
 
@@ -382,6 +441,7 @@ File *make_file(FILE *file, char *name);
 File *make_file_string(char *s);
 int readc(void);
 void unreadc(int c);
+int read_span(const char *set, char **start);
 File *current_file(void);
 void stream_push(File *file);
 int stream_depth(void);
@@ -390,11 +450,33 @@ void stream_stash(File *f);
 void stream_unstash(void);
 
 // gen.c
+typedef struct LisaAsm_s LisaAsm_t;     // See ../lisa_as/asmlib.h
+extern bool peepstats;
+extern bool static_frames;
 void set_output_file(FILE *fp);
+void set_output_asm(LisaAsm_t *pAsm);
 void close_output_file(void);
+void output_line(char *line);
 void emit_toplevel(Node *v);
 
+// intern.c
+typedef struct {
+    uint32_t hash;
+    int id;       // stable id, counting from 0
+    int len;
+    char str[];
+} Intern;
+
+#define INTERN_OF(s) ((Intern *)((s) - offsetof(Intern, str)))
+
+extern Arena intern_arena;
+char *intern(char *s);
+char *intern_len(char *p, int len);
+char *intern_find(char *s);
+bool is_interned(char *s);
+
 // lex.c
+void lex_init_buffers(void);
 void lex_init(char *filename);
 char *get_base_file(void);
 void skip_cond_incl(void);
@@ -406,12 +488,16 @@ void unget_token(Token *tok);
 Token *lex_string(char *s);
 Token *lex(void);
 
+// main.c
+int compile_request(int argc, char **argv);
+
 // map.c
 Map *make_map(void);
 Map *make_map_parent(Map *parent);
 void *map_get(Map *m, char *key);
 void map_put(Map *m, char *key, void *val);
 void map_remove(Map *m, char *key);
+void map_put_all(Map *m, Map *src);
 size_t map_len(Map *m);
 
 // parse.c
@@ -427,12 +513,56 @@ Vector *read_toplevels(void);
 void parse_init(void);
 char *fullpath(char *path);
 
+// profile.c
+extern bool profile_generate;
+extern char *profile_use;
+void prof_init(void);
+ProfSite *prof_site(SourceLoc *loc);
+ProfSite *prof_case_site(ProfSite *sw, long val);
+long prof_case_count(ProfSite *sw, long val);
+long prof_then_count(ProfSite *s);
+long prof_else_count(ProfSite *s);
+void prof_swap(ProfSite *s);
+char *prof_label(ProfSite *s, char kind);
+
+// server.c
+int run_server(char *path);
+
 // set.c
 Set *set_add(Set *s, char *v);
 bool set_has(Set *s, char *v);
 Set *set_union(Set *a, Set *b);
 Set *set_intersection(Set *a, Set *b);
 
+// tokcache.c
+enum { LEX_TOKEN, LEX_HEADER_NAME, LEX_SKIP };
+
+// One call into the lexer on a header, as recorded or replayed
+typedef struct {
+    int kind;
+    Token tok[2];  // what lex() returned, or the tokens skip_cond_incl ungot
+    int ntok;
+    char *name;    // what read_header_file_name returned
+    bool std;
+    int line;      // the lexer's mark position after the call
+    int column;
+    // the position of the file when the call was made
+    int off;
+    int fline;
+    int fcolumn;
+    int fntok;
+    int last;
+    int buf[3];
+    int buflen;
+} LexCall;
+
+extern char *token_cache_dir;
+void tcache_attach(File *f);
+void tcache_close(File *f);
+bool tcache_replay(File *f, LexCall *c);
+void tcache_begin(File *f, LexCall *c);
+void tcache_record(File *f, LexCall *c);
+
 // vector.c
 Vector *make_vector(void);
 Vector *make_vector1(void *e);
@@ -447,6 +577,9 @@ void *vec_tail(Vector *vec);
 Vector *vec_reverse(Vector *vec);
 void *vec_body(Vector *vec);
 int vec_len(Vector *vec);
+
+// opt_lisa.c
+extern bool optstats;
 void LisaOptimizeAST(Vector *toplevels);
 void GeneratePcode(Vector *toplevels);
 #endif
@@ -3,11 +3,13 @@
 #include <libgen.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/types.h>
-#include <sys/wait.h>
 #include <unistd.h>
 #include "lisacc.h"
 #include "whereami.h"
+#include "asmlib.h"
+
+// Instruction width of the generated code (lisa_as -w)
+#define ASM_WIDTH 16
 
 static char *infile;
 static char *outfile;
@@ -17,8 +19,9 @@ static bool cpponly;
 static bool dumpasm;
 static bool dontlink;
 static bool pcode;
+static bool keepasm;
 static Buffer *cppdefs;
-static Vector *tmpfiles = &EMPTY_VECTOR;
+static LisaAsm_t *assembler;
 char        *gpToolPath;
 char        gOptimizationLevel = '1';
 
@@ -31,11 +34,24 @@ static void usage(int exitcode) {
             "  -D name           Predefine name as a macro\n"
             "  -D name=def\n"
             "  -S                Stop before assembly (default)\n"
-            "  -c                Do not run linker (default)\n"
+            "  -c                Compile and assemble to a .rel file\n"
             "  -U name           Undefine name\n"
             "  -fdump-ast        print AST\n"
             "  -fdump-stack      Print stacktrace\n"
             "  -fno-dump-source  Do not emit source code as assembly comment\n"
+            "  -fkeep-asm        With -c, also write the generated .s file\n"
+            "  -fpeep-stats      Print peephole optimizer statistics per function\n"
+            "  -fopt-stats       Print AST optimizer pass statistics\n"
+            "  -fmem-report      Print bytes allocated per memory arena\n"
+            "  -fstatic-frames   Keep the char locals of functions in static frames\n"
+            "                    the linker overlays instead of on the stack\n"
+            "  -fprofile-generate\n"
+            "                    Add the probe labels lisa_sim -g counts branches at\n"
+            "  -fprofile-use=FILE\n"
+            "                    Lay out branches and switch cases from the counts\n"
+            "                    of a lisa_sim -g profile\n"
+            "  -ftoken-cache=DIR Keep the lexed tokens of headers in DIR and\n"
+            "                    reuse them while the headers are unchanged\n"
             "  -o filename       Output to the specified file\n"
             "  -g                Do nothing at this moment\n"
             "  -p                Generate p-code output\n"
@@ -45,16 +61,14 @@ static void usage(int exitcode) {
             "  -m64              Output 64-bit code (default)\n"
             "  -w                Disable all warnings\n"
             "  -h                print this help\n"
+            "  --server [path]   Serve compile requests from lisa_cc_client\n"
+            "                    on a Unix socket (default $LISA_CC_SERVER, else\n"
+            "                    lisa_cc.sock in $XDG_RUNTIME_DIR or /tmp/lisa_cc-<uid>)\n"
             "\n"
             "One of -a, -c, -E or -S must be specified.\n\n");
     exit(exitcode);
 }
 
-static void delete_temp_files() {
-    for (int i = 0; i < vec_len(tmpfiles); i++)
-        unlink(vec_get(tmpfiles, i));
-}
-
 static char *base(char *path) {
     return basename(strdup(path));
 }
@@ -68,24 +82,26 @@ static char *replace_suffix(char *filename, char suffix) {
     return r;
 }
 
+static char *rel_filename(char *filename) {
+    char *r = replace_suffix(filename, 's');
+    r[strlen(r) - 2] = '\0';
+    return format("%s.rel", r);
+}
+
+// Opens the .s output, if there is one.  When assembling, the .s is
+// only written with -fkeep-asm.
 static FILE *open_asmfile() {
-    if (dumpasm) {
+    if (dumpasm)
         asmfile = outfile ? outfile : replace_suffix(base(infile), 's');
-    } else {
-        asmfile = format("/tmp/lisaccXXXXXX.s");
-        if (!mkstemps(asmfile, 2))
-            perror("mkstemps");
-        vec_push(tmpfiles, asmfile);
-    }
+    else if (keepasm && !dumpast)
+        asmfile = replace_suffix(base(infile), 's');
+    else
+        return NULL;
     if (!strcmp(asmfile, "-"))
         return stdout;
     FILE *fp = fopen(asmfile, "w+");
     if (!fp)
         perror("fopen");
-    fprintf(fp, "// =============================\n");
-    fprintf(fp, "// Generated by lisa-cc         \n");
-    fprintf(fp, "// asmsyntax=lisa\n");
-    fprintf(fp, "// =============================\n\n");
     return fp;
 }
 
@@ -103,6 +119,22 @@ static void parse_f_arg(char *s) {
         dumpstack = true;
     else if (!strcmp(s, "no-dump-source"))
         dumpsource = false;
+    else if (!strcmp(s, "keep-asm"))
+        keepasm = true;
+    else if (!strcmp(s, "peep-stats"))
+        peepstats = true;
+    else if (!strcmp(s, "opt-stats"))
+        optstats = true;
+    else if (!strcmp(s, "mem-report"))
+        memreport = true;
+    else if (!strcmp(s, "static-frames"))
+        static_frames = true;
+    else if (!strcmp(s, "profile-generate"))
+        profile_generate = true;
+    else if (!strncmp(s, "profile-use=", 12))
+        profile_use = s + 12;
+    else if (!strncmp(s, "token-cache=", 12))
+        token_cache_dir = s + 12;
     else
         usage(1);
 }
@@ -196,24 +228,35 @@ void get_exec_path(void)
     }
 }
 
-int main(int argc, char **argv) {
-    setbuf(stdout, NULL);
-    if (atexit(delete_temp_files))
-        perror("atexit");
-    get_exec_path();
-    parseopt(argc, argv);
-    lex_init(infile);
-    cpp_init();
-    parse_init();
+static int compile(void) {
     set_output_file(open_asmfile());
+
+    // Assemble the generated lines in-process as they are written
+    bool assemble = !dumpast && !dumpasm && !cpponly;
+    if (assemble) {
+        assembler = lisa_asm_open(replace_suffix(base(infile), 's'), ASM_WIDTH, stderr);
+        set_output_asm(assembler);
+    }
+    if (!asmfile || strcmp(asmfile, "-")) {
+        output_line("// =============================");
+        output_line("// Generated by lisa-cc         ");
+        output_line("// asmsyntax=lisa");
+        output_line("// =============================");
+        output_line("");
+    }
     if (buf_len(cppdefs) > 0)
         read_from_string(buf_body(cppdefs));
 
     if (cpponly)
         preprocess();
 
+    prof_init();
+
     Vector *toplevels = read_toplevels();
 
+    // The tokens and macros are no longer needed once the AST is built
+    arena_release(&token_arena);
+
     // Run optimizations on the AST for LISA
     LisaOptimizeAST(toplevels);
 
@@ -233,19 +276,38 @@ int main(int argc, char **argv) {
 
     close_output_file();
 
-    if (!dumpast && !dumpasm) {
+    if (assemble) {
         if (!outfile)
-            outfile = replace_suffix(base(infile), 'o');
-        pid_t pid = fork();
-        if (pid < 0) perror("fork");
-        if (pid == 0) {
-            execlp("as", "as", "-o", outfile, "-c", asmfile, (char *)NULL);
-            perror("execl failed");
-        }
-        int status;
-        waitpid(pid, &status, 0);
-        if (status < 0)
-            error("as failed");
+            outfile = rel_filename(base(infile));
+        set_output_asm(NULL);
+        if (lisa_asm_finish(assembler, outfile, 0) != 0)
+            return 1;
     }
+    if (memreport)
+        print_mem_report();
     return 0;
 }
+
+// Compiles one request in a compile server worker, which has already
+// run the request independent part of cpp_init and parse_init.
+int compile_request(int argc, char **argv) {
+    optind = 1;
+    parseopt(argc, argv);
+    cpp_init_request();
+    lex_init(infile);
+    return compile();
+}
+
+int main(int argc, char **argv) {
+    setbuf(stdout, NULL);
+    get_exec_path();
+    if (argc > 1 && !strcmp(argv[1], "--server"))
+        return run_server(argc > 2 ? argv[2] : NULL);
+    if (argc > 1 && !strncmp(argv[1], "--server=", 9))
+        return run_server(argv[1] + 9);
+    parseopt(argc, argv);
+    lex_init(infile);
+    cpp_init();
+    parse_init();
+    return compile();
+}
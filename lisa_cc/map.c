@@ -1,6 +1,11 @@
 // Copyright 2014 Rui Ueyama. Released under the MIT license.
 
 // This is an implementation of hash table.
+//
+// Keys are interned strings, so a probe compares pointers and the hash
+// comes from the string itself.  A key that is not interned yet is
+// interned by map_put; map_get and map_remove look it up instead, and
+// a string that was never interned cannot be a key of any map.
 
 #include <stdlib.h>
 #include <string.h>
@@ -9,14 +14,8 @@
 #define INIT_SIZE 16
 #define TOMBSTONE ((void *)-1)
 
-static uint32_t hash(char *p) {
-    // FNV hash
-    uint32_t r = 2166136261;
-    for (; *p; p++) {
-        r ^= *p;
-        r *= 16777619;
-    }
-    return r;
+static uint32_t hash(char *key) {
+    return INTERN_OF(key)->hash;
 }
 
 static Map *do_make_map(Map *parent, int size) {
@@ -69,29 +68,40 @@ Map *make_map_parent(Map *parent) {
     return do_make_map(parent, INIT_SIZE);
 }
 
-static void *map_get_nostack(Map *m, char *key) {
+// Returns the interned key for a lookup, or NULL if there can't be one
+static char *lookup_key(char *key) {
+    return is_interned(key) ? key : intern_find(key);
+}
+
+static void *map_get_nostack(Map *m, char *key, uint32_t h) {
     if (!m->key)
         return NULL;
     int mask = m->size - 1;
-    int i = hash(key) & mask;
+    int i = h & mask;
     for (; m->key[i] != NULL; i = (i + 1) & mask)
-        if (m->key[i] != TOMBSTONE && !strcmp(m->key[i], key))
+        if (m->key[i] == key)
             return m->val[i];
     return NULL;
 }
 
 void *map_get(Map *m, char *key) {
-    void *r = map_get_nostack(m, key);
-    if (r)
-        return r;
+    key = lookup_key(key);
+    if (!key)
+        return NULL;
+    uint32_t h = hash(key);
     // Map is stackable. If no value is found,
     // continue searching from the parent.
-    if (m->parent)
-        return map_get(m->parent, key);
+    for (; m; m = m->parent) {
+        void *r = map_get_nostack(m, key, h);
+        if (r)
+            return r;
+    }
     return NULL;
 }
 
 void map_put(Map *m, char *key, void *val) {
+    if (!is_interned(key))
+        key = intern(key);
     maybe_rehash(m);
     int mask = m->size - 1;
     int i = hash(key) & mask;
@@ -105,7 +115,7 @@ void map_put(Map *m, char *key, void *val) {
                 m->nused++;
             return;
         }
-        if (!strcmp(k, key)) {
+        if (k == key) {
             m->val[i] = val;
             return;
         }
@@ -113,12 +123,13 @@ void map_put(Map *m, char *key, void *val) {
 }
 
 void map_remove(Map *m, char *key) {
-    if (!m->key)
+    key = lookup_key(key);
+    if (!m->key || !key)
         return;
     int mask = m->size - 1;
     int i = hash(key) & mask;
     for (; m->key[i] != NULL; i = (i + 1) & mask) {
-        if (m->key[i] == TOMBSTONE || strcmp(m->key[i], key))
+        if (m->key[i] != key)
             continue;
         m->key[i] = TOMBSTONE;
         m->val[i] = NULL;
@@ -127,6 +138,13 @@ void map_remove(Map *m, char *key) {
     }
 }
 
+// Puts each entry of src, but not those of its parents, into m
+void map_put_all(Map *m, Map *src) {
+    for (int i = 0; src->key && i < src->size; i++)
+        if (src->key[i] != NULL && src->key[i] != TOMBSTONE)
+            map_put(m, src->key[i], src->val[i]);
+}
+
 size_t map_len(Map *m) {
     return m->nelem;
 }
@@ -4,9 +4,11 @@
 // Optimizations to the Abstract Syntax Tree for the
 // Pico16 soft processor.
 
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <time.h>
 #include "lisacc.h"
 
 typedef void (*node_op_t)(Node *v, Node **vsource, int *changes,
@@ -15,6 +17,63 @@ typedef void (*node_op_t)(Node *v, Node **vsource, int *changes,
 int gConvCount       = 0;
 int gConvPruned      = 0;
 int gTotalAstChanges = 0;
+bool optstats        = false;
+
+/* Changes made by passes that don't report them in *changes (so they
+   don't start another round), but that still dirty the subtree */
+static int gAstTouched = 0;
+
+/* Passes have one bit each in Node.optClean */
+#define OPT_MAX_PASSES  32
+
+/* Index lists of the shared leaves referenced by each top level */
+typedef struct
+{
+  int       *pShared;
+  int       nShared;
+} opt_top_t;
+
+/* A leaf node referenced from more than one place, and a copy of it
+   from when it was last checked */
+typedef struct
+{
+  Node      *v;
+  Node      node;
+  Type      type;
+} opt_shared_t;
+
+typedef struct
+{
+  Node      *v;
+  int       top;
+} opt_leaf_t;
+
+/* AST pass manager state */
+static struct
+{
+  int           pass;             /* Pass being run, -1 for other walks */
+  int           epoch;            /* Statement state from other epochs is stale */
+  opt_top_t     *pTops;
+  int           nTops;
+  int           top;              /* Top level being walked */
+  int           *pChecked;        /* Change count when the leaves were checked */
+  int           checked;
+  int           checkedTouched;
+  opt_shared_t  *pShared;
+  int           nShared;
+  opt_leaf_t    *pLeaves;
+  int           nLeaves;
+  int           maxLeaves;
+  int           rounds;
+  int           walks[OPT_MAX_PASSES];
+  int           visits[OPT_MAX_PASSES];
+  int           skips[OPT_MAX_PASSES];
+  int           changes[OPT_MAX_PASSES];
+  double        msec[OPT_MAX_PASSES];
+} gOpt = { -1 };
+
+static void WalkStatements(Vector *stmts, int top, node_op_t pFunc,
+              int *changes, int parentAssignChar);
 
 /*
 ======================================================================
@@ -96,6 +155,9 @@ static void IterateNodeSearch(Node *v, Node **vsource,
   if (!v)
     return;
 
+  if (gOpt.pass >= 0)
+    gOpt.visits[gOpt.pass]++;
+
   /* Call the function handler */
   (*pFunc)(v, vsource, changes, parentAssignChar, vNextSibling); 
 
@@ -136,20 +198,16 @@ static void IterateNodeSearch(Node *v, Node **vsource,
       IterateNodeSearch(v->struc, &v->struc, pFunc, changes, parentAssignChar, NULL);
       break;
 
+    case AST_SWITCH_TABLE:
+      IterateNodeSearch(v->tableidx, &v->tableidx, pFunc, changes, 1, NULL);
+      break;
+
     case AST_RETURN:
       IterateNodeSearch(v->retval, &v->retval, pFunc, changes, v->retval->ty->kind == KIND_CHAR, NULL);
       break;
 
     case AST_COMPOUND_STMT:
-      for (i = 0; i < vec_len(v->stmts); i++)
-      {
-        Node *sibling;
-        if (i < vec_len(v->stmts)-1)
-          sibling = vec_get(v->stmts, i+1);
-        else
-          sibling = NULL;
-        IterateNodeSearch(vec_get(v->stmts,i), (Node**) &v->stmts->body[i], pFunc, changes, parentAssignChar, sibling);
-      }
+      WalkStatements(v->stmts, 0, pFunc, changes, parentAssignChar);
       break;
 
     case AST_ADDR:
@@ -206,6 +264,123 @@ static void IterateNodeSearch(Node *v, Node **vsource,
   }
 }
 
+/*
+======================================================================
+If the pass changed something since the last call, test if it changed
+a leaf that other statements share.  Their recorded state can't tell
+which passes that affects, so all of it is dropped.
+======================================================================
+*/
+static void CheckSharedLeaves(int *changes)
+{
+  int           i;
+  opt_top_t     *pTop = &gOpt.pTops[gOpt.top];
+  opt_shared_t  *pShared;
+
+  if (changes == gOpt.pChecked && *changes == gOpt.checked &&
+      gAstTouched == gOpt.checkedTouched)
+  {
+    return;
+  }
+  gOpt.pChecked = changes;
+  gOpt.checked = *changes;
+  gOpt.checkedTouched = gAstTouched;
+
+  for (i = 0; i < pTop->nShared; i++)
+  {
+    pShared = &gOpt.pShared[pTop->pShared[i]];
+    if (memcmp(&pShared->node, pShared->v, offsetof(Node, optClean)) == 0 &&
+        memcmp(&pShared->type, pShared->v->ty, sizeof(Type)) == 0)
+    {
+      continue;
+    }
+
+    pShared->node = *pShared->v;
+    pShared->type = *pShared->v->ty;
+    gOpt.epoch++;
+  }
+}
+
+/*
+======================================================================
+Iterate over a list of statements (or the top level nodes).  While a
+pass is run, each statement remembers the passes that found nothing
+to do in it, and a statement is skipped when the pass already found
+nothing there and nothing in it changed since.  That gives the same
+result as walking it again.
+======================================================================
+*/
+static void WalkStatements(Vector *stmts, int top, node_op_t pFunc,
+              int *changes, int parentAssignChar)
+{
+  int   i;
+  int   before;
+  int   touched;
+  Node  *v;
+  Node  *sibling;
+
+  for (i = 0; i < vec_len(stmts); i++)
+  {
+    v = vec_get(stmts, i);
+    if (i < vec_len(stmts)-1)
+      sibling = vec_get(stmts, i+1);
+    else
+      sibling = NULL;
+
+    if (gOpt.pass < 0 || !v)
+    {
+      IterateNodeSearch(v, top ? NULL : (Node **) &stmts->body[i], pFunc, changes, parentAssignChar, sibling);
+      continue;
+    }
+
+    /* A pass on an enclosing node may have changed a shared leaf */
+    if (!top)
+      CheckSharedLeaves(changes);
+
+    /* The context a pass sees must be the same too */
+    if (v->optEpoch == gOpt.epoch && v->optAssignChar == parentAssignChar &&
+        v->optSibling == sibling && (v->optClean & (1u << gOpt.pass)))
+    {
+      gOpt.skips[gOpt.pass]++;
+      continue;
+    }
+
+    if (top)
+    {
+      gOpt.top = i;
+      gOpt.walks[gOpt.pass]++;
+    }
+    before = *changes;
+    touched = gAstTouched;
+    IterateNodeSearch(v, top ? NULL : (Node **) &stmts->body[i], pFunc, changes, parentAssignChar, sibling);
+
+    /* The pass may have replaced the statement */
+    v = vec_get(stmts, i);
+    if (*changes == before && touched == gAstTouched)
+    {
+      if (v->optEpoch != gOpt.epoch || v->optAssignChar != parentAssignChar ||
+          v->optSibling != sibling)
+      {
+        v->optEpoch = gOpt.epoch;
+        v->optAssignChar = parentAssignChar;
+        v->optSibling = sibling;
+        v->optClean = 0;
+      }
+      v->optClean |= 1u << gOpt.pass;
+    }
+    else
+    {
+      /* PruneAssignReturn looks at the next statement, and can change it */
+      v->optClean = 0;
+      if (i > 0 && vec_get(stmts, i-1))
+        ((Node *) vec_get(stmts, i-1))->optClean = 0;
+      if (sibling)
+        sibling->optClean = 0;
+      CheckSharedLeaves(changes);
+    }
+  }
+}
+
 /*
 ======================================================================
 Prune AST_CONV nodes thare are children of AST_NOT
@@ -576,6 +751,7 @@ static void PruneAssignReturn(Node *v, Node **vsource, int *changes, int parentA
 
       /* Make the sibling AST_RETURN a NOP */
       vNextSibling->kind = AST_PRUNED;
+      gAstTouched++;
     }
   }
 }
@@ -587,6 +763,8 @@ Optimize out assign to variable followed by return of that variable
 */
 static void PruneConstArrayAdd(Node *v, Node **vsource, int *changes, int parentAssignChar, Node* vNextSibling)
 {
+  int   offset;
+
   /* Only process AST_DEREF nodes with operand '+' */
   if (v->kind != AST_DEREF)
     return;
@@ -608,9 +786,14 @@ static void PruneConstArrayAdd(Node *v, Node **vsource, int *changes, int parent
   if (v->operand->left->ty->kind != KIND_PTR)
     return;
 
+  /* Test if the offset of the element is less than 128 */
+  offset = v->operand->right->ival * v->operand->left->ty->ptr->size;
+  if (offset >= 128)
+    return;
+
   /* Make the literal value an offset to the AST_CONV and prune the AST_OP_PLUS */
   v->operand->ty->size = v->operand->left->operand->ty->align;
-  v->operand->left->ty->offset = v->operand->right->ival * v->operand->ty->size;
+  v->operand->left->ty->offset = offset;
   v->operand->left->ty->size = v->operand->left->operand->ty->align;
   v->operand = v->operand->left;
   (*changes)++;
@@ -819,7 +1002,11 @@ static void OptimizeOperationSize(Node *v, Node **vsource, int *changes, int par
           v->ival <= 255 && v->ival >= 0)
       {
           /* Ensure the literal is marked as usig */
-          v->ty->usig = true;
+          if (!v->ty->usig)
+          {
+            v->ty->usig = true;
+            gAstTouched++;
+          }
       }
       break;
 
@@ -857,6 +1044,7 @@ static void OptimizeOperationSize(Node *v, Node **vsource, int *changes, int par
             /* Set the LITERAL to type Char */
             vr->ty->kind = KIND_CHAR;
             vr->ty->size = 1;
+            gAstTouched++;
           }
       }
       break;
@@ -1180,6 +1368,34 @@ static void PruneCompoundStmt(Node *v, Node **vsource, int *changes, int parentA
   }
 }
 
+/*
+======================================================================
+Exchange the 'then' and 'els' clauses of an AST_IF and reverse its
+comparison
+======================================================================
+*/
+static void SwapIfElse(Node *v)
+{
+  Node  *tmp;
+
+  /* Reverse the 'then' and 'els' nodes */
+  tmp = v->then;
+  v->then = v->els;
+  v->els = tmp;
+  prof_swap(v->prof);
+
+  /* Reverse the IF condition kind */
+  switch (v->cond->kind)
+  {
+    case '<': v->cond->kind = OP_GE; break;
+    case '>': v->cond->kind = OP_LE; break;
+    case OP_EQ: v->cond->kind = OP_NE; break;
+    case OP_NE: v->cond->kind = OP_EQ; break;
+    case OP_LE: v->cond->kind = '>'; break;
+    case OP_GE: v->cond->kind = '<'; break;
+  }
+}
+
 /*
 ======================================================================
 Optimize AST_IF else condition if it is a single statement by 
@@ -1188,7 +1404,6 @@ making it the 'then' clause and reversing the if comparison.
 */
 static void OptimizeIfElse(Node *v, Node **vsource, int *changes, int parentAssignChar, Node* vNextSibling)
 {
-  Node  *tmp;
   int   kind;
 
   /* Test for AST_IF node */
@@ -1282,21 +1497,52 @@ static void OptimizeIfElse(Node *v, Node **vsource, int *changes, int parentAssi
       return;
   }
 
-  /* Reverse the 'then' and 'els' nodes */
-  tmp = v->then;
-  v->then = v->els;
-  v->els = tmp;
+  SwapIfElse(v);
+  (*changes)++;
+}
 
-  /* Reverse the IF condition kind */
+/*
+======================================================================
+Place the side of an if / else the profile (-fprofile-use) says ran
+more often in the 'els' clause.  The then side pays a br over the
+else side on its way out, so the else side is the cheaper one to
+run.  A goto or return side is left where OptimizeIfElse put it.
+======================================================================
+*/
+static void OptimizeIfLayout(Node *v, Node **vsource, int *changes, int parentAssignChar, Node* vNextSibling)
+{
+  /* Test for AST_IF node with a profile */
+  if (v->kind != AST_IF && v->kind != AST_TERNARY)
+    return;
+  if (v->then == NULL || v->els == NULL)
+    return;
+  if (prof_then_count(v->prof) <= prof_else_count(v->prof))
+    return;
+
+  if (v->then->kind == AST_GOTO || v->then->kind == AST_RETURN ||
+      v->els->kind == AST_GOTO || v->els->kind == AST_RETURN)
+    return;
+
+  /* Test the IF condition type.  A float compare can't be reversed. */
   switch (v->cond->kind)
   {
-    case '<': v->cond->kind = OP_GE; break;
-    case '>': v->cond->kind = OP_LE; break;
-    case OP_EQ: v->cond->kind = OP_NE; break;
-    case OP_NE: v->cond->kind = OP_EQ; break;
-    case OP_LE: v->cond->kind = '>'; break;
-    case OP_GE: v->cond->kind = '<'; break;
+    case '<':
+    case '>':
+    case OP_LE:
+    case OP_GE:
+      if (is_flotype(v->cond->left->ty) || is_flotype(v->cond->right->ty))
+        return;
+      break;
+
+    case OP_EQ:
+    case OP_NE:
+      break;
+    
+    default:
+      return;
   }
+
+  SwapIfElse(v);
   (*changes)++;
 }
 
@@ -1359,7 +1605,6 @@ static void OptimizeLongComparison(Node *v, Node **vsource, int *changes, int pa
       *pLeft = left->operand;
       *changes += 1;
     }
-    (*changes)++;
   }
 }
 
@@ -1479,46 +1724,237 @@ static void OptimizeAssociatveArgs(Node *v, Node **vsource, int *changes, int pa
     }
   }
 }
+
+/*
+======================================================================
+The optimization passes in the order they run.  Changes made by the
+first two passes have never been counted toward running another
+round, and the table keeps it that way so the output doesn't change.
+======================================================================
+*/
+typedef struct
+{
+  const char  *pName;
+  node_op_t   pFunc;
+  int         counted;      /* Changes cause another round */
+} opt_pass_t;
+
+static const opt_pass_t gOptPasses[] =
+{
+  /* Constant integer math pruning */
+  { "PruneConstIntegerMath",      PruneConstIntegerMath,      0 },
+
+  /* Constant power of 2 integer divide pruning */
+  { "PruneConstPowerOfTwoDivide", PruneConstPowerOfTwoDivide, 0 },
+
+  /* Literal size optimization */
+  { "OptimizeLiteralSizes",       OptimizeLiteralSizes,       1 },
+
+  /* AST_CONV pruning */
+  { "PruneConvNodes",             PruneConvNodes,             1 },
+
+  /* Constant AST_IF pruning */
+  { "PruneConstIfNodes",          PruneConstIfNodes,          1 },
+
+  /* AST_COMPOUND_STMT pruning */
+  { "PruneCompoundStmt",          PruneCompoundStmt,          1 },
+
+  /* Swap single statement else clauses into the then clause */
+  { "OptimizeIfElse",             OptimizeIfElse,             1 },
+
+  /* Put the side the profile says is hot in the else clause */
+  { "OptimizeIfLayout",           OptimizeIfLayout,           1 },
+
+  /* Set >> << |&^ operation sizes */
+  { "OptimizeOperationSize",      OptimizeOperationSize,      1 },
+
+  /* Change x = x + 1 to x++ */
+  { "OptimizePostInc",            OptimizePostInc,            1 },
+
+  /* Change x = x - 1 to x-- */
+  { "OptimizePostDec",            OptimizePostDec,            1 },
+
+  /* AST_CONV to long for comparison against long AST_LITERAL < 65536 */
+  { "OptimizeLongComparison",     OptimizeLongComparison,     1 },
+
+  /* AST_CONV to INT for comparison against long AST_LITERAL < 256 */
+  { "OptimizeIntComparison",      OptimizeIntComparison,      1 },
+
+  /* Put the simpler branch of | & ^ || && on the right */
+  { "OptimizeAssociatveArgs",     OptimizeAssociatveArgs,     1 },
+
+  /* Ensure KIND_BYTE nodes are size 1 */
+  { "CheckByteNodeSizes",         CheckByteNodeSizes,         1 },
+
+  /* Prune return AST_CONV nodes */
+  { "PruneReturnConvNodes",       PruneReturnConvNodes,       1 },
+
+  /* Prune const array access pointer arith */
+  { "PruneConstArrayAdd",         PruneConstArrayAdd,         1 },
+
+  /* Prune assign followed by return */
+  { "PruneAssignReturn",          PruneAssignReturn,          1 },
+};
+
+#define OPT_PASS_COUNT  ((int) (sizeof(gOptPasses) / sizeof(gOptPasses[0])))
+
+/*
+======================================================================
+Record the AST_GVAR, AST_LVAR and AST_LITERAL leaves under a top
+level node.  The parser hands out one node for all uses of a variable
+or an enum constant, so a pass working on one statement can change a
+node that other statements and top levels see too.  The top level
+index is passed in through the changes argument.
+======================================================================
+*/
+static void CollectLeaves(Node *v, Node **vsource, int *changes, int parentAssignChar, Node* vNextSibling)
+{
+  if (v->kind == AST_GVAR || v->kind == AST_LVAR || v->kind == AST_LITERAL)
+  {
+    if (gOpt.nLeaves == gOpt.maxLeaves)
+    {
+      gOpt.maxLeaves = gOpt.maxLeaves ? gOpt.maxLeaves * 2 : 256;
+      gOpt.pLeaves = realloc(gOpt.pLeaves, gOpt.maxLeaves * sizeof(opt_leaf_t));
+    }
+    gOpt.pLeaves[gOpt.nLeaves].v = v;
+    gOpt.pLeaves[gOpt.nLeaves++].top = *changes;
+  }
+
+  /* IterateNodeSearch doesn't descend into '~', but PruneNotConv
+     looks through it */
+  else if (v->kind == '~' && v->operand)
+    IterateNodeSearch(v->operand, &v->operand, &CollectLeaves, changes, parentAssignChar, NULL);
+}
+
+static int CompareLeaves(const void *a, const void *b)
+{
+  const opt_leaf_t *pA = a;
+  const opt_leaf_t *pB = b;
+
+  if (pA->v != pB->v)
+    return pA->v < pB->v ? -1 : 1;
+  return pA->top - pB->top;
+}
+
+/*
+======================================================================
+Find the leaves referenced more than once and build the per top level
+lists of them
+======================================================================
+*/
+static void InitOptimization(Vector *toplevels)
+{
+  int         i, j, k;
+  opt_top_t   *pTop;
+
+  memset(&gOpt, 0, sizeof(gOpt));
+  gOpt.pass = -1;
+  gOpt.epoch = 1;
+  gOpt.nTops = vec_len(toplevels);
+  gOpt.pTops = calloc(gOpt.nTops ? gOpt.nTops : 1, sizeof(opt_top_t));
+
+  for (i = 0; i < gOpt.nTops; i++)
+  {
+    k = i;
+    IterateNodeSearch(vec_get(toplevels, i), NULL, &CollectLeaves, &k, 0, NULL);
+  }
+
+  qsort(gOpt.pLeaves, gOpt.nLeaves, sizeof(opt_leaf_t), CompareLeaves);
+  for (i = 0; i < gOpt.nLeaves; i = j)
+  {
+    for (j = i + 1; j < gOpt.nLeaves && gOpt.pLeaves[j].v == gOpt.pLeaves[i].v; j++)
+      ;
+
+    /* Only referenced once */
+    if (j == i + 1)
+      continue;
+
+    gOpt.pShared = realloc(gOpt.pShared, (gOpt.nShared + 1) * sizeof(opt_shared_t));
+    gOpt.pShared[gOpt.nShared].v = gOpt.pLeaves[i].v;
+    gOpt.pShared[gOpt.nShared].node = *gOpt.pLeaves[i].v;
+    gOpt.pShared[gOpt.nShared].type = *gOpt.pLeaves[i].v->ty;
+
+    for (k = i; k < j; k++)
+    {
+      if (k > i && gOpt.pLeaves[k].top == gOpt.pLeaves[k-1].top)
+        continue;
+      pTop = &gOpt.pTops[gOpt.pLeaves[k].top];
+      pTop->pShared = realloc(pTop->pShared, (pTop->nShared + 1) * sizeof(int));
+      pTop->pShared[pTop->nShared++] = gOpt.nShared;
+    }
+    gOpt.nShared++;
+  }
+  free(gOpt.pLeaves);
+  gOpt.pLeaves = NULL;
+}
+
 /*
 ======================================================================
 Run an optimization over all nodes by iterating the optimization 
-handler through the AST tree.
+handler through the AST tree until it makes no more changes.
 ======================================================================
 */
-static int RunOptimization(Vector *toplevels, node_op_t pFunc)
+static int RunOptimization(Vector *toplevels, int pass)
 {
-  int   i;
-  int   changes;
-  int   opt_changes = 0;
-  Node  *v;
+  int             changes;
+  int             opt_changes = 0;
+  struct timespec start, end;
+
+  if (optstats)
+    clock_gettime(CLOCK_MONOTONIC, &start);
 
-  /* Optimize out AST_CONV nodes that aren't needed */
+  gOpt.pass = pass;
   do
   {
      /* Initialize changes */
      changes = 0;
 
      /* Loop across all top level AST tree nodes */
-     for (i = 0; i < vec_len(toplevels); i++)
-       {
-         v = vec_get(toplevels, i);
-         Node *sibling;
-         if (i < vec_len(toplevels)-1)
-           sibling = vec_get(toplevels, i+1);
-         else
-           sibling = NULL;
-         IterateNodeSearch(v, NULL, pFunc, &changes, 0, sibling);
-       }
+     WalkStatements(toplevels, 1, gOptPasses[pass].pFunc, &changes, 0);
 
      /* Keep track of the number of changes we make to the AST tree */
      gTotalAstChanges += changes;
      opt_changes += changes;
   } while (changes > 0);
+  gOpt.pass = -1;
+
+  gOpt.changes[pass] += opt_changes;
+  if (optstats)
+  {
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    gOpt.msec[pass] += (end.tv_sec - start.tv_sec) * 1000.0 +
+                       (end.tv_nsec - start.tv_nsec) / 1000000.0;
+  }
 
   /* report the number of changes for this optimization */
   return opt_changes;
 }
 
+/*
+======================================================================
+Free the pass state, printing its statistics for -fopt-stats
+======================================================================
+*/
+static void EndOptimization(void)
+{
+  int   i;
+
+  if (optstats)
+  {
+    fprintf(stderr, "ast optimizer: %d toplevels, %d rounds\n", gOpt.nTops, gOpt.rounds);
+    fprintf(stderr, "    %-28s %6s %8s %8s %8s %9s\n", "pass", "walks", "visits",
+            "skipped", "changes", "msec");
+    for (i = 0; i < OPT_PASS_COUNT; i++)
+      fprintf(stderr, "    %-28s %6d %8d %8d %8d %9.3f\n", gOptPasses[i].pName,
+              gOpt.walks[i], gOpt.visits[i], gOpt.skips[i], gOpt.changes[i], gOpt.msec[i]);
+  }
+
+  for (i = 0; i < gOpt.nTops; i++)
+    free(gOpt.pTops[i].pShared);
+  free(gOpt.pTops);
+  free(gOpt.pShared);
+}
+
 /*
 ======================================================================
 Run all known optimizations passes on the AST top level
@@ -1526,70 +1962,27 @@ Run all known optimizations passes on the AST top level
 */
 void LisaOptimizeAST(Vector *toplevels)
 {
+  int pass;
   int changes;
-  int totalChanges = 0;
+  int passChanges;
 
   /* Optimize global variable order */
   OptimizeGlobalVarOrder(toplevels);
 
+  InitOptimization(toplevels);
   do 
   {
-    /* Run the Constant integer math pruning optimization */
-    changes = RunOptimization(toplevels, &PruneConstIntegerMath);
-    
-    /* Run the Constant power of 2 integer divide pruning optimization */
-    changes = RunOptimization(toplevels, &PruneConstPowerOfTwoDivide);
-    
-    /* Run the Literal size optimization */
-    changes = RunOptimization(toplevels, &OptimizeLiteralSizes);
-    
-    /* Run the AST_CONV pruning optimization */
-    changes += RunOptimization(toplevels, &PruneConvNodes);
-    
-    /* Run the AST_CONV pruning optimization */
-    changes += RunOptimization(toplevels, &PruneConstIfNodes);
-    
-    /* Run the AST_COMPOUND_STMT pruning optimization */
-    changes += RunOptimization(toplevels, &PruneCompoundStmt);
-    
-    /* Run the AST_COMPOUND_STMT pruning optimization */
-    changes += RunOptimization(toplevels, &OptimizeIfElse);
-
-    /* Run optimization to set >> << |&^ operation sizes */
-    changes += RunOptimization(toplevels, &OptimizeOperationSize);
- 
-    /* Run optimization to change x = x + 1 to x++ */
-    changes += RunOptimization(toplevels, &OptimizePostInc);
- 
-    /* Run optimization to change x = x - 1 to x++ */
-    changes += RunOptimization(toplevels, &OptimizePostDec);
- 
-    /* Run optimization for AST_CONV to long for comparison
-     * against long AST_LITERAL that is < 65536 */
-    changes += RunOptimization(toplevels, &OptimizeLongComparison);
-
-    /* Run optimization for AST_CONV to INT for comparison
-     * against long AST_LITERAL that is < 256 */
-    changes += RunOptimization(toplevels, &OptimizeIntComparison);
-
-    /* Run optimization for | & ^ || && to put simpler branch on right */
-    changes += RunOptimization(toplevels, &OptimizeAssociatveArgs);
- 
-    /* Run optimization to ensure KIND_BYTE nodes are size 1 */
-    changes += RunOptimization(toplevels, &CheckByteNodeSizes);
- 
-    /* Prune return RETURN nodes */
-    changes += RunOptimization(toplevels, &PruneReturnConvNodes);
- 
-    /* Prune const array access pointer arith */
-    changes += RunOptimization(toplevels, &PruneConstArrayAdd);
- 
-    /* Prune assign followed by return */
-    changes += RunOptimization(toplevels, &PruneAssignReturn);
- 
-    totalChanges += changes;
+    changes = 0;
+    gOpt.rounds++;
+    for (pass = 0; pass < OPT_PASS_COUNT; pass++)
+    {
+      passChanges = RunOptimization(toplevels, pass);
+      if (gOptPasses[pass].counted)
+        changes += passChanges;
+    }
   } while (changes > 0);
+  EndOptimization();
 
 //  printf("Parsed %d AST_CONV nodes\n", gConvCount);
-//  printf("Pruned %d AST_* nodes\n", totalChanges);
+//  printf("Pruned %d AST_* nodes\n", gTotalAstChanges);
 }
@@ -39,6 +39,7 @@ static Vector *toplevels;
 static Vector *localvars;
 static Vector *gotos;
 static Vector *cases;
+static ProfSite *switch_site;
 static Type *current_func_type;
 
 static char *defaultcase;
@@ -122,7 +123,7 @@ enum {
 
 static void mark_location() {
     Token *tok = peek();
-    source_loc = malloc(sizeof(SourceLoc));
+    source_loc = arena_alloc(&ast_arena, sizeof(SourceLoc));
     source_loc->file = tok->file->name;
     source_loc->line = tok->line;
 #if 0
@@ -172,7 +173,7 @@ static char *make_static_label(char *name) {
 }
 
 static Case *make_case(int beg, int end, char *label) {
-    Case *r = malloc(sizeof(Case));
+    Case *r = arena_alloc(&ast_arena, sizeof(Case));
     r->beg = beg;
     r->end = end;
     r->label = label;
@@ -184,13 +185,13 @@ static Map *env() {
 }
 
 static Type *copy_type(Type *ty) {
-    Type *r = malloc(sizeof(Type));
+    Type *r = arena_alloc(&ast_arena, sizeof(Type));
     memcpy(r, ty, sizeof(Type));
     return r;
 }
 
 static Node *make_ast(Node *tmpl) {
-    Node *r = malloc(sizeof(Node));
+    Node *r = arena_alloc(&ast_arena, sizeof(Node));
     *r = *tmpl;
     r->sourceLoc = source_loc;
     return r;
@@ -320,16 +321,24 @@ static Node *ast_conv(Type *totype, Node *val) {
 }
 
 static Node *ast_if(Node *cond, Node *then, Node *els) {
+    return make_ast(&(Node){ AST_IF, .cond = cond, .then = then, .els = els });
+}
+
+// An if statement is located at its 'if' keyword, which read_stmt pushed
+// onto if_source_loc_stack.  Loops build their AST_IFs with plain ast_if.
+static Node *ast_if_stmt(Node *cond, Node *then, Node *els) {
     SourceLoc *source_loc_save = source_loc;
     Node *ret;
     source_loc = if_source_loc_stack[--if_source_stack_idx];
-    ret = make_ast(&(Node){ AST_IF, .cond = cond, .then = then, .els = els });
+    ret = ast_if(cond, then, els);
+    ret->prof = prof_site(source_loc);
     source_loc = source_loc_save;
     return ret;
 }
 
 static Node *ast_ternary(Type *ty, Node *cond, Node *then, Node *els) {
-    return make_ast(&(Node){ AST_TERNARY, copy_type(ty), .cond = cond, .then = then, .els = els });
+    return make_ast(&(Node){ AST_TERNARY, copy_type(ty), .cond = cond, .then = then, .els = els,
+                             .prof = prof_site(source_loc) });
 }
 
 static Node *ast_return(Node *retval) {
@@ -369,13 +378,13 @@ static Node *ast_label_addr(char *label) {
 }
 
 static Type *make_type(Type *tmpl) {
-    Type *r = malloc(sizeof(Type));
+    Type *r = arena_alloc(&ast_arena, sizeof(Type));
     *r = *tmpl;
     return r;
 }
 
 static Type *make_numtype(int kind, bool usig) {
-    Type *r = calloc(1, sizeof(Type));
+    Type *r = arena_calloc(&ast_arena, sizeof(Type));
     r->kind = kind;
     r->usig = usig;
     if (kind == KIND_VOID)         r->size = r->align = 0;
@@ -535,7 +544,7 @@ static bool next_token(int kind) {
 }
 
 void *make_pair(void *first, void *second) {
-    void **r = malloc(sizeof(void *) * 2);
+    void **r = arena_alloc(&ast_arena, sizeof(void *) * 2);
     r[0] = first;
     r[1] = second;
     return r;
@@ -1130,6 +1139,8 @@ static Node *read_unary_addr() {
       sprintf(line, "%d", tok->line);
       errorf(tok->file->name, line, "Can't take address of an SFR!\n");
     }
+    if (operand->kind == AST_LVAR)
+        operand->addrtaken = true;
     return ast_uop(AST_ADDR, make_ptr_type(operand->ty), operand);
 }
 
@@ -1244,7 +1255,8 @@ static Node *read_shift_expr() {
         Node *right = read_additive_expr();
         ensure_inttype(node);
         ensure_inttype(right);
-        node = ast_binop(node->ty, op, conv(node), conv(right));
+        Node *left = conv(node);
+        node = ast_binop(left->ty, op, left, conv(right));
     }
     return node;
 }
@@ -1446,7 +1458,7 @@ static Vector *read_rectype_fields_sub() {
             ensure_not_void(fieldtype);
             fieldtype = copy_type(fieldtype);
             fieldtype->bitsize = next_token(':') ? read_bitsize(name, fieldtype) : -1;
-            if (fieldtype->bitsize < 9)
+            if (fieldtype->bitsize > 0 && fieldtype->bitsize < 9)
             {
                fieldtype->kind = KIND_CHAR;
                fieldtype->size = 1;
@@ -2448,9 +2460,9 @@ static Node *read_if_stmt() {
     expect(')');
     Node *then = read_stmt();
     if (!next_token(KELSE))
-        return ast_if(cond, then, NULL);
+        return ast_if_stmt(cond, then, NULL);
     Node *els = read_stmt();
-    return ast_if(cond, then, els);
+    return ast_if_stmt(cond, then, els);
 }
 
 /*
@@ -2574,7 +2586,139 @@ static Node *make_switch_jump(Node *var, Case *c) {
         Node *y = ast_binop(type_int, OP_LE, var, ast_inttype(type_int, c->end));
         cond = ast_binop(type_int, OP_LOGAND, x, y);
     }
-    return ast_if(cond, ast_jump(c->label), NULL);
+    Node *r = ast_if(cond, ast_jump(c->label), NULL);
+    r->prof = prof_case_site(switch_site, c->beg);
+    return r;
+}
+
+// A switch with more cases than SWITCH_CHAIN_MAX uses a jump table when the
+// table has at most SWITCH_TABLE_SPREAD entries per case and fits the
+// unsigned char index, and a binary tree of compares otherwise.  A leaf of
+// the tree compares up to SWITCH_LEAF_MAX cases in turn.
+#define SWITCH_CHAIN_MAX    4
+#define SWITCH_TABLE_SPREAD 3
+#define SWITCH_TABLE_MAX    256
+#define SWITCH_LEAF_MAX     3
+
+static int compare_cases(const void *a, const void *b) {
+    Case *x = *(Case **)a;
+    Case *y = *(Case **)b;
+    return x->beg < y->beg ? -1 : x->beg > y->beg;
+}
+
+// Gets the range of values a switch variable of type ty can hold.
+// Returns false if it is wider than an int.
+static bool switch_range(Type *ty, long *min, long *max) {
+    if (ty->size > type_int->size)
+        return false;
+    int bits = ty->size * 8;
+    *min = ty->usig ? 0 : -(1L << (bits - 1));
+    *max = ty->usig ? (1L << bits) - 1 : (1L << (bits - 1)) - 1;
+    return true;
+}
+
+// With -fprofile-use, orders cases compared in turn from the most taken.
+// The order doesn't change what the compares do, since the cases of a
+// switch that fits an int never match the same value.
+static void order_cases(Case **c, int n) {
+    for (int i = 1; i < n; i++) {
+        Case *x = c[i];
+        long count = prof_case_count(switch_site, x->beg);
+        int j = i;
+        for (; j > 0 && prof_case_count(switch_site, c[j - 1]->beg) < count; j--)
+            c[j] = c[j - 1];
+        c[j] = x;
+    }
+}
+
+static Node *make_switch_tree(Node *var, Case **c, int n, char *deflabel) {
+    if (n <= SWITCH_LEAF_MAX) {
+        order_cases(c, n);
+        Vector *v = make_vector();
+        for (int i = 0; i < n; i++)
+            vec_push(v, make_switch_jump(var, c[i]));
+        vec_push(v, ast_jump(deflabel));
+        return ast_compound_stmt(v);
+    }
+    int mid = n / 2;
+    Node *cond = ast_binop(type_int, '<', var, ast_inttype(var->ty, c[mid]->beg));
+    return ast_if(cond, make_switch_tree(var, c, mid, deflabel),
+                  make_switch_tree(var, c + mid, n - mid, deflabel));
+}
+
+// Jumps through a table indexed by the low byte of var - min, once var is
+// known to be in range.
+static void make_switch_table(Vector *v, Node *var, Case **c, int n, char *deflabel,
+                              long tymin, long tymax) {
+    int min = c[0]->beg;
+    int max = c[n - 1]->end;
+    if (min > tymin)
+        vec_push(v, ast_if(ast_binop(type_int, '<', var, ast_inttype(var->ty, min)),
+                           ast_jump(deflabel), NULL));
+    if (max < tymax)
+        vec_push(v, ast_if(ast_binop(type_int, '>', var, ast_inttype(var->ty, max)),
+                           ast_jump(deflabel), NULL));
+
+    Node *idx = var;
+    if (var->ty->size != 1 || !var->ty->usig)
+        idx = ast_conv(type_uchar, var);
+    if (min & 0xFF)
+        idx = ast_binop(type_uchar, '-', idx, ast_inttype(type_uchar, min & 0xFF));
+
+    Vector *labels = make_vector();
+    for (int i = 0; i < n; i++) {
+        for (int val = vec_len(labels) + min; val < c[i]->beg; val++)
+            vec_push(labels, deflabel);
+        for (int val = c[i]->beg; val <= c[i]->end; val++)
+            vec_push(labels, c[i]->label);
+    }
+    vec_push(v, make_ast(&(Node){ AST_SWITCH_TABLE, .tableidx = idx, .tablelabels = labels }));
+}
+
+// Pushes the code that jumps to the case matching var, or to deflabel.
+// A few cases are compared in turn.  More are found through a jump table
+// if they are dense, else through a binary tree of compares.
+static void make_switch_dispatch(Vector *v, Node *var, Vector *cases, char *deflabel) {
+    int n = vec_len(cases);
+    long tymin, tymax;
+    Case **c = NULL;
+    int len = 0;
+
+    // Case values outside the range of a char never match.  Those of an int
+    // wrap around, so such a switch keeps the chain.
+    if (switch_range(var->ty, &tymin, &tymax)) {
+        c = arena_alloc(&ast_arena, (n + 1) * sizeof(Case *));
+        for (int i = 0; c && i < n; i++) {
+            Case *x = vec_get(cases, i);
+            if (x->beg >= tymin && x->end <= tymax)
+                c[len++] = x;
+            else if (var->ty->size > 1)
+                c = NULL;
+            else if (x->end >= tymin && x->beg <= tymax)
+                c[len++] = make_case(MAX(x->beg, tymin), MIN(x->end, tymax), x->label);
+        }
+    }
+    if (!c) {
+        for (int i = 0; i < n; i++)
+            vec_push(v, make_switch_jump(var, vec_get(cases, i)));
+        vec_push(v, ast_jump(deflabel));
+        return;
+    }
+
+    if (len <= SWITCH_CHAIN_MAX) {
+        order_cases(c, len);
+        for (int i = 0; i < len; i++)
+            vec_push(v, make_switch_jump(var, c[i]));
+        vec_push(v, ast_jump(deflabel));
+        return;
+    }
+
+    qsort(c, len, sizeof(Case *), compare_cases);
+    long span = (long)c[len - 1]->end - c[0]->beg + 1;
+    if (span <= SWITCH_TABLE_MAX && span <= len * SWITCH_TABLE_SPREAD)
+        make_switch_table(v, var, c, len, deflabel, tymin, tymax);
+    else
+        vec_push(v, make_switch_tree(var, c, len, deflabel));
 }
 
 // C11 6.8.4.2p3: No two case constant expressions have the same value.
@@ -2605,6 +2749,7 @@ static void check_case_duplicates(Vector *cases) {
     lbreak = obreak
 
 static Node *read_switch_stmt() {
+    ProfSite *site = prof_site(source_loc);
     expect('(');
     Node *expr = conv(read_expr());
     ensure_inttype(expr);
@@ -2615,6 +2760,10 @@ static Node *read_switch_stmt() {
     Node *body = read_stmt();
     Vector *v = make_vector();
     Node *var;
+
+    // Cases compare against a char before its promotion to int
+    if (expr->kind == AST_CONV && is_inttype(expr->operand->ty) && expr->operand->ty->size == 1)
+        expr = expr->operand;
     if (expr->kind == AST_LVAR || expr->kind == AST_GVAR)
         var = expr;
     else
@@ -2622,9 +2771,8 @@ static Node *read_switch_stmt() {
         var = ast_lvar(expr->ty, make_tempname());
         vec_push(v, ast_binop(expr->ty, '=', var, expr));
     }
-    for (int i = 0; i < vec_len(cases); i++)
-        vec_push(v, make_switch_jump(var, vec_get(cases, i)));
-    vec_push(v, ast_jump(defaultcase ? defaultcase : end));
+    switch_site = site;
+    make_switch_dispatch(v, var, cases, defaultcase ? defaultcase : end);
     if (body)
         vec_push(v, body);
     vec_push(v, ast_dest(end));
@@ -0,0 +1,156 @@
+// Copyright 2026 Ken Pettit <pettitkd@gmail.com>
+// Released under the MIT license.
+
+// Branch profiles (-fprofile-generate and -fprofile-use=FILE).
+//
+// Every if statement, conditional expression and switch of the file being
+// compiled is a site, named after its source location:
+//
+//     <file>.<line>.<n>           n counts the sites on the line from 0
+//     <file>.<line>.<n>.<case>    compare of a switch against a case value
+//
+// where <file> is the base name of the source with anything other than
+// letters and digits changed to '_', and a negative case value is written
+// as m<value>.  Sites of included files are not named, since the code of
+// a header can be in more than one object of a program.
+//
+// With -fprofile-generate the code of each site gets two public probe
+// labels:  __pgo.<site>.c where the condition is evaluated, and
+// __pgo.<site>.t at the start of the then side (__pgo.<site>.f if an AST
+// pass swapped it with the else side).  lisa_sim -m <map> -g <profile>
+// counts the instructions run at those labels and writes one line per
+// site, "<site> <count> <taken>": the times the branch ran and the times
+// its condition, as written in the source, was true.  Profiles of several
+// runs can be concatenated; their counts are summed when read.
+//
+// With -fprofile-use the counts of the profile are given to the sites, and
+// the AST passes and the switch lowering place the hot code from them.
+
+#include <ctype.h>
+#include <errno.h>
+#include <libgen.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lisacc.h"
+
+bool profile_generate;
+char *profile_use;
+
+// Sites named so far, by "<file>.<line>", and the counts of the profile
+static Map *site_lines;
+static Map *profile;
+
+typedef struct {
+    long count;
+    long taken;
+} Counts;
+
+static void load_profile(char *filename) {
+    FILE *fp = fopen(filename, "r");
+    if (!fp)
+        error("cannot open profile %s: %s", filename, strerror(errno));
+
+    char line[512], name[256];
+    long count, taken;
+    while (fgets(line, sizeof(line), fp)) {
+        if (line[0] == '#')
+            continue;
+        if (sscanf(line, "%255s %ld %ld", name, &count, &taken) != 3)
+            continue;
+        Counts *c = map_get(profile, name);
+        if (!c) {
+            c = calloc(1, sizeof(Counts));
+            map_put(profile, strdup(name), c);
+        }
+        c->count += count;
+        c->taken += taken;
+    }
+    fclose(fp);
+}
+
+void prof_init(void) {
+    site_lines = make_map();
+    profile = make_map();
+    if (profile_use)
+        load_profile(profile_use);
+}
+
+static ProfSite *make_site(char *name) {
+    ProfSite *s = arena_calloc(&ast_arena, sizeof(ProfSite));
+    s->name = name;
+    s->count = -1;
+    Counts *c = map_get(profile, name);
+    if (c) {
+        s->count = c->count;
+        s->taken = c->taken < c->count ? c->taken : c->count;
+    }
+    return s;
+}
+
+// Returns the site of the branch at loc, or NULL if no profile is being
+// generated or used.
+ProfSite *prof_site(SourceLoc *loc) {
+    if (!profile_generate && !profile_use)
+        return NULL;
+    if (!loc || strcmp(loc->file, get_base_file()))
+        return NULL;
+
+    char *file = format("%s", basename(strdup(loc->file)));
+    for (char *p = file; *p; p++)
+        if (!isalnum(*p))
+            *p = '_';
+    char *key = format("%s.%d", file, loc->line);
+    int n = (intptr_t)map_get(site_lines, key);
+    map_put(site_lines, key, (void *)(intptr_t)(n + 1));
+    return make_site(format("%s.%d", key, n));
+}
+
+static char *case_name(ProfSite *sw, long val) {
+    if (val < 0)
+        return format("%s.m%ld", sw->name, -val);
+    return format("%s.%ld", sw->name, val);
+}
+
+// Returns the site of the compare of switch sw against the case starting
+// at val.
+ProfSite *prof_case_site(ProfSite *sw, long val) {
+    return sw ? make_site(case_name(sw, val)) : NULL;
+}
+
+// The times switch sw went to the case starting at val, -1 if the profile
+// has no count
+long prof_case_count(ProfSite *sw, long val) {
+    Counts *c = sw ? map_get(profile, case_name(sw, val)) : NULL;
+    return c ? c->taken : -1;
+}
+
+// The times the then side of a site ran, -1 if the profile has no count
+long prof_then_count(ProfSite *s) {
+    if (!s || s->count < 0)
+        return -1;
+    return s->swapped ? s->count - s->taken : s->taken;
+}
+
+long prof_else_count(ProfSite *s) {
+    if (!s || s->count < 0)
+        return -1;
+    return s->swapped ? s->taken : s->count - s->taken;
+}
+
+// Records that the then and else sides of a site were exchanged, and its
+// condition reversed.
+void prof_swap(ProfSite *s) {
+    if (s)
+        s->swapped = !s->swapped;
+}
+
+// Returns the probe label of a site for -fprofile-generate:  kind 'c' where
+// the condition is evaluated and 't' at the then side.  Returns NULL if
+// there is no probe to emit.
+char *prof_label(ProfSite *s, char kind) {
+    if (!profile_generate || !s)
+        return NULL;
+    if (kind == 't' && s->swapped)
+        kind = 'f';
+    return format("__pgo.%s.%c", s->name, kind);
+}
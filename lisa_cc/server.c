@@ -0,0 +1,266 @@
+// Copyright 2026 Ken Pettit <pettitkd@gmail.com>
+// Released under the MIT license.
+
+// Compile server.  "lisa_cc --server" initializes the preprocessor and
+// parser once -- keywords, builtin macros, the lisacc.h typedefs, an
+// in-memory copy of the standard headers and the preprocessed macros of
+// those that only define macros -- then serves compile requests
+// from lisa_cc_client over a Unix socket.  Each request runs in a forked
+// worker that starts from that warm state, so a build pays the process
+// start and init cost once instead of once per file, and a compile error
+// (which exits) only ends its own worker.  The server itself reads each
+// request, forks its worker and, once the worker exits, sends the exit
+// status back to the client.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "lisacc.h"
+#include "server.h"
+
+static void server_fail(char *what) {
+    fprintf(stderr, "lisa_cc: %s: %s\n", what, strerror(errno));
+    exit(1);
+}
+
+static int listen_on(char *path) {
+    struct sockaddr_un addr;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "lisa_cc: socket path too long: %s\n", path);
+        exit(1);
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        server_fail("socket");
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    // Replace a stale socket left by a previous server, but nothing else
+    struct stat st;
+    if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode))
+        unlink(path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+        server_fail(path);
+    if (listen(fd, 64) < 0)
+        server_fail("listen");
+    return fd;
+}
+
+static bool read_full(int fd, void *buf, size_t len) {
+    char *p = buf;
+    while (len > 0) {
+        ssize_t n = read(fd, p, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+// Receives the request header and the client's stdio descriptors.
+static bool read_header(int conn, ServerRequest *req, int *fds) {
+    char cbuf[CMSG_SPACE(sizeof(int) * SERVER_NFDS)];
+    struct iovec iov = { req, sizeof(*req) };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cbuf;
+    msg.msg_controllen = sizeof(cbuf);
+    ssize_t n = recvmsg(conn, &msg, 0);
+    if (n <= 0)
+        return false;
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if (!cmsg || cmsg->cmsg_type != SCM_RIGHTS ||
+        cmsg->cmsg_len != CMSG_LEN(sizeof(int) * SERVER_NFDS))
+        return false;
+    memcpy(fds, CMSG_DATA(cmsg), sizeof(int) * SERVER_NFDS);
+    if (n < sizeof(*req) && !read_full(conn, (char *)req + n, sizeof(*req) - n))
+        return false;
+    return !memcmp(req->magic, SERVER_MAGIC, 4) && req->argc > 0 &&
+        req->size <= SERVER_MAX_REQUEST;
+}
+
+// Splits the request body into the working directory and argv.
+static char **split_request(char *body, uint32_t size, uint32_t argc, char **cwd) {
+    if (size == 0 || body[size - 1] != '\0')
+        return NULL;
+    char **argv = calloc(argc + 1, sizeof(char *));
+    char *p = body;
+    char *end = body + size;
+    *cwd = p;
+    p += strlen(p) + 1;
+    for (uint32_t i = 0; i < argc; i++) {
+        if (p >= end) {
+            free(argv);
+            return NULL;
+        }
+        argv[i] = p;
+        p += strlen(p) + 1;
+    }
+    return argv;
+}
+
+// Workers in flight and the connections waiting for their status
+typedef struct {
+    pid_t pid;
+    int conn;
+} Worker;
+
+static Worker *workers;
+static int nworkers;
+static int maxworkers;
+static int child_pipe[2];
+static int listen_fd;
+
+// Closes the server's descriptors in a new worker.
+static void close_server_fds(int conn) {
+    for (int i = 0; i < nworkers; i++)
+        close(workers[i].conn);
+    close(conn);
+    close(listen_fd);
+    close(child_pipe[0]);
+    close(child_pipe[1]);
+}
+
+// Reads a request from conn and forks the worker that compiles it.
+// Returns the worker's pid, or -1 if the request was malformed.
+static pid_t start_request(int conn) {
+    ServerRequest req;
+    int fds[SERVER_NFDS] = { -1, -1, -1 };
+    char *body = NULL;
+    char *cwd;
+    char **argv = NULL;
+    if (read_header(conn, &req, fds)) {
+        body = malloc(req.size + 1);
+        if (read_full(conn, body, req.size))
+            argv = split_request(body, req.size, req.argc, &cwd);
+    }
+    pid_t pid = -1;
+    if (argv)
+        pid = fork();
+    if (pid == 0) {
+        close_server_fds(conn);
+        for (int i = 0; i < SERVER_NFDS; i++) {
+            dup2(fds[i], i);
+            close(fds[i]);
+        }
+        signal(SIGCHLD, SIG_DFL);
+        signal(SIGPIPE, SIG_DFL);
+        if (chdir(cwd) < 0) {
+            fprintf(stderr, "lisa_cc: %s: %s\n", cwd, strerror(errno));
+            exit(1);
+        }
+        exit(compile_request(req.argc, argv));
+    }
+    for (int i = 0; i < SERVER_NFDS; i++)
+        if (fds[i] >= 0)
+            close(fds[i]);
+    free(argv);
+    free(body);
+    return pid;
+}
+
+static char *socket_path(char *arg) {
+    if (arg)
+        return arg;
+    char path[PATH_MAX];
+    if (!server_socket_path(path, sizeof(path), true))
+        server_fail("socket directory");
+    return strdup(path);
+}
+
+static void on_sigchld(int sig) {
+    int saved = errno;
+    write(child_pipe[1], "", 1);
+    errno = saved;
+}
+
+// Sends each finished worker's exit status to its client.
+static void reap_workers(void) {
+    int status;
+    pid_t pid;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        for (int i = 0; i < nworkers; i++) {
+            if (workers[i].pid != pid)
+                continue;
+            int32_t result = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+            write(workers[i].conn, &result, sizeof(result));
+            close(workers[i].conn);
+            workers[i] = workers[--nworkers];
+            break;
+        }
+    }
+}
+
+int run_server(char *arg) {
+    char *path = socket_path(arg);
+    lex_init_buffers();
+    cpp_init_server();
+    parse_init();
+
+    int fd = listen_fd = listen_on(path);
+    if (pipe(child_pipe) < 0)
+        server_fail("pipe");
+    fcntl(child_pipe[0], F_SETFL, O_NONBLOCK);
+    fcntl(child_pipe[1], F_SETFL, O_NONBLOCK);
+    signal(SIGCHLD, on_sigchld);
+    signal(SIGPIPE, SIG_IGN);
+    fprintf(stderr, "lisa_cc: compile server listening on %s\n", path);
+
+    struct timeval timeout = { SERVER_READ_TIMEOUT, 0 };
+    for (;;) {
+        struct pollfd pfd[2] = { { child_pipe[0], POLLIN, 0 }, { fd, POLLIN, 0 } };
+        if (poll(pfd, 2, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            server_fail("poll");
+        }
+        if (pfd[0].revents) {
+            char buf[64];
+            while (read(child_pipe[0], buf, sizeof(buf)) > 0)
+                ;
+            reap_workers();
+        }
+        if (!pfd[1].revents)
+            continue;
+        int conn = accept(fd, NULL, NULL);
+        if (conn < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            server_fail("accept");
+        }
+        // A worker can read and write anything the server's user can
+        if (!server_peer_ok(conn)) {
+            close(conn);
+            continue;
+        }
+        setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        pid_t pid = start_request(conn);
+        if (pid < 0) {
+            close(conn);
+            continue;
+        }
+        if (nworkers == maxworkers) {
+            maxworkers = maxworkers ? maxworkers * 2 : 16;
+            workers = realloc(workers, maxworkers * sizeof(Worker));
+        }
+        workers[nworkers].pid = pid;
+        workers[nworkers].conn = conn;
+        nworkers++;
+    }
+}
@@ -0,0 +1,42 @@
+// Copyright 2026 Ken Pettit <pettitkd@gmail.com>
+// Released under the MIT license.
+
+// Wire protocol between the lisa_cc compile server (lisa_cc --server)
+// and its client, lisa_cc_client.
+//
+// The client connects to the server's Unix socket and sends one request:
+// a ServerRequest header followed by 'size' bytes holding the client's
+// working directory and then each argv string, all NUL terminated.  The
+// client's stdin, stdout and stderr descriptors ride along as SCM_RIGHTS
+// ancillary data on the first message, so the compile reads and writes
+// the client's own streams.  The server answers with a single int32_t:
+// the compile's exit status, or 128 + signal if it was killed.
+//
+// Only a client and server of the same user talk:  see serverutil.c.
+
+#ifndef LISA_CC_SERVER_H
+#define LISA_CC_SERVER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SERVER_MAGIC "LCCS"
+#define SERVER_ENV "LISA_CC_SERVER"
+#define SERVER_DEFAULT_DIR "/tmp/lisa_cc-%d"  // formatted with getuid()
+#define SERVER_SOCKET_NAME "lisa_cc.sock"
+#define SERVER_MAX_REQUEST (1024 * 1024)
+#define SERVER_NFDS 3
+#define SERVER_READ_TIMEOUT 5   // seconds the server waits for a request
+
+typedef struct {
+    char magic[4];
+    uint32_t argc;
+    uint32_t size;
+} ServerRequest;
+
+// serverutil.c
+bool server_socket_path(char *buf, size_t size, bool create);
+bool server_peer_ok(int fd);
+
+#endif
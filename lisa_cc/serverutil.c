@@ -0,0 +1,74 @@
+// Copyright 2026 Ken Pettit <pettitkd@gmail.com>
+// Released under the MIT license.
+
+// Socket location and peer checks shared by the compile server and
+// lisa_cc_client.  A worker runs with the server's user and reads and
+// writes files for whoever connects, so each side only talks to a peer
+// of its own user:  the default socket lives in a directory only the user
+// can enter, and both ends check the other's credentials on connect.
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "server.h"
+
+// Returns true if dir is a real directory owned by the user that no one
+// else can enter.
+static bool private_dir(char *dir) {
+    struct stat st;
+    if (lstat(dir, &st) < 0 || !S_ISDIR(st.st_mode))
+        return false;
+    return st.st_uid == getuid() && (st.st_mode & 077) == 0;
+}
+
+// Writes the socket path to use into buf:  $LISA_CC_SERVER if set, else
+// lisa_cc.sock in $XDG_RUNTIME_DIR, else in /tmp/lisa_cc-<uid>, which is
+// made with mode 0700 if create is set.  Returns false, with errno set,
+// if the path does not fit or its directory is not private to the user.
+bool server_socket_path(char *buf, size_t size, bool create) {
+    char dir[128];
+    char *env = getenv(SERVER_ENV);
+    if (env && *env) {
+        if (snprintf(buf, size, "%s", env) >= size) {
+            errno = ENAMETOOLONG;
+            return false;
+        }
+        return true;
+    }
+
+    char *runtime = getenv("XDG_RUNTIME_DIR");
+    if (runtime && *runtime) {
+        if (snprintf(dir, sizeof(dir), "%s", runtime) >= sizeof(dir)) {
+            errno = ENAMETOOLONG;
+            return false;
+        }
+    } else {
+        snprintf(dir, sizeof(dir), SERVER_DEFAULT_DIR, (int)getuid());
+        if (create && mkdir(dir, 0700) < 0 && errno != EEXIST)
+            return false;
+    }
+    if (!private_dir(dir)) {
+        errno = EACCES;
+        return false;
+    }
+    if (snprintf(buf, size, "%s/%s", dir, SERVER_SOCKET_NAME) >= size) {
+        errno = ENAMETOOLONG;
+        return false;
+    }
+    return true;
+}
+
+// Returns true if the process at the other end of the connected socket
+// fd runs as the same user as this one.
+bool server_peer_ok(int fd) {
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0)
+        return false;
+    return len == sizeof(cred) && cred.uid == getuid();
+}
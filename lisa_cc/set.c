@@ -12,13 +12,16 @@
 // It should be very fast for small number of items.
 // However, if you plan to add a lot of items to a set,
 // you should consider using Map as a set.
+//
+// Sets are only used for the preprocessor's hidesets, so they are
+// allocated from the token arena.
 
 #include <stdlib.h>
 #include <string.h>
 #include "lisacc.h"
 
 Set *set_add(Set *s, char *v) {
-    Set *r = malloc(sizeof(Set));
+    Set *r = arena_alloc(&token_arena, sizeof(Set));
     r->next = s;
     r->v = v;
     return r;
@@ -0,0 +1,553 @@
+// Copyright 2026 Ken Pettit <pettitkd@gmail.com>
+// Released under the MIT license.
+
+// On-disk token cache for headers (-ftoken-cache=DIR).
+//
+// Every call the preprocessor makes into the lexer on a header -- lex(),
+// read_header_file_name() and skip_cond_incl() -- is recorded together
+// with the position in the file before and after it, and what it
+// returned.  When the header is closed the recording is written to DIR,
+// under a name derived from the header's path.  The next compile that
+// includes the header, unchanged on disk, replays the recorded result of
+// each call instead of lexing the characters again.
+//
+// A call is only replayed when the file is in exactly the position the
+// call was recorded at, so what the preprocessor does with the header
+// never has to be part of the key.  If a different -D, -U or include
+// path takes another #if branch, the calls that differ miss the cache and
+// are lexed from the characters as usual, since the position is always
+// kept in step with the replayed calls.  Their results are added to the
+// entry, so it ends up covering every branch that was taken.  The macro
+// table is rebuilt by the preprocessor from the replayed #define tokens.
+//
+// Calls that move on into the including file, or that print a warning,
+// are never recorded.  An entry is dropped when the header's size, mtime
+// or inode no longer match, or when it was written by another build of the
+// compiler, whose token kinds and keyword ids may differ.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "lisacc.h"
+
+#define MAGIC "LTC"
+#define VERSION 3
+
+char *token_cache_dir;
+
+// The state of a File that the lexer's result depends on
+typedef struct {
+    uint32_t off;
+    int32_t column;
+    int16_t last;
+    uint8_t buflen;
+    uint8_t buf[3];
+} State;
+
+typedef struct {
+    State before;
+    State after;
+    uint8_t kind;
+    uint8_t ntok;
+    uint8_t std;
+    uint8_t pad;
+    int32_t dline;    // line and ntok deltas
+    int32_t dntok;
+    int32_t pline;    // lexer mark position, line relative to before
+    int32_t pcolumn;
+    int32_t arg;      // first token, or the header name string (-1 if none)
+} Item;
+
+typedef struct {
+    uint8_t kind;
+    uint8_t space;
+    uint8_t bol;
+    uint8_t enc;
+    int32_t id;       // id for TKEYWORD, c for TCHAR and TINVALID
+    int32_t str;      // sval string for TIDENT, TNUMBER and TSTRING
+    int32_t slen;
+    int32_t dline;    // line and count relative to the item's before state
+    int32_t column;
+    int32_t dcount;
+} CachedToken;
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint64_t build;
+    int64_t size;
+    int64_t mtime;
+    int64_t mtime_nsec;
+    int64_t ino;
+    uint32_t pathlen;
+    uint32_t nstrs;
+    uint32_t strbytes;
+    uint32_t nitems;
+    uint32_t ntoks;
+} Header;
+
+struct TokenCache {
+    char *path;
+    Header key;
+    Item *items;
+    int nitems;
+    int maxitems;
+    CachedToken *toks;
+    int ntoks;
+    int maxtoks;
+    char **strs;      // NUL terminated; idents are interned
+    int *slens;       // including the NUL
+    uint8_t *sflags;
+    int nstrs;
+    int maxstrs;
+    Map *idents;      // ident -> string number + 1, while recording
+    int *heads;       // items hashed by offset
+    int *chain;
+    int hashsize;
+    int cursor;       // the item expected next
+    bool owned;       // items and toks are malloc'ed, not in the mapped entry
+    bool dirty;
+};
+
+enum { STR_IDENT = 1 };
+
+#define FNV_BASIS 14695981039346656037ULL
+
+static uint64_t fnv(uint64_t r, void *p, size_t len) {
+    // FNV hash
+    for (unsigned char *s = p; len > 0; s++, len--) {
+        r ^= *s;
+        r *= 1099511628211ULL;
+    }
+    return r;
+}
+
+static uint64_t hash64(char *s) {
+    return fnv(FNV_BASIS, s, strlen(s));
+}
+
+static uint64_t hash_keyword(uint64_t r, char *str, int id) {
+    r = fnv(r, str, strlen(str) + 1);
+    return fnv(r, &id, sizeof(id));
+}
+
+// Identifies the compiler build:  a hash of the keyword table, and of the
+// size and mtime of the lisa_cc binary for the changes the table does
+// not show.
+static uint64_t build_id(void) {
+    static uint64_t id;
+    if (id)
+        return id;
+    id = FNV_BASIS;
+#define op(ident, str)         id = hash_keyword(id, str, ident);
+#define keyword(ident, str, _) id = hash_keyword(id, str, ident);
+#include "keyword.inc"
+#undef keyword
+#undef op
+    struct stat st;
+    if (stat("/proc/self/exe", &st) == 0) {
+        id = fnv(id, &st.st_size, sizeof(st.st_size));
+        id = fnv(id, &st.st_mtim, sizeof(st.st_mtim));
+    }
+    return id;
+}
+
+static char *cache_file(TokenCache *tc) {
+    return format("%s/%016" PRIx64 ".ltc", token_cache_dir, hash64(tc->path));
+}
+
+static void get_state(File *f, State *s) {
+    memset(s, 0, sizeof(State));
+    s->off = f->p - f->begin;
+    s->column = f->column;
+    s->last = f->last;
+    s->buflen = f->buflen;
+    for (int i = 0; i < f->buflen; i++)
+        s->buf[i] = f->buf[i];
+}
+
+static void set_state(File *f, State *s) {
+    f->p = f->begin + s->off;
+    f->column = s->column;
+    f->last = s->last;
+    f->buflen = s->buflen;
+    for (int i = 0; i < s->buflen; i++)
+        f->buf[i] = s->buf[i];
+}
+
+static bool same_state(State *a, State *b) {
+    if (a->off != b->off || a->column != b->column || a->last != b->last || a->buflen != b->buflen)
+        return false;
+    for (int i = 0; i < a->buflen; i++)
+        if (a->buf[i] != b->buf[i])
+            return false;
+    return true;
+}
+
+static void hash_item(TokenCache *tc, int i) {
+    int h = tc->items[i].before.off & (tc->hashsize - 1);
+    tc->chain[i] = tc->heads[h];
+    tc->heads[h] = i;
+}
+
+// Hashes the items by offset.  The table is made the first time a call
+// is not the one after the last, and kept at most half full.
+static void rehash(TokenCache *tc) {
+    free(tc->heads);
+    tc->hashsize = 64;
+    while (tc->hashsize < tc->nitems * 2)
+        tc->hashsize *= 2;
+    tc->heads = malloc(tc->hashsize * sizeof(int));
+    memset(tc->heads, -1, tc->hashsize * sizeof(int));
+    tc->chain = realloc(tc->chain, tc->hashsize * sizeof(int));
+    for (int i = 0; i < tc->nitems; i++)
+        hash_item(tc, i);
+}
+
+static int add_string(TokenCache *tc, char *s, int len, int flags) {
+    if (tc->nstrs == tc->maxstrs) {
+        tc->maxstrs = tc->maxstrs ? tc->maxstrs * 2 : 256;
+        tc->strs = realloc(tc->strs, tc->maxstrs * sizeof(char *));
+        tc->slens = realloc(tc->slens, tc->maxstrs * sizeof(int));
+        tc->sflags = realloc(tc->sflags, tc->maxstrs);
+    }
+    tc->strs[tc->nstrs] = s;
+    tc->slens[tc->nstrs] = len;
+    tc->sflags[tc->nstrs] = flags;
+    return tc->nstrs++;
+}
+
+static int add_ident(TokenCache *tc, char *s) {
+    if (!tc->idents) {
+        tc->idents = make_map();
+        for (int i = 0; i < tc->nstrs; i++)
+            if (tc->sflags[i] & STR_IDENT)
+                map_put(tc->idents, tc->strs[i], (void *)(intptr_t)(i + 1));
+    }
+    intptr_t i = (intptr_t)map_get(tc->idents, s);
+    if (i)
+        return i - 1;
+    i = add_string(tc, s, strlen(s) + 1, STR_IDENT);
+    map_put(tc->idents, s, (void *)(i + 1));
+    return i;
+}
+
+static void add_token(TokenCache *tc, LexCall *c, Token *tok) {
+    if (tc->ntoks == tc->maxtoks) {
+        tc->maxtoks *= 2;
+        tc->toks = realloc(tc->toks, tc->maxtoks * sizeof(CachedToken));
+    }
+    CachedToken *t = &tc->toks[tc->ntoks++];
+    memset(t, 0, sizeof(CachedToken));
+    t->kind = tok->kind;
+    t->space = tok->space;
+    t->bol = tok->bol;
+    t->str = -1;
+    t->dline = tok->line - c->fline;
+    t->column = tok->column;
+    t->dcount = tok->count - c->fntok;
+    switch (tok->kind) {
+    case TIDENT:
+        t->str = add_ident(tc, tok->sval);
+        break;
+    case TNUMBER:
+        t->str = add_string(tc, tok->sval, strlen(tok->sval) + 1, 0);
+        break;
+    case TSTRING:
+        t->str = add_string(tc, tok->sval, tok->slen, 0);
+        t->slen = tok->slen;
+        t->enc = tok->enc;
+        break;
+    case TCHAR:
+        t->id = tok->c;
+        t->enc = tok->enc;
+        break;
+    case TKEYWORD:
+        t->id = tok->id;
+        break;
+    case TINVALID:
+        t->id = tok->c;
+        break;
+    }
+}
+
+static void get_token(TokenCache *tc, File *f, LexCall *c, CachedToken *t, Token *tok) {
+    memset(tok, 0, sizeof(Token));
+    tok->kind = t->kind;
+    tok->file = f;
+    tok->space = t->space;
+    tok->bol = t->bol;
+    tok->line = c->fline + t->dline;
+    tok->column = t->column;
+    tok->count = c->fntok + t->dcount;
+    switch (t->kind) {
+    case TIDENT:
+    case TNUMBER:
+        tok->sval = tc->strs[t->str];
+        break;
+    case TSTRING:
+        tok->sval = tc->strs[t->str];
+        tok->slen = t->slen;
+        tok->enc = t->enc;
+        break;
+    case TCHAR:
+        tok->c = t->id;
+        tok->enc = t->enc;
+        break;
+    case TKEYWORD:
+        tok->id = t->id;
+        break;
+    case TINVALID:
+        tok->c = t->id;
+        break;
+    }
+}
+
+// Reads the entry for tc->path, if there is a valid one
+static void load(TokenCache *tc) {
+    char *file = cache_file(tc);
+    int fd = open(file, O_RDONLY);
+    if (fd < 0)
+        return;
+    struct stat st;
+    char *data = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size >= sizeof(Header))
+        data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return;
+
+    Header *h = (Header *)data;
+    size_t pathlen = strlen(tc->path);
+    uint64_t strs = sizeof(Header) + pathlen;
+    uint64_t items = strs + h->nstrs * (uint64_t)(sizeof(int32_t) + 1) + h->strbytes;
+    items = (items + 3) & ~3;
+    uint64_t toks = items + h->nitems * (uint64_t)sizeof(Item);
+    uint64_t size = toks + h->ntoks * (uint64_t)sizeof(CachedToken);
+    if (memcmp(h, &tc->key, offsetof(Header, pathlen)) || h->pathlen != pathlen ||
+        memcmp(data + sizeof(Header), tc->path, pathlen) || size != st.st_size) {
+        munmap(data, st.st_size);
+        return;
+    }
+
+    // The entry stays mapped, since the tokens made from its strings
+    // outlive the header.  Items and tokens are copied only if more calls
+    // have to be recorded.
+    int32_t *lens = (int32_t *)(data + strs);
+    uint8_t *flags = (uint8_t *)(lens + h->nstrs);
+    char *p = (char *)(flags + h->nstrs);
+    char *end = p + h->strbytes;
+    for (int i = 0; i < h->nstrs; i++) {
+        if (lens[i] <= 0 || lens[i] > end - p || p[lens[i] - 1] != '\0')
+            goto bad;
+        add_string(tc, (flags[i] & STR_IDENT) ? intern_len(p, lens[i] - 1) : p,
+                   lens[i], flags[i]);
+        p += lens[i];
+    }
+    Item *it = (Item *)(data + items);
+    CachedToken *t = (CachedToken *)(data + toks);
+    for (int i = 0; i < h->nitems; i++) {
+        int ntok = it[i].kind == LEX_HEADER_NAME ? 0 : it[i].ntok;
+        if (it[i].before.off > tc->key.size || it[i].after.off > tc->key.size ||
+            it[i].before.buflen > 3 || it[i].after.buflen > 3 || ntok > 2 ||
+            (ntok && (it[i].arg < 0 || it[i].arg + ntok > h->ntoks)) ||
+            (it[i].kind == LEX_HEADER_NAME && (it[i].arg < -1 || it[i].arg >= (int)h->nstrs)))
+            goto bad;
+    }
+    for (int i = 0; i < h->ntoks; i++) {
+        bool hasstr = t[i].kind == TIDENT || t[i].kind == TNUMBER || t[i].kind == TSTRING;
+        if (t[i].str >= (int)h->nstrs || (hasstr && t[i].str < 0))
+            goto bad;
+    }
+    tc->items = it;
+    tc->nitems = h->nitems;
+    tc->toks = t;
+    tc->ntoks = h->ntoks;
+    return;
+  bad:
+    tc->nstrs = 0;
+    munmap(data, st.st_size);
+}
+
+// Makes the items and tokens of a loaded entry writable
+static void own(TokenCache *tc) {
+    if (tc->owned)
+        return;
+    tc->maxitems = tc->nitems > 256 ? tc->nitems : 256;
+    Item *items = malloc(tc->maxitems * sizeof(Item));
+    memcpy(items, tc->items, tc->nitems * sizeof(Item));
+    tc->items = items;
+    tc->maxtoks = tc->ntoks > 1024 ? tc->ntoks : 1024;
+    CachedToken *toks = malloc(tc->maxtoks * sizeof(CachedToken));
+    memcpy(toks, tc->toks, tc->ntoks * sizeof(CachedToken));
+    tc->toks = toks;
+    tc->owned = true;
+}
+
+// Writes the entry, replacing the old one atomically
+static void save(TokenCache *tc) {
+    mkdir(token_cache_dir, 0777);
+    char *file = cache_file(tc);
+    char *tmp = format("%s.%d", file, (int)getpid());
+    FILE *fp = fopen(tmp, "w");
+    if (!fp)
+        return;
+    Header h = tc->key;
+    h.pathlen = strlen(tc->path);
+    h.nstrs = tc->nstrs;
+    h.strbytes = 0;
+    for (int i = 0; i < tc->nstrs; i++)
+        h.strbytes += tc->slens[i];
+    h.nitems = tc->nitems;
+    h.ntoks = tc->ntoks;
+    fwrite(&h, sizeof(h), 1, fp);
+    fwrite(tc->path, 1, h.pathlen, fp);
+    for (int i = 0; i < tc->nstrs; i++)
+        fwrite(&(int32_t){ tc->slens[i] }, sizeof(int32_t), 1, fp);
+    fwrite(tc->sflags, 1, tc->nstrs, fp);
+    for (int i = 0; i < tc->nstrs; i++)
+        fwrite(tc->strs[i], 1, tc->slens[i], fp);
+    static char zero[4];
+    fwrite(zero, 1, -ftell(fp) & 3, fp);
+    fwrite(tc->items, sizeof(Item), tc->nitems, fp);
+    fwrite(tc->toks, sizeof(CachedToken), tc->ntoks, fp);
+    if (ferror(fp) | fclose(fp) || rename(tmp, file))
+        unlink(tmp);
+}
+
+// Starts replaying or recording the lexer calls on a header just opened
+void tcache_attach(File *f) {
+    struct stat st;
+    if (stat(f->name, &st) == -1 || st.st_size != f->end - f->begin)
+        return;
+    TokenCache *tc = calloc(1, sizeof(TokenCache));
+    tc->path = strdup(f->name);
+    memcpy(tc->key.magic, MAGIC, 4);
+    tc->key.version = VERSION;
+    tc->key.build = build_id();
+    tc->key.size = st.st_size;
+    tc->key.mtime = st.st_mtim.tv_sec;
+    tc->key.mtime_nsec = st.st_mtim.tv_nsec;
+    tc->key.ino = st.st_ino;
+    load(tc);
+    f->tcache = tc;
+}
+
+// Called when the header is closed.  The entry is rewritten if any call
+// had to be lexed from the characters.
+void tcache_close(File *f) {
+    TokenCache *tc = f->tcache;
+    if (tc->dirty)
+        save(tc);
+    if (tc->owned) {
+        free(tc->items);
+        free(tc->toks);
+    }
+    free(tc->heads);
+    free(tc->chain);
+    free(tc->slens);
+    free(tc->sflags);
+    free(tc->strs);
+    free(tc->path);
+    free(tc);
+    f->tcache = NULL;
+}
+
+static int find(TokenCache *tc, int kind, State *s) {
+    int i = tc->cursor;
+    if (i < tc->nitems && tc->items[i].kind == kind && same_state(&tc->items[i].before, s))
+        return i;
+    if (tc->nitems == 0)
+        return -1;
+    if (!tc->heads)
+        rehash(tc);
+    for (i = tc->heads[s->off & (tc->hashsize - 1)]; i >= 0; i = tc->chain[i])
+        if (tc->items[i].kind == kind && same_state(&tc->items[i].before, s))
+            return i;
+    return -1;
+}
+
+// Looks up a call of kind c->kind at the current position of f.  If it
+// was recorded, moves f past it, fills in c and returns true.
+bool tcache_replay(File *f, LexCall *c) {
+    TokenCache *tc = f->tcache;
+    State s;
+    get_state(f, &s);
+    int i = find(tc, c->kind, &s);
+    if (i < 0)
+        return false;
+    Item *it = &tc->items[i];
+    tc->cursor = i + 1;
+    c->fline = f->line;
+    c->fntok = f->ntok;
+    if (it->kind == LEX_HEADER_NAME) {
+        c->name = it->arg < 0 ? NULL : tc->strs[it->arg];
+        c->std = it->std;
+    } else {
+        c->ntok = it->ntok;
+        for (int j = 0; j < it->ntok; j++)
+            get_token(tc, f, c, &tc->toks[it->arg + j], &c->tok[j]);
+        c->line = f->line + it->pline;
+        c->column = it->pcolumn;
+    }
+    set_state(f, &it->after);
+    f->line += it->dline;
+    f->ntok += it->dntok;
+    return true;
+}
+
+// Remembers the position of f before a call that has to be lexed
+void tcache_begin(File *f, LexCall *c) {
+    c->off = f->p - f->begin;
+    c->fcolumn = f->column;
+    c->last = f->last;
+    c->buflen = f->buflen;
+    for (int i = 0; i < f->buflen; i++)
+        c->buf[i] = f->buf[i];
+    c->fline = f->line;
+    c->fntok = f->ntok;
+}
+
+// Adds a call that was lexed from the characters, c being filled in by
+// tcache_begin and with the call's results
+void tcache_record(File *f, LexCall *c) {
+    TokenCache *tc = f->tcache;
+    own(tc);
+    if (tc->nitems == tc->maxitems) {
+        tc->maxitems *= 2;
+        tc->items = realloc(tc->items, tc->maxitems * sizeof(Item));
+    }
+    Item *it = &tc->items[tc->nitems];
+    memset(it, 0, sizeof(Item));
+    it->before.off = c->off;
+    it->before.column = c->fcolumn;
+    it->before.last = c->last;
+    it->before.buflen = c->buflen;
+    for (int i = 0; i < c->buflen; i++)
+        it->before.buf[i] = c->buf[i];
+    get_state(f, &it->after);
+    it->kind = c->kind;
+    it->dline = f->line - c->fline;
+    it->dntok = f->ntok - c->fntok;
+    if (c->kind == LEX_HEADER_NAME) {
+        it->arg = c->name ? add_string(tc, c->name, strlen(c->name) + 1, 0) : -1;
+        it->std = c->name && c->std;
+    } else {
+        it->arg = tc->ntoks;
+        it->ntok = c->ntok;
+        for (int i = 0; i < c->ntok; i++)
+            add_token(tc, c, &c->tok[i]);
+        it->pline = c->line - c->fline;
+        it->pcolumn = c->column;
+    }
+    tc->cursor = ++tc->nitems;
+    if (tc->heads && tc->nitems > tc->hashsize / 2)
+        rehash(tc);
+    else if (tc->heads)
+        hash_item(tc, tc->nitems - 1);
+    tc->dirty = true;
+}
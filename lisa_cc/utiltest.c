@@ -105,6 +105,23 @@ static void test_map() {
     }
 }
 
+static void test_intern() {
+    char *a = intern("abc");
+    assert_true(a == intern_len("abcd", 3));
+    assert_true(a == intern_find("abc"));
+    assert_true(is_interned(a));
+    assert_null(intern_find("never interned"));
+
+    // A copy is not interned, even at the offset an interned string has
+    // and behind a header that holds the id of one
+    _Alignas(ARENA_ALIGN) char buf[2 * ARENA_ALIGN];
+    Intern *fake = (Intern *)buf;
+    *fake = *INTERN_OF(a);
+    strcpy(fake->str, "abc");
+    assert_true(!is_interned(fake->str));
+    assert_true(!is_interned(strdup("abc")));
+}
+
 static void test_map_stack() {
     Map *m1 = make_map();
     map_put(m1, "x", (void *)1);
@@ -176,6 +193,7 @@ int main(int argc, char **argv) {
     test_buf();
     test_list();
     test_map();
+    test_intern();
     test_map_stack();
     test_dict();
     test_set();
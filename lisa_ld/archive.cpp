@@ -0,0 +1,353 @@
+// ------------------------------------------------------------------------------
+// (c) Copyright, Ken Pettit, BSD License
+//         All Rights Reserved
+// ------------------------------------------------------------------------------
+//
+//  File        : archive.cpp
+//  Revision    : 1.0
+//  Author      : Ken Pettit
+//  Created     : 10/16/2026
+//
+// Description:
+//    Library archives of relocatable objects.
+//
+// Modifications:
+//
+//    Author            Date        Ver  Description
+//    ================  ==========  ===  =======================================
+//    Ken Pettit        10/16/2026  1.0  Initial version
+//
+// ------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <map>
+
+#include "archive.h"
+#include "relbin.h"
+#include "errors.h"
+
+/* 
+=============================================================================
+Constructor
+=============================================================================
+*/
+CArchive::CArchive()
+{
+    m_MemberCount = 0;
+    m_pMap = NULL;
+    m_MapSize = 0;
+    m_pMembers = NULL;
+    m_pSymbols = NULL;
+    m_SymbolCount = 0;
+    m_pStrings = NULL;
+}
+
+/* 
+=============================================================================
+Destructor
+=============================================================================
+*/
+CArchive::~CArchive()
+{
+    if (m_pMap != NULL)
+        munmap(m_pMap, m_MapSize);
+}
+
+/* 
+=============================================================================
+Tests if the file starts with the archive magic
+=============================================================================
+*/
+bool CArchive::IsArchive(const char *pFilename)
+{
+    FILE*   fd;
+    char    magic[4];
+    bool    isArchive = false;
+
+    if ((fd = fopen(pFilename, "rb")) != NULL)
+    {
+        isArchive = fread(magic, 1, sizeof(magic), fd) == sizeof(magic) &&
+                    memcmp(magic, ARCHIVE_MAGIC, sizeof(magic)) == 0;
+        fclose(fd);
+    }
+
+    return isArchive;
+}
+
+/* 
+=============================================================================
+Map and validate an archive.  The mapping is private and writable because
+binary members are relocated in place.
+=============================================================================
+*/
+int CArchive::Open(const char *pFilename)
+{
+    const ArcHeader_t*  pHdr;
+    struct stat         st;
+    uint32_t            x;
+    int                 fd;
+
+    m_Filename = pFilename;
+    if ((fd = open(pFilename, O_RDONLY)) < 0)
+    {
+        printf("Error opening file %s\n", pFilename);
+        return ERROR_CANT_OPEN_FILE;
+    }
+    if (fstat(fd, &st) != 0 || st.st_size == 0 ||
+        (m_pMap = (uint8_t *) mmap(NULL, st.st_size, PROT_READ | PROT_WRITE,
+                                   MAP_PRIVATE, fd, 0)) == MAP_FAILED)
+    {
+        printf("Error reading file %s\n", pFilename);
+        m_pMap = NULL;
+        close(fd);
+        return ERROR_CANT_READ_FILE;
+    }
+    close(fd);
+    m_MapSize = st.st_size;
+
+    pHdr = (const ArcHeader_t *) m_pMap;
+    if (m_MapSize < sizeof(ArcHeader_t) || memcmp(pHdr->magic, ARCHIVE_MAGIC, 4) != 0)
+    {
+        printf("%s: Not a library archive\n", pFilename);
+        return ERROR_INVALID_FILE_FORMAT;
+    }
+    if (pHdr->version != ARCHIVE_VERSION || pHdr->headerSize != sizeof(ArcHeader_t))
+    {
+        printf("%s: Unsupported archive version %d\n", pFilename, pHdr->version);
+        return ERROR_INVALID_FILE_FORMAT;
+    }
+
+    // Each table must lie within the file
+    #define TABLE_OK(off, count, type) \
+        ((off) <= m_MapSize && (uint64_t) (count) * sizeof(type) <= m_MapSize - (off))
+
+    if (!TABLE_OK(pHdr->memberOffset, pHdr->memberCount, ArcMember_t) ||
+        !TABLE_OK(pHdr->symbolOffset, pHdr->symbolCount, ArcSymbol_t) ||
+        !TABLE_OK(pHdr->stringOffset, pHdr->stringSize, char) ||
+        pHdr->stringSize == 0 || m_pMap[pHdr->stringOffset + pHdr->stringSize - 1] != '\0')
+    {
+        printf("%s: Corrupt archive tables\n", pFilename);
+        return ERROR_INVALID_FILE_FORMAT;
+    }
+    #undef TABLE_OK
+
+    m_pMembers = (const ArcMember_t *) (m_pMap + pHdr->memberOffset);
+    m_pSymbols = (const ArcSymbol_t *) (m_pMap + pHdr->symbolOffset);
+    m_pStrings = (const char *) m_pMap + pHdr->stringOffset;
+    m_MemberCount = pHdr->memberCount;
+    m_SymbolCount = pHdr->symbolCount;
+
+    for (x = 0; x < pHdr->memberCount; x++)
+    {
+        if (m_pMembers[x].name >= pHdr->stringSize ||
+            m_pMembers[x].offset % ARCHIVE_ALIGN != 0 ||
+            (uint64_t) m_pMembers[x].offset + m_pMembers[x].size > m_MapSize)
+        {
+            printf("%s: Corrupt archive member %d\n", pFilename, x);
+            return ERROR_INVALID_FILE_FORMAT;
+        }
+    }
+
+    for (x = 0; x < pHdr->symbolCount; x++)
+    {
+        if (m_pSymbols[x].name >= pHdr->stringSize ||
+            m_pSymbols[x].member >= pHdr->memberCount)
+        {
+            printf("%s: Corrupt archive symbol %d\n", pFilename, x);
+            return ERROR_INVALID_FILE_FORMAT;
+        }
+    }
+
+    m_Loaded.assign(m_MemberCount, false);
+    return ERROR_NONE;
+}
+
+/* 
+=============================================================================
+Binary search the symbol index
+=============================================================================
+*/
+int CArchive::FindSymbol(const char *pName)
+{
+    uint32_t    lo = 0, hi = m_SymbolCount;
+    uint32_t    mid;
+    int         cmp;
+
+    while (lo < hi)
+    {
+        mid = (lo + hi) / 2;
+        cmp = strcmp(pName, m_pStrings + m_pSymbols[mid].name);
+        if (cmp == 0)
+            return m_pSymbols[mid].member;
+        if (cmp < 0)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+
+    return -1;
+}
+
+/* 
+=============================================================================
+Member accessors
+=============================================================================
+*/
+const char* CArchive::MemberName(int member)
+{
+    return m_pStrings + m_pMembers[member].name;
+}
+
+uint8_t* CArchive::MemberImage(int member, size_t& size)
+{
+    size = m_pMembers[member].size;
+    return m_pMap + m_pMembers[member].offset;
+}
+
+/* 
+=============================================================================
+Create an archive from a list of text or binary .rel files
+=============================================================================
+*/
+int CArchive::Create(const char *pFilename, char * const *ppMembers, int count)
+{
+    ArcHeader_t                         hdr;
+    std::vector<ArcMember_t>            members;
+    std::vector<ArcSymbol_t>            symbols;
+    std::vector<std::vector<uint8_t> >  images;
+    std::map<std::string, uint32_t>     index;
+    std::string                         strings(1, '\0');
+    ArcMember_t                         mem;
+    ArcSymbol_t                         sym;
+    const char*                         pBase;
+    uint32_t                            offset;
+    FILE*                               fd;
+    long                                size;
+    size_t                              x, y;
+    int                                 m, err;
+    bool                                ok;
+    static const uint8_t                pad[ARCHIVE_ALIGN] = { 0 };
+
+    for (m = 0; m < count; m++)
+    {
+        CRelObject  obj;
+
+        // Read the member's symbols
+        if (CRelObject::IsBinary(ppMembers[m]))
+            err = obj.ReadBin(ppMembers[m]);
+        else if ((fd = fopen(ppMembers[m], "r")) == NULL)
+        {
+            printf("Error opening file %s\n", ppMembers[m]);
+            return ERROR_CANT_OPEN_FILE;
+        }
+        else
+        {
+            err = obj.ReadText(fd, ppMembers[m]);
+            fclose(fd);
+        }
+        if (err != ERROR_NONE)
+            return err;
+
+        for (x = 0; x < obj.m_Sections.size(); x++)
+            for (y = 0; y < obj.m_Sections[x]->m_Symbols.size(); y++)
+            {
+                const RelSymbol_t& s = obj.m_Sections[x]->m_Symbols[y];
+                if (s.type != RELBIN_SYM_PUBLIC)
+                    continue;
+                if (!index.insert(std::pair<std::string, uint32_t>(s.name, m)).second)
+                    printf("%s: Symbol %s already defined in %s, ignored\n", ppMembers[m],
+                            s.name.c_str(), ppMembers[index[s.name]]);
+            }
+
+        // Keep the member's bytes as is
+        images.push_back(std::vector<uint8_t>());
+        if ((fd = fopen(ppMembers[m], "rb")) == NULL)
+        {
+            printf("Error opening file %s\n", ppMembers[m]);
+            return ERROR_CANT_OPEN_FILE;
+        }
+        fseek(fd, 0, SEEK_END);
+        size = ftell(fd);
+        fseek(fd, 0, SEEK_SET);
+        images.back().resize(size > 0 ? size : 0);
+        ok = size >= 0 && fread(images.back().data(), 1, size, fd) == (size_t) size;
+        fclose(fd);
+        if (!ok)
+        {
+            printf("Error reading file %s\n", ppMembers[m]);
+            return ERROR_CANT_READ_FILE;
+        }
+
+        // Members are known by their base name
+        pBase = strrchr(ppMembers[m], '/');
+        pBase = pBase ? pBase + 1 : ppMembers[m];
+        mem.name = strings.size();
+        strings.append(pBase, strlen(pBase) + 1);
+        mem.size = size;
+        members.push_back(mem);
+    }
+
+    // The symbol index is sorted since it is built from the map
+    for (auto it = index.begin(); it != index.end(); it++)
+    {
+        sym.name = strings.size();
+        sym.member = it->second;
+        strings.append(it->first.c_str(), it->first.size() + 1);
+        symbols.push_back(sym);
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, ARCHIVE_MAGIC, sizeof(hdr.magic));
+    hdr.version = ARCHIVE_VERSION;
+    hdr.headerSize = sizeof(hdr);
+    hdr.memberCount = members.size();
+    hdr.memberOffset = sizeof(hdr);
+    hdr.symbolCount = symbols.size();
+    hdr.symbolOffset = hdr.memberOffset + members.size() * sizeof(ArcMember_t);
+    hdr.stringSize = strings.size();
+    hdr.stringOffset = hdr.symbolOffset + symbols.size() * sizeof(ArcSymbol_t);
+
+    // Place the member data after the strings, each one aligned
+    offset = hdr.stringOffset + hdr.stringSize;
+    for (x = 0; x < members.size(); x++)
+    {
+        offset = (offset + ARCHIVE_ALIGN - 1) & ~(ARCHIVE_ALIGN - 1);
+        members[x].offset = offset;
+        offset += members[x].size;
+    }
+
+    if ((fd = fopen(pFilename, "wb")) == NULL)
+    {
+        printf("%s: Unable to open file for writing\n", pFilename);
+        return ERROR_CANT_OPEN_FILE;
+    }
+
+    ok = fwrite(&hdr, sizeof(hdr), 1, fd) == 1;
+    ok = ok && fwrite(members.data(), sizeof(ArcMember_t), members.size(), fd) == members.size();
+    ok = ok && fwrite(symbols.data(), sizeof(ArcSymbol_t), symbols.size(), fd) == symbols.size();
+    ok = ok && fwrite(strings.data(), 1, strings.size(), fd) == strings.size();
+    offset = hdr.stringOffset + hdr.stringSize;
+    for (x = 0; ok && x < members.size(); x++)
+    {
+        ok = fwrite(pad, 1, members[x].offset - offset, fd) == members[x].offset - offset;
+        ok = ok && fwrite(images[x].data(), 1, images[x].size(), fd) == images[x].size();
+        offset = members[x].offset + members[x].size;
+    }
+    ok = fclose(fd) == 0 && ok;
+
+    if (!ok)
+    {
+        printf("%s: Error writing file\n", pFilename);
+        return ERROR_CANT_OPEN_FILE;
+    }
+
+    return ERROR_NONE;
+}
+
+// vim: sw=4 ts=4
@@ -0,0 +1,111 @@
+// ------------------------------------------------------------------------------
+// (c) Copyright, Ken Pettit, BSD License
+//         All Rights Reserved
+// ------------------------------------------------------------------------------
+//
+//  File        : archive.h
+//  Revision    : 1.0
+//  Author      : Ken Pettit
+//  Created     : 10/16/2026
+//
+// Description:
+//    Library archives of relocatable objects.  An archive holds any number
+//    of text or binary .rel members plus an index of every PUBLIC symbol
+//    sorted by name, so the linker can find the member defining an extern
+//    without loading the others.  All fields are little endian.  Layout:
+//
+//        ArcHeader_t
+//        ArcMember_t[memberCount]
+//        ArcSymbol_t[symbolCount]     Sorted by name
+//        char strings[stringSize]     NUL terminated, offset 0 is ""
+//        member data                  Each aligned to ARCHIVE_ALIGN bytes
+//
+// Modifications:
+//
+//    Author            Date        Ver  Description
+//    ================  ==========  ===  =======================================
+//    Ken Pettit        10/16/2026  1.0  Initial version
+//
+// ------------------------------------------------------------------------------
+
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <list>
+
+#define ARCHIVE_MAGIC       "LARC"
+#define ARCHIVE_VERSION     1
+
+/// Member data alignment so binary members can be used in place
+#define ARCHIVE_ALIGN       8
+
+typedef struct ArcHeader_s
+{
+    char            magic[4];       // ARCHIVE_MAGIC
+    uint16_t        version;        // ARCHIVE_VERSION
+    uint16_t        headerSize;     // sizeof(ArcHeader_t)
+    uint32_t        memberCount;
+    uint32_t        memberOffset;
+    uint32_t        symbolCount;
+    uint32_t        symbolOffset;
+    uint32_t        stringSize;
+    uint32_t        stringOffset;
+} ArcHeader_t;
+
+typedef struct ArcMember_s
+{
+    uint32_t        name;           // String table offset
+    uint32_t        offset;         // File offset of the member data
+    uint32_t        size;           // Size of the member data
+} ArcMember_t;
+
+typedef struct ArcSymbol_s
+{
+    uint32_t        name;           // String table offset
+    uint32_t        member;         // Index of the defining member
+} ArcSymbol_t;
+
+class CArchive
+{
+    public:
+        CArchive();
+        ~CArchive();
+
+        /// Maps and validates an archive
+        int                 Open(const char *pFilename);
+
+        /// Returns the member defining the PUBLIC symbol, or -1
+        int                 FindSymbol(const char *pName);
+
+        const char*         MemberName(int member);
+        uint8_t*            MemberImage(int member, size_t& size);
+
+        /// Tests if the file starts with the archive magic
+        static bool         IsArchive(const char *pFilename);
+
+        /// Creates an archive from a list of .rel files
+        static int          Create(const char *pFilename, char * const *ppMembers,
+                                int count);
+
+        std::string         m_Filename;
+        int                 m_MemberCount;
+        std::vector<bool>   m_Loaded;       // Member has been linked
+
+    private:
+        uint8_t*            m_pMap;
+        size_t              m_MapSize;
+        const ArcMember_t*  m_pMembers;
+        const ArcSymbol_t*  m_pSymbols;
+        uint32_t            m_SymbolCount;
+        const char*         m_pStrings;
+};
+
+typedef std::list<CArchive *> ArchiveList_t;
+
+#endif /* ARCHIVE_H */
+
+// vim: sw=4 ts=4
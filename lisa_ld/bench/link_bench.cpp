@@ -0,0 +1,211 @@
+// ------------------------------------------------------------------------------
+// (c) Copyright, Ken Pettit, BSD License
+//         All Rights Reserved
+// ------------------------------------------------------------------------------
+//
+//  File        : link_bench.cpp
+//  Revision    : 1.0
+//  Author      : Ken Pettit
+//  Created     : 10/16/2026
+//
+// Description:  
+//    Link benchmark.  Generates a synthetic relocatable file with many
+//    sections and section relative relocations, then reports the cost of
+//    the original per-section scan of every relocation versus the
+//    relocation index, and the time for the full link.
+//
+// Modifications:
+//
+//    Author            Date        Ver  Description
+//    ================  ==========  ===  =======================================
+//    Ken Pettit        10/16/2026  1.0  Initial version
+//
+// ------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <chrono>
+
+#include "parser.h"
+#include "linker.h"
+#include "errors.h"
+
+using namespace std::chrono;
+
+/*
+=============================================================================
+Generate the linker script and a relocatable file with 'sections' sections
+holding 'relocs' relocations in total
+=============================================================================
+*/
+static int GenerateInput(const char *pScript, const char *pRel, int sections, int relocs)
+{
+    FILE   *fd;
+    int     s, r, perSection;
+
+    if ((fd = fopen(pScript, "w")) == NULL)
+    {
+        printf("Unable to create %s\n", pScript);
+        return ERROR_CANT_OPEN_FILE;
+    }
+    fprintf(fd, "MEMORY\n{\n  code_sram (rx) : ORIGIN = 0x0000, LENGTH = %dK\n}\n",
+            (relocs + sections) / 1024 + 1);
+    fprintf(fd, "SECTIONS\n{\n  .text :\n  {\n    *(.text)\n  } > code_sram\n}\n");
+    fclose(fd);
+
+    if ((fd = fopen(pRel, "w")) == NULL)
+    {
+        printf("Unable to create %s\n", pRel);
+        return ERROR_CANT_OPEN_FILE;
+    }
+
+    perSection = relocs / sections;
+    for (s = 0; s < sections; s++)
+    {
+        fprintf(fd, "s bench_%d.text\n", s);
+        fprintf(fd, "p _func_%d 0x0000\n", s);
+        fprintf(fd, "l _local_%d 0x0001\n", s);
+        fprintf(fd, "i 0x2880\n");
+
+        // Each word jumps to a pseudo random section of the same file
+        for (r = 0; r < perSection; r++)
+            fprintf(fd, "r 0x%04X bench_%d.text\n", r & 0xFF,
+                    (s * 7919 + r * 104729) % sections);
+    }
+
+    fclose(fd);
+    return ERROR_NONE;
+}
+
+/*
+=============================================================================
+The original relocation pass:  for every located section, walk every
+relocation of every section in the file comparing target names
+=============================================================================
+*/
+static int ScanAllRelocations(CFile *pFile)
+{
+    int     matches = 0;
+
+    auto sit = pFile->m_FileSections.begin();
+    while (sit != pFile->m_FileSections.end())
+    {
+        auto sit2 = pFile->m_FileSections.begin();
+        while (sit2 != pFile->m_FileSections.end())
+        {
+            auto rit = sit2->second->m_RelocationList.begin();
+            while (rit != sit2->second->m_RelocationList.end())
+            {
+                if ((*rit)->m_Section == sit->first)
+                    matches++;
+                rit++;
+            }
+            sit2++;
+        }
+        sit++;
+    }
+
+    return matches;
+}
+
+/*
+=============================================================================
+The indexed pass:  each located section looks up its own bucket
+=============================================================================
+*/
+static int ScanIndexedRelocations(CFile *pFile)
+{
+    int     matches = 0;
+
+    auto sit = pFile->m_FileSections.begin();
+    while (sit != pFile->m_FileSections.end())
+    {
+        auto bit = pFile->m_RelocIndex.find(sit->first);
+        if (bit != pFile->m_RelocIndex.end())
+            matches += bit->second.size();
+        sit++;
+    }
+
+    return matches;
+}
+
+/*
+=============================================================================
+Main entry point
+=============================================================================
+*/
+int main(int argc, char* argv[])
+{
+    const char     *pScript = "/tmp/lisa_link_bench.ld";
+    const char     *pRel = "/tmp/lisa_link_bench.rel";
+    char            sOut[] = "/tmp/lisa_link_bench.lst";
+    int             sections = 1000;
+    int             relocs = 100000;
+    int             matches;
+    double          secs;
+
+    if (argc > 1)
+        sections = atoi(argv[1]);
+    if (argc > 2)
+        relocs = atoi(argv[2]);
+
+    if (GenerateInput(pScript, pRel, sections, relocs) != ERROR_NONE)
+        return 1;
+
+    CParseCtx   spec;
+    CParser     parser(&spec);
+    CLinker     linker(&spec);
+    CFile      *pFile = new CFile(&spec);
+
+    parser.m_DebugLevel = 0;
+    if (parser.ParseLinkerScript(pScript, &spec) != ERROR_NONE)
+    {
+        printf("Error parsing %s\n", pScript);
+        return 1;
+    }
+
+    // Time loading the relocatable file
+    auto start = steady_clock::now();
+    pFile->m_Filename = pRel;
+    pFile->m_DebugLevel = 0;
+    if (pFile->LoadRelFile(pRel) != ERROR_NONE)
+        return 1;
+    secs = duration<double>(steady_clock::now() - start).count();
+    printf("Load:               %10.3f sec (%d sections, %d relocations)\n",
+            secs, sections, relocs);
+
+    // Time the original relocation scan
+    start = steady_clock::now();
+    matches = ScanAllRelocations(pFile);
+    secs = duration<double>(steady_clock::now() - start).count();
+    printf("Scanned relocs:     %10.3f sec (%d applied)\n", secs, matches);
+
+    // Time the relocation index
+    start = steady_clock::now();
+    matches = ScanIndexedRelocations(pFile);
+    secs = duration<double>(steady_clock::now() - start).count();
+    printf("Indexed relocs:     %10.6f sec (%d applied)\n", secs, matches);
+
+    // Time the full link
+    linker.m_DebugLevel = 0;
+    linker.m_Mixed = 0;
+    linker.m_MapFile = 1;
+    linker.m_FileList.push_back(pFile);
+    start = steady_clock::now();
+    if (linker.Link(sOut) != ERROR_NONE)
+        return 1;
+    secs = duration<double>(steady_clock::now() - start).count();
+    printf("Link:               %10.3f sec\n", secs);
+
+    unlink(pScript);
+    unlink(pRel);
+    unlink(sOut);
+    unlink("/tmp/lisa_link_bench.hex");
+    unlink("/tmp/lisa_link_bench.map");
+    return 0;
+}
+
+// vim: sw=4 ts=4
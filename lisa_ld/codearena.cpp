@@ -0,0 +1,125 @@
+// ------------------------------------------------------------------------------
+// (c) Copyright, Ken Pettit, BSD License
+//         All Rights Reserved
+// ------------------------------------------------------------------------------
+//
+//  File        : codearena.cpp
+//  Revision    : 1.0
+//  Author      : Ken Pettit
+//  Created     : 10/16/2026
+//
+// Description:
+//    Arena allocator for section code words.
+//
+// Modifications:
+//
+//    Author            Date        Ver  Description
+//    ================  ==========  ===  =======================================
+//    Ken Pettit        10/16/2026  1.0  Initial version
+//
+// ------------------------------------------------------------------------------
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "codearena.h"
+
+/* 
+=============================================================================
+Constructor
+=============================================================================
+*/
+CCodeArena::CCodeArena(size_t blockWords)
+{
+    m_BlockWords = blockWords;
+    m_BytesReserved = 0;
+    m_BytesUsed = 0;
+    m_BytesAbandoned = 0;
+    m_BlockCount = 0;
+    m_pNext = NULL;
+    m_pEnd = NULL;
+    m_pLast = NULL;
+}
+
+/* 
+=============================================================================
+Destructor
+=============================================================================
+*/
+CCodeArena::~CCodeArena()
+{
+    size_t  x;
+
+    for (x = 0; x < m_Blocks.size(); x++)
+        free(m_Blocks[x]);
+}
+
+/* 
+=============================================================================
+Allocate zeroed words from the arena.  Requests larger than a block get a
+block of their own so the current block isn't abandoned.
+=============================================================================
+*/
+uint16_t* CCodeArena::Alloc(size_t words)
+{
+    uint16_t   *pBlock;
+
+    if (words > m_BlockWords)
+    {
+        if ((pBlock = (uint16_t *) calloc(words, sizeof(uint16_t))) == NULL)
+            return NULL;
+        m_Blocks.push_back(pBlock);
+        m_BlockCount++;
+        m_BytesReserved += words * sizeof(uint16_t);
+        m_BytesUsed += words * sizeof(uint16_t);
+        return pBlock;
+    }
+
+    // Start a new block if this one is full
+    if (m_pNext == NULL || (size_t) (m_pEnd - m_pNext) < words)
+    {
+        if ((pBlock = (uint16_t *) calloc(m_BlockWords, sizeof(uint16_t))) == NULL)
+            return NULL;
+        m_Blocks.push_back(pBlock);
+        m_BlockCount++;
+        m_BytesReserved += m_BlockWords * sizeof(uint16_t);
+        m_pNext = pBlock;
+        m_pEnd = pBlock + m_BlockWords;
+    }
+
+    m_pLast = m_pNext;
+    m_pNext += words;
+    m_BytesUsed += words * sizeof(uint16_t);
+    return m_pLast;
+}
+
+/* 
+=============================================================================
+Grow a buffer previously returned by Alloc or Grow
+=============================================================================
+*/
+uint16_t* CCodeArena::Grow(uint16_t *pCode, size_t oldWords, size_t newWords)
+{
+    uint16_t   *pNew;
+
+    if (pCode == NULL)
+        return Alloc(newWords);
+
+    // Extend in place if this is the newest allocation and it still fits
+    if (pCode == m_pLast && pCode + oldWords == m_pNext &&
+        (size_t) (m_pEnd - pCode) >= newWords)
+    {
+        m_pNext = pCode + newWords;
+        m_BytesUsed += (newWords - oldWords) * sizeof(uint16_t);
+        return pCode;
+    }
+
+    // Otherwise move it.  The old words stay in the arena until it is freed.
+    if ((pNew = Alloc(newWords)) == NULL)
+        return NULL;
+    memcpy(pNew, pCode, oldWords * sizeof(uint16_t));
+    m_BytesAbandoned += oldWords * sizeof(uint16_t);
+    return pNew;
+}
+
+// vim: sw=4 ts=4
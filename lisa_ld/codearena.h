@@ -0,0 +1,63 @@
+// ------------------------------------------------------------------------------
+// (c) Copyright, Ken Pettit, BSD License
+//         All Rights Reserved
+// ------------------------------------------------------------------------------
+//
+//  File        : codearena.h
+//  Revision    : 1.0
+//  Author      : Ken Pettit
+//  Created     : 10/16/2026
+//
+// Description:
+//    Arena allocator for section code words.  Sections are loaded one at a
+//    time, so the buffer being filled is almost always the newest allocation
+//    and can be extended in place.  Everything is released when the arena
+//    is destroyed.
+//
+// Modifications:
+//
+//    Author            Date        Ver  Description
+//    ================  ==========  ===  =======================================
+//    Ken Pettit        10/16/2026  1.0  Initial version
+//
+// ------------------------------------------------------------------------------
+
+#ifndef CODEARENA_H
+#define CODEARENA_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+/// Default arena block size in words
+#define CODE_ARENA_BLOCK_WORDS  32768
+
+class CCodeArena
+{
+    public:
+        CCodeArena(size_t blockWords = CODE_ARENA_BLOCK_WORDS);
+        ~CCodeArena();
+
+        /// Allocates 'words' zeroed words
+        uint16_t*           Alloc(size_t words);
+
+        /// Grows a buffer from oldWords to newWords, in place if possible.
+        /// The returned buffer keeps the old contents and is zero filled.
+        uint16_t*           Grow(uint16_t *pCode, size_t oldWords, size_t newWords);
+
+        size_t              m_BytesReserved;    // Total size of all blocks
+        size_t              m_BytesUsed;        // Bytes handed out
+        size_t              m_BytesAbandoned;   // Bytes left behind by moves
+        int                 m_BlockCount;
+
+    private:
+        std::vector<uint16_t *> m_Blocks;
+        size_t              m_BlockWords;
+        uint16_t*           m_pNext;            // Next free word in the block
+        uint16_t*           m_pEnd;             // End of the current block
+        uint16_t*           m_pLast;            // Most recent allocation
+};
+
+#endif /* CODEARENA_H */
+
+// vim: sw=4 ts=4
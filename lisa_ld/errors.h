@@ -48,6 +48,9 @@
 #define ERROR_BRANCH_DISTANCE_TOO_BIG       33
 #define ERROR_DUPLICATE_SYMBOL              34
 #define ERROR_UNDEFINED_SYMBOL              35
+#define ERROR_MEMORY_OVERFLOW               36
+#define ERROR_NO_GC_ROOTS                   37
+#define ERROR_STATIC_FRAME                  38
 
 #endif  // ERRORS_H
 
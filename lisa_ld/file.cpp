@@ -24,12 +24,58 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "file.h"
+#include "relbin.h"
 #include "errors.h"
 
 #define     iswhite(a)  (((a) == ' ') || ((a) == '\t'))
 
+CCodeArena CFile::m_CodeArena;
+
+/* 
+=============================================================================
+Grow a section's code buffer to at least 'words' words.  The size doubles
+so a section loaded one word at a time is copied a bounded number of times.
+=============================================================================
+*/
+int CFileSection::GrowCode(int words)
+{
+    uint16_t   *pCode;
+    int         size;
+
+    if (words <= m_CodeSize)
+        return ERROR_NONE;
+
+    if (m_Mapped || words > MAX_SECTION_WORDS)
+    {
+        printf("%s: Section %s exceeds %d words\n", m_Filename.c_str(),
+                m_Name.c_str(), m_Mapped ? m_CodeSize : MAX_SECTION_WORDS);
+        return ERROR_OUT_OF_MEMORY;
+    }
+
+    size = m_CodeSize ? m_CodeSize : MIN_SECTION_WORDS;
+    while (size < words)
+        size *= 2;
+    if (size > MAX_SECTION_WORDS)
+        size = MAX_SECTION_WORDS;
+
+    if ((pCode = m_pArena->Grow(m_pCode, m_CodeSize, size)) == NULL)
+    {
+        printf("%s: Out of memory loading section %s\n", m_Filename.c_str(),
+                m_Name.c_str());
+        return ERROR_OUT_OF_MEMORY;
+    }
+
+    m_pCode = pCode;
+    m_CodeSize = size;
+    return ERROR_NONE;
+}
+
 /* 
 =============================================================================
 Constructor
@@ -39,6 +85,27 @@ CFile::CFile(CParseCtx* pSpec)
 {
     m_pSpec = pSpec;
     m_ActiveSection = NULL;
+    m_pMap = NULL;
+    m_MapSize = 0;
+}
+
+/* 
+=============================================================================
+Destructor
+=============================================================================
+*/
+CFile::~CFile()
+{
+    FileSectionMap_t::iterator  it;
+
+    // Sections may point into the mapped file so delete them first
+    for (it = m_FileSections.begin(); it != m_FileSections.end(); ++it)
+        delete it->second;
+    for (it = m_DroppedSections.begin(); it != m_DroppedSections.end(); ++it)
+        delete it->second;
+
+    if (m_pMap != NULL)
+        munmap(m_pMap, m_MapSize);
 }
 
 /* 
@@ -91,7 +158,7 @@ int CFile::ParseSection(CParserFile *pFile)
     }
 
     // Create a new section and make it active
-    pSection = new CFileSection();
+    pSection = new CFileSection(&m_CodeArena);
     pSection->m_Filename = pFile->m_Filename;
     pSection->m_Name = m_Args[1];
     m_ActiveSection = pSection;
@@ -213,6 +280,8 @@ Parse instruction line from file
 */
 int CFile::ParseInstruction(CParserFile *pFile)
 {
+    int     err;
+
     // Validate we have an active section
     if (m_ActiveSection == NULL)
     {
@@ -233,8 +302,9 @@ int CFile::ParseInstruction(CParserFile *pFile)
     if (m_ActiveSection->m_Address < m_ActiveSection->m_FirstCodeOffset)
          m_ActiveSection->m_FirstCodeOffset = m_ActiveSection->m_Address;
 
-    m_ActiveSection->m_pCode[m_ActiveSection->m_Address++] =
-        strtol(m_Args[1].c_str(), NULL, 0);
+    if ((err = m_ActiveSection->SetCode(m_ActiveSection->m_Address++,
+            strtol(m_Args[1].c_str(), NULL, 0))) != ERROR_NONE)
+        return err;
 
     // Keep track of the last valid instruction address / offset
     if (m_ActiveSection->m_Address > m_ActiveSection->m_LastCodeOffset)
@@ -250,6 +320,8 @@ Parse extern line from file
 */
 int CFile::ParseExtern(CParserFile *pFile)
 {
+    int     err;
+
     // Validate we have an active section
     if (m_ActiveSection == NULL)
     {
@@ -284,8 +356,10 @@ int CFile::ParseExtern(CParserFile *pFile)
     pRel->m_Label = m_Args[2];
     pRel->m_Opcode = strtol(m_Args[1].c_str(), NULL, 0);
     pRel->m_Offset = m_ActiveSection->m_Address;
-    m_ActiveSection->m_pCode[m_ActiveSection->m_Address++] = pRel->m_Opcode;
     m_ActiveSection->m_ExternsList.push_back(pRel);
+    if ((err = m_ActiveSection->SetCode(m_ActiveSection->m_Address++,
+            pRel->m_Opcode)) != ERROR_NONE)
+        return err;
 
     // Keep track of the last valid instruction address / offset
     if (m_ActiveSection->m_Address > m_ActiveSection->m_LastCodeOffset)
@@ -301,6 +375,8 @@ Parse a relocation line from file
 */
 int CFile::ParseRelocation(CParserFile *pFile)
 {
+    int     err;
+
     // Validate we have an active section
     if (m_ActiveSection == NULL)
     {
@@ -335,8 +411,12 @@ int CFile::ParseRelocation(CParserFile *pFile)
     pRel->m_Section = m_Args[2];
     pRel->m_Opcode = strtol(m_Args[1].c_str(), NULL, 0);
     pRel->m_Offset = m_ActiveSection->m_Address;
-    m_ActiveSection->m_pCode[m_ActiveSection->m_Address++] = pRel->m_Opcode;
+    pRel->m_pSection = m_ActiveSection;
     m_ActiveSection->m_RelocationList.push_back(pRel);
+    m_RelocIndex[pRel->m_Section].push_back(pRel);
+    if ((err = m_ActiveSection->SetCode(m_ActiveSection->m_Address++,
+            pRel->m_Opcode)) != ERROR_NONE)
+        return err;
 
     // Keep track of the last valid instruction address / offset
     if (m_ActiveSection->m_Address > m_ActiveSection->m_LastCodeOffset)
@@ -461,19 +541,13 @@ int CFile::ParseLine(const char *pLine, CParserFile *pFile)
 
 /* 
 =============================================================================
-Load a relocatable file
+Load a text relocatable file
 =============================================================================
 */
-int CFile::LoadRelFile(const char *pFilename)
+int CFile::LoadRelTextFile(const char *pFilename)
 {
-    CParserFile     file;
-    char            sLine[512];
     FILE*           fd;
-    int32_t         err, lastErr;
-    bool            parseFailed;
-    char*           pComment;
-    int             c;
-    int             numOnLine;
+    int32_t         err;
 
     // Try to open the file
     if ((fd = fopen(pFilename, "r")) == NULL)
@@ -482,6 +556,27 @@ int CFile::LoadRelFile(const char *pFilename)
         return ERROR_CANT_OPEN_FILE;
     }
 
+    err = LoadRelText(fd, pFilename);
+
+    // Close the file
+    fclose(fd);
+
+    return err;
+}
+
+/* 
+=============================================================================
+Load text relocatable records from an open file
+=============================================================================
+*/
+int CFile::LoadRelText(FILE *fd, const char *pFilename)
+{
+    CParserFile     file;
+    char            sLine[512];
+    int32_t         err, lastErr;
+    bool            parseFailed;
+    char*           pComment;
+
     // Initialize the CFileSection and CParserFile
     file.m_Filename = pFilename;
     file.m_Line = 0;
@@ -519,69 +614,253 @@ int CFile::LoadRelFile(const char *pFilename)
         }
     }
 
-    // Close the file
-    fclose(fd);
+    // Trailing 'u' records only advance the offset.  Back every section
+    // with zeroed words up to its last offset so the linker can copy it.
+    auto it = m_FileSections.begin();
+    while (it != m_FileSections.end())
+    {
+        if ((err = it->second->GrowCode(it->second->m_LastCodeOffset)) != ERROR_NONE)
+            lastErr = err;
+        it++;
+    }
 
-    if (m_DebugLevel > 1)
+    return lastErr;
+}
+
+/* 
+=============================================================================
+Load a binary relocatable file.  The file is mapped privately and each
+section's code words are used in place, so the linker's relocation patches
+only copy the pages they touch.
+=============================================================================
+*/
+int CFile::LoadRelBinFile(const char *pFilename)
+{
+    struct stat             st;
+    int                     fd;
+
+    // Map the file
+    if ((fd = open(pFilename, O_RDONLY)) < 0)
+    {
+        printf("Error opening file %s\n", pFilename);
+        return ERROR_CANT_OPEN_FILE;
+    }
+    if (fstat(fd, &st) != 0 || st.st_size == 0 ||
+        (m_pMap = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                       fd, 0)) == MAP_FAILED)
+    {
+        printf("Error reading file %s\n", pFilename);
+        m_pMap = NULL;
+        close(fd);
+        return ERROR_CANT_READ_FILE;
+    }
+    close(fd);
+    m_MapSize = st.st_size;
+
+    return LoadRelBinImage((uint8_t *) m_pMap, m_MapSize, pFilename);
+}
+
+/* 
+=============================================================================
+Load a binary relocatable image that is already in memory.  The image must
+stay mapped (and writable) for the life of this CFile.
+=============================================================================
+*/
+int CFile::LoadRelBinImage(uint8_t *pImage, size_t size, const char *pFilename)
+{
+    const RelBinHeader_t*   pHdr;
+    const RelBinSection_t*  pSec;
+    const RelBinSymbol_t*   pSym;
+    const RelBinReloc_t*    pRel;
+    const char*             pStrings;
+    uint16_t*               pCode;
+    CFileSection*           pSection;
+    CRelocation*            pReloc;
+    uint32_t                x, y;
+    int                     err;
+
+    // Validate all table bounds once so the loops below can index freely
+    if ((err = CRelObject::Validate(pImage, size, pFilename)) != ERROR_NONE)
+        return err;
+
+    pHdr = (const RelBinHeader_t *) pImage;
+    pSec = (const RelBinSection_t *) (pImage + pHdr->sectionOffset);
+    pSym = (const RelBinSymbol_t *) (pImage + pHdr->symbolOffset);
+    pRel = (const RelBinReloc_t *) (pImage + pHdr->relocOffset);
+    pCode = (uint16_t *) (pImage + pHdr->codeOffset);
+    pStrings = (const char *) pImage + pHdr->stringOffset;
+
+    for (x = 0; x < pHdr->sectionCount; x++, pSec++)
     {
-        auto it = m_FileSections.begin();
-        while (it != m_FileSections.end())
+        pSection = new CFileSection(NULL, pCode + pSec->code);
+        pSection->m_Filename = pFilename;
+        pSection->m_Name = pStrings + pSec->name;
+        pSection->m_Address = pSec->address;
+        pSection->m_FirstCodeOffset = pSec->firstCode;
+        pSection->m_LastCodeOffset = pSec->lastCode;
+        pSection->m_CodeSize = pSec->lastCode;
+        if (!m_FileSections.insert(std::pair<std::string, CFileSection *>(
+                pSection->m_Name, pSection)).second)
         {
-            printf("Section: %s\n", it->second->m_Name.c_str());
+            printf("%s: Duplicate section %s\n", pFilename, pSection->m_Name.c_str());
+            delete pSection;
+            return ERROR_DUPLICATE_SECTION;
+        }
 
-            // Print all public labels
-            auto pit = it->second->m_PublicLabels.begin();
-            while (pit != it->second->m_PublicLabels.end())
-            {
-                printf("  PUBLIC: %s\n", pit->first.c_str());
-                pit++;
-            }
+        for (y = pSec->firstSymbol; y < pSec->firstSymbol + pSec->symbolCount; y++)
+        {
+            if (pSym[y].type == RELBIN_SYM_PUBLIC)
+                pSection->m_PublicLabels.insert(std::pair<std::string, int>(
+                        pStrings + pSym[y].name, pSym[y].value));
+            else
+                pSection->m_LocalLabels.insert(std::pair<std::string, int>(
+                        pStrings + pSym[y].name, pSym[y].value));
+        }
 
-            // Print all extern references
-            auto eit = it->second->m_ExternsList.begin();
-            while (eit != it->second->m_ExternsList.end())
+        for (y = pSec->firstReloc; y < pSec->firstReloc + pSec->relocCount; y++)
+        {
+            pReloc = new CRelocation;
+            pReloc->m_Type = pRel[y].type;
+            pReloc->m_Offset = pRel[y].offset;
+            pReloc->m_Opcode = pRel[y].opcode;
+            if (pRel[y].type == RELBIN_REL_EXTERN)
             {
-                printf("  EXTERN: %s\n", (*eit)->m_Label.c_str());
-                eit++;
+                pReloc->m_Label = pStrings + pRel[y].name;
+                pSection->m_ExternsList.push_back(pReloc);
             }
-
-            // Print all relocation references
-            auto rit = it->second->m_RelocationList.begin();
-            while (rit != it->second->m_RelocationList.end())
+            else
             {
-                printf("  RELOC:  0x%04X  %s\n", (*rit)->m_Opcode, (*rit)->m_Label.c_str());
-                rit++;
+                pReloc->m_Section = pStrings + pRel[y].name;
+                pReloc->m_pSection = pSection;
+                pSection->m_RelocationList.push_back(pReloc);
+                m_RelocIndex[pReloc->m_Section].push_back(pReloc);
             }
+        }
+    }
+
+    return ERROR_NONE;
+}
+
+/* 
+=============================================================================
+Load a relocatable file in either the text or binary format
+=============================================================================
+*/
+int CFile::LoadRelFile(const char *pFilename)
+{
+    int32_t         lastErr;
+
+    if (CRelObject::IsBinary(pFilename))
+        lastErr = LoadRelBinFile(pFilename);
+    else
+        lastErr = LoadRelTextFile(pFilename);
+
+    if (m_DebugLevel > 1)
+        PrintSections();
+
+    return lastErr;
+}
+
+/* 
+=============================================================================
+Load one member of a library archive.  Binary members are used in place in
+the archive's mapping, text members are parsed straight from it.
+=============================================================================
+*/
+int CFile::LoadArchiveMember(CArchive *pArchive, int member)
+{
+    uint8_t        *pImage;
+    size_t          size;
+    FILE           *fd;
+    int32_t         err;
 
-            // Print all opcode values
-            if (it->second->m_FirstCodeOffset != 0xFFFFFF)
+    pImage = pArchive->MemberImage(member, size);
+    m_Filename = pArchive->m_Filename + "(" + pArchive->MemberName(member) + ")";
+
+    if (size >= 4 && memcmp(pImage, RELBIN_MAGIC, 4) == 0)
+        err = LoadRelBinImage(pImage, size, m_Filename.c_str());
+    else
+    {
+        if ((fd = fmemopen(pImage, size, "r")) == NULL)
+        {
+            printf("Error reading %s\n", m_Filename.c_str());
+            return ERROR_CANT_READ_FILE;
+        }
+        err = LoadRelText(fd, m_Filename.c_str());
+        fclose(fd);
+    }
+
+    if (m_DebugLevel > 1)
+        PrintSections();
+
+    return err;
+}
+
+/* 
+=============================================================================
+Print the loaded sections for debugging
+=============================================================================
+*/
+void CFile::PrintSections(void)
+{
+    int             c;
+    int             numOnLine;
+
+    auto it = m_FileSections.begin();
+    while (it != m_FileSections.end())
+    {
+        printf("Section: %s\n", it->second->m_Name.c_str());
+
+        // Print all public labels
+        auto pit = it->second->m_PublicLabels.begin();
+        while (pit != it->second->m_PublicLabels.end())
+        {
+            printf("  PUBLIC: %s\n", pit->first.c_str());
+            pit++;
+        }
+
+        // Print all extern references
+        auto eit = it->second->m_ExternsList.begin();
+        while (eit != it->second->m_ExternsList.end())
+        {
+            printf("  EXTERN: %s\n", (*eit)->m_Label.c_str());
+            eit++;
+        }
+
+        // Print all relocation references
+        auto rit = it->second->m_RelocationList.begin();
+        while (rit != it->second->m_RelocationList.end())
+        {
+            printf("  RELOC:  0x%04X  %s\n", (*rit)->m_Opcode, (*rit)->m_Label.c_str());
+            rit++;
+        }
+
+        // Print all opcode values
+        if (it->second->m_FirstCodeOffset != 0xFFFFFF)
+        {
+            printf("  CODE:  0x%04X - 0x%04X\n", it->second->m_FirstCodeOffset,
+                    it->second->m_LastCodeOffset);
+            numOnLine = 0;
+            printf("    ");
+            for (c = it->second->m_FirstCodeOffset; c < it->second->m_LastCodeOffset; c++)
             {
-                printf("  CODE:  0x%04X - 0x%04X\n", it->second->m_FirstCodeOffset,
-                        it->second->m_LastCodeOffset);
-                numOnLine = 0;
-                printf("    ");
-                for (c = it->second->m_FirstCodeOffset; c < it->second->m_LastCodeOffset; c++)
+                printf("0x%04X  ", it->second->m_pCode[c]);
+                numOnLine++;
+                if (numOnLine == 8)
                 {
-                    printf("0x%04X  ", it->second->m_pCode[c]);
-                    numOnLine++;
-                    if (numOnLine == 8)
-                    {
-                        printf("\n    ");
-                        numOnLine = 0;
-                    }
+                    printf("\n    ");
+                    numOnLine = 0;
                 }
-                printf("\n");
-            }
-            else if (it->second->m_Address != 0)
-            {
-                printf("  DATA: 0x0000 - 0x%04X\n", it->second->m_Address);
             }
-
-            it++;
+            printf("\n");
+        }
+        else if (it->second->m_Address != 0)
+        {
+            printf("  DATA: 0x0000 - 0x%04X\n", it->second->m_Address);
         }
-    }
 
-    return lastErr;
+        it++;
+    }
 }
 
 // vim: sw=4 ts=4
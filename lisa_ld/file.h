@@ -23,15 +23,21 @@
 #define FILE_H
 
 #include "parser.h"
+#include "codearena.h"
+#include "archive.h"
+#include "errors.h"
+#include <vector>
 
 #define REL_TYPE_EXTERN     1
 #define REL_TYPE_FUNCTION   2
 #define REL_TYPE_SYMBOL     3
 
+class CFileSection;
+
 class CRelocation
 {
     public:
-        CRelocation() { m_Offset = 0; m_Opcode = 0; m_Resolved = 0; }
+        CRelocation() { m_Offset = 0; m_Opcode = 0; m_Resolved = 0; m_pSection = NULL; }
 
         int             m_Type;
         int             m_Offset;
@@ -39,19 +45,47 @@ class CRelocation
         int             m_Resolved;
         std::string     m_Section;
         std::string     m_Label;
+        CFileSection   *m_pSection;         // Section holding the word
 };
 
+/// Largest section offset a relocatable file may place code at
+#define MAX_SECTION_WORDS   65536
+
+/// Initial size of a section's code buffer
+#define MIN_SECTION_WORDS   64
+
 typedef std::map<std::string, int> StrIntMap_t;
 typedef std::list<CRelocation *> RelocationList_t;
+typedef std::vector<CRelocation *> RelocationVector_t;
+
+/// Section relative relocations of a file, bucketed by the section they
+/// are relative to
+typedef std::map<std::string, RelocationVector_t> RelocationIndex_t;
 
 class CFileSection
 {
     public:
-        CFileSection() { m_Address = 0; m_Line = 0; m_LocateAddress = -1;
-                         m_pCode = new uint16_t[8192];
+        CFileSection(CCodeArena *pArena, uint16_t *pCode = NULL) { m_Address = 0; m_Line = 0;
+                         m_LocateAddress = -1;
+                         m_pArena = pArena; m_pCode = pCode; m_CodeSize = 0;
+                         m_Mapped = pCode != NULL;
                          m_FirstCodeOffset = 0xFFFFFF;
-                         m_LastCodeOffset = 0; }
-        ~CFileSection() { delete[] m_pCode; }
+                         m_LastCodeOffset = 0;
+                         m_OverlayOffset = -1; }
+
+        /// Stores a word, growing the code buffer as needed
+        int                 SetCode(int offset, uint16_t value)
+                            {
+                                int err;
+                                if (offset >= m_CodeSize &&
+                                    (err = GrowCode(offset + 1)) != ERROR_NONE)
+                                        return err;
+                                m_pCode[offset] = value;
+                                return ERROR_NONE;
+                            }
+
+        /// Grows the code buffer to hold at least 'words' zeroed words
+        int                 GrowCode(int words);
 
         std::string         m_Filename;
         std::string         m_Name;
@@ -63,10 +97,14 @@ class CFileSection
         RelocationList_t    m_ExternsList;
         CMemory            *m_pLocateMem;       // Locate memory region
 
+        CCodeArena         *m_pArena;           // Arena the code buffer lives in
         uint16_t           *m_pCode;
+        int                 m_CodeSize;         // Words available in m_pCode
+        bool                m_Mapped;           // True if m_pCode is in a mapped file
         int                 m_LocateAddress;
         int                 m_FirstCodeOffset;
         int                 m_LastCodeOffset;
+        int                 m_OverlayOffset;    // Static frame offset in the overlay region
 };
 
 typedef std::map<std::string, CFileSection *> FileSectionMap_t;
@@ -75,14 +113,31 @@ class CFile
 {
     public:
         CFile(CParseCtx* pSpec);
+        ~CFile();
 
+        /// Loads a text or binary relocatable file
         int                 LoadRelFile(const char *pFilename);
 
+        /// Loads a member of a library archive
+        int                 LoadArchiveMember(CArchive *pArchive, int member);
+
         int                 m_DebugLevel;
         std::string         m_Filename;
         FileSectionMap_t    m_FileSections;
+        FileSectionMap_t    m_DroppedSections;  // Discarded by --gc-sections
+        RelocationIndex_t   m_RelocIndex;
+
+        /// Arena holding the code of all text loaded sections
+        static CCodeArena   m_CodeArena;
 
     private:
+        int                 LoadRelTextFile(const char *pFilename);
+        int                 LoadRelText(FILE *fd, const char *pFilename);
+        int                 LoadRelBinFile(const char *pFilename);
+        int                 LoadRelBinImage(uint8_t *pImage, size_t size,
+                                const char *pFilename);
+        void                PrintSections(void);
+
         /// Parses a single line from a CParseCtx file
         int                 ParseLine(const char* pLine, CParserFile* pFile);
         int                 ParseArgs(char *sLine, CParserFile* pFile);
@@ -101,6 +156,10 @@ class CFile
         std::string         m_Args[8];
         int                 m_Argc;
 
+        /// Memory mapping of a binary relocatable file
+        void*               m_pMap;
+        size_t              m_MapSize;
+
         /// Pointer to the CParseCtx we are parsing into
         CParseCtx*          m_pSpec;
 };
@@ -24,6 +24,10 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <set>
+#include <algorithm>
 
 #include "linker.h"
 #include "errors.h"
@@ -39,6 +43,8 @@ CLinker::CLinker( CParseCtx *pSpec )
     m_DebugLevel = 0;
     m_Mixed = 0;
     m_MapFile = 0;
+    m_GcSections = 0;
+    m_OverlaySize = 0;
 }
 
 /* 
@@ -91,41 +97,275 @@ void CLinker::AddLibPath(const char *name)
 
 /* 
 =============================================================================
-Locate segments by spec
+Add a library to be searched for unresolved externs (-l name)
 =============================================================================
 */
-int CLinker::LocateSectionsBySpec(CSection *pSection, COperation *pOp)
+void CLinker::AddLibrary(const char *name)
 {
-    int         searchMode = 0;
-    char        str[pOp->m_StrParam.length()+1];
-    int         err = ERROR_NONE;
-    int         match;
-    char        mapStr[256];
+    m_LibNames.push_back(name);
+}
 
-    if (m_DebugLevel > 0)
-        printf("Locating sections with %s\n", pOp->m_StrParam.c_str());
-    if (strncmp(pOp->m_StrParam.c_str(), "*(", 2) == 0)
+/* 
+=============================================================================
+Add a library archive given by filename
+=============================================================================
+*/
+int CLinker::AddArchive(const char *pFilename)
+{
+    CArchive   *pArchive = new CArchive;
+    int         err;
+
+    if ((err = pArchive->Open(pFilename)) != ERROR_NONE)
+    {
+        delete pArchive;
+        return err;
+    }
+
+    m_Archives.push_back(pArchive);
+    return ERROR_NONE;
+}
+
+/* 
+=============================================================================
+Find each -l library in the library paths.  'name' is tried as libname.lar
+then as given, in each -L path and then the current directory.
+=============================================================================
+*/
+int CLinker::OpenLibraries(void)
+{
+    std::string     path;
+    bool            found;
+    int             err;
+
+    auto nit = m_LibNames.begin();
+    while (nit != m_LibNames.end())
+    {
+        found = false;
+        StrList_t   paths = m_pSpec->m_LibPaths;
+        paths.push_back("");
+
+        auto pit = paths.begin();
+        while (!found && pit != paths.end())
+        {
+            path = *pit + "lib" + *nit + ".lar";
+            if (access(path.c_str(), R_OK) != 0)
+                path = *pit + *nit;
+            if (access(path.c_str(), R_OK) == 0)
+            {
+                if ((err = AddArchive(path.c_str())) != ERROR_NONE)
+                    return err;
+                found = true;
+            }
+            pit++;
+        }
+
+        if (!found)
+        {
+            printf("Unable to find library %s\n", nit->c_str());
+            return ERROR_FILE_NOT_FOUND;
+        }
+        nit++;
+    }
+
+    return ERROR_NONE;
+}
+
+/* 
+=============================================================================
+Pull in the archive members that define outstanding externs.  Members are
+appended to the file list, so walking the list until its end also visits
+the externs of every member loaded along the way.
+=============================================================================
+*/
+int CLinker::LoadLibraryMembers(void)
+{
+    std::set<std::string>   defined;
+    std::set<std::string>   searched;
+    CFile                  *pFile;
+    int                     member;
+    int                     err;
+
+    if (m_Archives.empty())
+        return ERROR_NONE;
+
+    // Collect the PUBLIC symbols of the input files
+    auto fit = m_FileList.begin();
+    while (fit != m_FileList.end())
+    {
+        auto sit = (*fit)->m_FileSections.begin();
+        while (sit != (*fit)->m_FileSections.end())
+        {
+            auto pit = sit->second->m_PublicLabels.begin();
+            while (pit != sit->second->m_PublicLabels.end())
+            {
+                defined.insert(pit->first);
+                pit++;
+            }
+            sit++;
+        }
+        fit++;
+    }
+
+    fit = m_FileList.begin();
+    while (fit != m_FileList.end())
+    {
+        auto sit = (*fit)->m_FileSections.begin();
+        while (sit != (*fit)->m_FileSections.end())
+        {
+            auto xit = sit->second->m_ExternsList.begin();
+            while (xit != sit->second->m_ExternsList.end())
+            {
+                const std::string& label = (*xit)->m_Label;
+                xit++;
+
+                // Skip symbols already defined or already looked up.  Linker
+                // script variables are defined too.
+                if (defined.count(label) || m_pSpec->m_Variables.count(label) ||
+                    !searched.insert(label).second)
+                {
+                    continue;
+                }
+
+                // Search the archives in order
+                auto ait = m_Archives.begin();
+                for (member = -1; ait != m_Archives.end(); ait++)
+                    if ((member = (*ait)->FindSymbol(label.c_str())) >= 0)
+                        break;
+                if (member < 0 || (*ait)->m_Loaded[member])
+                    continue;
+
+                if (m_DebugLevel > 0)
+                    printf("Loading %s(%s) for %s\n", (*ait)->m_Filename.c_str(),
+                            (*ait)->MemberName(member), label.c_str());
+
+                // Load the member and add it to the end of the file list
+                (*ait)->m_Loaded[member] = true;
+                pFile = new CFile(m_pSpec);
+                pFile->m_DebugLevel = m_DebugLevel;
+                if ((err = pFile->LoadArchiveMember(*ait, member)) != ERROR_NONE)
+                    return err;
+                m_FileList.push_back(pFile);
+
+                auto msit = pFile->m_FileSections.begin();
+                while (msit != pFile->m_FileSections.end())
+                {
+                    auto pit = msit->second->m_PublicLabels.begin();
+                    while (pit != msit->second->m_PublicLabels.end())
+                    {
+                        defined.insert(pit->first);
+                        pit++;
+                    }
+                    msit++;
+                }
+            }
+            sit++;
+        }
+        fit++;
+    }
+
+    return ERROR_NONE;
+}
+
+/* 
+=============================================================================
+Append "0x%04X name" to a map symbol list without going through sprintf
+=============================================================================
+*/
+static void AddMapSymbol(StrList_t& symbols, int address, const std::string& name)
+{
+    static const char   hex[] = "0123456789ABCDEF";
+    char                digits[8];
+    uint32_t            value = (uint32_t) address;
+    int                 count = 0;
+
+    // Collect the digits least significant first, at least 4 of them
+    do
+    {
+        digits[count++] = hex[value & 0xF];
+        value >>= 4;
+    } while (value != 0);
+    while (count < 4)
+        digits[count++] = '0';
+
+    symbols.push_back(std::string());
+    std::string& str = symbols.back();
+    str.reserve(count + 3 + name.length());
+    str += "0x";
+    while (count > 0)
+        str += digits[--count];
+    str += ' ';
+    str += name;
+}
+
+/* 
+=============================================================================
+Split a section load specification into the string to match and the
+search mode:  0 is an exact name, 1 "*(name)" matches the end of the
+section name and 2 "*(name*)" matches if the section name is in 'name'.
+=============================================================================
+*/
+static int ParseLoadSpec(const std::string& spec, std::string& str)
+{
+    int     searchMode = 0;
+
+    if (strncmp(spec.c_str(), "*(", 2) == 0)
     {
         // Search mode 1 is match last part of string
         searchMode = 1;
-        strcpy(str, &pOp->m_StrParam.c_str()[2]);
-        if (str[strlen(str)-1] == ')')
-            str[strlen(str)-1] = 0;
+        str = spec.substr(2);
+        if (!str.empty() && str[str.length()-1] == ')')
+            str.erase(str.length()-1);
 
         // Test if the string end with wildcard
-        if (str[strlen(str)-1] == '*')
+        if (!str.empty() && str[str.length()-1] == '*')
         {
             // SearchMode 2 is strstr
             searchMode = 2;
-            str[strlen(str)-1] = 0;
+            str.erase(str.length()-1);
         }
     }
     else 
-        strcpy(str, pOp->m_StrParam.c_str());
+        str = spec;
+
+    return searchMode;
+}
+
+/* 
+=============================================================================
+Test if a section name matches a parsed load specification
+=============================================================================
+*/
+static bool SectionMatchesSpec(int searchMode, const std::string& str,
+        const std::string& name)
+{
+    if (searchMode == 0)
+        return name == str;
+    else if (searchMode == 1)
+        return name.length() >= str.length() &&
+            name.compare(name.length() - str.length(), str.length(), str) == 0;
+    else
+        return strstr(str.c_str(), name.c_str()) != NULL;
+}
+
+/* 
+=============================================================================
+Locate segments by spec
+=============================================================================
+*/
+int CLinker::LocateSectionsBySpec(CSection *pSection, COperation *pOp)
+{
+    int         searchMode;
+    std::string str;
+    int         err = ERROR_NONE;
+    int         overlayBase = -1;
+    StrList_t  *pMapSymbols;
+
+    if (m_DebugLevel > 0)
+        printf("Locating sections with %s\n", pOp->m_StrParam.c_str());
+    searchMode = ParseLoadSpec(pOp->m_StrParam, str);
 
     // Loop for all files
     auto fit = m_FileList.begin();
-    int  len = strlen(str);
     while (fit != m_FileList.end())
     {
         // Iterate through all sections of this file
@@ -140,37 +380,45 @@ int CLinker::LocateSectionsBySpec(CSection *pSection, COperation *pOp)
                 continue;
             }
 
-            match = 0;
-            if (searchMode == 0)
-            {
-                if (strcmp(str, sit->first.c_str()) == 0)
-                    match = 1;
-            }
-            else if (searchMode == 1)
-            {
-                const char *pStr = sit->first.c_str();
-                if (sit->first.length() >= len && strcmp(str, &pStr[strlen(pStr) - len]) == 0)
-                    match = 1;
-            }
-            else if (searchMode == 2)
-            {
-                if (strstr(str, sit->first.c_str()) != NULL)
-                    match = 1;
-            }
-
-            if (match)
+            if (SectionMatchesSpec(searchMode, str, sit->first))
             {
                 int     offset = pSection->m_pMem->m_Address;
 
+                // Static frames go to their offset in the overlay region,
+                // which the first one reserves
+                if (sit->second->m_OverlayOffset != -1)
+                {
+                    if (overlayBase == -1)
+                    {
+                        overlayBase = pSection->m_pMem->m_Address;
+                        pSection->m_pMem->m_Address += m_OverlaySize;
+                    }
+                    offset = overlayBase + sit->second->m_OverlayOffset;
+
+                    // They are accessed with lda / sta
+                    if (offset + sit->second->m_LastCodeOffset > MAX_DIRECT_ADDRESS + 1)
+                    {
+                        printf("%s: Static frame %s at 0x%04X is out of direct address range\n",
+                                (*fit)->m_Filename.c_str(), sit->first.c_str(), offset);
+                        err = ERROR_MEMORY_OVERFLOW;
+                    }
+                }
+
                 // Locate the section at the current Memory address
                 if (m_DebugLevel > 0)
-                    printf("   Adding %s at 0x%04X\n", sit->first.c_str(), pSection->m_pMem->m_Address);
+                    printf("   Adding %s at 0x%04X\n", sit->first.c_str(), offset);
 
                 // If the section has an AT specifier, then it will be located there
                 if (pSection->m_pAtMem)
                     sit->second->m_LocateAddress = pSection->m_pAtMem->m_Address;
                 else
-                    sit->second->m_LocateAddress = pSection->m_pMem->m_Address;
+                    sit->second->m_LocateAddress = offset;
+
+                // Labels go to either the CODE or DATA map symbol list
+                if (strchr(pSection->m_pMem->m_Access.c_str(), 'x') != NULL)
+                    pMapSymbols = &m_CodeMapSymbols;
+                else
+                    pMapSymbols = &m_DataMapSymbols;
 
                 // Update all PUBLIC symbol addresses in this section and add
                 // them to our known label map
@@ -190,19 +438,11 @@ int CLinker::LocateSectionsBySpec(CSection *pSection, COperation *pOp)
                     }
                     else
                     {
-                        char  sVal[16];
-                        sprintf(sVal, "%d", pit->second);
                         m_pSpec->m_Variables.insert(std::pair<std::string,
-                                std::string>(pit->first, sVal));
+                                std::string>(pit->first, std::to_string(pit->second)));
                     }
 
-                    sprintf(mapStr, "0x%04X %s", pit->second, pit->first.c_str());
-
-                    // Add this label to either the CODE or DATA label list
-                    if (strchr(pSection->m_pMem->m_Access.c_str(), 'x') != NULL)
-                        m_CodeMapSymbols.push_back(mapStr);
-                    else
-                        m_DataMapSymbols.push_back(mapStr);
+                    AddMapSymbol(*pMapSymbols, pit->second, pit->first);
 
                     // Next public label
                     pit++;
@@ -214,47 +454,34 @@ int CLinker::LocateSectionsBySpec(CSection *pSection, COperation *pOp)
                 {
                     // Update the label address
                     lit->second += offset;
-
-                    sprintf(mapStr, "0x%04X %s", lit->second, lit->first.c_str());
-
-                    // Add this label to either the CODE or DATA label list
-                    if (strchr(pSection->m_pMem->m_Access.c_str(), 'x') != NULL)
-                        m_CodeMapSymbols.push_back(mapStr);
-                    else
-                        m_DataMapSymbols.push_back(mapStr);
+                    AddMapSymbol(*pMapSymbols, lit->second, lit->first);
 
                     // Next public label
                     lit++;
                 }
                     
-                // Perform relocations of this section with this file
-                auto sit2 = (*fit)->m_FileSections.begin();
-                while (sit2 != (*fit)->m_FileSections.end())
+                // Perform the relocations of this file that are relative to
+                // this section.  They were bucketed by target when loaded.
+                auto bit = (*fit)->m_RelocIndex.find(sit->first);
+                if (bit != (*fit)->m_RelocIndex.end())
                 {
-                    // Iterate through all relocations
-                    auto rit = sit2->second->m_RelocationList.begin();
-                    while (rit != sit2->second->m_RelocationList.end())
+                    auto rit = bit->second.begin();
+                    while (rit != bit->second.end())
                     {
-                        // Test if this relocation is relative to this file section
-                        if ((*rit)->m_Section == sit->first)
-                        {
-                            // Add the location offset to the opcode
-                            (*rit)->m_Opcode += offset;
-                            
-                            // Save the resulting value to the code
-                            sit2->second->m_pCode[(*rit)->m_Offset] = (*rit)->m_Opcode;
-                        }
+                        // Add the location offset to the opcode
+                        (*rit)->m_Opcode += offset;
+
+                        // Save the resulting value to the code
+                        (*rit)->m_pSection->m_pCode[(*rit)->m_Offset] = (*rit)->m_Opcode;
 
                         // Next relocation
                         rit++;
                     }
-
-                    // Next section within this file
-                    sit2++;
                 }
 
                 // Advance the Memory address by the section's size
-                pSection->m_pMem->m_Address += sit->second->m_LastCodeOffset;
+                if (sit->second->m_OverlayOffset == -1)
+                    pSection->m_pMem->m_Address += sit->second->m_LastCodeOffset;
                 sit->second->m_pLocateMem = pSection->m_pMem;
 
                 // If this section has an AT specifier, advance that address also 
@@ -276,6 +503,540 @@ int CLinker::LocateSectionsBySpec(CSection *pSection, COperation *pOp)
     return err;
 }
 
+/* 
+=============================================================================
+Discard sections that can't be reached from the ENTRY symbol or a KEEP()
+section by following extern references and section relative relocations.
+Discarded sections are kept by their CFile since relocations into located
+sections may still patch their words.
+=============================================================================
+*/
+int CLinker::CollectGarbage(void)
+{
+    typedef std::pair<CFile *, CFileSection *>  FileSection_t;
+    std::map<std::string, FileSection_t>        publics;
+    std::set<CFileSection *>                    live;
+    std::vector<FileSection_t>                  work;
+    std::string                                 str;
+    FileSection_t                               item;
+    int                                         searchMode;
+
+    // Map every PUBLIC label to the section defining it
+    auto fit = m_FileList.begin();
+    while (fit != m_FileList.end())
+    {
+        auto sit = (*fit)->m_FileSections.begin();
+        while (sit != (*fit)->m_FileSections.end())
+        {
+            auto pit = sit->second->m_PublicLabels.begin();
+            while (pit != sit->second->m_PublicLabels.end())
+            {
+                publics.insert(std::pair<std::string, FileSection_t>(pit->first,
+                        FileSection_t(*fit, sit->second)));
+                pit++;
+            }
+            sit++;
+        }
+        fit++;
+    }
+
+    // The section holding the entry point is a root
+    if (!m_pSpec->m_EntryLabel.empty())
+    {
+        auto eit = publics.find(m_pSpec->m_EntryLabel);
+        if (eit == publics.end())
+            printf("Warning: Entry symbol %s not defined\n", m_pSpec->m_EntryLabel.c_str());
+        else if (live.insert(eit->second.second).second)
+            work.push_back(eit->second);
+    }
+
+    // Every section matched by a KEEP() specification is a root
+    auto it = m_pSpec->m_SectionList.begin();
+    while (it != m_pSpec->m_SectionList.end())
+    {
+        auto opit = (*it)->m_Ops.begin();
+        while (opit != (*it)->m_Ops.end())
+        {
+            if ((*opit)->m_Type == OP_LOAD_SECTION && ((*opit)->m_IntParam & PARAM_KEEP))
+            {
+                searchMode = ParseLoadSpec((*opit)->m_StrParam, str);
+                fit = m_FileList.begin();
+                while (fit != m_FileList.end())
+                {
+                    auto sit = (*fit)->m_FileSections.begin();
+                    while (sit != (*fit)->m_FileSections.end())
+                    {
+                        if (SectionMatchesSpec(searchMode, str, sit->first) &&
+                            live.insert(sit->second).second)
+                        {
+                            work.push_back(FileSection_t(*fit, sit->second));
+                        }
+                        sit++;
+                    }
+                    fit++;
+                }
+            }
+            opit++;
+        }
+        it++;
+    }
+
+    // With no roots every section would be discarded
+    if (work.empty())
+    {
+        printf("Error: --gc-sections has no ENTRY symbol or KEEP() section to start from\n");
+        return ERROR_NO_GC_ROOTS;
+    }
+
+    // Mark everything reachable from the roots
+    while (!work.empty())
+    {
+        item = work.back();
+        work.pop_back();
+
+        auto xit = item.second->m_ExternsList.begin();
+        while (xit != item.second->m_ExternsList.end())
+        {
+            auto pit = publics.find((*xit)->m_Label);
+            if (pit != publics.end() && live.insert(pit->second.second).second)
+                work.push_back(pit->second);
+            xit++;
+        }
+
+        auto rit = item.second->m_RelocationList.begin();
+        while (rit != item.second->m_RelocationList.end())
+        {
+            auto sit = item.first->m_FileSections.find((*rit)->m_Section);
+            if (sit != item.first->m_FileSections.end() && live.insert(sit->second).second)
+                work.push_back(FileSection_t(item.first, sit->second));
+            rit++;
+        }
+    }
+
+    // Move the unreachable sections out of the way
+    fit = m_FileList.begin();
+    while (fit != m_FileList.end())
+    {
+        auto sit = (*fit)->m_FileSections.begin();
+        while (sit != (*fit)->m_FileSections.end())
+        {
+            if (live.count(sit->second))
+            {
+                sit++;
+                continue;
+            }
+
+            if (m_DebugLevel > 0)
+                printf("Discarding %s (%d words)\n", sit->first.c_str(),
+                        sit->second->m_LastCodeOffset);
+            m_Discarded.push_back(sit->second);
+            (*fit)->m_DroppedSections.insert(*sit);
+            sit = (*fit)->m_FileSections.erase(sit);
+        }
+        fit++;
+    }
+
+    return ERROR_NONE;
+}
+
+/* 
+=============================================================================
+Test if a section is matched by a load specification of the linker script
+that goes to an executable memory region, or with keep set, by a KEEP()
+specification.
+=============================================================================
+*/
+static bool SectionLoadedBy(CParseCtx *pSpec, const std::string& name, bool keep)
+{
+    std::string str;
+    int         searchMode;
+
+    auto it = pSpec->m_SectionList.begin();
+    while (it != pSpec->m_SectionList.end())
+    {
+        auto opit = (*it)->m_Ops.begin();
+        while (opit != (*it)->m_Ops.end())
+        {
+            if ((*opit)->m_Type == OP_LOAD_SECTION)
+            {
+                searchMode = ParseLoadSpec((*opit)->m_StrParam, str);
+                if (SectionMatchesSpec(searchMode, str, name))
+                {
+                    if (keep)
+                        return ((*opit)->m_IntParam & PARAM_KEEP) != 0;
+                    return (*it)->m_pMem != NULL &&
+                        strchr((*it)->m_pMem->m_Access.c_str(), 'x') != NULL;
+                }
+            }
+            opit++;
+        }
+        it++;
+    }
+
+    return false;
+}
+
+/// A function of the call graph the static frames are overlaid with
+typedef struct
+{
+    CFile              *pFile;
+    CFileSection       *pCode;          // Section holding the function
+    std::string         name;
+    int                 addr;           // Offset of the function in pCode
+    CFileSection       *pFrame;         // Its static frame, if any
+    int                 size;           // Bytes in the static frame
+    bool                vector;         // In a KEEP() section
+    bool                addrTaken;      // May be called through a pointer
+    bool                called;
+    int                 thread;         // Root it was first reached from
+    std::vector<int>    calls;
+} OverlayFunc_t;
+
+/* 
+=============================================================================
+Find the function holding the given offset of a code section
+=============================================================================
+*/
+static int FindOverlayFunc(std::map<CFileSection *, std::vector<int> >& bySection,
+        std::vector<OverlayFunc_t>& funcs, CFileSection *pCode, int offset)
+{
+    int     found = -1;
+
+    auto it = bySection.find(pCode);
+    if (it == bySection.end())
+        return -1;
+
+    // The functions are sorted by address
+    auto fit = it->second.begin();
+    while (fit != it->second.end() && funcs[*fit].addr <= offset)
+    {
+        found = *fit;
+        fit++;
+    }
+
+    return found;
+}
+
+/* 
+=============================================================================
+Assign the static frames lisa_cc -fstatic-frames writes to the
+<module>.<function>.overlay sections their offsets in the overlay region.
+
+The call graph is built from the jal relocations and externs of the code
+sections.  A frame is placed above the frames of every function that may
+call it, so the frames of functions that are never active at the same
+time share addresses.  Each function called from a KEEP() section (the
+reset and interrupt vectors) is the root of its own thread, and threads
+get separate parts of the region.  Functions whose address is taken and
+functions nothing calls are placed above all threads, since it isn't
+known who calls them.
+=============================================================================
+*/
+int CLinker::AllocateOverlays(void)
+{
+    std::vector<OverlayFunc_t>                  funcs;
+    std::map<CFileSection *, std::vector<int> > bySection;
+    std::map<std::string, int>                  publics;
+    std::vector<std::vector<int> >              groups;
+    std::vector<int>                            offset;
+    std::vector<int>                            work;
+    std::vector<bool>                           member;
+    std::vector<int>                            seen;
+    std::list<CFileSection *>                   orphans;
+    OverlayFunc_t                               func;
+    int                                         caller, callee, i;
+    int                                         err = ERROR_NONE;
+
+    m_OverlaySize = 0;
+
+    // Find the static frames
+    auto fit = m_FileList.begin();
+    while (fit != m_FileList.end())
+    {
+        auto sit = (*fit)->m_FileSections.begin();
+        while (sit != (*fit)->m_FileSections.end())
+        {
+            if (SectionMatchesSpec(1, ".overlay", sit->first))
+                m_Overlays.push_back(sit->second);
+            sit++;
+        }
+        fit++;
+    }
+    if (m_Overlays.empty())
+        return ERROR_NONE;
+
+    // Every label of a code section starts a function
+    fit = m_FileList.begin();
+    while (fit != m_FileList.end())
+    {
+        auto sit = (*fit)->m_FileSections.begin();
+        while (sit != (*fit)->m_FileSections.end())
+        {
+            if (!SectionLoadedBy(m_pSpec, sit->first, false))
+            {
+                sit++;
+                continue;
+            }
+
+            func.pFile = *fit;
+            func.pCode = sit->second;
+            func.pFrame = NULL;
+            func.size = 0;
+            func.vector = SectionLoadedBy(m_pSpec, sit->first, true);
+            func.addrTaken = false;
+            func.called = false;
+            func.thread = -1;
+            for (int pass = 0; pass < 2; pass++)
+            {
+                StrIntMap_t& labels = pass ? sit->second->m_LocalLabels :
+                    sit->second->m_PublicLabels;
+                auto lit = labels.begin();
+                while (lit != labels.end())
+                {
+                    func.name = lit->first;
+                    func.addr = lit->second;
+                    if (pass == 0)
+                        publics[func.name] = funcs.size();
+                    bySection[sit->second].push_back(funcs.size());
+                    funcs.push_back(func);
+                    lit++;
+                }
+            }
+
+            std::vector<int>& list = bySection[sit->second];
+            std::sort(list.begin(), list.end(), [&funcs](int a, int b)
+                    { return funcs[a].addr < funcs[b].addr; });
+            sit++;
+        }
+        fit++;
+    }
+
+    // Give each frame to its function:  <module>.<function>.overlay
+    auto oit = m_Overlays.begin();
+    while (oit != m_Overlays.end())
+    {
+        std::string prefix = (*oit)->m_Name.substr(0, (*oit)->m_Name.length() - 8);
+
+        for (i = 0; i < (int) funcs.size(); i++)
+        {
+            if (funcs[i].pCode->m_Filename == (*oit)->m_Filename &&
+                prefix.length() > funcs[i].name.length() &&
+                prefix.compare(prefix.length() - funcs[i].name.length() - 1,
+                    std::string::npos, "." + funcs[i].name) == 0)
+            {
+                funcs[i].pFrame = *oit;
+                funcs[i].size = (*oit)->m_LastCodeOffset;
+                break;
+            }
+        }
+        if (i == (int) funcs.size())
+        {
+            printf("%s: No function for static frame %s\n", (*oit)->m_Filename.c_str(),
+                    (*oit)->m_Name.c_str());
+            orphans.push_back(*oit);
+        }
+        oit++;
+    }
+
+    // Build the call graph from the jal relocations and the externs
+    for (caller = 0; caller < (int) funcs.size(); caller++)
+    {
+        CFileSection *pCode = funcs[caller].pCode;
+
+        // Each section's relocations are only visited from its first function
+        if (bySection[pCode].front() != caller)
+            continue;
+
+        auto rit = pCode->m_RelocationList.begin();
+        while (rit != pCode->m_RelocationList.end())
+        {
+            auto sit = funcs[caller].pFile->m_FileSections.find((*rit)->m_Section);
+            if (sit != funcs[caller].pFile->m_FileSections.end() &&
+                (callee = FindOverlayFunc(bySection, funcs, sit->second,
+                    (*rit)->m_Opcode)) != -1)
+            {
+                i = FindOverlayFunc(bySection, funcs, pCode, (*rit)->m_Offset);
+                if ((*rit)->m_Type == REL_TYPE_FUNCTION && i != -1)
+                    funcs[i].calls.push_back(callee);
+                else
+                    funcs[callee].addrTaken = true;
+            }
+            rit++;
+        }
+
+        // An extern jal is "e 0x0000", the address word of an ldx follows its opcode
+        auto xit = pCode->m_ExternsList.begin();
+        while (xit != pCode->m_ExternsList.end())
+        {
+            auto pit = publics.find((*xit)->m_Label);
+            if (pit != publics.end())
+            {
+                callee = pit->second;
+                i = FindOverlayFunc(bySection, funcs, pCode, (*xit)->m_Offset);
+                if ((*xit)->m_Opcode == OPCODE_JAL && i != -1 && !((*xit)->m_Offset > 0 &&
+                    (pCode->m_pCode[(*xit)->m_Offset - 1] == OPCODE16_LDX ||
+                     pCode->m_pCode[(*xit)->m_Offset - 1] == OPCODE_LDX)))
+                {
+                    funcs[i].calls.push_back(callee);
+                }
+                else
+                    funcs[callee].addrTaken = true;
+            }
+            xit++;
+        }
+    }
+
+    // Each function the vectors call is a thread
+    for (caller = 0; caller < (int) funcs.size(); caller++)
+    {
+        for (i = 0; i < (int) funcs[caller].calls.size(); i++)
+        {
+            callee = funcs[caller].calls[i];
+            funcs[callee].called = true;
+            if (funcs[caller].vector && !funcs[callee].vector && funcs[callee].thread == -1)
+            {
+                funcs[callee].thread = groups.size();
+                groups.push_back(std::vector<int>(1, callee));
+            }
+        }
+    }
+
+    // Find the functions of each thread.  One with a static frame can't
+    // be entered from two threads.
+    seen.assign(funcs.size(), -1);
+    for (int g = 0; g < (int) groups.size(); g++)
+    {
+        work = groups[g];
+        seen[groups[g][0]] = g;
+        while (!work.empty())
+        {
+            caller = work.back();
+            work.pop_back();
+            for (i = 0; i < (int) funcs[caller].calls.size(); i++)
+            {
+                callee = funcs[caller].calls[i];
+                if (funcs[callee].vector || seen[callee] == g)
+                    continue;
+                seen[callee] = g;
+                if (funcs[callee].thread == -1)
+                    funcs[callee].thread = g;
+                else if (funcs[callee].pFrame)
+                {
+                    printf("Function %s has a static frame but may be entered from both %s and %s\n",
+                            funcs[callee].name.c_str(),
+                            funcs[groups[funcs[callee].thread][0]].name.c_str(),
+                            funcs[groups[g][0]].name.c_str());
+                    err = ERROR_STATIC_FRAME;
+                }
+                groups[g].push_back(callee);
+                work.push_back(callee);
+            }
+        }
+    }
+
+    // The rest go above all threads
+    work.clear();
+    for (i = 0; i < (int) funcs.size(); i++)
+        if (!funcs[i].vector && (funcs[i].addrTaken || (!funcs[i].called && funcs[i].thread == -1)))
+            work.push_back(i);
+    groups.push_back(std::vector<int>());
+    member.assign(funcs.size(), false);
+    while (!work.empty())
+    {
+        caller = work.back();
+        work.pop_back();
+        if (member[caller] || funcs[caller].vector)
+            continue;
+        member[caller] = true;
+        groups.back().push_back(caller);
+        for (i = 0; i < (int) funcs[caller].calls.size(); i++)
+            work.push_back(funcs[caller].calls[i]);
+    }
+
+    // Place each frame above those of its callers.  Only a recursive
+    // function with a frame keeps being moved up.
+    offset.assign(funcs.size(), 0);
+    for (int g = 0; g < (int) groups.size(); g++)
+    {
+        bool    changed = true;
+        int     end = m_OverlaySize;
+
+        member.assign(funcs.size(), false);
+        for (i = 0; i < (int) groups[g].size(); i++)
+        {
+            member[groups[g][i]] = true;
+            offset[groups[g][i]] = m_OverlaySize;
+        }
+
+        for (int round = 0; changed && round <= (int) groups[g].size(); round++)
+        {
+            changed = false;
+            for (i = 0; i < (int) groups[g].size(); i++)
+            {
+                caller = groups[g][i];
+                for (int c = 0; c < (int) funcs[caller].calls.size(); c++)
+                {
+                    callee = funcs[caller].calls[c];
+                    if (member[callee] && offset[caller] + funcs[caller].size > offset[callee])
+                    {
+                        offset[callee] = offset[caller] + funcs[caller].size;
+                        changed = true;
+                    }
+                }
+            }
+        }
+
+        // Still moving after a round per function means a recursion through
+        // a function with a frame.  Report the ones that can reach themselves.
+        for (i = 0; changed && i < (int) groups[g].size(); i++)
+        {
+            if (funcs[groups[g][i]].pFrame == NULL)
+                continue;
+            seen.assign(funcs.size(), 0);
+            work = funcs[groups[g][i]].calls;
+            while (!work.empty() && seen[groups[g][i]] == 0)
+            {
+                caller = work.back();
+                work.pop_back();
+                if (seen[caller]++ == 0)
+                    work.insert(work.end(), funcs[caller].calls.begin(), funcs[caller].calls.end());
+            }
+            if (seen[groups[g][i]])
+            {
+                printf("Function %s has a static frame but is recursive\n",
+                        funcs[groups[g][i]].name.c_str());
+                err = ERROR_STATIC_FRAME;
+            }
+        }
+
+        for (i = 0; i < (int) groups[g].size(); i++)
+        {
+            caller = groups[g][i];
+            if (funcs[caller].pFrame == NULL)
+                continue;
+            funcs[caller].pFrame->m_OverlayOffset = offset[caller];
+            if (offset[caller] + funcs[caller].size > end)
+                end = offset[caller] + funcs[caller].size;
+        }
+        m_OverlaySize = end;
+    }
+
+    // Frames without a function don't share their space
+    oit = orphans.begin();
+    while (oit != orphans.end())
+    {
+        (*oit)->m_OverlayOffset = m_OverlaySize;
+        m_OverlaySize += (*oit)->m_LastCodeOffset;
+        oit++;
+    }
+
+    if (m_DebugLevel > 0)
+        printf("Overlay region of %d bytes for %d static frames\n", m_OverlaySize,
+                (int) m_Overlays.size());
+
+    return err;
+}
+
 /* 
 =============================================================================
 Locate segments
@@ -286,7 +1047,6 @@ int CLinker::LocateSections(void)
     COperation *pOp;
     char        name[256];
     char        str[256];
-    char        mapStr[256];
     int         address;
     int         err = ERROR_NONE;
 
@@ -318,11 +1078,10 @@ int CLinker::LocateSections(void)
                                 pOp->m_StrParam, str));
 
                     // Add the variable to the map symbols
-                    sprintf(mapStr, "0x%04X %s", address, pOp->m_StrParam.c_str());
                     if (strchr((*it)->m_pMem->m_Access.c_str(), 'x') != NULL || (*it)->m_pAtMem)
-                        m_CodeMapSymbols.push_back(mapStr);
+                        AddMapSymbol(m_CodeMapSymbols, address, pOp->m_StrParam);
                     else
-                        m_DataMapSymbols.push_back(mapStr);
+                        AddMapSymbol(m_DataMapSymbols, address, pOp->m_StrParam);
 
                     // Provide %hi and %lo also
                     sprintf(name, "%%lo(%s)", pOp->m_StrParam.c_str());
@@ -402,9 +1161,8 @@ int CLinker::ResolveExterns(void)
                 auto vit = m_pSpec->m_Variables.find((*xit)->m_Label);
                 if (vit == m_pSpec->m_Variables.end())
                 {
-                    // TODO:  Search all libraries for this symbol
-
-                    // Test if this symbol already reported as unresolved
+                    // No input file or library member defines it.  Test if
+                    // this symbol already reported as unresolved
                     auto rep = m_UnresolveReport.find((*xit)->m_Label);
                     if (rep == m_UnresolveReport.end())
                     {
@@ -437,6 +1195,30 @@ int CLinker::ResolveExterns(void)
     return err; 
 }
 
+/* 
+=============================================================================
+Size the code image to cover every executable MEMORY region
+=============================================================================
+*/
+int CLinker::SizeCodeImage(void)
+{
+    int         size = 0;
+
+    auto it = m_pSpec->m_MemoryMap.begin();
+    while (it != m_pSpec->m_MemoryMap.end())
+    {
+        if (strchr(it->second->m_Access.c_str(), 'x') != NULL &&
+            it->second->m_Origin + it->second->m_Length > size)
+        {
+            size = it->second->m_Origin + it->second->m_Length;
+        }
+        it++;
+    }
+
+    m_Code.assign(size, 0);
+    return size;
+}
+
 /* 
 =============================================================================
 Perform the link operation
@@ -452,6 +1234,7 @@ int CLinker::Assemble(void)
     // Loop for all input files
     m_MaxCodeAddr = 0;
     m_MaxDataAddr = 0;
+    SizeCodeImage();
     auto fit = m_FileList.begin();
     while (fit != m_FileList.end())
     {
@@ -464,6 +1247,16 @@ int CLinker::Assemble(void)
             {
                 // Add this section's code at it's m_LocateAddress location
                 size = sit->second->m_LastCodeOffset;
+                if (sit->second->m_LocateAddress + size > (int) m_Code.size())
+                {
+                    printf("%s: Section %s at 0x%04X extends past the end of memory region %s\n",
+                            sit->second->m_Filename.c_str(), sit->first.c_str(),
+                            sit->second->m_LocateAddress,
+                            sit->second->m_pLocateMem->m_Name.c_str());
+                    err = ERROR_MEMORY_OVERFLOW;
+                    sit++;
+                    continue;
+                }
                 for (x = 0; x < size; x++)
                     m_Code[sit->second->m_LocateAddress + x] = sit->second->m_pCode[x];
 
@@ -492,7 +1285,7 @@ int CLinker::Assemble(void)
         for (x = 0; x < m_MaxCodeAddr; x++)
             printf("0x%04X:  0x%04X\n", x, m_Code[x]);
     }
-    return 0;
+    return err;
 }
 
 /* 
@@ -540,6 +1333,43 @@ int CLinker::GenerateMapFile(char *pOutFilename)
         it++;
     }
 
+    // Report where the static frames were overlaid
+    if (!m_Overlays.empty())
+    {
+        int     total = 0;
+
+        fprintf(fd, "\nStatic Frames\n");
+        fprintf(fd, "=============\n");
+        auto oit = m_Overlays.begin();
+        while (oit != m_Overlays.end())
+        {
+            fprintf(fd, "0x%04X %4d %s (%s)\n", (*oit)->m_LocateAddress,
+                    (*oit)->m_LastCodeOffset, (*oit)->m_Name.c_str(),
+                    (*oit)->m_Filename.c_str());
+            total += (*oit)->m_LastCodeOffset;
+            oit++;
+        }
+        fprintf(fd, "%6d bytes overlaid in %d\n", total, m_OverlaySize);
+    }
+
+    // Report what --gc-sections dropped
+    if (m_GcSections)
+    {
+        int     saved = 0;
+
+        fprintf(fd, "\nDiscarded Sections\n");
+        fprintf(fd, "==================\n");
+        auto dit = m_Discarded.begin();
+        while (dit != m_Discarded.end())
+        {
+            fprintf(fd, "%6d %s (%s)\n", (*dit)->m_LastCodeOffset,
+                    (*dit)->m_Name.c_str(), (*dit)->m_Filename.c_str());
+            saved += (*dit)->m_LastCodeOffset;
+            dit++;
+        }
+        fprintf(fd, "%6d words saved\n", saved);
+    }
+
     fclose(fd);
     return ERROR_NONE;
 }
@@ -619,6 +1449,51 @@ int CLinker::GenerateTestbenchFile(char *pOutFilename)
     return ERROR_NONE;
 }
 
+/* 
+=============================================================================
+Report the memory used for code buffers and the peak RSS
+=============================================================================
+*/
+void CLinker::ReportMemoryUsage(void)
+{
+    struct rusage   usage;
+    size_t          bytes, total = 0;
+    int             count = 0;
+
+    printf("\nMemory usage\n");
+    printf("============\n");
+    printf("%-40s %8s %8s\n", "Section", "Words", "Bytes");
+
+    auto fit = m_FileList.begin();
+    while (fit != m_FileList.end())
+    {
+        auto sit = (*fit)->m_FileSections.begin();
+        while (sit != (*fit)->m_FileSections.end())
+        {
+            bytes = sit->second->m_CodeSize * sizeof(uint16_t);
+            printf("%-40s %8d %8zu%s\n", (sit->second->m_Filename + ":" +
+                    sit->first).c_str(), sit->second->m_LastCodeOffset,
+                    sit->second->m_Mapped ? (size_t) 0 : bytes,
+                    sit->second->m_Mapped ? "  (mapped)" : "");
+            if (!sit->second->m_Mapped)
+                total += bytes;
+            count++;
+            sit++;
+        }
+        fit++;
+    }
+
+    printf("Section buffers:  %zu bytes for %d sections (%zu at 8192 words each)\n",
+            total, count, (size_t) count * 8192 * sizeof(uint16_t));
+    printf("Code arena:       %zu bytes in %d blocks, %zu used, %zu moved\n",
+            CFile::m_CodeArena.m_BytesReserved, CFile::m_CodeArena.m_BlockCount,
+            CFile::m_CodeArena.m_BytesUsed, CFile::m_CodeArena.m_BytesAbandoned);
+    printf("Output image:     %zu bytes\n", m_Code.size() * sizeof(uint16_t));
+
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+        printf("Peak RSS:         %ld KB\n", usage.ru_maxrss);
+}
+
 /* 
 =============================================================================
 Perform the link operation
@@ -628,6 +1503,21 @@ int CLinker::Link(char *pOutFilename)
 {
     int     err;
 
+    // Add the library members needed to resolve externs
+    if ((err = OpenLibraries()) != ERROR_NONE)
+        return err;
+    if ((err = LoadLibraryMembers()) != ERROR_NONE)
+        return err;
+
+    // Drop the sections nothing refers to
+    if (m_GcSections)
+        if ((err = CollectGarbage()) != ERROR_NONE)
+            return err;
+
+    // Overlay the static frames using the call graph
+    if ((err = AllocateOverlays()) != ERROR_NONE)
+        return err;
+
     // First locate all segments by walking through the operation list
     if ((err = LocateSections()) != ERROR_NONE)
         return err;
@@ -663,6 +1553,9 @@ int CLinker::Link(char *pOutFilename)
     if ((err = GenerateTestbenchFile(pOutFilename)) != ERROR_NONE)
         return err;
 
+    if (m_DebugLevel > 0)
+        ReportMemoryUsage();
+
     return ERROR_NONE;
 }
 
@@ -24,6 +24,10 @@
 
 #include "parser.h"
 #include "file.h"
+#include <vector>
+
+/// Static frames are accessed with lda / sta, which reach this far
+#define MAX_DIRECT_ADDRESS  0x1FF
 
 class CLinker
 {
@@ -33,30 +37,44 @@ class CLinker
         int             Link(char *pOutFilename);
         void            AddDefine(const char *name);
         void            AddLibPath(const char *name);
+        void            AddLibrary(const char *name);
+        int             AddArchive(const char *pFilename);
 
         CParseCtx     * m_pSpec;
         FileList_t      m_FileList;
 
     private:
+        int             OpenLibraries(void);
+        int             LoadLibraryMembers(void);
+        int             CollectGarbage(void);
+        int             AllocateOverlays(void);
         int             LocateSections(void);
         int             LocateSectionsBySpec(CSection *pSection, COperation *pOp);
         int             ResolveExterns(void);
+        int             SizeCodeImage(void);
         int             Assemble(void);
         int             GenerateMapFile(char *pOutFilename);
         int             GenerateHexFile(char *pOutFilename);
         int             GenerateTestbenchFile(char *pOutFilename);
+        void            ReportMemoryUsage(void);
 
     public:
 
         int             m_DebugLevel;
         int             m_Mixed;
         int             m_MapFile;
-        uint16_t        m_Code[8192];
+        int             m_GcSections;       // Discard unreferenced sections
+        std::vector<uint16_t> m_Code;   // Image of the executable regions
         int             m_MaxCodeAddr;
         int             m_MaxDataAddr;
         StrIntMap_t     m_UnresolveReport;
         StrList_t       m_CodeMapSymbols;
         StrList_t       m_DataMapSymbols;
+        StrList_t       m_LibNames;         // Libraries given with -l
+        ArchiveList_t   m_Archives;         // Archives searched for externs
+        std::list<CFileSection *> m_Discarded;  // Sections dropped by the GC
+        std::list<CFileSection *> m_Overlays;   // Static frames of lisa_cc functions
+        int             m_OverlaySize;      // Bytes of the overlay region
 };
 
 #endif /* LINKER_H */
@@ -26,17 +26,70 @@
 
 #include "parser.h"
 #include "linker.h"
+#include "relbin.h"
 #include "errors.h"
 
 void usage(const char *name)
 {
     printf("\nusage:  %s [-DglLo] input_file [input_file]...\n", name);
+    printf("        %s -c -o output_file input_file\n", name);
+    printf("        %s -a -o library_file input_file [input_file]...\n", name);
     printf("\nOptions:\n");
+    printf("   -a              Create a library archive from the input files\n");
+    printf("   -c              Convert a .rel file between text and binary format\n");
     printf("   -L path         Add path to the library dirctory search list\n");
     printf("   -l name         Add library to be linked\n");
     printf("   -D name[=value] Define name in the define symbol table\n");
     printf("   -g level        Set the debug level\n");
-    printf("   -o filename     Set the output filename\n\n");
+    printf("   -o filename     Set the output filename\n");
+    printf("   --gc-sections   Discard sections unreachable from ENTRY and KEEP()\n\n");
+}
+
+/// Long only options
+#define OPT_GC_SECTIONS     256
+
+static struct option long_options[] =
+{
+    { "gc-sections",    no_argument,    NULL,   OPT_GC_SECTIONS },
+    { NULL,             0,              NULL,   0 }
+};
+
+/*
+================================================================================
+Converts a text .rel file to binary or a binary .rel file to text
+================================================================================
+*/
+int convert_rel_file(const char *pIn, const char *pOut)
+{
+    CRelObject      obj;
+    FILE*           fd;
+    int             err;
+
+    if (CRelObject::IsBinary(pIn))
+    {
+        if ((err = obj.ReadBin(pIn)) != ERROR_NONE)
+            return err;
+        if ((fd = fopen(pOut, "w")) == NULL)
+        {
+            printf("%s: Unable to open file for writing\n", pOut);
+            return ERROR_CANT_OPEN_FILE;
+        }
+        err = obj.WriteText(fd);
+        fclose(fd);
+        return err;
+    }
+
+    if ((fd = fopen(pIn, "r")) == NULL)
+    {
+        printf("Error opening file %s\n", pIn);
+        return ERROR_CANT_OPEN_FILE;
+    }
+    err = obj.ReadText(fd, pIn);
+    fclose(fd);
+    if (err != ERROR_NONE)
+        return err;
+
+    return obj.WriteBin(pOut);
 }
 
 /*
@@ -60,6 +113,9 @@ int main(int argc, char* argv[])
     bool            binaryOutput = false;
     bool            mixed = false;
     bool            mapFile = false;
+    bool            convert = false;
+    bool            archive = false;
+    bool            gcSections = false;
     int             c;
 
     // Test if resource script provided
@@ -70,7 +126,7 @@ int main(int argc, char* argv[])
     }
 
     // Parse options
-    while ((c = getopt(argc, argv, "D:g:hl:L:mMo:T:")) != -1)
+    while ((c = getopt_long(argc, argv, "acD:g:hl:L:mMo:T:", long_options, NULL)) != -1)
     {
         switch (c)
         {
@@ -82,6 +138,18 @@ int main(int argc, char* argv[])
             mapFile = true;
             break;
 
+        case 'a':
+            archive = true;
+            break;
+
+        case OPT_GC_SECTIONS:
+            gcSections = true;
+            break;
+
+        case 'c':
+            convert = true;
+            break;
+
         case 'D':
             linker.AddDefine(optarg);
             break;
@@ -90,6 +158,10 @@ int main(int argc, char* argv[])
             linker.AddLibPath(optarg);
             break;
 
+        case 'l':
+            linker.AddLibrary(optarg);
+            break;
+
         case 'T':
             pLinkerScript = optarg;
             break;
@@ -130,6 +202,28 @@ int main(int argc, char* argv[])
        return 1;
     }
 
+    // Convert a single object file without linking
+    if (convert)
+    {
+        if (optind != argc - 1)
+        {
+            printf("Expected exactly one input file to convert\n");
+            return 1;
+        }
+        return convert_rel_file(argv[optind], pOut);
+    }
+
+    // Create a library archive from the input files
+    if (archive)
+    {
+        if (optind >= argc)
+        {
+            printf("Expected input files to archive\n");
+            return 1;
+        }
+        return CArchive::Create(pOut, &argv[optind], argc - optind);
+    }
+
     if (pLinkerScript == NULL)
     {
         printf("Pleae specify Linker Script with '-T filename' option\n");
@@ -150,6 +244,14 @@ int main(int argc, char* argv[])
     // The remaining arguments are input files.  Parse each one
     for (c = optind; c < argc; c++)
     {
+        // Library archives are only searched for unresolved externs
+        if (CArchive::IsArchive(argv[c]))
+        {
+            if ((err = linker.AddArchive(argv[c])) != ERROR_NONE)
+                exit(err);
+            continue;
+        }
+
         // Create a new CFile class for this file
         pFile = new CFile(&spec);
         pFile->m_Filename = argv[c];
@@ -167,6 +269,7 @@ int main(int argc, char* argv[])
     linker.m_DebugLevel = debugLevel;
     linker.m_Mixed = mixed;
     linker.m_MapFile = mapFile;
+    linker.m_GcSections = gcSections;
     err = linker.Link(pOut);
     if (err != ERROR_NONE)
         return err;
@@ -28,6 +28,7 @@
 
 #define     OPCODE_NOP      0x2880
 #define     OPCODE_LDX      0x2860
+#define     OPCODE16_LDX    0xA180
 #define     OPCODE_JAL      0x0000
 #define     OPCODE_LDI      0x2000
 #define     OPCODE_RETI     0x2100
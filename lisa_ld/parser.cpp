@@ -225,7 +225,7 @@ bool CParser::TestForEntry(char* sLine, CParserFile* pFile, int32_t& err)
         }
         
         // Save the segment name
-        m_EntryLabel = sToken;
+        m_pSpec->m_EntryLabel = sToken;
 
         return true;
     }
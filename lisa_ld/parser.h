@@ -103,7 +103,6 @@ class CParser
         /// Holds the text for the last error encountered
         std::string         m_Error;
         std::string         m_OutputArch;
-        std::string         m_EntryLabel;
 
         /// Parser state in case it becomes stateful
         int32_t             m_ParseState;
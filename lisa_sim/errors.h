@@ -0,0 +1,31 @@
+// ------------------------------------------------------------------------------
+// (c) Copyright, Ken Pettit, BSD License
+//         All Rights Reserved
+// ------------------------------------------------------------------------------
+//
+//  File        : errors.h
+//  Revision    : 1.0
+//  Author      : Ken Pettit
+//  Created     : 10/17/2026
+//
+// Description:  
+//    Error definitions used for the simulator
+//
+// Modifications:
+//
+//    Author            Date        Ver  Description
+//    ================  ==========  ===  =======================================
+//    Ken Pettit        10/17/2026  1.0  Initial version
+//
+// ------------------------------------------------------------------------------
+
+#ifndef ERRORS_H
+#define ERRORS_H
+
+#define ERROR_NONE                          0
+#define ERROR_INVALID_SYNTAX                3
+#define ERROR_CANT_OPEN_FILE                7
+#define ERROR_INVALID_FILE_FORMAT           16
+#define ERROR_MEMORY_OVERFLOW               36
+
+#endif  // ERRORS_H
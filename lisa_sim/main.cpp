@@ -0,0 +1,206 @@
+// ------------------------------------------------------------------------------
+// (c) Copyright, Ken Pettit, BSD License
+//         All Rights Reserved
+// ------------------------------------------------------------------------------
+//
+//  File        : main.cpp
+//  Revision    : 1.0
+//  Author      : Ken Pettit
+//  Created     : 10/17/2026
+//
+// Description:
+//    Main entry point for the LISA instruction set simulator.
+//
+// Modifications:
+//
+//    Author            Date        Ver  Description
+//    ================  ==========  ===  =======================================
+//    Ken Pettit        10/17/2026  1.0  Initial version
+//
+// ------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <unistd.h>
+
+#include "simulator.h"
+#include "profiler.h"
+#include "errors.h"
+
+void usage(const char *name)
+{
+    printf("\nusage:  %s [-cgmnoptwx] hex_file\n", name);
+    printf("\nRuns a program linked by lisa_ld (its .lst or .hex output) and reports\n");
+    printf("the cycles, the instruction mix and the stack high-water mark.\n");
+    printf("\nOptions:\n");
+    printf("   -w width        Set the instruction width, 14 or 16 (default 14)\n");
+    printf("   -n cycles       Stop after this many cycles (default %llu)\n",
+            (unsigned long long) SIM_MAX_CYCLES);
+    printf("   -c filename     Load opcode cycle costs (\"opcode cycles [taken]\")\n");
+    printf("   -m filename     Profile the functions of a lisa_ld map file (-M)\n");
+    printf("   -o filename     Write the profile in callgrind format (needs -m)\n");
+    printf("   -g filename     Write the branch profile of lisa_cc -fprofile-generate\n");
+    printf("                   probes for -fprofile-use (needs -m)\n");
+    printf("   -p address      Map a console SFR that prints each byte written\n");
+    printf("   -t              Trace each instruction to stderr\n");
+    printf("   -x address      Map an exit SFR that stops with the byte written\n\n");
+}
+
+int main(int argc, char* argv[])
+{
+    CSimulator     *pSim;
+    uint64_t        maxCycles = SIM_MAX_CYCLES;
+    const char     *pCycleFile = NULL;
+    const char     *pMapFile = NULL;
+    const char     *pCallgrindFile = NULL;
+    const char     *pBranchFile = NULL;
+    CProfiler      *pProfiler = NULL;
+    int             consoleAddr = -1;
+    int             exitAddr = -1;
+    int             width = 14;
+    bool            trace = false;
+    int             err;
+    int             c;
+
+    if (argc < 2)
+    {
+        usage(argv[0]);
+        exit(1);
+    }
+
+    // Parse options
+    while ((c = getopt(argc, argv, "c:g:hm:n:o:p:tw:x:")) != -1)
+    {
+        switch (c)
+        {
+        case 'c':
+            pCycleFile = optarg;
+            break;
+
+        case 'g':
+            pBranchFile = optarg;
+            break;
+
+        case 'm':
+            pMapFile = optarg;
+            break;
+
+        case 'o':
+            pCallgrindFile = optarg;
+            break;
+
+        case 'n':
+            maxCycles = strtoull(optarg, NULL, 0);
+            break;
+
+        case 'p':
+            consoleAddr = strtol(optarg, NULL, 0) & 0xFFFF;
+            break;
+
+        case 't':
+            trace = true;
+            break;
+
+        case 'w':
+            width = atoi(optarg);
+            break;
+
+        case 'x':
+            exitAddr = strtol(optarg, NULL, 0) & 0xFFFF;
+            break;
+
+        case 'h':
+            // Print the usage
+            usage(argv[0]);
+            return 0;
+
+        case '?':
+            if (optopt == 'c' || optopt == 'g' || optopt == 'm' || optopt == 'n' ||
+                optopt == 'o' || optopt == 'p' || optopt == 'w' || optopt == 'x')
+                fprintf(stderr, "Option -%c requires an argument\n", optopt);
+            else if (isprint(optopt))
+                fprintf(stderr, "Unknown option '-%c'\n", optopt);
+            else
+                fprintf(stderr, "Unknown option character '\\x%x'\n", optopt);
+            return 1;
+
+        default:
+            abort();
+            break;
+        }
+    }
+
+    if (width != 14 && width != 16)
+    {
+        printf("Width must be 14 or 16\n");
+        return 1;
+    }
+
+    if (pCallgrindFile != NULL && pMapFile == NULL)
+    {
+        printf("A callgrind file needs a map file (-m)\n");
+        return 1;
+    }
+
+    if (pBranchFile != NULL && pMapFile == NULL)
+    {
+        printf("A branch profile needs a map file (-m)\n");
+        return 1;
+    }
+
+    if (optind != argc - 1)
+    {
+        printf("Expected exactly one hex file\n");
+        return 1;
+    }
+
+    pSim = new CSimulator(width);
+    if (pCycleFile != NULL)
+        if ((err = pSim->LoadCycleFile(pCycleFile)) != ERROR_NONE)
+            return err;
+    if ((err = pSim->LoadHexFile(argv[optind])) != ERROR_NONE)
+        return err;
+
+    if (consoleAddr != -1)
+        pSim->AddSfr(consoleAddr, new CConsoleSfr(stdout));
+    if (exitAddr != -1)
+        pSim->AddSfr(exitAddr, new CExitSfr(pSim));
+    if (trace)
+        pSim->m_pTrace = stderr;
+    if (pMapFile != NULL)
+    {
+        pProfiler = new CProfiler();
+        if ((err = pProfiler->LoadMapFile(pMapFile)) != ERROR_NONE)
+            return err;
+        pSim->m_pProfiler = pProfiler;
+    }
+
+    pSim->Run(maxCycles);
+    fflush(stdout);
+    pSim->Report(stdout);
+    if (pProfiler != NULL)
+    {
+        pProfiler->Finish();
+        pProfiler->Report(stdout);
+        if (pCallgrindFile != NULL)
+            if ((err = pProfiler->WriteCallgrind(pCallgrindFile, argv[optind])) != ERROR_NONE)
+                return err;
+        if (pBranchFile != NULL)
+            if ((err = pProfiler->WriteBranchProfile(pBranchFile, argv[optind])) != ERROR_NONE)
+                return err;
+    }
+
+    switch (pSim->m_StopReason)
+    {
+        case SIM_STOP_EXIT:
+            return pSim->m_ExitCode;
+        case SIM_STOP_CYCLES:
+        case SIM_STOP_INVALID:
+            return 2;
+    }
+    return 0;
+}
+
+// vim: sw=4 ts=4
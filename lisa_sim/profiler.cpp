@@ -0,0 +1,474 @@
+// ------------------------------------------------------------------------------
+// (c) Copyright, Ken Pettit, BSD License
+//         All Rights Reserved
+// ------------------------------------------------------------------------------
+//
+//  File        : profiler.cpp
+//  Revision    : 1.0
+//  Author      : Ken Pettit
+//  Created     : 10/17/2026
+//
+// Description:
+//    Per-function cycle profiler for lisa_sim.
+//
+//    Exclusive cycles are charged by address:  every instruction belongs to
+//    the function whose symbol is the closest one at or below it, so code
+//    reached by a branch (a tail call, a shared epilogue) is charged to the
+//    function it is in.  Code at no function's address, past _etext or
+//    after a section marker, is charged to the function that called or
+//    jumped to it.  Inclusive cycles come from the shadow call stack:
+//    a jal or call_ix pushes a frame, and a ret / rets / reti / rc / rz to
+//    the return address of a frame pops it and everything above it.  A
+//    return that matches no frame is treated as a jump.
+//
+// Modifications:
+//
+//    Author            Date        Ver  Description
+//    ================  ==========  ===  =======================================
+//    Ken Pettit        10/17/2026  1.0  Initial version
+//
+// ------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+#include "profiler.h"
+#include "errors.h"
+
+/*
+=============================================================================
+Constructor
+=============================================================================
+*/
+CProfiler::CProfiler()
+{
+    m_pFuncIndex = new uint16_t[SIM_CODE_WORDS];
+    m_pPcFunc = new uint16_t[SIM_CODE_WORDS];
+    m_pPcCycles = new uint64_t[SIM_CODE_WORDS];
+    m_pPcCount = new uint64_t[SIM_CODE_WORDS];
+    memset(m_pFuncIndex, 0, SIM_CODE_WORDS * sizeof(uint16_t));
+    memset(m_pPcFunc, 0, SIM_CODE_WORDS * sizeof(uint16_t));
+    memset(m_pPcCycles, 0, SIM_CODE_WORDS * sizeof(uint64_t));
+    memset(m_pPcCount, 0, SIM_CODE_WORDS * sizeof(uint64_t));
+    m_CurFunc = 0;
+    m_Cycles = 0;
+    m_Instructions = 0;
+}
+
+/*
+=============================================================================
+Destructor
+=============================================================================
+*/
+CProfiler::~CProfiler()
+{
+    delete[] m_pFuncIndex;
+    delete[] m_pPcFunc;
+    delete[] m_pPcCycles;
+    delete[] m_pPcCount;
+}
+
+/*
+=============================================================================
+Returns true for the section markers of the linker script (_stext,
+_evectors ...), which share their address with a real function.  Library
+helpers start with two underscores and C functions with none.
+=============================================================================
+*/
+static bool IsMarker(const std::string& name)
+{
+    return name.length() > 1 && name[0] == '_' && name[1] != '_';
+}
+
+/// Prefix of the branch probe labels of lisa_cc -fprofile-generate
+#define PROBE_PREFIX    "__pgo."
+
+/*
+=============================================================================
+Loads the functions from the "Code Space" section of a map file.  When
+several symbols share an address, the first one that is not a section
+marker names the function.  A marker with no function at its address,
+such as _etext, starts code in no function.  Branch probe labels are kept
+apart from the functions.
+=============================================================================
+*/
+int CProfiler::LoadMapFile(const char *pFilename)
+{
+    FILE           *fd;
+    char            line[512];
+    char            name[256];
+    unsigned int    addr;
+    bool            inCode = false;
+    ProfFunc_t      func;
+    int             x, pc;
+
+    if ((fd = fopen(pFilename, "r")) == NULL)
+    {
+        printf("Unable to open file '%s'\n", pFilename);
+        return ERROR_CANT_OPEN_FILE;
+    }
+
+    func.calls = 0;
+    func.selfCycles = 0;
+    func.selfInstructions = 0;
+    func.inclCycles = 0;
+    func.depth = 0;
+    m_Funcs.clear();
+    while (fgets(line, sizeof(line), fd) != NULL)
+    {
+        if (strncmp(line, "Code Space", 10) == 0)
+        {
+            inCode = true;
+            continue;
+        }
+        if (!inCode || line[0] == '=')
+            continue;
+        if (sscanf(line, "0x%x %255s", &addr, name) != 2)
+        {
+            // A blank line ends the section
+            if (m_Funcs.size() > 0)
+                break;
+            continue;
+        }
+        if (addr >= SIM_CODE_WORDS)
+            continue;
+        if (strncmp(name, PROBE_PREFIX, strlen(PROBE_PREFIX)) == 0)
+        {
+            m_Probes[name + strlen(PROBE_PREFIX)] = addr;
+            continue;
+        }
+
+        func.name = name;
+        func.address = addr;
+        if (m_Funcs.size() > 0 && m_Funcs.back().address == addr)
+        {
+            if (IsMarker(m_Funcs.back().name) && !IsMarker(func.name))
+                m_Funcs.back().name = func.name;
+            continue;
+        }
+        m_Funcs.push_back(func);
+    }
+    fclose(fd);
+
+    if (m_Funcs.size() == 0)
+    {
+        printf("%s: No code symbols found\n", pFilename);
+        return ERROR_INVALID_FILE_FORMAT;
+    }
+
+    // Code below the first symbol is charged to an unnamed function
+    std::stable_sort(m_Funcs.begin(), m_Funcs.end(),
+            [](const ProfFunc_t& a, const ProfFunc_t& b)
+            { return a.address < b.address; });
+    if (m_Funcs[0].address != 0)
+    {
+        func.name = "<unknown>";
+        func.address = 0;
+        m_Funcs.insert(m_Funcs.begin(), func);
+    }
+
+    for (x = 0, pc = 0; pc < SIM_CODE_WORDS; pc++)
+    {
+        while (x + 1 < (int) m_Funcs.size() && m_Funcs[x + 1].address <= pc)
+            x++;
+        m_pFuncIndex[pc] = IsMarker(m_Funcs[x].name) ? PROF_NO_FUNC : x;
+    }
+
+    return ERROR_NONE;
+}
+
+/*
+=============================================================================
+Accounts for one instruction the simulator ran.  next is the address it
+went to.
+=============================================================================
+*/
+void CProfiler::Step(uint16_t pc, uint16_t next, const SimInst_t *pInst, int cycles)
+{
+    ProfCall_t     *pCall;
+    ProfFrame_t     frame;
+    ProfFunc_t     *pFunc;
+    uint32_t        key;
+
+    // Code in no function stays with the function that got there
+    pc &= SIM_CODE_WORDS - 1;
+    if (m_pFuncIndex[pc] != PROF_NO_FUNC)
+        m_CurFunc = m_pFuncIndex[pc];
+    if (m_pPcCount[pc] == 0)
+        m_pPcFunc[pc] = m_CurFunc;
+    pFunc = &m_Funcs[m_CurFunc];
+    pFunc->selfCycles += cycles;
+    pFunc->selfInstructions++;
+    m_pPcCycles[pc] += cycles;
+    m_pPcCount[pc]++;
+    m_Cycles += cycles;
+    m_Instructions++;
+
+    switch (pInst->op)
+    {
+        case SIM_JAL:
+        case SIM_CALL_IX:
+            // A call to no function is part of the caller
+            next &= SIM_CODE_WORDS - 1;
+            if (m_pFuncIndex[next] == PROF_NO_FUNC)
+                break;
+            key = ((uint32_t) pc << 16) | next;
+            pCall = &m_Calls[key];
+            if (pCall->calls++ == 0)
+            {
+                pCall->callSite = pc;
+                pCall->target = next;
+            }
+
+            frame.func = m_pFuncIndex[next];
+            frame.caller = m_CurFunc;
+            frame.returnPc = pc + pInst->len;
+            frame.pCall = pCall;
+            frame.startCycles = m_Cycles;
+            frame.startInstructions = m_Instructions;
+            m_Stack.push_back(frame);
+
+            pFunc = &m_Funcs[frame.func];
+            pFunc->calls++;
+            pFunc->depth++;
+            break;
+
+        case SIM_RET:
+        case SIM_RETS:
+        case SIM_RETI:
+        case SIM_RC:
+        case SIM_RZ:
+            if (next != (uint16_t) (pc + pInst->len))
+                Return(next);
+            break;
+    }
+}
+
+/*
+=============================================================================
+Pops the frames down to and including the one returning to next
+=============================================================================
+*/
+void CProfiler::Return(uint16_t next)
+{
+    int     x;
+
+    for (x = (int) m_Stack.size() - 1; x >= 0; x--)
+        if (m_Stack[x].returnPc == next)
+            break;
+    if (x < 0)
+        return;
+
+    while ((int) m_Stack.size() > x)
+        PopFrame();
+}
+
+/*
+=============================================================================
+Closes the top frame of the shadow stack.  The inclusive cycles of a
+recursive function are only counted by its outermost frame.
+=============================================================================
+*/
+void CProfiler::PopFrame(void)
+{
+    ProfFrame_t&    frame = m_Stack.back();
+    ProfFunc_t     *pFunc = &m_Funcs[frame.func];
+
+    frame.pCall->inclCycles += m_Cycles - frame.startCycles;
+    frame.pCall->inclInstructions += m_Instructions - frame.startInstructions;
+    if (--pFunc->depth == 0)
+        pFunc->inclCycles += m_Cycles - frame.startCycles;
+    m_CurFunc = frame.caller;
+    m_Stack.pop_back();
+}
+
+/*
+=============================================================================
+Closes the frames still active when the simulation stopped
+=============================================================================
+*/
+void CProfiler::Finish(void)
+{
+    while (m_Stack.size() > 0)
+        PopFrame();
+}
+
+/*
+=============================================================================
+Prints the flat profile, most exclusive cycles first, and the call graph
+=============================================================================
+*/
+void CProfiler::Report(FILE *fd)
+{
+    std::map<uint32_t, ProfCall_t>::iterator    it;
+    std::map<uint32_t, ProfCall_t>              edges;
+    std::vector<int>    funcs;
+    ProfCall_t         *pEdge;
+    ProfFunc_t         *pFunc;
+    uint32_t            key;
+    int                 x;
+
+    for (x = 0; x < (int) m_Funcs.size(); x++)
+        if (m_Funcs[x].selfInstructions || m_Funcs[x].calls)
+            funcs.push_back(x);
+    std::stable_sort(funcs.begin(), funcs.end(), [this](int a, int b)
+            { return m_Funcs[a].selfCycles > m_Funcs[b].selfCycles; });
+
+    fprintf(fd, "\nFlat profile\n");
+    fprintf(fd, "============\n");
+    fprintf(fd, "%7s %12s %12s %7s %10s %12s  %s\n", "% self", "Self", "Inclusive",
+            "% incl", "Calls", "Self/call", "Function");
+    for (x = 0; x < (int) funcs.size(); x++)
+    {
+        pFunc = &m_Funcs[funcs[x]];
+        fprintf(fd, "%6.2f%% %12llu %12llu %6.2f%% %10llu ",
+                m_Cycles ? 100.0 * pFunc->selfCycles / m_Cycles : 0.0,
+                (unsigned long long) pFunc->selfCycles,
+                (unsigned long long) pFunc->inclCycles,
+                m_Cycles ? 100.0 * pFunc->inclCycles / m_Cycles : 0.0,
+                (unsigned long long) pFunc->calls);
+        if (pFunc->calls)
+            fprintf(fd, "%12.1f", (double) pFunc->selfCycles / pFunc->calls);
+        else
+            fprintf(fd, "%12s", "");
+        fprintf(fd, "  %s\n", pFunc->name.c_str());
+    }
+
+    // Merge the call sites of each caller / callee pair
+    for (it = m_Calls.begin(); it != m_Calls.end(); it++)
+    {
+        key = (m_pPcFunc[it->second.callSite] << 16) |
+              m_pFuncIndex[it->second.target];
+        pEdge = &edges[key];
+        pEdge->calls += it->second.calls;
+        pEdge->inclCycles += it->second.inclCycles;
+    }
+
+    fprintf(fd, "\nCall graph\n");
+    fprintf(fd, "==========\n");
+    fprintf(fd, "%-24s %-24s %10s %12s\n", "Caller", "Callee", "Calls", "Inclusive");
+    for (it = edges.begin(); it != edges.end(); it++)
+    {
+        fprintf(fd, "%-24s %-24s %10llu %12llu\n",
+                m_Funcs[it->first >> 16].name.c_str(),
+                m_Funcs[it->first & 0xFFFF].name.c_str(),
+                (unsigned long long) it->second.calls,
+                (unsigned long long) it->second.inclCycles);
+    }
+}
+
+/*
+=============================================================================
+Writes the profile in the callgrind format of valgrind, so kcachegrind and
+callgrind_annotate can show it.  Positions are code addresses, and the
+events are cycles and instructions.
+=============================================================================
+*/
+int CProfiler::WriteCallgrind(const char *pFilename, const char *pCmd)
+{
+    std::map<uint32_t, ProfCall_t>::iterator    it;
+    FILE       *fd;
+    int         pc, func, last = -1;
+
+    if ((fd = fopen(pFilename, "w")) == NULL)
+    {
+        printf("Unable to open output file '%s'\n", pFilename);
+        return ERROR_CANT_OPEN_FILE;
+    }
+
+    fprintf(fd, "# callgrind format\n");
+    fprintf(fd, "version: 1\n");
+    fprintf(fd, "creator: lisa_sim\n");
+    fprintf(fd, "cmd: %s\n", pCmd);
+    fprintf(fd, "positions: instr\n");
+    fprintf(fd, "events: Cycles Instructions\n");
+    fprintf(fd, "summary: %llu %llu\n\n", (unsigned long long) m_Cycles,
+            (unsigned long long) m_Instructions);
+    fprintf(fd, "ob=%s\n", pCmd);
+
+    // The calls are sorted by call site, so they follow the address order
+    it = m_Calls.begin();
+    for (pc = 0; pc < SIM_CODE_WORDS; pc++)
+    {
+        if (m_pPcCount[pc] == 0)
+            continue;
+
+        func = m_pPcFunc[pc];
+        if (func != last)
+        {
+            fprintf(fd, "\nfn=%s\n", m_Funcs[func].name.c_str());
+            last = func;
+        }
+        fprintf(fd, "0x%04X %llu %llu\n", pc, (unsigned long long) m_pPcCycles[pc],
+                (unsigned long long) m_pPcCount[pc]);
+
+        for (; it != m_Calls.end() && it->second.callSite <= pc; it++)
+        {
+            if (it->second.callSite != pc)
+                continue;
+            fprintf(fd, "cfn=%s\n", m_Funcs[m_pFuncIndex[it->second.target]].name.c_str());
+            fprintf(fd, "calls=%llu 0x%04X\n", (unsigned long long) it->second.calls,
+                    it->second.target);
+            fprintf(fd, "0x%04X %llu %llu\n", pc, (unsigned long long) it->second.inclCycles,
+                    (unsigned long long) it->second.inclInstructions);
+        }
+    }
+
+    fprintf(fd, "\ntotals: %llu %llu\n", (unsigned long long) m_Cycles,
+            (unsigned long long) m_Instructions);
+    fclose(fd);
+
+    return ERROR_NONE;
+}
+
+/*
+=============================================================================
+Writes the branch profile of the probe labels:  a line of "site count
+taken" for each branch.  Probe <site>.c is where the condition of the
+branch is evaluated, and <site>.t the start of the side run when it is
+true, or <site>.f of the side run when it is false.  A probe address that
+is also reached from elsewhere, such as a loop at the start of the then
+side, over counts the side, so it is clipped to the count.
+=============================================================================
+*/
+int CProfiler::WriteBranchProfile(const char *pFilename, const char *pCmd)
+{
+    std::map<std::string, uint16_t>::iterator   it, side;
+    std::string     site;
+    FILE           *fd;
+    uint64_t        count, taken;
+
+    if ((fd = fopen(pFilename, "w")) == NULL)
+    {
+        printf("Unable to open output file '%s'\n", pFilename);
+        return ERROR_CANT_OPEN_FILE;
+    }
+
+    fprintf(fd, "# lisa_sim branch profile of %s\n", pCmd);
+    fprintf(fd, "# site count taken\n");
+    for (it = m_Probes.begin(); it != m_Probes.end(); it++)
+    {
+        if (it->first.length() < 2 || it->first.compare(it->first.length() - 2, 2, ".c") != 0)
+            continue;
+
+        site = it->first.substr(0, it->first.length() - 2);
+        count = m_pPcCount[it->second];
+        if ((side = m_Probes.find(site + ".t")) != m_Probes.end())
+            taken = std::min(m_pPcCount[side->second], count);
+        else if ((side = m_Probes.find(site + ".f")) != m_Probes.end())
+            taken = count - std::min(m_pPcCount[side->second], count);
+        else
+            continue;
+
+        fprintf(fd, "%s %llu %llu\n", site.c_str(), (unsigned long long) count,
+                (unsigned long long) taken);
+    }
+    fclose(fd);
+
+    return ERROR_NONE;
+}
+
+// vim: sw=4 ts=4
@@ -0,0 +1,108 @@
+// ------------------------------------------------------------------------------
+// (c) Copyright, Ken Pettit, BSD License
+//         All Rights Reserved
+// ------------------------------------------------------------------------------
+//
+//  File        : profiler.h
+//  Revision    : 1.0
+//  Author      : Ken Pettit
+//  Created     : 10/17/2026
+//
+// Description:
+//    Per-function cycle profiler for lisa_sim.  Functions are the code
+//    symbols of the map file lisa_ld writes with -M.  The simulator reports
+//    each instruction it runs, and the profiler keeps a shadow call stack
+//    of the jal / call_ix calls and the returns to their RA to measure
+//    exclusive and inclusive cycles.  The __pgo probe labels lisa_cc
+//    -fprofile-generate puts at each branch are counted into a branch
+//    profile for lisa_cc -fprofile-use.
+//
+// Modifications:
+//
+//    Author            Date        Ver  Description
+//    ================  ==========  ===  =======================================
+//    Ken Pettit        10/17/2026  1.0  Initial version
+//
+// ------------------------------------------------------------------------------
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <map>
+
+#include "simulator.h"
+
+/// m_pFuncIndex of an address in no function, such as code past _etext
+#define PROF_NO_FUNC    0xFFFF
+
+/// A function of the map file and its totals
+typedef struct ProfFunc_s
+{
+    std::string     name;
+    uint16_t        address;
+    uint64_t        calls;
+    uint64_t        selfCycles;
+    uint64_t        selfInstructions;
+    uint64_t        inclCycles;
+    int             depth;          // Active frames, for recursion
+} ProfFunc_t;
+
+/// Calls from one call site to one target
+typedef struct ProfCall_s
+{
+    uint16_t        callSite;
+    uint16_t        target;
+    uint64_t        calls;
+    uint64_t        inclCycles;
+    uint64_t        inclInstructions;
+} ProfCall_t;
+
+/// An active call on the shadow stack
+typedef struct ProfFrame_s
+{
+    int             func;
+    int             caller;         // Function charged before the call
+    uint16_t        returnPc;
+    ProfCall_t     *pCall;
+    uint64_t        startCycles;
+    uint64_t        startInstructions;
+} ProfFrame_t;
+
+class CProfiler
+{
+    public:
+        CProfiler();
+        ~CProfiler();
+
+        int             LoadMapFile(const char *pFilename);
+        void            Step(uint16_t pc, uint16_t next, const SimInst_t *pInst,
+                            int cycles);
+        void            Finish(void);
+        void            Report(FILE *fd);
+        int             WriteCallgrind(const char *pFilename, const char *pCmd);
+        int             WriteBranchProfile(const char *pFilename, const char *pCmd);
+
+    private:
+        void            Return(uint16_t next);
+        void            PopFrame(void);
+
+        std::vector<ProfFunc_t>         m_Funcs;
+        std::map<uint32_t, ProfCall_t>  m_Calls;        // By site << 16 | target
+        std::vector<ProfFrame_t>        m_Stack;
+        std::map<std::string, uint16_t> m_Probes;       // __pgo labels, by site
+        uint16_t       *m_pFuncIndex;   // Function of each code address
+        uint16_t       *m_pPcFunc;      // Function charged when each address first ran
+        int             m_CurFunc;      // Function charged for the last instruction
+        uint64_t       *m_pPcCycles;    // Cycles of each code address
+        uint64_t       *m_pPcCount;     // Times each code address ran
+        uint64_t        m_Cycles;
+        uint64_t        m_Instructions;
+};
+
+#endif /* PROFILER_H */
+
+// vim: sw=4 ts=4
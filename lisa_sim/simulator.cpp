@@ -0,0 +1,1234 @@
+// ------------------------------------------------------------------------------
+// (c) Copyright, Ken Pettit, BSD License
+//         All Rights Reserved
+// ------------------------------------------------------------------------------
+//
+//  File        : simulator.cpp
+//  Revision    : 1.0
+//  Author      : Ken Pettit
+//  Created     : 10/17/2026
+//
+// Description:
+//    Cycle counting instruction set simulator for the LISA core.
+//
+//    The machine model follows the code lisa_cc and the runtime library
+//    generate:  A is the 8-bit accumulator, IX, SP and RA are 16 bits, the
+//    stack grows down with SP pointing at the last byte pushed, and 16-bit
+//    values are little endian.  Memory operands are N(ix), N(sp) or, for
+//    lda / sta, a direct address.  add / adc / sub carry in and out through
+//    C, compares leave A - M in Z and C (borrow), and the logical opcodes
+//    and loads set Z without touching C.  call_ix advances IX, which is how
+//    crt0 walks the reti table holding the .data initializers.
+//
+// Modifications:
+//
+//    Author            Date        Ver  Description
+//    ================  ==========  ===  =======================================
+//    Ken Pettit        10/17/2026  1.0  Initial version
+//
+// ------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+#include "parsectx.h"
+#include "simulator.h"
+#include "profiler.h"
+#include "errors.h"
+
+/*
+=============================================================================
+Cycle costs.  These are estimates for a core that fetches one word per
+cycle and needs a second cycle for a data memory access or a change of
+flow.  Load a measured table with -c.
+=============================================================================
+*/
+SimOpInfo_t gSimOps[SIM_OP_COUNT] =
+{
+    { "invalid",   1, 0 },
+    { "adc",       1, 0 }, { "add",       2, 0 }, { "addax",     1, 0 },
+    { "addaxu",    1, 0 }, { "ads",       1, 0 }, { "adx",       1, 0 },
+    { "amode",     1, 0 }, { "and",       2, 0 }, { "andi",      1, 0 },
+    { "bnz",       1, 1 }, { "br",        1, 1 }, { "brk",       1, 0 },
+    { "btst",      1, 0 }, { "bz",        1, 1 }, { "call_ix",   2, 0 },
+    { "cmp",       2, 0 }, { "cpi",       1, 0 }, { "cpx_ra",    1, 0 },
+    { "cpx_sp",    1, 0 }, { "dcx",       2, 0 }, { "di",        1, 0 },
+    { "div",      18, 0 }, { "ei",        1, 0 }, { "if",        1, 0 },
+    { "ifte",      1, 0 }, { "iftt",      1, 0 }, { "inx",       2, 0 },
+    { "jal",       2, 0 }, { "jmp_ix",    2, 0 }, { "lda",       2, 0 },
+    { "ldac",      2, 0 }, { "ldax",      2, 0 }, { "ldc",       1, 0 },
+    { "lddiv",     3, 0 }, { "ldi",       1, 0 }, { "ldx",       2, 0 },
+    { "ldxx",      3, 0 }, { "ldz",       1, 0 }, { "lra",       3, 0 },
+    { "mul",       2, 0 }, { "mulu",      2, 0 }, { "nop",       1, 0 },
+    { "notz",      1, 0 }, { "or",        2, 0 }, { "pop_a",     2, 0 },
+    { "pop_ix",    3, 0 }, { "push_a",    2, 0 }, { "push_ix",   3, 0 },
+    { "rc",        1, 1 }, { "rem",      18, 0 }, { "restc",     1, 0 },
+    { "ret",       2, 0 }, { "reti",      2, 0 }, { "rets",      2, 0 },
+    { "rz",        1, 1 }, { "savec",     1, 0 }, { "shl",       1, 0 },
+    { "shl16",     2, 0 }, { "shr",       1, 0 }, { "shr16",     2, 0 },
+    { "spix",      1, 0 }, { "sra",       3, 0 }, { "sta",       2, 0 },
+    { "stax",      2, 0 }, { "stxx",      3, 0 }, { "sub",       2, 0 },
+    { "subax",     1, 0 }, { "subaxu",    1, 0 }, { "swap",      2, 0 },
+    { "swapi",     1, 0 }, { "tax",       1, 0 }, { "taxu",      1, 0 },
+    { "txa",       1, 0 }, { "txau",      1, 0 }, { "xchg_ia",   1, 0 },
+    { "xchg_ra",   1, 0 }, { "xchg_sp",   1, 0 }, { "xor",       2, 0 },
+    { "float",     1, 0 }
+};
+
+/// Cycles of an instruction skipped by if / iftt / ifte
+#define SKIP_CYCLES     1
+
+/// Operand forms of the encodings
+enum
+{
+    ARG_NONE = 0,
+    ARG_MEM,            // N(ix) or N(sp)
+    ARG_DIRECT,         // Direct address or N(sp)
+    ARG_STACK,          // ldxx / stxx offset, always N(sp)
+    ARG_IMM,            // 8-bit immediate
+    ARG_SIGNED,         // Signed ads / adx immediate
+    ARG_BRANCH,         // Relative branch
+    ARG_JAL,            // Absolute code address
+    ARG_COND,           // Condition or small constant in the low bits
+    ARG_WORD,           // Operand in the following word
+    ARG_DIV             // Divisor form, immediate divisor follows if even
+};
+
+/// An encoding of one opcode
+typedef struct SimEncoding_s
+{
+    int             value;
+    int             mask;           // Operand bits
+    uint8_t         op;
+    uint8_t         argType;
+} SimEncoding_t;
+
+/*
+=============================================================================
+The 16-bit encodings.  Bits in the mask are operand bits.
+=============================================================================
+*/
+static const SimEncoding_t gEncodings16[] =
+{
+    { OPCODE16_JAL,      0x7FFF, SIM_JAL,     ARG_JAL },
+    { OPCODE16_LDI,      0x03FF, SIM_LDI,     ARG_IMM },
+    { OPCODE16_MULU,     0x03FF, SIM_MULU,    ARG_MEM },
+    { OPCODE16_RET,      0x0000, SIM_RET,     ARG_NONE },
+    { OPCODE16_CALL_IX,  0x0000, SIM_CALL_IX, ARG_NONE },
+    { OPCODE16_JMP_IX,   0x0000, SIM_JMP_IX,  ARG_NONE },
+    { OPCODE16_XCHG_RA,  0x0000, SIM_XCHG_RA, ARG_NONE },
+    { OPCODE16_XCHG_IA,  0x0000, SIM_XCHG_IA, ARG_NONE },
+    { OPCODE16_XCHG_SP,  0x0000, SIM_XCHG_SP, ARG_NONE },
+    { OPCODE16_SPIX,     0x0000, SIM_SPIX,    ARG_NONE },
+    { OPCODE16_CPX_RA,   0x0000, SIM_CPX_RA,  ARG_NONE },
+    { OPCODE16_CPX_SP,   0x0000, SIM_CPX_SP,  ARG_NONE },
+    { OPCODE16_RC,       0x0000, SIM_RC,      ARG_NONE },
+    { OPCODE16_RETS,     0x0000, SIM_RETS,    ARG_NONE },
+    { OPCODE16_RZ,       0x0000, SIM_RZ,      ARG_NONE },
+    { OPCODE16_RETI,     0x03FF, SIM_RETI,    ARG_IMM },
+    { OPCODE16_ADC,      0x03FF, SIM_ADC,     ARG_IMM },
+    { OPCODE16_ADS,      0x03FF, SIM_ADS,     ARG_SIGNED },
+    { OPCODE16_ADX,      0x03FF, SIM_ADX,     ARG_SIGNED },
+    { OPCODE16_DCX,      0x03FF, SIM_DCX,     ARG_MEM },
+    { OPCODE16_SHL,      0x0003, SIM_SHL,     ARG_NONE },
+    { OPCODE16_SHR,      0x0003, SIM_SHR,     ARG_NONE },
+    { OPCODE16_LDC,      0x0007, SIM_LDC,     ARG_COND },
+    { OPCODE16_TXA,      0x0007, SIM_TXA,     ARG_NONE },
+    { OPCODE16_TXAU,     0x0007, SIM_TXAU,    ARG_NONE },
+    { OPCODE16_SHL16,    0x000F, SIM_SHL16,   ARG_NONE },
+    { OPCODE16_SHR16,    0x000F, SIM_SHR16,   ARG_NONE },
+    { OPCODE16_BTST,     0x0007, SIM_BTST,    ARG_COND },
+    { OPCODE16_LDZ,      0x000F, SIM_LDZ,     ARG_COND },
+    { OPCODE16_NOP,      0x0003, SIM_NOP,     ARG_NONE },
+    { OPCODE16_NOTZ,     0x0003, SIM_NOTZ,    ARG_NONE },
+    { OPCODE16_DI,       0x0000, SIM_DI,      ARG_NONE },
+    { OPCODE16_EI,       0x0000, SIM_EI,      ARG_NONE },
+    { OPCODE16_BRK,      0x0003, SIM_BRK,     ARG_NONE },
+    { OPCODE16_PUSH_A,   0x003F, SIM_PUSH_A,  ARG_NONE },
+    { OPCODE16_POP_A,    0x003F, SIM_POP_A,   ARG_NONE },
+    { OPCODE16_TAX,      0x0007, SIM_TAX,     ARG_NONE },
+    { OPCODE16_TAXU,     0x0007, SIM_TAXU,    ARG_NONE },
+    { OPCODE16_AMODE,    0x001F, SIM_AMODE,   ARG_COND },
+    { OPCODE16_SRA,      0x0003, SIM_SRA,     ARG_NONE },
+    { OPCODE16_LRA,      0x0003, SIM_LRA,     ARG_NONE },
+    { OPCODE16_PUSH_IX,  0x0003, SIM_PUSH_IX, ARG_NONE },
+    { OPCODE16_POP_IX,   0x0003, SIM_POP_IX,  ARG_NONE },
+    { OPCODE16_LDDIV,    0x0007, SIM_LDDIV,   ARG_WORD },
+    { OPCODE16_SAVEC,    0x0003, SIM_SAVEC,   ARG_NONE },
+    { OPCODE16_RESTC,    0x0003, SIM_RESTC,   ARG_NONE },
+    { OPCODE16_LDX,      0x001F, SIM_LDX,     ARG_WORD },
+    { OPCODE16_ADDAX,    0x0000, SIM_ADDAX,   ARG_NONE },
+    { OPCODE16_ADDAXU,   0x0000, SIM_ADDAXU,  ARG_NONE },
+    { OPCODE16_SUBAX,    0x0000, SIM_SUBAX,   ARG_NONE },
+    { OPCODE16_SUBAXU,   0x0000, SIM_SUBAXU,  ARG_NONE },
+    { OPCODE16_LDAC,     0x001F, SIM_LDAC,    ARG_COND },
+    { OPCODE16_TFA,      0x001F, SIM_FLOAT,   ARG_NONE },
+    { OPCODE16_IF,       0x0027, SIM_IF,      ARG_COND },
+    { OPCODE16_IFTT,     0x0027, SIM_IFTT,    ARG_COND },
+    { OPCODE16_IFTE,     0x0027, SIM_IFTE,    ARG_COND },
+    { OPCODE16_DIV,      0x000F, SIM_DIV,     ARG_DIV },
+    { OPCODE16_REM,      0x000F, SIM_REM,     ARG_DIV },
+    { OPCODE16_ITOF,     0x0001, SIM_FLOAT,   ARG_NONE },
+    { OPCODE16_CPI,      0x03FF, SIM_CPI,     ARG_IMM },
+    { OPCODE16_BNZ,      0x07FF, SIM_BNZ,     ARG_BRANCH },
+    { OPCODE16_BR,       0x07FF, SIM_BR,      ARG_BRANCH },
+    { OPCODE16_BZ,       0x07FF, SIM_BZ,      ARG_BRANCH },
+    { OPCODE16_ADD,      0x03FF, SIM_ADD,     ARG_MEM },
+    { OPCODE16_MUL,      0x03FF, SIM_MUL,     ARG_MEM },
+    { OPCODE16_SUB,      0x03FF, SIM_SUB,     ARG_MEM },
+    { OPCODE16_LDXX,     0x01FF, SIM_LDXX,    ARG_STACK },
+    { OPCODE16_STXX,     0x01FF, SIM_STXX,    ARG_STACK },
+    { OPCODE16_AND,      0x03FF, SIM_AND,     ARG_MEM },
+    { OPCODE16_ANDI,     0x03FF, SIM_ANDI,    ARG_IMM },
+    { OPCODE16_OR,       0x03FF, SIM_OR,      ARG_MEM },
+    { OPCODE16_SWAPI,    0x03FF, SIM_SWAPI,   ARG_IMM },
+    { OPCODE16_XOR,      0x03FF, SIM_XOR,     ARG_MEM },
+    { OPCODE16_INX,      0x03FF, SIM_INX,     ARG_MEM },
+    { OPCODE16_CMP,      0x03FF, SIM_CMP,     ARG_MEM },
+    { OPCODE16_SWAP,     0x03FF, SIM_SWAP,    ARG_MEM },
+    { OPCODE16_LDAX,     0x03FF, SIM_LDAX,    ARG_MEM },
+    { OPCODE16_LDA,      0x03FF, SIM_LDA,     ARG_DIRECT },
+    { OPCODE16_STAX,     0x03FF, SIM_STAX,    ARG_MEM },
+    { OPCODE16_STA,      0x03FF, SIM_STA,     ARG_DIRECT }
+};
+
+/*
+=============================================================================
+The 14-bit encodings.  The assembler ORs the register number of xchg and
+cpx into the base opcode, so "xchg sp" and "cpx sp" have a second form.
+=============================================================================
+*/
+static const SimEncoding_t gEncodings14[] =
+{
+    { OPCODE_JAL,        0x1FFF, SIM_JAL,     ARG_JAL },
+    { OPCODE_LDI,        0x00FF, SIM_LDI,     ARG_IMM },
+    { OPCODE_MULU,       0x00FF, SIM_MULU,    ARG_MEM },
+    { OPCODE_RET,        0x0000, SIM_RET,     ARG_NONE },
+    { OPCODE_CALL_IX,    0x0000, SIM_CALL_IX, ARG_NONE },
+    { OPCODE_JMP_IX,     0x0000, SIM_JMP_IX,  ARG_NONE },
+    { OPCODE_XCHG_RA,    0x0000, SIM_XCHG_RA, ARG_NONE },
+    { OPCODE_XCHG_IA,    0x0000, SIM_XCHG_IA, ARG_NONE },
+    { OPCODE_XCHG_SP,    0x0000, SIM_XCHG_SP, ARG_NONE },
+    { OPCODE_XCHG | 8,   0x0000, SIM_XCHG_SP, ARG_NONE },
+    { OPCODE_SPIX,       0x0000, SIM_SPIX,    ARG_NONE },
+    { OPCODE_CPX_RA,     0x0000, SIM_CPX_RA,  ARG_NONE },
+    { OPCODE_CPX_SP,     0x0000, SIM_CPX_SP,  ARG_NONE },
+    { OPCODE_CPX | 8,    0x0000, SIM_CPX_SP,  ARG_NONE },
+    { OPCODE_RC,         0x0000, SIM_RC,      ARG_NONE },
+    { OPCODE_RETS,       0x0000, SIM_RETS,    ARG_NONE },
+    { OPCODE_RZ,         0x0000, SIM_RZ,      ARG_NONE },
+    { OPCODE_RETI,       0x00FF, SIM_RETI,    ARG_IMM },
+    { OPCODE_ADC,        0x00FF, SIM_ADC,     ARG_IMM },
+    { OPCODE_ADS,        0x00FF, SIM_ADS,     ARG_SIGNED },
+    { OPCODE_ADX,        0x00FF, SIM_ADX,     ARG_SIGNED },
+    { OPCODE_DCX,        0x00FF, SIM_DCX,     ARG_MEM },
+    { OPCODE_SHL,        0x0000, SIM_SHL,     ARG_NONE },
+    { OPCODE_SHR,        0x0000, SIM_SHR,     ARG_NONE },
+    { OPCODE_LDC,        0x0001, SIM_LDC,     ARG_COND },
+    { OPCODE_TXA,        0x0001, SIM_TXA,     ARG_NONE },
+    { OPCODE_TXAU,       0x0001, SIM_TXAU,    ARG_NONE },
+    { OPCODE_SHL16,      0x0003, SIM_SHL16,   ARG_NONE },
+    { OPCODE_SHR16,      0x0003, SIM_SHR16,   ARG_NONE },
+    { OPCODE_BTST,       0x0007, SIM_BTST,    ARG_COND },
+    { OPCODE_LDZ,        0x0003, SIM_LDZ,     ARG_COND },
+    { OPCODE_NOP,        0x0000, SIM_NOP,     ARG_NONE },
+    { OPCODE_NOTZ,       0x0000, SIM_NOTZ,    ARG_NONE },
+    { OPCODE_BRK,        0x0000, SIM_BRK,     ARG_NONE },
+    { OPCODE_PUSH_A,     0x000F, SIM_PUSH_A,  ARG_NONE },
+    { OPCODE_POP_A,      0x000F, SIM_POP_A,   ARG_NONE },
+    { OPCODE_TAX,        0x0001, SIM_TAX,     ARG_NONE },
+    { OPCODE_TAXU,       0x0001, SIM_TAXU,    ARG_NONE },
+    { OPCODE_AMODE,      0x0007, SIM_AMODE,   ARG_COND },
+    { OPCODE_SRA,        0x0000, SIM_SRA,     ARG_NONE },
+    { OPCODE_LRA,        0x0000, SIM_LRA,     ARG_NONE },
+    { OPCODE_PUSH_IX,    0x0000, SIM_PUSH_IX, ARG_NONE },
+    { OPCODE_POP_IX,     0x0000, SIM_POP_IX,  ARG_NONE },
+    { OPCODE_LDDIV,      0x0001, SIM_LDDIV,   ARG_WORD },
+    { OPCODE_SAVEC,      0x0000, SIM_SAVEC,   ARG_NONE },
+    { OPCODE_RESTC,      0x0000, SIM_RESTC,   ARG_NONE },
+    { OPCODE_LDX,        0x0007, SIM_LDX,     ARG_WORD },
+    { OPCODE_ADDAX,      0x0000, SIM_ADDAX,   ARG_NONE },
+    { OPCODE_ADDAXU,     0x0000, SIM_ADDAXU,  ARG_NONE },
+    { OPCODE_SUBAX,      0x0000, SIM_SUBAX,   ARG_NONE },
+    { OPCODE_SUBAXU,     0x0000, SIM_SUBAXU,  ARG_NONE },
+    { OPCODE_LDAC,       0x000F, SIM_LDAC,    ARG_COND },
+    { OPCODE_IF,         0x0027, SIM_IF,      ARG_COND },
+    { OPCODE_IFTT,       0x0027, SIM_IFTT,    ARG_COND },
+    { OPCODE_IFTE,       0x0027, SIM_IFTE,    ARG_COND },
+    { OPCODE_DIV,        0x0003, SIM_DIV,     ARG_DIV },
+    { OPCODE_REM,        0x0003, SIM_REM,     ARG_DIV },
+    { OPCODE_CPI,        0x00FF, SIM_CPI,     ARG_IMM },
+    { OPCODE_BNZ,        0x01FF, SIM_BNZ,     ARG_BRANCH },
+    { OPCODE_BR,         0x01FF, SIM_BR,      ARG_BRANCH },
+    { OPCODE_BZ,         0x01FF, SIM_BZ,      ARG_BRANCH },
+    { OPCODE_ADD,        0x00FF, SIM_ADD,     ARG_MEM },
+    { OPCODE_MUL,        0x00FF, SIM_MUL,     ARG_MEM },
+    { OPCODE_SUB,        0x00FF, SIM_SUB,     ARG_MEM },
+    { OPCODE_LDXX,       0x007F, SIM_LDXX,    ARG_STACK },
+    { OPCODE_STXX,       0x007F, SIM_STXX,    ARG_STACK },
+    { OPCODE_AND,        0x00FF, SIM_AND,     ARG_MEM },
+    { OPCODE_ANDI,       0x00FF, SIM_ANDI,    ARG_IMM },
+    { OPCODE_OR,         0x00FF, SIM_OR,      ARG_MEM },
+    { OPCODE_SWAPI,      0x00FF, SIM_SWAPI,   ARG_IMM },
+    { OPCODE_XOR,        0x00FF, SIM_XOR,     ARG_MEM },
+    { OPCODE_INX,        0x00FF, SIM_INX,     ARG_MEM },
+    { OPCODE_CMP,        0x00FF, SIM_CMP,     ARG_MEM },
+    { OPCODE_SWAP,       0x00FF, SIM_SWAP,    ARG_MEM },
+    { OPCODE_LDAX,       0x00FF, SIM_LDAX,    ARG_MEM },
+    { OPCODE_LDA,        0x00FF, SIM_LDA,     ARG_DIRECT },
+    { OPCODE_STAX,       0x00FF, SIM_STAX,    ARG_MEM },
+    { OPCODE_STA,        0x00FF, SIM_STA,     ARG_DIRECT },
+    { OPCODE_DI,         0x0000, SIM_DI,      ARG_NONE },
+    { OPCODE_EI,         0x0000, SIM_EI,      ARG_NONE }
+};
+
+/// Encoding of every 16-bit word, built once per width
+static const SimEncoding_t  *gDecode[2][0x10000];
+
+/*
+=============================================================================
+Builds the word to encoding table of one width.  A word takes the
+matching encoding with the fewest operand bits.
+=============================================================================
+*/
+static void BuildDecodeTable(const SimEncoding_t **ppTable,
+        const SimEncoding_t *pEnc, int count)
+{
+    int     w, x;
+
+    for (w = 0; w < 0x10000; w++)
+    {
+        ppTable[w] = NULL;
+        for (x = 0; x < count; x++)
+        {
+            if ((w & ~pEnc[x].mask) != pEnc[x].value)
+                continue;
+            if (ppTable[w] == NULL || pEnc[x].mask < ppTable[w]->mask)
+                ppTable[w] = &pEnc[x];
+        }
+    }
+}
+
+/*
+=============================================================================
+Constructor
+=============================================================================
+*/
+CSimulator::CSimulator(int width)
+{
+    int     idx = width == 16;
+
+    m_Width = width;
+    if (gDecode[idx][OPCODE16_RET] == NULL)
+    {
+        if (idx)
+            BuildDecodeTable(gDecode[1], gEncodings16,
+                    sizeof(gEncodings16) / sizeof(SimEncoding_t));
+        else
+            BuildDecodeTable(gDecode[0], gEncodings14,
+                    sizeof(gEncodings14) / sizeof(SimEncoding_t));
+    }
+
+    memset(m_Code, 0, sizeof(m_Code));
+    memset(m_SfrIndex, 0, sizeof(m_SfrIndex));
+    m_CodeSize = 0;
+    m_pTrace = NULL;
+    m_pProfiler = NULL;
+
+    // Index 0 means no SFR at an address
+    m_Sfrs.push_back(NULL);
+    Reset();
+}
+
+/*
+=============================================================================
+Destructor
+=============================================================================
+*/
+CSimulator::~CSimulator()
+{
+}
+
+/*
+=============================================================================
+Loads the code image written by lisa_ld.  Both the .lst file with one hex
+word per line and the testbench .hex file with "@addr" and byte pairs
+are accepted.
+=============================================================================
+*/
+int CSimulator::LoadHexFile(const char *pFilename)
+{
+    FILE       *fd;
+    char        line[1024];
+    char       *ptr, *pEnd;
+    int         addr = 0;
+    int         testbench = -1;
+    long        value;
+
+    if ((fd = fopen(pFilename, "r")) == NULL)
+    {
+        printf("Unable to open file '%s'\n", pFilename);
+        return ERROR_CANT_OPEN_FILE;
+    }
+
+    while (fgets(line, sizeof(line), fd) != NULL)
+    {
+        ptr = line;
+        while (*ptr == ' ' || *ptr == '\t')
+            ptr++;
+        if (*ptr == '\n' || *ptr == '\r' || *ptr == 0)
+            continue;
+
+        // The testbench file gives the byte address of the data
+        if (*ptr == '@')
+        {
+            testbench = 1;
+            addr = strtol(ptr + 1, NULL, 16) * 2;
+            continue;
+        }
+        if (testbench == -1)
+            testbench = 0;
+
+        while (*ptr != 0 && *ptr != '\n' && *ptr != '\r')
+        {
+            value = strtol(ptr, &pEnd, 16);
+            if (pEnd == ptr)
+            {
+                printf("%s: Invalid hex data '%s'\n", pFilename, ptr);
+                fclose(fd);
+                return ERROR_INVALID_FILE_FORMAT;
+            }
+            ptr = pEnd;
+            while (*ptr == ' ' || *ptr == '\t')
+                ptr++;
+
+            if (addr >= SIM_CODE_WORDS * 2)
+            {
+                printf("%s: Code image too big\n", pFilename);
+                fclose(fd);
+                return ERROR_MEMORY_OVERFLOW;
+            }
+
+            // Testbench data is LSB first, one byte at a time
+            if (testbench)
+            {
+                if (addr & 1)
+                    m_Code[addr >> 1] |= (value & 0xFF) << 8;
+                else
+                    m_Code[addr >> 1] = value & 0xFF;
+                addr++;
+            }
+            else
+            {
+                m_Code[addr >> 1] = value;
+                addr += 2;
+            }
+        }
+    }
+    fclose(fd);
+
+    m_CodeSize = (addr + 1) >> 1;
+    Predecode();
+    Reset();
+
+    return ERROR_NONE;
+}
+
+/*
+=============================================================================
+Loads cycle costs from a file with lines of "opcode cycles [taken]".
+'#' starts a comment.
+=============================================================================
+*/
+int CSimulator::LoadCycleFile(const char *pFilename)
+{
+    FILE       *fd;
+    char        line[256];
+    char        name[64];
+    int         cycles, taken, count, x;
+    int         lineNo = 0;
+
+    if ((fd = fopen(pFilename, "r")) == NULL)
+    {
+        printf("Unable to open file '%s'\n", pFilename);
+        return ERROR_CANT_OPEN_FILE;
+    }
+
+    while (fgets(line, sizeof(line), fd) != NULL)
+    {
+        lineNo++;
+        if (strchr(line, '#') != NULL)
+            *strchr(line, '#') = 0;
+        if ((count = sscanf(line, "%63s %d %d", name, &cycles, &taken)) <= 0)
+            continue;
+        if (count == 1)
+        {
+            printf("%s: Line %d: Expected a cycle count\n", pFilename, lineNo);
+            fclose(fd);
+            return ERROR_INVALID_SYNTAX;
+        }
+
+        for (x = 0; x < SIM_OP_COUNT; x++)
+            if (strcmp(gSimOps[x].name, name) == 0)
+                break;
+        if (x == SIM_OP_COUNT)
+        {
+            printf("%s: Line %d: Unknown opcode '%s'\n", pFilename, lineNo, name);
+            fclose(fd);
+            return ERROR_INVALID_SYNTAX;
+        }
+        gSimOps[x].cycles = cycles;
+        if (count == 3)
+            gSimOps[x].taken = taken;
+    }
+    fclose(fd);
+
+    return ERROR_NONE;
+}
+
+/*
+=============================================================================
+Maps an SFR hook at a data address.  Reads and writes of the address go
+to the hook instead of the data memory.
+=============================================================================
+*/
+void CSimulator::AddSfr(uint16_t addr, CSfrHook *pHook)
+{
+    m_SfrIndex[addr] = m_Sfrs.size();
+    m_Sfrs.push_back(pHook);
+}
+
+/*
+=============================================================================
+Resets the processor and the statistics.  Data memory is not cleared.
+=============================================================================
+*/
+void CSimulator::Reset(void)
+{
+    m_Pc = 0;
+    m_Ix = 0;
+    m_Sp = 0;
+    m_Ra = 0;
+    m_A = 0;
+    m_Z = 0;
+    m_C = 0;
+    m_S = 0;
+    m_SavedC = 0;
+    m_AMode = 0;
+    m_IntEnable = 0;
+
+    m_Cycles = 0;
+    m_Instructions = 0;
+    memset(m_OpCount, 0, sizeof(m_OpCount));
+    memset(m_OpCycles, 0, sizeof(m_OpCycles));
+    m_StackBase = 0;
+    m_StackLow = 0;
+    m_StopReason = SIM_STOP_NONE;
+    m_ExitCode = 0;
+    m_ExitPc = -1;
+}
+
+/*
+=============================================================================
+Decodes the instruction at pc
+=============================================================================
+*/
+void CSimulator::Decode(uint16_t pc, SimInst_t *pInst)
+{
+    uint16_t                word = m_Code[pc];
+    const SimEncoding_t    *pEnc = gDecode[m_Width == 16][word];
+    int                     operand, spBit, offMask;
+
+    memset(pInst, 0, sizeof(SimInst_t));
+    pInst->len = 1;
+    if (pEnc == NULL)
+    {
+        pInst->op = SIM_INVALID;
+        pInst->arg = word;
+        return;
+    }
+
+    pInst->op = pEnc->op;
+    operand = word & pEnc->mask;
+    spBit = m_Width == 16 ? 0x200 : 0x80;
+    offMask = spBit - 1;
+
+    switch (pEnc->argType)
+    {
+        case ARG_MEM:
+            pInst->mode = operand & spBit ? SIM_MODE_SP : SIM_MODE_IX;
+            pInst->arg = operand & offMask;
+            break;
+
+        case ARG_DIRECT:
+            pInst->mode = operand & spBit ? SIM_MODE_SP : SIM_MODE_DIRECT;
+            pInst->arg = operand & offMask;
+            break;
+
+        case ARG_STACK:
+            pInst->mode = SIM_MODE_SP;
+            pInst->arg = operand;
+            break;
+
+        case ARG_IMM:
+            pInst->arg = operand & 0xFF;
+            break;
+
+        case ARG_SIGNED:
+            // 10-bit or 8-bit two's complement
+            if (m_Width == 16)
+                pInst->arg = operand & 0x200 ? operand - 0x400 : operand;
+            else
+                pInst->arg = operand & 0x80 ? operand - 0x100 : operand;
+            break;
+
+        case ARG_BRANCH:
+            // 11-bit or 9-bit two's complement distance from the branch
+            if (m_Width == 16)
+                operand = operand & 0x400 ? operand - 0x800 : operand;
+            else
+                operand = operand & 0x100 ? operand - 0x200 : operand;
+            pInst->arg = (pc + operand) & (SIM_CODE_WORDS - 1);
+            break;
+
+        case ARG_JAL:
+        case ARG_COND:
+            pInst->arg = operand;
+            break;
+
+        case ARG_WORD:
+            pInst->len = 2;
+            pInst->arg = m_Code[(pc + 1) & (SIM_CODE_WORDS - 1)];
+            break;
+
+        case ARG_DIV:
+            // An even divisor form takes an immediate divisor
+            pInst->extra = operand;
+            if ((operand & 1) == 0)
+            {
+                pInst->len = 2;
+                pInst->arg = m_Code[(pc + 1) & (SIM_CODE_WORDS - 1)];
+            }
+            break;
+    }
+}
+
+/*
+=============================================================================
+Predecodes every word of the code space.  A word that is the operand of a
+two word instruction is decoded too, in case something jumps to it.
+=============================================================================
+*/
+void CSimulator::Predecode(void)
+{
+    int     pc;
+
+    for (pc = 0; pc < SIM_CODE_WORDS; pc++)
+        Decode(pc, &m_Inst[pc]);
+}
+
+/*
+=============================================================================
+Evaluates an if / iftt / ifte / ldz condition.  The unsigned conditions
+compare A with the operand of the last cmp / cpi through Z and C.
+=============================================================================
+*/
+int CSimulator::Condition(int cond)
+{
+    switch (cond)
+    {
+        case 0:     return m_Z;                 // eq / z
+        case 1:     return !m_Z;                // ne / nz
+        case 2:     return !m_C;                // nc
+        case 3:     return m_C;                 // c
+        case 4:     return !m_C && !m_Z;        // gt
+        case 5:     return m_C;                 // lt
+        case 6:     return !m_C;                // ge
+        case 7:     return m_C || m_Z;          // le
+        case 0x24:  return !m_S && !m_Z;        // sgt
+        case 0x25:  return m_S;                 // slt
+        case 0x26:  return !m_S;                // sge
+        case 0x27:  return m_S || m_Z;          // sle
+    }
+    return 0;
+}
+
+/// Length of the instruction at pc
+#define INST_LEN(pc)    m_Inst[(pc) & (SIM_CODE_WORDS - 1)].len
+
+/*
+=============================================================================
+Runs from the current state until the program stops or maxCycles is
+reached.  The first jal is taken to be crt0's call to main:  the run
+stops when something returns to the address after it, and the stack is
+measured from there.
+=============================================================================
+*/
+int CSimulator::Run(uint64_t maxCycles)
+{
+    const SimInst_t    *pInst;
+    uint16_t            addr, pc, next;
+    uint16_t            val;
+    int                 tmp, cycles, divisor, dividend, quot, rem;
+    int                 skipAfter = 0;
+    int                 op;
+
+    while (m_StopReason == SIM_STOP_NONE)
+    {
+        if (m_Cycles >= maxCycles)
+        {
+            m_StopReason = SIM_STOP_CYCLES;
+            break;
+        }
+
+        pc = m_Pc;
+        pInst = &m_Inst[pc & (SIM_CODE_WORDS - 1)];
+        next = pc + pInst->len;
+        op = pInst->op;
+        cycles = gSimOps[op].cycles;
+
+        if (m_pTrace != NULL)
+            fprintf(m_pTrace, "%04X  %04X  %-8s A=%02X IX=%04X SP=%04X RA=%04X %c%c\n",
+                    pc, m_Code[pc & (SIM_CODE_WORDS - 1)], gSimOps[op].name, m_A,
+                    m_Ix, m_Sp, m_Ra, m_Z ? 'Z' : '-', m_C ? 'C' : '-');
+
+        switch (op)
+        {
+            // =================================================================
+            // Accumulator and memory
+            // =================================================================
+            case SIM_LDI:
+                m_A = pInst->arg;
+                m_Z = m_A == 0;
+                break;
+
+            case SIM_LDAX:
+            case SIM_LDA:
+                m_A = Read8(Address(pInst));
+                m_Z = m_A == 0;
+                break;
+
+            case SIM_STAX:
+            case SIM_STA:
+                Write8(Address(pInst), m_A);
+                break;
+
+            case SIM_SWAP:
+                addr = Address(pInst);
+                tmp = Read8(addr);
+                Write8(addr, m_A);
+                m_A = tmp;
+                break;
+
+            case SIM_SWAPI:
+                // Exchange the nibbles of A
+                m_A = (m_A << 4) | (m_A >> 4);
+                break;
+
+            case SIM_LDAC:
+                // Low byte of the code word at IX
+                m_A = m_Code[m_Ix & (SIM_CODE_WORDS - 1)] & 0xFF;
+                m_Z = m_A == 0;
+                break;
+
+            case SIM_ADD:
+            case SIM_ADC:
+                val = op == SIM_ADD ? Read8(Address(pInst)) : pInst->arg;
+                tmp = m_A + val + m_C;
+                m_S = ((int8_t) (tmp & 0xFF) < 0) !=
+                      (((m_A ^ tmp) & (val ^ tmp) & 0x80) != 0);
+                m_C = tmp > 0xFF;
+                m_A = tmp;
+                m_Z = m_A == 0;
+                break;
+
+            case SIM_SUB:
+                val = Read8(Address(pInst));
+                tmp = m_A - val - m_C;
+                m_S = ((int8_t) (tmp & 0xFF) < 0) !=
+                      (((m_A ^ val) & (m_A ^ tmp) & 0x80) != 0);
+                m_C = tmp < 0;
+                m_A = tmp;
+                m_Z = m_A == 0;
+                break;
+
+            case SIM_CMP:
+            case SIM_CPI:
+                val = op == SIM_CMP ? Read8(Address(pInst)) : pInst->arg;
+                m_Z = m_A == val;
+                m_C = m_A < val;
+                m_S = (int8_t) m_A < (int8_t) val;
+                break;
+
+            case SIM_AND:
+                m_A &= Read8(Address(pInst));
+                m_Z = m_A == 0;
+                break;
+
+            case SIM_ANDI:
+                m_A &= pInst->arg;
+                m_Z = m_A == 0;
+                break;
+
+            case SIM_OR:
+                m_A |= Read8(Address(pInst));
+                m_Z = m_A == 0;
+                break;
+
+            case SIM_XOR:
+                m_A ^= Read8(Address(pInst));
+                m_Z = m_A == 0;
+                break;
+
+            case SIM_INX:
+                addr = Address(pInst);
+                tmp = Read8(addr) + 1;
+                Write8(addr, tmp);
+                m_C = tmp > 0xFF;
+                m_Z = (tmp & 0xFF) == 0;
+                break;
+
+            case SIM_DCX:
+                addr = Address(pInst);
+                tmp = Read8(addr) - 1;
+                Write8(addr, tmp);
+                m_C = tmp < 0;
+                m_Z = (tmp & 0xFF) == 0;
+                break;
+
+            case SIM_MUL:
+            case SIM_MULU:
+                // mul keeps the low byte of the product, mulu the high byte
+                val = Read8(Address(pInst));
+                if (m_AMode == 2)
+                    tmp = (int8_t) m_A * (int8_t) val;
+                else
+                    tmp = m_A * val;
+                m_A = op == SIM_MUL ? tmp : tmp >> 8;
+                m_Z = m_A == 0;
+                break;
+
+            case SIM_SHL:
+                m_C = m_A >> 7;
+                m_A <<= 1;
+                m_Z = m_A == 0;
+                break;
+
+            case SIM_SHR:
+                m_C = m_A & 1;
+                if (m_AMode == 2)
+                    m_A = (int8_t) m_A >> 1;
+                else
+                    m_A >>= 1;
+                m_Z = m_A == 0;
+                break;
+
+            case SIM_SHL16:
+            case SIM_SHR16:
+                // The MSB of a 16-bit value is at 1(sp)
+                addr = m_Sp + 1;
+                val = m_A | (Read8(addr) << 8);
+                if (op == SIM_SHL16)
+                {
+                    m_C = val >> 15;
+                    val <<= 1;
+                }
+                else
+                {
+                    m_C = val & 1;
+                    if (m_AMode == 2)
+                        val = (int16_t) val >> 1;
+                    else
+                        val >>= 1;
+                }
+                m_A = val;
+                Write8(addr, val >> 8);
+                m_Z = val == 0;
+                break;
+
+            case SIM_BTST:
+                m_Z = (m_A & (1 << (pInst->arg & 7))) == 0;
+                break;
+
+            case SIM_DIV:
+            case SIM_REM:
+                // ci / cc divide IX[7:0], ii / ic divide IX.  ic / cc divide
+                // by A (with the MSB at 1(sp) for ic), ii / ci by the word
+                // that follows
+                dividend = pInst->extra & 2 ? m_Ix & 0xFF : m_Ix;
+                if ((pInst->extra & 1) == 0)
+                    divisor = pInst->arg;
+                else if (pInst->extra & 2)
+                    divisor = m_A;
+                else
+                    divisor = m_A | (Read8(m_Sp + 1) << 8);
+                if (m_AMode == 2)
+                {
+                    if (pInst->extra & 2)
+                        dividend = (int8_t) dividend, divisor = (int8_t) divisor;
+                    else
+                        dividend = (int16_t) dividend, divisor = (int16_t) divisor;
+                }
+                if (divisor == 0)
+                {
+                    quot = -1;
+                    rem = dividend;
+                }
+                else
+                {
+                    quot = dividend / divisor;
+                    rem = dividend % divisor;
+                }
+                tmp = op == SIM_DIV ? quot : rem;
+                m_A = tmp;
+                if ((pInst->extra & 2) == 0)
+                    Write8(m_Sp + 1, tmp >> 8);
+                m_Ix = op == SIM_DIV ? rem : quot;
+                m_Z = (tmp & 0xFFFF) == 0;
+                break;
+
+            case SIM_LDDIV:
+                // The dividend goes to IX, bits 31:16 to RA
+                addr = m_Sp + pInst->arg;
+                m_Ix = Read16(addr);
+                m_Ra = Read16(addr + 2);
+                break;
+
+            case SIM_AMODE:
+                m_AMode = pInst->arg;
+                break;
+
+            // =================================================================
+            // Flags
+            // =================================================================
+            case SIM_LDC:
+                m_C = pInst->arg & 1;
+                break;
+
+            case SIM_LDZ:
+                switch (pInst->arg)
+                {
+                    case 0:     m_Z = 0; break;
+                    case 1:     m_Z = 1; break;
+                    case 2:     m_Z = !m_Z; break;
+                    case 3:     m_Z = m_C; break;
+                    default:    m_Z = Condition(pInst->arg); break;
+                }
+                break;
+
+            case SIM_NOTZ:
+                m_Z = !m_Z;
+                break;
+
+            case SIM_SAVEC:
+                m_SavedC = m_C;
+                break;
+
+            case SIM_RESTC:
+                m_C = m_SavedC;
+                break;
+
+            // =================================================================
+            // IX, SP and RA
+            // =================================================================
+            case SIM_LDX:
+                m_Ix = pInst->arg;
+                break;
+
+            case SIM_LDXX:
+                m_Ix = Read16(Address(pInst));
+                break;
+
+            case SIM_STXX:
+                Write16(Address(pInst), m_Ix);
+                break;
+
+            case SIM_ADX:
+                m_Ix += pInst->arg;
+                break;
+
+            case SIM_ADS:
+                m_Sp += pInst->arg;
+                break;
+
+            case SIM_ADDAX:
+                m_Ix += m_A;
+                break;
+
+            case SIM_ADDAXU:
+                m_Ix += m_A << 8;
+                break;
+
+            case SIM_SUBAX:
+                m_Ix -= m_A;
+                break;
+
+            case SIM_SUBAXU:
+                m_Ix -= m_A << 8;
+                break;
+
+            case SIM_TAX:
+                m_Ix = (m_Ix & 0xFF00) | m_A;
+                break;
+
+            case SIM_TAXU:
+                m_Ix = (m_Ix & 0x00FF) | (m_A << 8);
+                break;
+
+            case SIM_TXA:
+                m_A = m_Ix;
+                break;
+
+            case SIM_TXAU:
+                m_A = m_Ix >> 8;
+                break;
+
+            case SIM_XCHG_RA:
+                val = m_Ix, m_Ix = m_Ra, m_Ra = val;
+                break;
+
+            case SIM_XCHG_SP:
+                val = m_Ix, m_Ix = m_Sp, m_Sp = val;
+                break;
+
+            case SIM_XCHG_IA:
+                val = m_Ix & 0xFF;
+                m_Ix = (m_Ix & 0xFF00) | m_A;
+                m_A = val;
+                break;
+
+            case SIM_SPIX:
+                m_Ix = m_Sp;
+                break;
+
+            case SIM_CPX_RA:
+            case SIM_CPX_SP:
+                val = op == SIM_CPX_RA ? m_Ra : m_Sp;
+                m_Z = m_Ix == val;
+                m_C = m_Ix < val;
+                break;
+
+            case SIM_PUSH_A:
+                m_Sp--;
+                Write8(m_Sp, m_A);
+                break;
+
+            case SIM_POP_A:
+                m_A = Read8(m_Sp);
+                m_Sp++;
+                break;
+
+            case SIM_PUSH_IX:
+                m_Sp -= 2;
+                Write16(m_Sp, m_Ix);
+                break;
+
+            case SIM_POP_IX:
+                m_Ix = Read16(m_Sp);
+                m_Sp += 2;
+                break;
+
+            case SIM_SRA:
+                m_Sp -= 2;
+                Write16(m_Sp, m_Ra);
+                break;
+
+            case SIM_LRA:
+                m_Ra = Read16(m_Sp);
+                m_Sp += 2;
+                break;
+
+            // =================================================================
+            // Flow control
+            // =================================================================
+            case SIM_BR:
+                if (pInst->arg == pc)
+                    m_StopReason = SIM_STOP_LOOP;
+                next = pInst->arg;
+                cycles += gSimOps[op].taken;
+                break;
+
+            case SIM_BZ:
+            case SIM_BNZ:
+                if (m_Z == (op == SIM_BZ))
+                {
+                    next = pInst->arg;
+                    cycles += gSimOps[op].taken;
+                }
+                break;
+
+            case SIM_JAL:
+                // The first call is crt0's call to main
+                if (m_ExitPc == -1)
+                {
+                    m_ExitPc = next;
+                    m_StackBase = m_Sp;
+                    m_StackLow = m_Sp;
+                }
+                m_Ra = next;
+                next = pInst->arg;
+                break;
+
+            case SIM_CALL_IX:
+                m_Ra = next;
+                next = m_Ix;
+                m_Ix++;
+                break;
+
+            case SIM_JMP_IX:
+                next = m_Ix;
+                break;
+
+            case SIM_RET:
+            case SIM_RETS:
+                next = m_Ra;
+                if (next == m_ExitPc)
+                    m_StopReason = SIM_STOP_RETURN;
+                break;
+
+            case SIM_RETI:
+                m_A = pInst->arg;
+                next = m_Ra;
+                if (next == m_ExitPc)
+                    m_StopReason = SIM_STOP_RETURN;
+                break;
+
+            case SIM_RC:
+            case SIM_RZ:
+                if (op == SIM_RC ? m_C : m_Z)
+                {
+                    next = m_Ra;
+                    cycles += gSimOps[op].taken;
+                    if (next == m_ExitPc)
+                        m_StopReason = SIM_STOP_RETURN;
+                }
+                break;
+
+            case SIM_IF:
+                if (!Condition(pInst->arg))
+                {
+                    cycles += SKIP_CYCLES;
+                    next += INST_LEN(next);
+                }
+                break;
+
+            case SIM_IFTT:
+                if (!Condition(pInst->arg))
+                {
+                    cycles += 2 * SKIP_CYCLES;
+                    next += INST_LEN(next);
+                    next += INST_LEN(next);
+                }
+                break;
+
+            case SIM_IFTE:
+                // Run the first of the next two, or skip to the second
+                if (Condition(pInst->arg))
+                    skipAfter = 2;
+                else
+                {
+                    cycles += SKIP_CYCLES;
+                    next += INST_LEN(next);
+                }
+                break;
+
+            case SIM_DI:
+                m_IntEnable = 0;
+                break;
+
+            case SIM_EI:
+                m_IntEnable = 1;
+                break;
+
+            case SIM_NOP:
+                break;
+
+            case SIM_BRK:
+                m_StopReason = SIM_STOP_BRK;
+                break;
+
+            default:
+                // Invalid or floating point opcode
+                m_StopReason = SIM_STOP_INVALID;
+                m_ExitCode = m_Code[pc & (SIM_CODE_WORDS - 1)];
+                next = pc;
+                break;
+        }
+
+        // The instruction after the one ifte ran is skipped, unless it
+        // changed the flow
+        if (skipAfter && --skipAfter == 0 && next == (uint16_t) (pc + pInst->len))
+        {
+            cycles += SKIP_CYCLES;
+            next += INST_LEN(next);
+        }
+
+        m_Pc = next;
+        m_Cycles += cycles;
+        m_Instructions++;
+        m_OpCount[op]++;
+        m_OpCycles[op] += cycles;
+        if (m_Sp < m_StackLow)
+            m_StackLow = m_Sp;
+        if (m_pProfiler != NULL)
+            m_pProfiler->Step(pc, next, pInst, cycles);
+    }
+
+    return m_StopReason;
+}
+
+/*
+=============================================================================
+Reports the cycle count, the instruction mix and the stack high-water
+mark
+=============================================================================
+*/
+void CSimulator::Report(FILE *fd)
+{
+    static const char *pReasons[] =
+    {
+        "running", "main returned", "brk", "exit SFR written",
+        "branch to itself", "cycle limit reached", "invalid opcode"
+    };
+    std::vector<int>    ops;
+    int                 x;
+
+    fprintf(fd, "Stopped:          %s", pReasons[m_StopReason]);
+    if (m_StopReason == SIM_STOP_RETURN)
+        fprintf(fd, ", A = 0x%02X", m_A);
+    else if (m_StopReason == SIM_STOP_EXIT)
+        fprintf(fd, ", code %d", m_ExitCode);
+    else if (m_StopReason == SIM_STOP_INVALID)
+        fprintf(fd, ", 0x%04X", m_ExitCode);
+    fprintf(fd, " at 0x%04X\n", m_Pc);
+    fprintf(fd, "Cycles:           %llu\n", (unsigned long long) m_Cycles);
+    fprintf(fd, "Instructions:     %llu\n", (unsigned long long) m_Instructions);
+    if (m_Instructions)
+        fprintf(fd, "CPI:              %.2f\n", (double) m_Cycles / m_Instructions);
+    fprintf(fd, "Stack high-water: %d bytes (SP 0x%04X to 0x%04X)\n",
+            m_StackBase - m_StackLow, m_StackBase, m_StackLow);
+
+    // Most executed opcodes first
+    for (x = 0; x < SIM_OP_COUNT; x++)
+        if (m_OpCount[x])
+            ops.push_back(x);
+    std::stable_sort(ops.begin(), ops.end(), [this](int a, int b)
+            { return m_OpCount[a] > m_OpCount[b]; });
+
+    fprintf(fd, "\nInstruction mix\n");
+    fprintf(fd, "===============\n");
+    fprintf(fd, "%-10s %12s %7s %12s %7s\n", "Opcode", "Count", "%", "Cycles", "%");
+    for (x = 0; x < (int) ops.size(); x++)
+    {
+        fprintf(fd, "%-10s %12llu %6.2f%% %12llu %6.2f%%\n", gSimOps[ops[x]].name,
+                (unsigned long long) m_OpCount[ops[x]],
+                100.0 * m_OpCount[ops[x]] / m_Instructions,
+                (unsigned long long) m_OpCycles[ops[x]],
+                100.0 * m_OpCycles[ops[x]] / m_Cycles);
+    }
+}
+
+// vim: sw=4 ts=4
@@ -0,0 +1,225 @@
+// ------------------------------------------------------------------------------
+// (c) Copyright, Ken Pettit, BSD License
+//         All Rights Reserved
+// ------------------------------------------------------------------------------
+//
+//  File        : simulator.h
+//  Revision    : 1.0
+//  Author      : Ken Pettit
+//  Created     : 10/17/2026
+//
+// Description:
+//    Cycle counting instruction set simulator for the LISA core.  The code
+//    image is predecoded once into a table of operations indexed by the PC,
+//    so the run loop is a single switch over small integers.
+//
+// Modifications:
+//
+//    Author            Date        Ver  Description
+//    ================  ==========  ===  =======================================
+//    Ken Pettit        10/17/2026  1.0  Initial version
+//
+// ------------------------------------------------------------------------------
+
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+/// Size of the code space in words (15-bit jal addresses)
+#define SIM_CODE_WORDS      0x8000
+
+/// Size of the data space in bytes
+#define SIM_DATA_BYTES      0x10000
+
+/// Default cycle limit
+#define SIM_MAX_CYCLES      1000000000ULL
+
+/// Operations of the simulator, one per opcode of lisa_as
+enum
+{
+    SIM_INVALID = 0,
+    SIM_ADC, SIM_ADD, SIM_ADDAX, SIM_ADDAXU, SIM_ADS, SIM_ADX, SIM_AMODE,
+    SIM_AND, SIM_ANDI, SIM_BNZ, SIM_BR, SIM_BRK, SIM_BTST, SIM_BZ,
+    SIM_CALL_IX, SIM_CMP, SIM_CPI, SIM_CPX_RA, SIM_CPX_SP, SIM_DCX, SIM_DI,
+    SIM_DIV, SIM_EI, SIM_IF, SIM_IFTE, SIM_IFTT, SIM_INX, SIM_JAL, SIM_JMP_IX,
+    SIM_LDA, SIM_LDAC, SIM_LDAX, SIM_LDC, SIM_LDDIV, SIM_LDI, SIM_LDX,
+    SIM_LDXX, SIM_LDZ, SIM_LRA, SIM_MUL, SIM_MULU, SIM_NOP, SIM_NOTZ, SIM_OR,
+    SIM_POP_A, SIM_POP_IX, SIM_PUSH_A, SIM_PUSH_IX, SIM_RC, SIM_REM,
+    SIM_RESTC, SIM_RET, SIM_RETI, SIM_RETS, SIM_RZ, SIM_SAVEC, SIM_SHL,
+    SIM_SHL16, SIM_SHR, SIM_SHR16, SIM_SPIX, SIM_SRA, SIM_STA, SIM_STAX,
+    SIM_STXX, SIM_SUB, SIM_SUBAX, SIM_SUBAXU, SIM_SWAP, SIM_SWAPI, SIM_TAX,
+    SIM_TAXU, SIM_TXA, SIM_TXAU, SIM_XCHG_IA, SIM_XCHG_RA, SIM_XCHG_SP,
+    SIM_XOR, SIM_FLOAT,
+    SIM_OP_COUNT
+};
+
+/// Addressing of a memory operand
+#define SIM_MODE_DIRECT     0       // lda / sta without (sp)
+#define SIM_MODE_IX         1       // N(ix)
+#define SIM_MODE_SP         2       // N(sp)
+
+/// Name and cycle cost of an operation
+typedef struct SimOpInfo_s
+{
+    const char     *name;
+    int             cycles;         // Cycles when executed
+    int             taken;          // Extra cycles when a branch is taken
+} SimOpInfo_t;
+
+extern SimOpInfo_t  gSimOps[SIM_OP_COUNT];
+
+/// A predecoded instruction
+typedef struct SimInst_s
+{
+    uint8_t         op;             // SIM_* operation
+    uint8_t         mode;           // SIM_MODE_* of a memory operand
+    uint8_t         len;            // Length in words
+    uint8_t         extra;          // Second operand (div / rem divisor form)
+    int32_t         arg;            // Operand, offset or branch target
+} SimInst_t;
+
+/// Why the simulation stopped
+enum
+{
+    SIM_STOP_NONE = 0,
+    SIM_STOP_RETURN,                // main returned to crt0
+    SIM_STOP_BRK,                   // brk opcode
+    SIM_STOP_EXIT,                  // Write to the exit SFR
+    SIM_STOP_LOOP,                  // Branch to itself
+    SIM_STOP_CYCLES,                // Cycle limit reached
+    SIM_STOP_INVALID                // Invalid or unsupported opcode
+};
+
+class CProfiler;
+
+/// A memory-mapped special function register
+class CSfrHook
+{
+    public:
+        virtual         ~CSfrHook() {}
+
+        virtual uint8_t Read(uint16_t addr) = 0;
+        virtual void    Write(uint16_t addr, uint8_t value) = 0;
+};
+
+class CSimulator
+{
+    public:
+        CSimulator(int width = 14);
+        ~CSimulator();
+
+        int             LoadHexFile(const char *pFilename);
+        int             LoadCycleFile(const char *pFilename);
+        void            AddSfr(uint16_t addr, CSfrHook *pHook);
+        void            Reset(void);
+        int             Run(uint64_t maxCycles = SIM_MAX_CYCLES);
+        void            Report(FILE *fd);
+
+        // Processor state
+        uint16_t        m_Pc;
+        uint16_t        m_Ix;
+        uint16_t        m_Sp;
+        uint16_t        m_Ra;
+        uint8_t         m_A;
+        uint8_t         m_Z;
+        uint8_t         m_C;
+        uint8_t         m_S;            // Signed less-than of the last compare
+        uint8_t         m_SavedC;
+        uint8_t         m_AMode;
+        uint8_t         m_IntEnable;
+
+        // Statistics
+        uint64_t        m_Cycles;
+        uint64_t        m_Instructions;
+        uint64_t        m_OpCount[SIM_OP_COUNT];
+        uint64_t        m_OpCycles[SIM_OP_COUNT];
+        uint16_t        m_StackBase;    // SP when main was entered
+        uint16_t        m_StackLow;     // Lowest SP seen in main
+        int             m_StopReason;
+        int             m_ExitCode;
+
+        int             m_Width;
+        int             m_CodeSize;     // Words loaded
+        FILE           *m_pTrace;       // Trace of each instruction run
+        CProfiler      *m_pProfiler;    // Per-function profile of the run
+        uint16_t        m_Code[SIM_CODE_WORDS];
+        uint8_t         m_Data[SIM_DATA_BYTES];
+
+    private:
+        void            Predecode(void);
+        void            Decode(uint16_t pc, SimInst_t *pInst);
+        int             Condition(int cond);
+
+        inline uint8_t  Read8(uint16_t addr)
+        {
+            if (m_SfrIndex[addr])
+                return m_Sfrs[m_SfrIndex[addr]]->Read(addr);
+            return m_Data[addr];
+        }
+
+        inline void     Write8(uint16_t addr, uint8_t value)
+        {
+            if (m_SfrIndex[addr])
+                m_Sfrs[m_SfrIndex[addr]]->Write(addr, value);
+            else
+                m_Data[addr] = value;
+        }
+
+        inline uint16_t Read16(uint16_t addr)
+        {
+            return Read8(addr) | (Read8(addr + 1) << 8);
+        }
+
+        inline void     Write16(uint16_t addr, uint16_t value)
+        {
+            Write8(addr, value & 0xFF);
+            Write8(addr + 1, value >> 8);
+        }
+
+        inline uint16_t Address(const SimInst_t *pInst)
+        {
+            if (pInst->mode == SIM_MODE_SP)
+                return m_Sp + pInst->arg;
+            if (pInst->mode == SIM_MODE_IX)
+                return m_Ix + pInst->arg;
+            return pInst->arg;
+        }
+
+        SimInst_t       m_Inst[SIM_CODE_WORDS];
+        uint8_t         m_SfrIndex[SIM_DATA_BYTES];
+        std::vector<CSfrHook *> m_Sfrs;
+        int             m_ExitPc;       // Return address of the call to main
+};
+
+/// Writes each byte to a FILE, as a console
+class CConsoleSfr : public CSfrHook
+{
+    public:
+        CConsoleSfr(FILE *fd) { m_pFd = fd; }
+
+        virtual uint8_t Read(uint16_t addr) { return 0; }
+        virtual void    Write(uint16_t addr, uint8_t value) { fputc(value, m_pFd); }
+
+        FILE           *m_pFd;
+};
+
+/// Stops the simulation with the byte written as the exit code
+class CExitSfr : public CSfrHook
+{
+    public:
+        CExitSfr(CSimulator *pSim) { m_pSim = pSim; }
+
+        virtual uint8_t Read(uint16_t addr) { return 0; }
+        virtual void    Write(uint16_t addr, uint8_t value)
+        {
+            m_pSim->m_ExitCode = value;
+            m_pSim->m_StopReason = SIM_STOP_EXIT;
+        }
+
+        CSimulator     *m_pSim;
+};
+
+#endif /* SIMULATOR_H */
@@ -0,0 +1,29 @@
+// Copyright 2026 Ken Pettit <pettitkd@gmail.com>
+// Released under the MIT license.
+//
+// Adds of a literal right after a compare.  add and adc take in the carry
+// flag, which the compare had left set, and the adds did not clear it
+// first.
+//
+// Expect: 33
+
+char    level;
+int     count;
+
+char main(void) {
+    char r = 0;
+
+    level = 3;
+    count = 0;
+    if (level < 50)
+        r = r + 10;
+    if (level < 100)
+        r = r + 20;
+    if (level < 20)
+        count = count + 0x0102;
+    if (count == 0x0102)
+        r = r + 3;
+    return r;
+}
+
+void porta_isr(void) { }
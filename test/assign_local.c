@@ -0,0 +1,29 @@
+// Copyright 2026 Ken Pettit <pettitkd@gmail.com>
+// Released under the MIT license.
+//
+// Assignments of one local to another.  emit_assign passed a local on the
+// right as a load for emit_store to do, which only a store through a
+// pointer does, so the value stored was whatever acc held.
+//
+// Expect: 3
+
+char main(void) {
+    int     loc;
+    int     copy;
+    char    small;
+    char    other;
+    char    r = 0;
+
+    loc = 500;
+    small = 9;
+    other = 1;
+    copy = loc;
+    other = small;
+    if (copy == 500)
+        r = r + 1;
+    if (other == 9)
+        r = r + 2;
+    return r;
+}
+
+void porta_isr(void) { }
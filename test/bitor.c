@@ -0,0 +1,40 @@
+// Copyright 2026 Ken Pettit <pettitkd@gmail.com>
+// Released under the MIT license.
+//
+// Int | and ^ with a literal and with an unsigned char side.  The LSB of
+// a literal was or'ed into acc and then overwritten by the MSB, and an
+// unsigned char var on the right was or'ed in as if it were an int, so
+// the byte after it went into the MSB.
+//
+// Expect: 15
+
+int             wide;
+int             other;
+unsigned char   small;
+unsigned char   after;
+
+char main(void) {
+    char            r = 0;
+    int             v;
+    unsigned char   *ps = &small;
+
+    wide = 0x0102;
+    other = 0x4020;
+    small = 0x30;
+    after = 0x0F;
+    v = wide | 0x0404;
+    if (v == 0x0506)
+        r = r + 1;
+    v = other | small;
+    if (v == 0x4030)
+        r = r + 2;
+    v = other ^ small;
+    if (v == 0x4010)
+        r = r + 4;
+    v = *ps | other;
+    if (v == 0x4030)
+        r = r + 8;
+    return r;
+}
+
+void porta_isr(void) { }
@@ -0,0 +1,39 @@
+// Copyright 2026 Ken Pettit <pettitkd@gmail.com>
+// Released under the MIT license.
+//
+// Calls with char, int and pointer args.
+//
+// Expect: 15
+
+int     value;
+
+char add_char(char a, char b) {
+    return a + b;
+}
+
+int add_int(int a, int b) {
+    return a + b;
+}
+
+char read_ptr(int *p, char n) {
+    return (char) *p + n;
+}
+
+char main(void) {
+    char    r = 0;
+    int     sum;
+
+    value = 0x0140;
+    if (add_char(3, 4) == 7)
+        r = r + 1;
+    sum = add_int(0x0120, 0x0103);
+    if (sum == 0x0223)
+        r = r + 2;
+    if (read_ptr(&value, 2) == 0x42)
+        r = r + 4;
+    if (add_char(r, 1) == 8)
+        r = r + 8;
+    return r;
+}
+
+void porta_isr(void) { }
@@ -0,0 +1,30 @@
+// Copyright 2026 Ken Pettit <pettitkd@gmail.com>
+// Released under the MIT license.
+//
+// An unsigned char compared with a var turns the load of the var into a
+// cmp, so acc still has the left side.  It was left named as the right
+// side, so the next test of that var in the same condition skipped
+// loading it.
+//
+// Expect: 3
+
+unsigned char   ga;
+unsigned char   gb;
+
+char main(void) {
+    char            r = 0;
+    unsigned char   a;
+    unsigned char   b;
+
+    ga = 3;
+    gb = 5;
+    a = ga;
+    b = gb;
+    if (a == b || b == 5)
+        r = r + 1;
+    if (a == b || a == 3)
+        r = r + 2;
+    return r;
+}
+
+void porta_isr(void) { }
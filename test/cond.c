@@ -0,0 +1,32 @@
+// Copyright 2026 Ken Pettit <pettitkd@gmail.com>
+// Released under the MIT license.
+//
+// Conditions on values that are not tests.  A pointer compared with a
+// literal was compared in acc while it is in ix, a pointer used as a
+// ternary condition was not tested at all, and a value such as *p used
+// in && or || was not compared with zero.
+//
+// Expect: 15
+
+char    ch;
+char    zero;
+
+char main(void) {
+    char    r = 0;
+    char    *p = &ch;
+    char    *z = &zero;
+    char    *n = 0;
+
+    ch = 4;
+    zero = 0;
+    if (p != 0)
+        r = r + 1;
+    if (n == 0)
+        r = r + 2;
+    r = r + ((p + 1) ? 4 : 0);
+    if (*z || *p)
+        r = r + 8;
+    return r;
+}
+
+void porta_isr(void) { }
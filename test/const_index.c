@@ -0,0 +1,40 @@
+// Copyright 2026 Ken Pettit <pettitkd@gmail.com>
+// Released under the MIT license.
+//
+// Elements of a global array at a constant index.  The optimizer folds
+// the index into the displacement of the load or store, and scaled it by
+// the size of a pointer rather than of the element, and did so whatever
+// the byte offset, which must fit the 7 bit displacement.
+//
+// Expect: 15
+
+struct pair {
+    int     lo;
+    int     hi;
+};
+
+int             table[80];
+struct pair     pairs[4];
+
+char main(void) {
+    char    *raw = (char *) pairs;
+    int     *p = table;
+    char    r = 0;
+
+    pairs[3].lo = 0x0033;
+    table[70] = 0x0770;
+    raw = raw + 12;
+    if (*raw == 0x33)
+        r = r + 1;
+    if (pairs[3].lo == 0x0033)
+        r = r + 2;
+    p = p + 60;
+    p = p + 10;
+    if (*p == 0x0770)
+        r = r + 4;
+    if (table[70] == 0x0770)
+        r = r + 8;
+    return r;
+}
+
+void porta_isr(void) { }
@@ -0,0 +1,31 @@
+// Copyright 2026 Ken Pettit <pettitkd@gmail.com>
+// Released under the MIT license.
+//
+// Signed char compares against zero.  The peephole that drops a cpi 0
+// after a load, and, or or xor, which only set Z, also dropped it ahead of
+// a test of the sign.
+//
+// Expect: 3
+
+char    neg;
+char    pos;
+
+char main(void) {
+    char    r = 0;
+    char    a;
+    char    b;
+
+    neg = -3;
+    pos = 5;
+    a = neg;
+    b = pos;
+    if (a < 0)
+        r = r + 1;
+    if (b > 0)
+        r = r + 2;
+    if (b <= 0)
+        r = r + 4;
+    return r;
+}
+
+void porta_isr(void) { }
@@ -0,0 +1,29 @@
+// Copyright 2026 Ken Pettit <pettitkd@gmail.com>
+// Released under the MIT license.
+//
+// The names of the vars cached in acc and ix were not reset between
+// functions.  The function before main left ix named as the address of a
+// global, so main stored to that global through whatever ix held on entry.
+//
+// Expect: 1
+
+int     wide;
+char    small;
+
+int get_wide(void) {
+    return wide;
+}
+
+char main(void) {
+    char    r = 0;
+    int     v;
+
+    wide = 0x0102;
+    small = 0x30;
+    v = wide | 0x0400;
+    if (v == 0x0502)
+        r = r + 1;
+    return r;
+}
+
+void porta_isr(void) { }
@@ -0,0 +1,33 @@
+// Copyright 2026 Ken Pettit <pettitkd@gmail.com>
+// Released under the MIT license.
+//
+// Stores to and loads from the fields of a global struct.  These used to
+// go to the start of the struct whatever the field.
+//
+// Expect: 109
+
+struct point {
+    char    tag;
+    int     x;
+    char    y;
+};
+
+struct point    origin;
+struct point    corner;
+
+char main(void) {
+    char    t;
+
+    origin.tag = 7;
+    origin.x = 300;
+    origin.y = 9;
+    corner.tag = origin.y;
+    corner.x = origin.x;
+    corner.y = 40;
+
+    // 7 + 9 + 40 + (300 & 0xFF) + 9
+    t = origin.tag + corner.tag + corner.y;
+    return t + (char)corner.x + origin.y;
+}
+
+void porta_isr(void) { }
@@ -0,0 +1,34 @@
+// Copyright 2026 Ken Pettit <pettitkd@gmail.com>
+// Released under the MIT license.
+//
+// An if whose last statement is another if, so both branch to the same
+// label.  When the peephole turned the inner "if cond / br label" into a
+// reversed if, it deleted the label once its jal and br count reached
+// zero, which does not count the bz of the outer if.
+//
+// Expect: 46
+
+char    mass;
+char    steps;
+
+char main(void) {
+    char i;
+    char alive;
+
+    alive = 1;
+    mass = 100;
+    steps = 0;
+    for (i = 0; i < 8; i++) {
+        if (alive) {
+            mass = mass - 20;
+            if (mass < 50)
+                alive = 0;
+        }
+        steps = steps + 1;
+    }
+
+    // 40 + 8 + 0 - 2
+    return mass + steps + alive - 2;
+}
+
+void porta_isr(void) { }
@@ -0,0 +1,41 @@
+// Copyright 2026 Ken Pettit <pettitkd@gmail.com>
+// Released under the MIT license.
+//
+// Quotients and remainders of ints.  __udivint and __uremint did not save
+// the LSB of the dividend before loading it, __sdivint left the signed
+// mode on for the code after it, and the caller did not count the divisor
+// it pushes in its stack position.
+//
+// Expect: 15
+
+int     num;
+int     den;
+int     res;
+
+char main(void) {
+    char r = 0;
+
+    num = 1000;
+    den = 7;
+    res = num / den;
+    if (res == 142)
+        r = r + 1;
+    res = num % den;
+    if (res == 6)
+        r = r + 2;
+    num = -1000;
+    res = num / den;
+    if (res == -142)
+        r = r + 4;
+    num = 0x1234;
+    den = 0x0100;
+    res = num / den;
+    if (res == 0x12)
+        r = r + 8;
+    return r;
+}
+
+void porta_isr(void) { }
+
+// Called by the runtime library on a divide by zero
+void _div0_vec(void) { }
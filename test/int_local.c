@@ -0,0 +1,31 @@
+// Copyright 2026 Ken Pettit <pettitkd@gmail.com>
+// Released under the MIT license.
+//
+// Loads of int locals.  emit_lload stages the MSB in 1(sp) and then moved
+// the offset of the LSB by 2, for the scratch bytes a first 16 bit op
+// adds to the frame, even when the frame already had them.
+//
+// Expect: 3
+
+int     den;
+int     res;
+
+char main(void) {
+    int     loc;
+    char    r = 0;
+
+    loc = 500;
+    den = 7;
+    res = loc / den;
+    if (res == 71)
+        r = r + 1;
+    res = loc + loc;
+    if (res == 1000)
+        r = r + 2;
+    return r;
+}
+
+void porta_isr(void) { }
+
+// Called by the runtime library on a divide by zero
+void _div0_vec(void) { }
@@ -0,0 +1,36 @@
+// Copyright 2026 Ken Pettit <pettitkd@gmail.com>
+// Released under the MIT license.
+//
+// Products of two ints.  __umulint returned the MSB of nLow * mLow in
+// place of its LSB and never stored the MSB of the product, the caller did
+// not move that MSB above the popped multiplicand, and __smulint ran it in
+// the signed mode, which gives the wrong MSB of nLow * mLow.
+//
+// Expect: 7
+
+int     lhs;
+int     rhs;
+int     prod;
+
+char main(void) {
+    char r = 0;
+
+    lhs = 300;
+    rhs = 7;
+    prod = lhs * rhs;
+    if (prod == 2100)
+        r = r + 1;
+    lhs = -12;
+    rhs = 250;
+    prod = lhs * rhs;
+    if (prod == -3000)
+        r = r + 2;
+    lhs = 0x0101;
+    rhs = 0x0101;
+    prod = lhs * rhs;
+    if (prod == 0x0201)
+        r = r + 4;
+    return r;
+}
+
+void porta_isr(void) { }
@@ -0,0 +1,40 @@
+// Copyright 2026 Ken Pettit <pettitkd@gmail.com>
+// Released under the MIT license.
+//
+// Int return values.  With one return, the MSB was only saved if the last
+// instruction stored or swapped it, so returning a literal dropped it.
+//
+// Expect: 7
+
+int     wide;
+
+int get_wide(void) {
+    return wide;
+}
+
+int get_sum(int a) {
+    return a + wide;
+}
+
+int get_const(void) {
+    return 0x0405;
+}
+
+char main(void) {
+    char    r = 0;
+    int     v;
+
+    wide = 0x0102;
+    v = get_wide();
+    if (v == 0x0102)
+        r = r + 1;
+    v = get_sum(0x0101);
+    if (v == 0x0203)
+        r = r + 2;
+    v = get_const();
+    if (v == 0x0405)
+        r = r + 4;
+    return r;
+}
+
+void porta_isr(void) { }
@@ -0,0 +1,35 @@
+// Copyright 2026 Ken Pettit <pettitkd@gmail.com>
+// Released under the MIT license.
+//
+// A leaf function that copies a struct swaps addresses through ra.  The
+// sra and lra around it were dropped as if nothing in it changed ra, so
+// it returned to the source address of the copy.
+//
+// Expect: 3
+
+struct rec {
+    char    tag;
+    char    len;
+};
+
+struct rec  ra;
+struct rec  rb;
+
+void copy_rec(void) {
+    rb = ra;
+}
+
+char main(void) {
+    char    r = 0;
+
+    ra.tag = 3;
+    ra.len = 4;
+    copy_rec();
+    if (rb.tag == 3)
+        r = r + 1;
+    if (rb.len == 4)
+        r = r + 2;
+    return r;
+}
+
+void porta_isr(void) { }
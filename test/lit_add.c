@@ -0,0 +1,21 @@
+// Copyright 2026 Ken Pettit <pettitkd@gmail.com>
+// Released under the MIT license.
+//
+// Adds of a literal to a char local while something is pushed on the
+// stack.  The local's offset already held the push depth, and the add
+// counted it again, so it read a byte past the local.
+//
+// Expect: 11
+
+unsigned char script[8] = { 1, 4, 2, 7, 0, 3, 1, 9 };
+
+char main(void) {
+    unsigned char i, r;
+
+    r = 0;
+    for (i = 0; i < 4; i = i + 2)
+        r = r + script[i + 1];
+    return r;
+}
+
+void porta_isr(void) { }
@@ -0,0 +1,36 @@
+// Copyright 2026 Ken Pettit <pettitkd@gmail.com>
+// Released under the MIT license.
+//
+// Stores of non-literal values to fields of a local struct.  They were
+// saved at the offset of the struct and sized by it, not by the field.
+//
+// Expect: 7
+
+struct rec {
+    char    tag;
+    char    len;
+    int     val;
+};
+
+char    small;
+int     wide;
+
+char main(void) {
+    char        r = 0;
+    struct rec  p;
+
+    small = 9;
+    wide = 0x0209;
+    p.tag = 1;
+    p.len = small;
+    p.val = wide;
+    if (p.len == 9)
+        r = r + 1;
+    if (p.val == 0x0209)
+        r = r + 2;
+    if (p.tag == 1)
+        r = r + 4;
+    return r;
+}
+
+void porta_isr(void) { }
@@ -0,0 +1,32 @@
+// Copyright 2026 Ken Pettit <pettitkd@gmail.com>
+// Released under the MIT license.
+//
+// Locals initialized from an expression.  The init was saved under the name
+// read from the init node, which has none, so the store was lost.
+//
+// Expect: 7
+
+char    small;
+int     wide;
+
+char main(void) {
+    char    r = 0;
+
+    small = 9;
+    wide = 0x0209;
+    {
+        char    x = small;
+        int     y = wide;
+        char    z = small + 1;
+
+        if (x == 9)
+            r = r + 1;
+        if (y == 0x0209)
+            r = r + 2;
+        if (z == 10)
+            r = r + 4;
+    }
+    return r;
+}
+
+void porta_isr(void) { }
@@ -0,0 +1,37 @@
+// Copyright 2026 Ken Pettit <pettitkd@gmail.com>
+// Released under the MIT license.
+//
+// Post-increment and decrement of global variables and of the fields of a
+// global struct.  These used to load ix from the string label of the node
+// and emitted "ldx (null)".
+//
+// Expect: 28
+
+struct counter {
+    char    hits;
+    int     total;
+};
+
+struct counter  stats;
+int             events;
+char            ticks;
+
+char main(void) {
+    char i;
+
+    stats.hits = 1;
+    stats.total = 250;
+    events = 10;
+    ticks = 3;
+    for (i = 0; i < 10; i++) {
+        stats.hits++;
+        stats.total++;
+        events--;
+        ticks++;
+    }
+
+    // 11 + (260 & 0xFF) + 0 + 13
+    return stats.hits + (char)stats.total + events + ticks;
+}
+
+void porta_isr(void) { }
@@ -0,0 +1,37 @@
+// Copyright 2026 Ken Pettit <pettitkd@gmail.com>
+// Released under the MIT license.
+//
+// Post-increment of pointers and of elements reached through one.  A
+// pointer always stepped by one byte and the expression had the stepped
+// value.  An int element stepped through a pointer used a bnc, which lisa
+// has no such branch for, and a char one was stored back to an address
+// that loading the value had replaced.
+//
+// Expect: 7
+
+int     words[4];
+char    bytes[4];
+
+char main(void) {
+    char    r = 0;
+    int     *pw = words;
+    char    *pb = bytes;
+    int     *q;
+
+    words[1] = 0x0102;
+    words[3] = 0;
+    bytes[2] = 0;
+    pw++;
+    if (*pw == 0x0102)
+        r = r + 1;
+    q = pw++;
+    if (*q == 0x0102)
+        r = r + 2;
+    pb[2]++;
+    pw[1]++;
+    if (bytes[2] == 1 && words[3] == 1)
+        r = r + 4;
+    return r;
+}
+
+void porta_isr(void) { }
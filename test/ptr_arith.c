@@ -0,0 +1,48 @@
+// Copyright 2026 Ken Pettit <pettitkd@gmail.com>
+// Released under the MIT license.
+//
+// Pointers plus a variable index.  The pointer pushed while the index is
+// computed was popped before the add, which then read the MSB of the
+// index from below the stack, the adds took in a carry they had not
+// cleared, an int index of a 4 byte element was scaled by 2, and ix was
+// still taken to hold the pointer var after it was moved.
+//
+// Expect: 31
+
+int     words[8];
+struct pair {
+    int     lo;
+    int     hi;
+};
+
+struct pair     pairs[4];
+char    bytes[8];
+
+char main(void) {
+    int     *pw = words;
+    struct pair *pp = pairs;
+    char    *raw = (char *) pairs;
+    char    *pb = bytes;
+    char    i = 5;
+    int     j = 3;
+    char    r = 0;
+
+    words[5] = 0x0505;
+    words[3] = 0x0303;
+    bytes[5] = 0x55;
+    raw = raw + 12;
+    *raw = 0x33;
+    if (*(pw + i) == 0x0505)
+        r = r + 1;
+    if (*(pw + j) == 0x0303)
+        r = r + 2;
+    if (*(pb + i) == 0x55)
+        r = r + 4;
+    if (*(pb + j) == 0)
+        r = r + 8;
+    if ((pp + j)->lo == 0x33)
+        r = r + 16;
+    return r;
+}
+
+void porta_isr(void) { }
@@ -0,0 +1,50 @@
+// Copyright 2026 Ken Pettit <pettitkd@gmail.com>
+// Released under the MIT license.
+//
+// Int ops on two loads through local pointers.  The second pointer was
+// read from its frame offset without the two bytes pushed for the left
+// operand, and its load through ix was skipped as if acc already held it,
+// since loads through ix were cached under the name of the node.
+//
+// Expect: 7
+
+int     lhs;
+int     rhs;
+
+char add_ok(void) {
+    char    r = 1;
+    int     *pl = &lhs;
+    int     *pr = &rhs;
+
+    if (*pl + *pr == 0x0305)
+        return r;
+    return 0;
+}
+
+char cmp_ok(void) {
+    char    r = 2;
+    int     *pl = &lhs;
+    int     *pr = &rhs;
+
+    if (*pl != *pr)
+        return r;
+    return 0;
+}
+
+char and_ok(void) {
+    char    r = 4;
+    int     *pl = &lhs;
+    int     *pr = &rhs;
+
+    if ((*pl & *pr) == 0x0002)
+        return r;
+    return 0;
+}
+
+char main(void) {
+    lhs = 0x0102;
+    rhs = 0x0203;
+    return add_ok() + cmp_ok() + and_ok();
+}
+
+void porta_isr(void) { }
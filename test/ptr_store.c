@@ -0,0 +1,31 @@
+// Copyright 2026 Ken Pettit <pettitkd@gmail.com>
+// Released under the MIT license.
+//
+// A pointer stored through a pointer.  The value is in ix, not acc, and
+// loading the address of the store replaced it, so acc was stored instead.
+//
+// Expect: 3
+
+char        *slot;
+char        ch;
+char        cd;
+
+char main(void) {
+    char        r = 0;
+    char        **pp = &slot;
+    char        *q;
+
+    ch = 5;
+    cd = 6;
+    *pp = &ch;
+    q = *pp;
+    if (*q == 5)
+        r = r + 1;
+    *pp = &cd;
+    q = *pp;
+    if (*q == 6)
+        r = r + 2;
+    return r;
+}
+
+void porta_isr(void) { }
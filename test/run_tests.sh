@@ -0,0 +1,94 @@
+#!/bin/bash
+#
+# Module:  Code generation tests for lisa-tools
+#
+# Copyright 2026 by Ken Pettit <pettitkd@gmail.com>
+#
+# Builds each test program in this directory at -O0, -O1, -O2 and -Os
+# through lisa_cc, lisa_ld and the runtime library, runs it on lisa_sim and
+# checks the value main returns against the "Expect:" comment in the source.
+# Extra lisa_cc options for a test can be given by a "Flags:" comment.
+#
+# usage:  run_tests.sh [-n cycles] [test...]
+#
+#    -n cycles       Cycle limit of each run (default 1000000)
+#
+# ------------------------------------------------------------------------------
+
+TESTDIR=$(cd "$(dirname "$0")" && pwd)
+TOP=$(dirname "$TESTDIR")
+CC=$TOP/lisa_cc/lisa_cc
+LD=$TOP/lisa_ld/lisa_ld
+SIM=$TOP/lisa_sim/lisa_sim
+LIBDIR=$TOP/lisa_as/lib/out
+SCRIPT=$TOP/lisa_ld/lisa.ld
+OUT=$TESTDIR/out
+LEVELS="0 1 2 s"
+
+maxcycles=1000000
+
+while getopts "n:h" opt; do
+    case $opt in
+        n) maxcycles=$OPTARG ;;
+        *) sed -n '/^# usage/,/^# ---/p' "$0" | sed 's/^# \{0,1\}//;$d'; exit 1 ;;
+    esac
+done
+shift $((OPTIND - 1))
+
+if [ $# -gt 0 ]; then
+    tests="$*"
+else
+    tests=$(cd "$TESTDIR" && ls *.c | sed 's/\.c$//')
+fi
+
+for tool in "$CC" "$LD" "$SIM" "$LIBDIR/crt0.rel" "$LIBDIR/liblisa.lar"; do
+    if [ ! -f "$tool" ]; then
+        echo "Missing $tool, run make first"
+        exit 1
+    fi
+done
+mkdir -p "$OUT"
+
+passed=0
+failed=0
+
+for t in $tests; do
+    src=$TESTDIR/$t.c
+    expect=$(sed -n 's/.*Expect: *\([0-9-]*\).*/\1/p' "$src" | head -1)
+    srcflags=$(sed -n 's/.*Flags: *//p' "$src" | head -1)
+
+    for o in $LEVELS; do
+        base=$OUT/$t.O$o
+
+        if ! "$CC" -w -O$o $srcflags -c -o "$base.rel" "$src" > "$base.cclog" 2>&1; then
+            result="build failed"
+        elif ! "$LD" -T "$SCRIPT" -o "$base.lst" "$LIBDIR/crt0.rel" "$base.rel" \
+                "$LIBDIR/liblisa.lar" > "$base.ldlog" 2>&1; then
+            result="link failed"
+        else
+            "$SIM" -w 16 -n "$maxcycles" "$base.lst" > "$base.simlog" 2>&1
+            stopped=$(sed -n 's/^Stopped: *//p' "$base.simlog")
+            case "$stopped" in
+                "main returned, A = "*)
+                    a=$(( $(echo "$stopped" | sed 's/.*A = \(0x[0-9A-F]*\).*/\1/') ))
+                    if [ $a -eq $(( expect & 0xFF )) ]; then
+                        result="ok"
+                    else
+                        result="returned $a, expected $expect"
+                    fi
+                    ;;
+                *)  result="stopped: $stopped" ;;
+            esac
+        fi
+
+        if [ "$result" = "ok" ]; then
+            passed=$((passed + 1))
+        else
+            failed=$((failed + 1))
+            printf "%-16s -O%-2s %s\n" $t $o "$result"
+        fi
+    done
+done
+
+echo "$passed passed, $failed failed"
+[ $failed -eq 0 ]
@@ -0,0 +1,41 @@
+// Copyright 2026 Ken Pettit <pettitkd@gmail.com>
+// Released under the MIT license.
+//
+// Int add stages its left operand in 0(sp) and 1(sp) before calling
+// __addint, as do int compares, subtracts and ands.  When nothing else in
+// the function had reserved those two bytes, the staging wrote over the
+// first local.
+//
+// Expect: 15
+
+struct rec {
+    char    tag;
+    char    len;
+};
+
+struct rec  ra;
+char        ca;
+char        cb;
+
+char main(void) {
+    char        r = 0;
+    char        *pa = &ca;
+    char        *pb = &cb;
+    struct rec  *ps = &ra;
+
+    ra.tag = 3;
+    ra.len = 5;
+    ca = 6;
+    cb = 8;
+    if (*pa == 6 && *pb == 8)
+        r = r + 1;
+    if (ps->tag == 3 && ps->len == 5)
+        r = r + 2;
+    if (*pa + *pb == 14)
+        r = r + 4;
+    if (ps->tag + ps->len == 8)
+        r = r + 8;
+    return r;
+}
+
+void porta_isr(void) { }
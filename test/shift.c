@@ -0,0 +1,40 @@
+// Copyright 2026 Ken Pettit <pettitkd@gmail.com>
+// Released under the MIT license.
+//
+// Shifts done in a loop, and shifts of a char promoted to int.  The shift
+// loops branched back with "br -3", which is not the three lines it was
+// meant to repeat, and a shift took the type of its left operand before
+// the promotion, so a char shifted left lost its MSB.
+//
+// Expect: 31
+
+char    bits;
+char    count;
+int     wide;
+int     res;
+
+char main(void) {
+    char r = 0;
+
+    bits = 0x41;
+    count = 3;
+    wide = 0x0123;
+    res = wide << 9;
+    if (res == 0x4600)
+        r = r + 1;
+    res = wide >> 7;
+    if (res == 0x0002)
+        r = r + 2;
+    res = 1 << count;
+    if (res == 0x0008)
+        r = r + 4;
+    res = 0x0100 >> count;
+    if (res == 0x0020)
+        r = r + 8;
+    res = bits << 4;
+    if (res == 0x0410)
+        r = r + 16;
+    return r;
+}
+
+void porta_isr(void) { }
@@ -0,0 +1,31 @@
+// Copyright 2026 Ken Pettit <pettitkd@gmail.com>
+// Released under the MIT license.
+//
+// A store to a struct field stages the value in 0(sp) and flags it, so a
+// store through a pointer reloads it from there.  A store to the field of
+// a named struct never cleared the flag, so the next store through a
+// pointer stored that stale value instead of its own.
+//
+// Expect: 3
+
+struct rec {
+    char    tag;
+    int     val;
+};
+
+struct rec  ra;
+char        buf[8];
+
+char main(void) {
+    char    r = 0;
+
+    ra.val = 0x0405;
+    buf[7] = 9;
+    if (buf[7] == 9)
+        r = r + 1;
+    if (ra.val == 0x0405)
+        r = r + 2;
+    return r;
+}
+
+void porta_isr(void) { }
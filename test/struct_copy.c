@@ -0,0 +1,53 @@
+// Copyright 2026 Ken Pettit <pettitkd@gmail.com>
+// Released under the MIT license.
+//
+// Struct assignment.  A struct of 8 bytes or less was stored as if it were
+// a scalar, a larger one was copied with x86 moves left from the 8cc back
+// end, and the address of a struct field was taken with an x86 add.
+//
+// Expect: 15
+
+struct small {
+    char    tag;
+    int     val;
+};
+
+struct big {
+    char    tag;
+    int     val;
+    char    buf[8];
+};
+
+struct outer {
+    char            id;
+    struct small    in;
+};
+
+struct small    sa;
+struct small    sb;
+struct big      ba;
+struct big      bb;
+struct outer    oa;
+
+char main(void) {
+    char    r = 0;
+
+    ba.buf[7] = 9;
+    bb = ba;
+    if (bb.buf[7] == 9)
+        r = r + 1;
+    sa.tag = 3;
+    sa.val = 0x0405;
+    sb = sa;
+    if (sb.tag == 3)
+        r = r + 2;
+    if (sb.val == 0x0405)
+        r = r + 4;
+    oa.id = 1;
+    oa.in = sa;
+    if (oa.id == 1 && oa.in.tag == 3)
+        r = r + 8;
+    return r;
+}
+
+void porta_isr(void) { }
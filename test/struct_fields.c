@@ -0,0 +1,32 @@
+// Copyright 2026 Ken Pettit <pettitkd@gmail.com>
+// Released under the MIT license.
+//
+// Sizes of struct fields.  A field with no bit width has a bitsize of -1,
+// which the test for a bitfield of 8 bits or less also took, so every
+// field was made a char.
+//
+// Expect: 35
+
+struct reading {
+    char    channel;
+    int     value;
+    int     limit;
+};
+
+struct reading  last;
+
+char main(void) {
+    char r = 0;
+
+    last.channel = 5;
+    last.value = 0x1234;
+    last.limit = 0x0345;
+    if (last.value == 0x1234)
+        r = r + 10;
+    if (last.limit == 0x0345)
+        r = r + 20;
+
+    return r + last.channel;
+}
+
+void porta_isr(void) { }
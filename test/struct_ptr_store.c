@@ -0,0 +1,27 @@
+// Copyright 2026 Ken Pettit <pettitkd@gmail.com>
+// Released under the MIT license.
+//
+// Stores to the fields of a struct through a pointer.  lisa_cc used to read
+// the pointed to type of the field to find the size of the store, and
+// crashed on a field that is not a pointer.
+//
+// Expect: 77
+
+struct item {
+    char    id;
+    int     count;
+};
+
+struct item     stock;
+
+char main(void) {
+    struct item *p = &stock;
+
+    p->id = 25;
+    p->count = 0x1234;
+
+    // 25 + 0x34
+    return stock.id + (char)stock.count;
+}
+
+void porta_isr(void) { }